@@ -176,7 +176,7 @@ bool Authentication::setup(Application *app)
 {
     return connect(app, &Application::postForked, this, [=] {
         auth = this;
-    });
+    }, Qt::DirectConnection);
 }
 
 AuthenticationRealm *AuthenticationPrivate::realm(const QString &realmName) const
@@ -106,11 +106,11 @@ bool CSRFProtection::setup(Application *app)
 
     connect(app, &Application::postForked, this, [](Application *app){
         csrf = app->plugin<CSRFProtection *>();
-    });
+    }, Qt::DirectConnection);
 
     connect(app, &Application::beforeDispatch, this, [d](Context *c) {
         d->beforeDispatch(c);
-    });
+    }, Qt::DirectConnection);
 
     return true;
 }
@@ -17,6 +17,7 @@
  */
 
 #include "memcached_p.h"
+#include "memcachedasync_p.h"
 
 #include <Cutelyst/Application>
 #include <Cutelyst/Engine>
@@ -24,6 +25,11 @@
 
 #include <utility>
 #include <QStringList>
+#include <QHash>
+#include <QCache>
+#include <QMutex>
+#include <QThread>
+#include <QCoreApplication>
 #include <QLoggingCategory>
 
 Q_LOGGING_CATEGORY(C_MEMCACHED, "cutelyst.plugin.memcached", QtWarningMsg)
@@ -31,6 +37,193 @@ Q_LOGGING_CATEGORY(C_MEMCACHED, "cutelyst.plugin.memcached", QtWarningMsg)
 using namespace Cutelyst;
 
 static thread_local Memcached *mcd = nullptr;
+
+namespace {
+// libmemcached handles must not be used by more than one thread, nor
+// survive a fork with their connections, so each worker thread clones
+// the configured handle once it started
+struct ThreadHandle {
+    ~ThreadHandle() {
+        if (memc) {
+            memcached_free(memc);
+        }
+    }
+    memcached_st *memc = nullptr;
+};
+}
+static thread_local ThreadHandle threadHandle;
+
+namespace {
+// Makes libmemcached queue the requests of a batch in its write buffers
+// without waiting for the answers, the binary protocol then uses the
+// quiet commands, the buffers are sent by flush()
+class MemcachedBatch
+{
+public:
+    explicit MemcachedBatch(memcached_st *memc)
+        : m_memc(memc)
+        , m_bufferRequests(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS))
+        , m_noReply(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_NOREPLY))
+    {
+        memcached_behavior_set(m_memc, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 1);
+        memcached_behavior_set(m_memc, MEMCACHED_BEHAVIOR_NOREPLY, 1);
+    }
+
+    ~MemcachedBatch()
+    {
+        memcached_behavior_set(m_memc, MEMCACHED_BEHAVIOR_NOREPLY, m_noReply);
+        memcached_behavior_set(m_memc, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, m_bufferRequests);
+    }
+
+    memcached_return_t flush()
+    {
+        return memcached_flush_buffers(m_memc);
+    }
+
+private:
+    memcached_st *m_memc;
+    uint64_t m_bufferRequests;
+    uint64_t m_noReply;
+};
+}
+
+namespace {
+struct AsyncConnections {
+    ~AsyncConnections() { qDeleteAll(connections); }
+    QHash<QString, MemcachedAsyncConnection *> connections;
+};
+}
+// The connections are driven by the event loop of their thread, their
+// sockets and timers must be gone before its event dispatcher is, which
+// thread local destructors run after
+static thread_local AsyncConnections *asyncConnections = nullptr;
+
+static void deleteAsyncConnections()
+{
+    delete asyncConnections;
+    asyncConnections = nullptr;
+}
+
+static AsyncConnections *threadAsyncConnections()
+{
+    if (!asyncConnections) {
+        asyncConnections = new AsyncConnections;
+
+        // QThread::finished is emitted on the thread itself, but not for the main one
+        QThread *thread = QThread::currentThread();
+        QCoreApplication *app = QCoreApplication::instance();
+        if (!app || app->thread() == thread) {
+            qAddPostRoutine(deleteAsyncConnections);
+        } else {
+            QObject::connect(thread, &QThread::finished, deleteAsyncConnections);
+        }
+    }
+    return asyncConnections;
+}
+
+namespace {
+struct LocalCacheEntry {
+    QByteArray value;
+    uint64_t cas;
+    qint64 expires;
+};
+
+// Ring of the keys written by the threads of this process, each thread
+// drops them from its own cache when it uses it next, a null key stands
+// for a flush
+struct LocalCacheInvalidations {
+    enum { Size = 256 };
+    QMutex mutex;
+    QString keys[Size];
+    QAtomicInt serial;
+};
+
+struct LocalCache {
+    QCache<QString, LocalCacheEntry> entries;
+    uint serial = 0;
+};
+}
+Q_GLOBAL_STATIC(LocalCacheInvalidations, localCacheInvalidations)
+static thread_local LocalCache localCache;
+static QAtomicInteger<quint64> localCacheHitCount;
+static QAtomicInteger<quint64> localCacheMissCount;
+
+static inline QString localCacheKey(const QString &groupKey, const QString &key)
+{
+    // Memcached keys can not contain spaces
+    return groupKey.isEmpty() ? key : groupKey + QLatin1Char(' ') + key;
+}
+
+// Applies the writes of all threads since the last call, returning the
+// serial of the last write seen
+static uint localCacheSync(int size)
+{
+    if (Q_UNLIKELY(localCache.entries.maxCost() != size)) {
+        localCache.entries.setMaxCost(size);
+    }
+
+    LocalCacheInvalidations *inv = localCacheInvalidations;
+    if (uint(inv->serial.loadAcquire()) == localCache.serial) {
+        return localCache.serial;
+    }
+
+    QMutexLocker locker(&inv->mutex);
+    const uint serial = uint(inv->serial.load());
+    if (serial - localCache.serial > LocalCacheInvalidations::Size) {
+        localCache.entries.clear();
+    } else {
+        for (uint i = localCache.serial; i != serial; ++i) {
+            const QString &key = inv->keys[i % LocalCacheInvalidations::Size];
+            if (key.isNull()) {
+                localCache.entries.clear();
+            } else {
+                localCache.entries.remove(key);
+            }
+        }
+    }
+    localCache.serial = serial;
+
+    return serial;
+}
+
+static void localCacheInsert(const QString &localKey, const QByteArray &value, uint64_t cas, uint serial, MemcachedPrivate *d)
+{
+    // Do not cache a value that was written while it was fetched
+    LocalCacheInvalidations *inv = localCacheInvalidations;
+    if (uint(inv->serial.loadAcquire()) != serial) {
+        QMutexLocker locker(&inv->mutex);
+        const uint current = uint(inv->serial.load());
+        if (current - serial > LocalCacheInvalidations::Size) {
+            return;
+        }
+        for (uint i = serial; i != current; ++i) {
+            const QString &key = inv->keys[i % LocalCacheInvalidations::Size];
+            if (key.isNull() || key == localKey) {
+                return;
+            }
+        }
+    }
+
+    localCache.entries.insert(localKey, new LocalCacheEntry{value, cas, d->localCacheClock.elapsed() + d->localCacheTtl});
+}
+
+static bool localCacheFind(const QString &localKey, QByteArray *value, uint64_t *cas, MemcachedPrivate *d)
+{
+    LocalCacheEntry *entry = localCache.entries.object(localKey);
+    if (entry) {
+        if (entry->expires > d->localCacheClock.elapsed()) {
+            *value = entry->value;
+            if (cas) {
+                *cas = entry->cas;
+            }
+            localCacheHitCount.fetchAndAddRelaxed(1);
+            return true;
+        }
+        localCache.entries.remove(localKey);
+    }
+    localCacheMissCount.fetchAndAddRelaxed(1);
+    return false;
+}
 const time_t Memcached::expirationNotAdd = MEMCACHED_EXPIRATION_NOT_ADD;
 
 Memcached::Memcached(Application *parent) :
@@ -193,8 +386,23 @@ bool Memcached::setup(Application *app)
             qCInfo(C_MEMCACHED, "Compression: disabled");
         }
 
+        d->asyncTimeout = map.value(QStringLiteral("async_timeout"), d->defaultConfig.value(QStringLiteral("async_timeout"), 1000)).toInt();
+        d->keyPrefix = map.value(QStringLiteral("namespace"), d->defaultConfig.value(QStringLiteral("namespace"))).toString().toUtf8();
+        d->hashWithNamespace = map.value(QStringLiteral("hash_with_namespace"), d->defaultConfig.value(QStringLiteral("hash_with_namespace"), false)).toBool();
+        d->asyncSupported = !useUDP;
+
+        d->localCacheSize = map.value(QStringLiteral("local_cache_size"), d->defaultConfig.value(QStringLiteral("local_cache_size"), 0)).toInt();
+        d->localCacheTtl = map.value(QStringLiteral("local_cache_ttl"), d->defaultConfig.value(QStringLiteral("local_cache_ttl"), 2000)).toLongLong();
+        if (d->localCacheSize > 0) {
+            d->localCacheClock.start();
+            qCInfo(C_MEMCACHED, "Local cache: enabled (Size: %i values per thread, TTL: %lli ms)", d->localCacheSize, d->localCacheTtl);
+        } else {
+            qCInfo(C_MEMCACHED, "Local cache: disabled");
+        }
+
         const QString encKey = map.value(QStringLiteral("encryption_key")).toString();
         if (!encKey.isEmpty()) {
+            d->asyncSupported = false;
             const QByteArray encKeyBa = encKey.toUtf8();
             const memcached_return_t rt = memcached_set_encoding_key(new_memc, encKeyBa.constData(), encKeyBa.size());
             if (Q_LIKELY(memcached_success(rt))) {
@@ -215,6 +423,7 @@ bool Memcached::setup(Application *app)
             if (Q_LIKELY(memcached_success(rt))) {
                 qCInfo(C_MEMCACHED, "SASL authentication: enabled");
                 d->saslEnabled = true;
+                d->asyncSupported = false;
             } else {
                 qCWarning(C_MEMCACHED, "Failed to enable SASL authentication: %s", memcached_strerror(new_memc, rt));
             }
@@ -233,8 +442,17 @@ bool Memcached::setup(Application *app)
 
     if (ok) {
         connect(app, &Application::postForked, this, [=] {
+            memcached_st *memc = memcached_clone(nullptr, d->memc);
+            if (Q_UNLIKELY(!memc)) {
+                qCCritical(C_MEMCACHED) << "Failed to create the memcached handle of this worker thread";
+                return;
+            }
+            if (threadHandle.memc) {
+                memcached_free(threadHandle.memc);
+            }
+            threadHandle.memc = memc;
             mcd = this;
-        });
+        }, Qt::DirectConnection);
         app->loadTranslations(QStringLiteral("plugin_memcached"));
     } else {
         qCCritical(C_MEMCACHED) << "Failed to configure the connection to the memcached server(s)";
@@ -263,7 +481,7 @@ bool Memcached::set(const QString &key, const QByteArray &value, time_t expirati
         _value = qCompress(value, mcd->d_ptr->compressionLevel);
     }
 
-    const memcached_return_t rt = memcached_set(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_set(threadHandle.memc,
                                                 _key.constData(),
                                                 _key.size(),
                                                 _value.constData(),
@@ -271,10 +489,12 @@ bool Memcached::set(const QString &key, const QByteArray &value, time_t expirati
                                                 expiration,
                                                 flags);
 
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to store key \"%s\": %s", _key.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to store key \"%s\": %s", _key.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -303,7 +523,7 @@ bool Memcached::setByKey(const QString &groupKey, const QString &key, const QByt
         _value = qCompress(value, mcd->d_ptr->compressionLevel);
     }
 
-    const memcached_return_t rt = memcached_set_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_set_by_key(threadHandle.memc,
                                                        _groupKey.constData(),
                                                        _groupKey.size(),
                                                        _key.constData(),
@@ -313,10 +533,12 @@ bool Memcached::setByKey(const QString &groupKey, const QString &key, const QByt
                                                        expiration,
                                                        flags);
 
+    mcd->d_ptr->localCacheInvalidate(groupKey, key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to store key \"%s\" on group \"%s\": %s", _key.constData(), _groupKey.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to store key \"%s\" on group \"%s\": %s", _key.constData(), _groupKey.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -344,7 +566,7 @@ bool Memcached::add(const QString &key, const QByteArray &value, time_t expirati
         _value = qCompress(value, mcd->d_ptr->compressionLevel);
     }
 
-    const memcached_return_t rt = memcached_add(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_add(threadHandle.memc,
                                                 _key.constData(),
                                                 _key.size(),
                                                 _value.constData(),
@@ -352,10 +574,12 @@ bool Memcached::add(const QString &key, const QByteArray &value, time_t expirati
                                                 expiration,
                                                 flags);
 
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTSTORED)) {
-        qCWarning(C_MEMCACHED, "Failed to add key \"%s\": %s", _key.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to add key \"%s\": %s", _key.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -384,7 +608,7 @@ bool Memcached::addByKey(const QString &groupKey, const QString &key, const QByt
         _value = qCompress(value, mcd->d_ptr->compressionLevel);
     }
 
-    const memcached_return_t rt = memcached_add_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_add_by_key(threadHandle.memc,
                                                       _groupKey.constData(),
                                                       _groupKey.size(),
                                                       _key.constData(),
@@ -394,10 +618,12 @@ bool Memcached::addByKey(const QString &groupKey, const QString &key, const QByt
                                                       expiration,
                                                       flags);
 
+    mcd->d_ptr->localCacheInvalidate(groupKey, key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTSTORED)) {
-        qCWarning(C_MEMCACHED, "Failed to add key \"%s\" on group \"%s\": %s", _key.constData(), _groupKey.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to add key \"%s\" on group \"%s\": %s", _key.constData(), _groupKey.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -425,7 +651,7 @@ bool Memcached::replace(const QString &key, const QByteArray &value, time_t expi
         _value = qCompress(value, mcd->d_ptr->compressionLevel);
     }
 
-    const memcached_return_t rt = memcached_replace(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_replace(threadHandle.memc,
                                                     _key.constData(),
                                                     _key.size(),
                                                     _value.constData(),
@@ -433,10 +659,12 @@ bool Memcached::replace(const QString &key, const QByteArray &value, time_t expi
                                                     expiration,
                                                     flags);
 
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTSTORED)) {
-        qCWarning(C_MEMCACHED, "Failed to replace key \"%s\": %s", _key.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to replace key \"%s\": %s", _key.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -465,7 +693,7 @@ bool Memcached::replaceByKey(const QString &groupKey, const QString &key, const
         _value = qCompress(value, mcd->d_ptr->compressionLevel);
     }
 
-    const memcached_return_t rt = memcached_replace_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_replace_by_key(threadHandle.memc,
                                                            _groupKey.constData(),
                                                            _groupKey.size(),
                                                            _key.constData(),
@@ -475,10 +703,12 @@ bool Memcached::replaceByKey(const QString &groupKey, const QString &key, const
                                                            expiration,
                                                            flags);
 
+    mcd->d_ptr->localCacheInvalidate(groupKey, key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTSTORED)) {
-        qCWarning(C_MEMCACHED, "Failed to replace key \"%s\" on group \"%s\": %s", _key.constData(), _groupKey.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to replace key \"%s\" on group \"%s\": %s", _key.constData(), _groupKey.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -498,6 +728,20 @@ QByteArray Memcached::get(const QString &key, uint64_t *cas, Cutelyst::Memcached
         return retData;
     }
 
+    MemcachedPrivate *d = mcd->d_ptr.data();
+    QString localKey;
+    uint localSerial = 0;
+    if (d->localCacheSize > 0) {
+        localKey = localCacheKey(QString(), key);
+        localSerial = localCacheSync(d->localCacheSize);
+        if (localCacheFind(localKey, &retData, cas, d)) {
+            if (returnType) {
+                *returnType = Memcached::Success;
+            }
+            return retData;
+        }
+    }
+
     memcached_return_t rt;
     const QByteArray _key = key.toUtf8();
     bool ok = false;
@@ -506,32 +750,36 @@ QByteArray Memcached::get(const QString &key, uint64_t *cas, Cutelyst::Memcached
     std::vector<size_t> sizes;
     keys.push_back(_key.constData());
     sizes.push_back(_key.size());
-    rt = memcached_mget(mcd->d_ptr->memc,
+    rt = memcached_mget(threadHandle.memc,
                         &keys[0],
                         &sizes[0],
                         keys.size());
 
     if (memcached_success(rt)) {
-        memcached_result_st *result = memcached_fetch_result(mcd->d_ptr->memc, NULL, &rt);
+        memcached_result_st *result = memcached_fetch_result(threadHandle.memc, NULL, &rt);
         if (result) {
             retData = QByteArray(memcached_result_value(result), memcached_result_length(result));
+            const uint64_t _cas = memcached_result_cas(result);
             if (cas) {
-                *cas = memcached_result_cas(result);
+                *cas = _cas;
             }
             MemcachedPrivate::Flags flags = MemcachedPrivate::Flags(memcached_result_flags(result));
             if (flags.testFlag(MemcachedPrivate::Compressed)) {
                 retData = qUncompress(retData);
             }
+            if (!localKey.isNull()) {
+                localCacheInsert(localKey, retData, _cas, localSerial, d);
+            }
             ok = true;
             // fetch another result even if there is no one to get
             // a NULL for the internal of libmemcached
-            memcached_fetch_result(mcd->d_ptr->memc, NULL, NULL);
+            memcached_fetch_result(threadHandle.memc, NULL, NULL);
         }
         memcached_result_free(result);
     }
 
     if (!ok && (rt != MEMCACHED_NOTFOUND)) {
-        qCWarning(C_MEMCACHED, "Failed to get data for key \"%s\": %s", _key.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to get data for key \"%s\": %s", _key.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -551,6 +799,20 @@ QByteArray Memcached::getByKey(const QString &groupKey, const QString &key, uint
         return retData;
     }
 
+    MemcachedPrivate *d = mcd->d_ptr.data();
+    QString localKey;
+    uint localSerial = 0;
+    if (d->localCacheSize > 0) {
+        localKey = localCacheKey(groupKey, key);
+        localSerial = localCacheSync(d->localCacheSize);
+        if (localCacheFind(localKey, &retData, cas, d)) {
+            if (returnType) {
+                *returnType = Memcached::Success;
+            }
+            return retData;
+        }
+    }
+
     memcached_return_t rt;
     const QByteArray _groupKey = groupKey.toUtf8();
     const QByteArray _key = key.toUtf8();
@@ -560,7 +822,7 @@ QByteArray Memcached::getByKey(const QString &groupKey, const QString &key, uint
     std::vector<size_t> sizes;
     keys.push_back(_key.constData());
     sizes.push_back(_key.size());
-    rt = memcached_mget_by_key(mcd->d_ptr->memc,
+    rt = memcached_mget_by_key(threadHandle.memc,
                                _groupKey.constData(),
                                _groupKey.size(),
                                &keys[0],
@@ -568,26 +830,30 @@ QByteArray Memcached::getByKey(const QString &groupKey, const QString &key, uint
                                keys.size());
 
     if (memcached_success(rt)) {
-        memcached_result_st *result = memcached_fetch_result(mcd->d_ptr->memc, NULL, &rt);
+        memcached_result_st *result = memcached_fetch_result(threadHandle.memc, NULL, &rt);
         if (result) {
             retData = QByteArray(memcached_result_value(result), memcached_result_length(result));
+            const uint64_t _cas = memcached_result_cas(result);
             if (cas) {
-                *cas = memcached_result_cas(result);
+                *cas = _cas;
             }
             MemcachedPrivate::Flags flags = MemcachedPrivate::Flags(memcached_result_flags(result));
             if (flags.testFlag(MemcachedPrivate::Compressed)) {
                 retData = qUncompress(retData);
             }
+            if (!localKey.isNull()) {
+                localCacheInsert(localKey, retData, _cas, localSerial, d);
+            }
             ok = true;
             // fetch another result even if there is no one to get
             // a NULL for the internal of libmemcached
-            memcached_fetch_result(mcd->d_ptr->memc, NULL, NULL);
+            memcached_fetch_result(threadHandle.memc, NULL, NULL);
         }
         memcached_result_free(result);
     }
 
     if (!ok && (rt != MEMCACHED_NOTFOUND)) {
-        qCWarning(C_MEMCACHED, "Failed to get data for key \"%s\" on group \"%s\": %s", _key.constData(), _groupKey.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to get data for key \"%s\" on group \"%s\": %s", _key.constData(), _groupKey.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -607,15 +873,17 @@ bool Memcached::remove(const QString &key, MemcachedReturnType *returnType)
 
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_delete(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_delete(threadHandle.memc,
                                                    _key.constData(),
                                                    _key.size(),
                                                    0);
 
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTFOUND)) {
-        qCWarning(C_MEMCACHED, "Failed to remove data for key \"%s\": %s", _key.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to remove data for key \"%s\": %s", _key.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -636,17 +904,19 @@ bool Memcached::removeByKey(const QString &groupKey, const QString &key, Memcach
     const QByteArray _groupKey = groupKey.toUtf8();
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_delete_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_delete_by_key(threadHandle.memc,
                                                           _groupKey.constData(),
                                                           _groupKey.size(),
                                                           _key.constData(),
                                                           _key.size(),
                                                           0);
 
+    mcd->d_ptr->localCacheInvalidate(groupKey, key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTFOUND)) {
-        qCWarning(C_MEMCACHED, "Failed to remove data for key \"%s\" on group \"%s\": %s", _key.constData(), _groupKey.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to remove data for key \"%s\" on group \"%s\": %s", _key.constData(), _groupKey.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     return ok;
@@ -664,14 +934,14 @@ bool Memcached::exist(const QString &key, MemcachedReturnType *returnType)
 
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_exist(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_exist(threadHandle.memc,
                                                   _key.constData(),
                                                   _key.size());
 
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTFOUND)) {
-        qCWarning(C_MEMCACHED, "Failed to check existence of key \"%s\": %s", _key.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to check existence of key \"%s\": %s", _key.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -692,7 +962,7 @@ bool Memcached::existByKey(const QString &groupKey, const QString &key, Memcache
     const QByteArray _groupKey = groupKey.toUtf8();
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_exist_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_exist_by_key(threadHandle.memc,
                                                          _groupKey.constData(),
                                                          _groupKey.size(),
                                                          _key.constData(),
@@ -721,16 +991,18 @@ bool Memcached::increment(const QString &key, uint32_t offset, uint64_t *value,
 
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_increment(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_increment(threadHandle.memc,
                                                       _key.constData(),
                                                       _key.size(),
                                                       offset,
                                                       value);
 
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTFOUND)) {
-        qCWarning(C_MEMCACHED, "Failed to increment key \"%s\" by %u: %s", _key.constData(), offset, memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to increment key \"%s\" by %u: %s", _key.constData(), offset, memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -751,7 +1023,7 @@ bool Memcached::incrementByKey(const QString &groupKey, const QString &key, uint
     const QByteArray _group = groupKey.toUtf8();
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_increment_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_increment_by_key(threadHandle.memc,
                                                              _group.constData(),
                                                              _group.size(),
                                                              _key.constData(),
@@ -759,10 +1031,12 @@ bool Memcached::incrementByKey(const QString &groupKey, const QString &key, uint
                                                              offset,
                                                              value);
 
+    mcd->d_ptr->localCacheInvalidate(groupKey, key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTFOUND)) {
-        qCWarning(C_MEMCACHED, "Failed to increment \"%s\" key on group \"%s\" by %lu: %s", _key.constData(), _group.constData(), offset, memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to increment \"%s\" key on group \"%s\" by %lu: %s", _key.constData(), _group.constData(), offset, memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -782,7 +1056,7 @@ bool Memcached::incrementWithInitial(const QString &key, uint64_t offset, uint64
 
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_increment_with_initial(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_increment_with_initial(threadHandle.memc,
                                                                    _key.constData(),
                                                                    _key.size(),
                                                                    offset,
@@ -790,10 +1064,12 @@ bool Memcached::incrementWithInitial(const QString &key, uint64_t offset, uint64
                                                                    expiration,
                                                                    value);
 
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to increment or initialize key \"%s\" by offset %lu or initial %lu: %s", _key.constData(), offset, initial, memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to increment or initialize key \"%s\" by offset %lu or initial %lu: %s", _key.constData(), offset, initial, memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -814,7 +1090,7 @@ bool Memcached::incrementWithInitialByKey(const QString &groupKey, const QString
     const QByteArray _group = groupKey.toUtf8();
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_increment_with_initial_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_increment_with_initial_by_key(threadHandle.memc,
                                                                           _group.constData(),
                                                                           _group.size(),
                                                                           _key.constData(),
@@ -824,9 +1100,11 @@ bool Memcached::incrementWithInitialByKey(const QString &groupKey, const QString
                                                                           expiration,
                                                                           value);
 
+    mcd->d_ptr->localCacheInvalidate(groupKey, key);
+
     const bool ok = memcached_success(rt);
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to increment or initialize key \"%s\" in group \"%s\" by offset %lu or initial %lu: %s", _key.constData(), _group.constData(), offset, initial, memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to increment or initialize key \"%s\" in group \"%s\" by offset %lu or initial %lu: %s", _key.constData(), _group.constData(), offset, initial, memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -846,16 +1124,18 @@ bool Memcached::decrement(const QString &key, uint32_t offset, uint64_t *value,
 
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_decrement(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_decrement(threadHandle.memc,
                                                       _key.constData(),
                                                       _key.size(),
                                                       offset,
                                                       value);
 
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTFOUND)) {
-        qCWarning(C_MEMCACHED, "Failed to decrement key \"%s\" by %u: %s", _key.constData(), offset, memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to decrement key \"%s\" by %u: %s", _key.constData(), offset, memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -876,7 +1156,7 @@ bool Memcached::decrementByKey(const QString &groupKey, const QString &key, uint
     const QByteArray _group = groupKey.toUtf8();
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_decrement_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_decrement_by_key(threadHandle.memc,
                                                              _group.constData(),
                                                              _group.size(),
                                                              _key.constData(),
@@ -884,10 +1164,12 @@ bool Memcached::decrementByKey(const QString &groupKey, const QString &key, uint
                                                              offset,
                                                              value);
 
+    mcd->d_ptr->localCacheInvalidate(groupKey, key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_NOTFOUND)) {
-        qCWarning(C_MEMCACHED, "Failed to decrement \"%s\" key on group \"%s\" by %lu: %s", _key.constData(), _group.constData(), offset, memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to decrement \"%s\" key on group \"%s\" by %lu: %s", _key.constData(), _group.constData(), offset, memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -907,7 +1189,7 @@ bool Memcached::decrementWithInitial(const QString &key, uint64_t offset, uint64
 
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_decrement_with_initial(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_decrement_with_initial(threadHandle.memc,
                                                                    _key.constData(),
                                                                    _key.size(),
                                                                    offset,
@@ -915,10 +1197,12 @@ bool Memcached::decrementWithInitial(const QString &key, uint64_t offset, uint64
                                                                    expiration,
                                                                    value);
 
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to decrement or initialize key \"%s\" by offset %lu or initial %lu: %s", _key.constData(), offset, initial, memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to decrement or initialize key \"%s\" by offset %lu or initial %lu: %s", _key.constData(), offset, initial, memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -939,7 +1223,7 @@ bool Memcached::decrementWithInitialByKey(const QString &groupKey, const QString
     const QByteArray _group = groupKey.toUtf8();
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_decrement_with_initial_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_decrement_with_initial_by_key(threadHandle.memc,
                                                                           _group.constData(),
                                                                           _group.size(),
                                                                           _key.constData(),
@@ -949,9 +1233,11 @@ bool Memcached::decrementWithInitialByKey(const QString &groupKey, const QString
                                                                           expiration,
                                                                           value);
 
+    mcd->d_ptr->localCacheInvalidate(groupKey, key);
+
     const bool ok = memcached_success(rt);
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to increment or initialize key \"%s\" in group \"%s\" by offset %lu or initial %lu: %s", _key.constData(), _group.constData(), offset, initial, memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to increment or initialize key \"%s\" in group \"%s\" by offset %lu or initial %lu: %s", _key.constData(), _group.constData(), offset, initial, memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -979,7 +1265,7 @@ bool Memcached::cas(const QString &key, const QByteArray &value, time_t expirati
         _value = qCompress(value, mcd->d_ptr->compressionLevel);
     }
 
-    const memcached_return_t rt = memcached_cas(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_cas(threadHandle.memc,
                                                 _key.constData(),
                                                 _key.size(),
                                                 _value.constData(),
@@ -988,10 +1274,12 @@ bool Memcached::cas(const QString &key, const QByteArray &value, time_t expirati
                                                 flags,
                                                 cas);
 
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_DATA_EXISTS)) {
-        qCWarning(C_MEMCACHED, "Failed to compare and set (cas) key \"%s\": %s", _key.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to compare and set (cas) key \"%s\": %s", _key.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -1020,7 +1308,7 @@ bool Memcached::casByKey(const QString &groupKey, const QString &key, const QByt
         _value = qCompress(value, mcd->d_ptr->compressionLevel);
     }
 
-    const memcached_return_t rt = memcached_cas_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_cas_by_key(threadHandle.memc,
                                                        _group.constData(),
                                                        _group.size(),
                                                        _key.constData(),
@@ -1031,10 +1319,12 @@ bool Memcached::casByKey(const QString &groupKey, const QString &key, const QByt
                                                        flags,
                                                        cas);
 
+    mcd->d_ptr->localCacheInvalidate(groupKey, key);
+
     const bool ok = memcached_success(rt);
 
     if (!ok && (rt != MEMCACHED_DATA_EXISTS)) {
-        qCWarning(C_MEMCACHED, "Failed to compare and set (cas) key \"%s\" in group \"%s\": %s", _key.constData(), _group.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to compare and set (cas) key \"%s\" in group \"%s\": %s", _key.constData(), _group.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -1052,12 +1342,12 @@ bool Memcached::flushBuffers(MemcachedReturnType *returnType)
         return false;
     }
 
-    const memcached_return_t rt = memcached_flush_buffers(mcd->d_ptr->memc);
+    const memcached_return_t rt = memcached_flush_buffers(threadHandle.memc);
 
     const bool ok = memcached_success(rt);
 
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to flush buffers: %s", memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to flush buffers: %s", memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -1075,12 +1365,14 @@ bool Memcached::flush(time_t expiration, MemcachedReturnType *returnType)
         return false;
     }
 
-    const memcached_return_t rt = memcached_flush(mcd->d_ptr->memc, expiration);
+    const memcached_return_t rt = memcached_flush(threadHandle.memc, expiration);
+
+    mcd->d_ptr->localCacheInvalidate(QString(), QString());
 
     const bool ok = memcached_success(rt);
 
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to wipe clean (flush) server content: %s", memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to wipe clean (flush) server content: %s", memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -1108,23 +1400,24 @@ QHash<QString,QByteArray> Memcached::mget(const QStringList &keys, QHash<QString
         return ret;
     }
 
-    std::vector<char *> _keys;
+    std::vector<QByteArray> _keysData;
+    _keysData.reserve(keys.size());
+    std::vector<const char *> _keys;
     _keys.reserve(keys.size());
     std::vector<size_t> _keysSizes;
     _keysSizes.reserve(keys.size());
 
     for (const QString &key : keys) {
-        const QByteArray _key = key.toUtf8();
-        char *data = new char[_key.size() + 1];
-        strcpy(data, _key.data());
-        _keys.push_back(data);
+        _keysData.push_back(key.toUtf8());
+        const QByteArray &_key = _keysData.back();
+        _keys.push_back(_key.constData());
         _keysSizes.push_back(_key.size());
     }
 
     memcached_return_t rt;
     bool ok = false;
 
-    rt = memcached_mget(mcd->d_ptr->memc,
+    rt = memcached_mget(threadHandle.memc,
                         &_keys[0],
                         &_keysSizes[0],
                         _keys.size());
@@ -1133,7 +1426,7 @@ QHash<QString,QByteArray> Memcached::mget(const QStringList &keys, QHash<QString
         ok = true;
         ret.reserve(keys.size());
         while ((rt != MEMCACHED_END) && (rt != MEMCACHED_NOTFOUND)) {
-            memcached_result_st *result = memcached_fetch_result(mcd->d_ptr->memc, NULL, &rt);
+            memcached_result_st *result = memcached_fetch_result(threadHandle.memc, NULL, &rt);
             if (result) {
                 const QString rk = QString::fromUtf8(memcached_result_key_value(result), memcached_result_key_length(result));
                 QByteArray rd(memcached_result_value(result), memcached_result_length(result));
@@ -1150,12 +1443,8 @@ QHash<QString,QByteArray> Memcached::mget(const QStringList &keys, QHash<QString
         }
     }
 
-    for (char *c : _keys) {
-        delete [] c;
-    }
-
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to get values for multiple keys: %s", memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to get values for multiple keys: %s", memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -1193,23 +1482,24 @@ QHash<QString, QByteArray> Memcached::mgetByKey(const QString &groupKey, const Q
 
     const QByteArray _group = groupKey.toUtf8();
 
-    std::vector<char *> _keys;
+    std::vector<QByteArray> _keysData;
+    _keysData.reserve(keys.size());
+    std::vector<const char *> _keys;
     _keys.reserve(keys.size());
     std::vector<size_t> _keysSizes;
     _keysSizes.reserve(keys.size());
 
     for (const QString &key : keys) {
-        const QByteArray _key = key.toUtf8();
-        char *data = new char[_key.size() + 1];
-        strcpy(data, _key.data());
-        _keys.push_back(data);
+        _keysData.push_back(key.toUtf8());
+        const QByteArray &_key = _keysData.back();
+        _keys.push_back(_key.constData());
         _keysSizes.push_back(_key.size());
     }
 
     memcached_return_t rt;
     bool ok = false;
 
-    rt = memcached_mget_by_key(mcd->d_ptr->memc,
+    rt = memcached_mget_by_key(threadHandle.memc,
                                _group.constData(),
                                _group.size(),
                                &_keys[0],
@@ -1222,7 +1512,7 @@ QHash<QString, QByteArray> Memcached::mgetByKey(const QString &groupKey, const Q
         ok = true;
         ret.reserve(keys.size());
         while ((rt != MEMCACHED_END) && (rt != MEMCACHED_NOTFOUND)) {
-            memcached_result_st *result = memcached_fetch_result(mcd->d_ptr->memc, NULL, &rt);
+            memcached_result_st *result = memcached_fetch_result(threadHandle.memc, NULL, &rt);
             if (result) {
                 const QString rk = QString::fromUtf8(memcached_result_key_value(result), memcached_result_key_length(result));
                 QByteArray rd(memcached_result_value(result), memcached_result_length(result));
@@ -1239,17 +1529,166 @@ QHash<QString, QByteArray> Memcached::mgetByKey(const QString &groupKey, const Q
         }
     }
 
-    for (char *c : _keys) {
-        delete [] c;
+    if (!ok) {
+        qCWarning(C_MEMCACHED, "Failed to get values for multiple keys in group \"%s\": %s", _group.constData(), memcached_strerror(threadHandle.memc, rt));
     }
 
+    MemcachedPrivate::setReturnType(returnType, rt);
+
+    return ret;
+}
+
+bool Memcached::mset(const QHash<QString, QByteArray> &values, time_t expiration, MemcachedReturnType *returnType)
+{
+    return msetByKey(QString(), values, expiration, returnType);
+}
+
+bool Memcached::msetByKey(const QString &groupKey, const QHash<QString, QByteArray> &values, time_t expiration, MemcachedReturnType *returnType)
+{
+    if (!mcd) {
+        qCCritical(C_MEMCACHED) << "Memcached plugin not registered";
+        if (returnType) {
+            *returnType = Memcached::PluginNotRegisterd;
+        }
+        return false;
+    }
+
+    if (values.empty()) {
+        qCWarning(C_MEMCACHED, "Can not set multiple values without a list of values.");
+        if (returnType) {
+            *returnType = Memcached::BadKeyProvided;
+        }
+        return false;
+    }
+
+    const QByteArray _group = groupKey.toUtf8();
+    memcached_return_t rt = MEMCACHED_SUCCESS;
+
+    MemcachedBatch batch(threadHandle.memc);
+    auto it = values.constBegin();
+    while (it != values.constEnd()) {
+        const QByteArray _key = it.key().toUtf8();
+
+        MemcachedPrivate::Flags flags;
+        QByteArray _value = it.value();
+
+        if (mcd->d_ptr->compression && (_value.size() > mcd->d_ptr->compressionThreshold)) {
+            flags |= MemcachedPrivate::Compressed;
+            _value = qCompress(it.value(), mcd->d_ptr->compressionLevel);
+        }
+
+        if (_group.isEmpty()) {
+            rt = memcached_set(threadHandle.memc,
+                               _key.constData(),
+                               _key.size(),
+                               _value.constData(),
+                               _value.size(),
+                               expiration,
+                               flags);
+        } else {
+            rt = memcached_set_by_key(threadHandle.memc,
+                                      _group.constData(),
+                                      _group.size(),
+                                      _key.constData(),
+                                      _key.size(),
+                                      _value.constData(),
+                                      _value.size(),
+                                      expiration,
+                                      flags);
+        }
+
+        mcd->d_ptr->localCacheInvalidate(groupKey, it.key());
+
+        if (!memcached_success(rt)) {
+            qCWarning(C_MEMCACHED, "Failed to queue key \"%s\" for storage: %s", _key.constData(), memcached_strerror(threadHandle.memc, rt));
+            break;
+        }
+        ++it;
+    }
+
+    // Whatever was queued is sent, even if a request failed
+    const memcached_return_t flushRt = batch.flush();
+    if (memcached_success(rt)) {
+        rt = flushRt;
+    }
+
+    const bool ok = memcached_success(rt);
+
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to get values for multiple keys in group \"%s\": %s", _group.constData(), memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to store multiple values: %s", memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
 
-    return ret;
+    return ok;
+}
+
+bool Memcached::mremove(const QStringList &keys, MemcachedReturnType *returnType)
+{
+    return mremoveByKey(QString(), keys, returnType);
+}
+
+bool Memcached::mremoveByKey(const QString &groupKey, const QStringList &keys, MemcachedReturnType *returnType)
+{
+    if (!mcd) {
+        qCCritical(C_MEMCACHED) << "Memcached plugin not registered";
+        if (returnType) {
+            *returnType = Memcached::PluginNotRegisterd;
+        }
+        return false;
+    }
+
+    if (keys.empty()) {
+        qCWarning(C_MEMCACHED, "Can not remove multiple values without a list of keys.");
+        if (returnType) {
+            *returnType = Memcached::BadKeyProvided;
+        }
+        return false;
+    }
+
+    const QByteArray _group = groupKey.toUtf8();
+    memcached_return_t rt = MEMCACHED_SUCCESS;
+
+    MemcachedBatch batch(threadHandle.memc);
+    for (const QString &key : keys) {
+        const QByteArray _key = key.toUtf8();
+
+        if (_group.isEmpty()) {
+            rt = memcached_delete(threadHandle.memc,
+                                  _key.constData(),
+                                  _key.size(),
+                                  0);
+        } else {
+            rt = memcached_delete_by_key(threadHandle.memc,
+                                         _group.constData(),
+                                         _group.size(),
+                                         _key.constData(),
+                                         _key.size(),
+                                         0);
+        }
+
+        mcd->d_ptr->localCacheInvalidate(groupKey, key);
+
+        if (!memcached_success(rt)) {
+            qCWarning(C_MEMCACHED, "Failed to queue key \"%s\" for removal: %s", _key.constData(), memcached_strerror(threadHandle.memc, rt));
+            break;
+        }
+    }
+
+    const memcached_return_t flushRt = batch.flush();
+    if (memcached_success(rt)) {
+        rt = flushRt;
+    }
+
+    const bool ok = memcached_success(rt);
+
+    if (!ok) {
+        qCWarning(C_MEMCACHED, "Failed to remove multiple values: %s", memcached_strerror(threadHandle.memc, rt));
+    }
+
+    MemcachedPrivate::setReturnType(returnType, rt);
+
+    return ok;
 }
 
 bool Memcached::touch(const QString &key, time_t expiration, MemcachedReturnType *returnType)
@@ -1264,7 +1703,7 @@ bool Memcached::touch(const QString &key, time_t expiration, MemcachedReturnType
 
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_touch(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_touch(threadHandle.memc,
                                                   _key.constData(),
                                                   _key.size(),
                                                   expiration);
@@ -1272,7 +1711,7 @@ bool Memcached::touch(const QString &key, time_t expiration, MemcachedReturnType
     const bool ok = memcached_success(rt);
 
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to touch key \"%s\" with new expiration time %lu: %s", _key.constData(), expiration, memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to touch key \"%s\" with new expiration time %lu: %s", _key.constData(), expiration, memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -1293,7 +1732,7 @@ bool Memcached::touchByKey(const QString &groupKey, const QString &key, time_t e
     const QByteArray _group = groupKey.toUtf8();
     const QByteArray _key = key.toUtf8();
 
-    const memcached_return_t rt = memcached_touch_by_key(mcd->d_ptr->memc,
+    const memcached_return_t rt = memcached_touch_by_key(threadHandle.memc,
                                                          _group.constData(),
                                                          _group.size(),
                                                          _key.constData(),
@@ -1303,7 +1742,7 @@ bool Memcached::touchByKey(const QString &groupKey, const QString &key, time_t e
     const bool ok = memcached_success(rt);
 
     if (!ok) {
-        qCWarning(C_MEMCACHED, "Failed to touch key \"%s\" in group \"%s\" with new expiration time %lu: %s", _key.constData(), _group.constData(), expiration, memcached_strerror(mcd->d_ptr->memc, rt));
+        qCWarning(C_MEMCACHED, "Failed to touch key \"%s\" in group \"%s\" with new expiration time %lu: %s", _key.constData(), _group.constData(), expiration, memcached_strerror(threadHandle.memc, rt));
     }
 
     MemcachedPrivate::setReturnType(returnType, rt);
@@ -1311,6 +1750,93 @@ bool Memcached::touchByKey(const QString &groupKey, const QString &key, time_t e
     return ok;
 }
 
+void Memcached::getAsync(const QString &key, QObject *receiver, const GetCallback &callback)
+{
+    MemcachedAsyncConnection::Request request;
+    request.command = MemcachedAsyncConnection::Get;
+    request.receiver = receiver;
+    request.getCallback = callback;
+
+    if (!mcd) {
+        qCCritical(C_MEMCACHED) << "Memcached plugin not registered";
+        MemcachedAsyncConnection::fail(request, Memcached::PluginNotRegisterd);
+        return;
+    }
+
+    QByteArray _key;
+    MemcachedAsyncConnection *conn = mcd->d_ptr->asyncConnection(key, &_key, request);
+    if (!conn) {
+        return;
+    }
+
+    conn->send(QByteArrayLiteral("gets ") + _key + QByteArrayLiteral("\r\n"), request);
+}
+
+void Memcached::setAsync(const QString &key, const QByteArray &value, time_t expiration, QObject *receiver, const ResultCallback &callback)
+{
+    MemcachedAsyncConnection::Request request;
+    request.command = MemcachedAsyncConnection::Store;
+    request.receiver = receiver;
+    request.resultCallback = callback;
+
+    if (!mcd) {
+        qCCritical(C_MEMCACHED) << "Memcached plugin not registered";
+        MemcachedAsyncConnection::fail(request, Memcached::PluginNotRegisterd);
+        return;
+    }
+
+    QByteArray _key;
+    MemcachedAsyncConnection *conn = mcd->d_ptr->asyncConnection(key, &_key, request);
+    if (!conn) {
+        return;
+    }
+
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
+    MemcachedPrivate::Flags flags;
+    QByteArray _value = value;
+
+    if (mcd->d_ptr->compression && (_value.size() > mcd->d_ptr->compressionThreshold)) {
+        flags |= MemcachedPrivate::Compressed;
+        _value = qCompress(value, mcd->d_ptr->compressionLevel);
+    }
+
+    // set <key> <flags> <exptime> <bytes>
+    QByteArray data;
+    data.reserve(_key.size() + _value.size() + 48);
+    data.append("set ").append(_key)
+            .append(' ').append(QByteArray::number(quint32(flags)))
+            .append(' ').append(QByteArray::number(qint64(expiration)))
+            .append(' ').append(QByteArray::number(_value.size()))
+            .append("\r\n").append(_value).append("\r\n");
+
+    conn->send(data, request);
+}
+
+void Memcached::removeAsync(const QString &key, QObject *receiver, const ResultCallback &callback)
+{
+    MemcachedAsyncConnection::Request request;
+    request.command = MemcachedAsyncConnection::Delete;
+    request.receiver = receiver;
+    request.resultCallback = callback;
+
+    if (!mcd) {
+        qCCritical(C_MEMCACHED) << "Memcached plugin not registered";
+        MemcachedAsyncConnection::fail(request, Memcached::PluginNotRegisterd);
+        return;
+    }
+
+    QByteArray _key;
+    MemcachedAsyncConnection *conn = mcd->d_ptr->asyncConnection(key, &_key, request);
+    if (!conn) {
+        return;
+    }
+
+    mcd->d_ptr->localCacheInvalidate(QString(), key);
+
+    conn->send(QByteArrayLiteral("delete ") + _key + QByteArrayLiteral("\r\n"), request);
+}
+
 QString Memcached::errorString(Context *c, MemcachedReturnType rt)
 {
     switch(rt) {
@@ -1403,6 +1929,16 @@ QString Memcached::errorString(Context *c, MemcachedReturnType rt)
     }
 }
 
+quint64 Memcached::localCacheHits()
+{
+    return localCacheHitCount.load();
+}
+
+quint64 Memcached::localCacheMisses()
+{
+    return localCacheMissCount.load();
+}
+
 QVersionNumber Memcached::libMemcachedVersion()
 {
     return QVersionNumber::fromString(QLatin1String(memcached_lib_version()));
@@ -1468,4 +2004,63 @@ void MemcachedPrivate::setReturnType(Memcached::MemcachedReturnType *rt1, memcac
     }
 }
 
+MemcachedAsyncConnection *MemcachedPrivate::asyncConnection(const QString &key, QByteArray *serverKey, const MemcachedAsyncConnection::Request &request)
+{
+    if (!asyncSupported) {
+        qCWarning(C_MEMCACHED) << "Asynchronous requests do not support encryption, SASL or UDP";
+        MemcachedAsyncConnection::fail(request, Memcached::NotSupported);
+        return nullptr;
+    }
+
+    const QByteArray _key = key.toUtf8();
+    *serverKey = keyPrefix + _key;
+
+    // The text protocol ends keys on white space
+    bool valid = !_key.isEmpty() && serverKey->size() <= MEMCACHED_MAX_KEY - 1;
+    for (int i = 0; valid && i < _key.size(); ++i) {
+        const uchar ch = uchar(_key.at(i));
+        valid = ch > 0x20 && ch != 0x7f;
+    }
+    if (!valid) {
+        qCWarning(C_MEMCACHED, "Invalid key \"%s\"", _key.constData());
+        MemcachedAsyncConnection::fail(request, Memcached::BadKeyProvided);
+        return nullptr;
+    }
+
+    // Picks the same server libmemcached would
+    const QByteArray &hashKey = hashWithNamespace ? *serverKey : _key;
+    const uint32_t position = memcached_generate_hash(threadHandle.memc, hashKey.constData(), size_t(hashKey.size()));
+    const auto instance = memcached_server_instance_by_position(threadHandle.memc, position);
+    if (!instance) {
+        MemcachedAsyncConnection::fail(request, Memcached::NoServers);
+        return nullptr;
+    }
+
+    const QString name = QString::fromUtf8(memcached_server_name(instance));
+    const quint16 port = quint16(memcached_server_port(instance));
+    const QString id = name + QLatin1Char(':') + QString::number(port);
+
+    AsyncConnections *connections = threadAsyncConnections();
+    MemcachedAsyncConnection *conn = connections->connections.value(id);
+    if (!conn) {
+        conn = new MemcachedAsyncConnection(name, port, asyncTimeout);
+        connections->connections.insert(id, conn);
+    }
+
+    return conn;
+}
+
+void MemcachedPrivate::localCacheInvalidate(const QString &groupKey, const QString &key)
+{
+    if (localCacheSize <= 0) {
+        return;
+    }
+
+    LocalCacheInvalidations *inv = localCacheInvalidations;
+    QMutexLocker locker(&inv->mutex);
+    const uint serial = uint(inv->serial.load());
+    inv->keys[serial % LocalCacheInvalidations::Size] = key.isNull() ? QString() : localCacheKey(groupKey, key);
+    inv->serial.storeRelease(int(serial + 1));
+}
+
 #include "moc_memcached.cpp"
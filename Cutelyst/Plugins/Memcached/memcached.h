@@ -25,6 +25,8 @@
 #include <QDataStream>
 #include <QVersionNumber>
 
+#include <functional>
+
 namespace Cutelyst {
 
 class Context;
@@ -61,6 +63,9 @@ class MemcachedPrivate;
  * @li @a encryption_key - string value, if set and not empty, AES encryption will be enabled (default: empty)
  * @li @a sasl_user - string value, if set and not empty, SASL authentication will be used - note that SASL support has to be enabled when building libmemcached (default: empty)
  * @li @a sasl_password - string value, if set and not empty, SASL authentication will be used (default: empty)
+ * @li @a local_cache_size - integer value, the number of values each thread keeps in its local cache, 0 disables it (default: 0)
+ * @li @a local_cache_ttl - integer value, time in milliseconds values are served from the local cache (default: 2000)
+ * @li @a async_timeout - integer value, time in milliseconds to wait for answers to asynchronous requests (default: 1000)
  *
  * @note If you want to use non-ASCII key names you have to enable the binary protocol.
  *
@@ -119,6 +124,43 @@ class MemcachedPrivate;
  * }
  * @endcode
  *
+ * <H3>Local cache</H3>
+ *
+ * If @a local_cache_size is set, every thread keeps the values most recently fetched with get() and getByKey()
+ * in front of the memcached servers, so frequently read values that rarely change, like configuration or
+ * profile data, are answered without a round trip to the server for up to @a local_cache_ttl milliseconds.
+ * Writes done through this plugin by any thread of the same process drop the written keys from the local
+ * caches of all threads immediately, writes of other processes are only seen after the values expired
+ * locally, so use short times for values that must not be outdated. localCacheHits() and localCacheMisses()
+ * tell how well the local cache performs.
+ *
+ * <H3>Asynchronous API</H3>
+ *
+ * The methods above block the worker thread until the server answers. getAsync(), setAsync() and
+ * removeAsync() instead return at once and call back from the event loop of the calling thread,
+ * each thread keeps one connection per server on which requests are pipelined, so a worker can
+ * have many cache operations in flight. Combined with Context::detachAsync() other requests are
+ * processed meanwhile:
+ *
+ * @code{.cpp}
+ * void MyController::index(Context *c)
+ * {
+ *     c->detachAsync();
+ *     Memcached::getAsync(QStringLiteral("myKey"), c, [c] (const QByteArray &value, uint64_t cas, Memcached::MemcachedReturnType rt) {
+ *         Q_UNUSED(cas)
+ *         if (rt == Memcached::Success) {
+ *             c->response()->setBody(value);
+ *         }
+ *         c->attachAsync();
+ *     });
+ * }
+ * @endcode
+ *
+ * The asynchronous methods speak the memcached text protocol to the server libmemcached would
+ * choose for the key and honor the @a namespace and @a compression options, they fail with
+ * Memcached::NotSupported when @a encryption_key, SASL or @a use_udp are configured. The
+ * @a async_timeout option sets the time in milliseconds to wait for an answer (default: 1000).
+ *
  * <H3>Build requirements</H3>
  *
  * To build this plugin you need the development and header files for <A HREF="http://libmemcached.org">libmemcached</A>
@@ -207,6 +249,17 @@ public:
     };
     Q_ENUM(MemcachedReturnType)
 
+    /**
+     * Callback of getAsync() receiving the @a value, its @a cas value and the @a returnType
+     * of the operation, the value is empty unless @a returnType is Memcached::Success.
+     */
+    typedef std::function<void(const QByteArray &value, uint64_t cas, MemcachedReturnType returnType)> GetCallback;
+
+    /**
+     * Callback of setAsync() and removeAsync() receiving the @a returnType of the operation.
+     */
+    typedef std::function<void(MemcachedReturnType returnType)> ResultCallback;
+
     /**
      * Sets default configuration values for configuration keys that are not set in
      * the Cutelyst configuratoin file.
@@ -921,6 +974,91 @@ public:
     template< typename T>
     static QHash<QString, T> mgetByKey(const QString &groupKey, const QStringList &keys, QHash<QString,uint64_t> *casValues = nullptr, MemcachedReturnType *returnType = nullptr);
 
+    /**
+     * Writes multiple @a values to the memcached servers, like Memcached::set() does for a single key.
+     * All requests are written without waiting for the servers to answer them, so storing many values
+     * takes a single round trip.
+     *
+     * @note The requests are sent with the noreply option, the servers do not acknowledge the single
+     * writes and a value that was refused by a server, for example because it is too large, is not
+     * reported. Use Memcached::mget() afterwards if you need to know which values were stored.
+     *
+     * @param[in] values keys and values of the objects to write to the servers
+     * @param[in] expiration time in seconds to keep the objects stored in the servers
+     * @param[out] returnType optional pointer to a MemcachedReturnType variable that takes the return type of the operation
+     * @return @c true if all requests were sent; @c false otherwise
+     * @since Cutelyst 2.9.0
+     */
+    static bool mset(const QHash<QString, QByteArray> &values, time_t expiration, MemcachedReturnType *returnType = nullptr);
+
+    /**
+     * Writes multiple @a values of type @a T to the memcached servers, like Memcached::mset().
+     *
+     * Type @a T has to be serializable into a QByteArray using QDataStream.
+     *
+     * @param[in] values keys and values of type @a T of the objects to write to the servers
+     * @param[in] expiration time in seconds to keep the objects stored in the servers
+     * @param[out] returnType optional pointer to a MemcachedReturnType variable that takes the return type of the operation
+     * @return @c true if all requests were sent; @c false otherwise
+     * @since Cutelyst 2.9.0
+     */
+    template< typename T>
+    static bool mset(const QHash<QString, T> &values, time_t expiration, MemcachedReturnType *returnType = nullptr);
+
+    /**
+     * Writes multiple @a values to the server specified by @a groupKey. This method behaves in a
+     * similar nature as Memcached::mset(), the free-form @a groupKey is used to map all keys to
+     * the same server like Memcached::setByKey() does.
+     *
+     * @param[in] groupKey key to specify the server to write the values to
+     * @param[in] values keys and values of the objects to write to the server
+     * @param[in] expiration time in seconds to keep the objects stored in the server
+     * @param[out] returnType optional pointer to a MemcachedReturnType variable that takes the return type of the operation
+     * @return @c true if all requests were sent; @c false otherwise
+     * @since Cutelyst 2.9.0
+     */
+    static bool msetByKey(const QString &groupKey, const QHash<QString, QByteArray> &values, time_t expiration, MemcachedReturnType *returnType = nullptr);
+
+    /**
+     * Writes multiple @a values of type @a T to the server specified by @a groupKey, like Memcached::msetByKey().
+     *
+     * Type @a T has to be serializable into a QByteArray using QDataStream.
+     *
+     * @param[in] groupKey key to specify the server to write the values to
+     * @param[in] values keys and values of type @a T of the objects to write to the server
+     * @param[in] expiration time in seconds to keep the objects stored in the server
+     * @param[out] returnType optional pointer to a MemcachedReturnType variable that takes the return type of the operation
+     * @return @c true if all requests were sent; @c false otherwise
+     * @since Cutelyst 2.9.0
+     */
+    template< typename T>
+    static bool msetByKey(const QString &groupKey, const QHash<QString, T> &values, time_t expiration, MemcachedReturnType *returnType = nullptr);
+
+    /**
+     * Removes multiple @a keys from the memcached servers, like Memcached::remove() does for a single
+     * key. All requests are written without waiting for the servers to answer them.
+     *
+     * @note Like Memcached::mset() the requests are sent with the noreply option, it is not reported
+     * if a key did not exist or could not be removed.
+     *
+     * @param[in] keys list of keys to remove
+     * @param[out] returnType optional pointer to a MemcachedReturnType variable that takes the return type of the operation
+     * @return @c true if all requests were sent; @c false otherwise
+     * @since Cutelyst 2.9.0
+     */
+    static bool mremove(const QStringList &keys, MemcachedReturnType *returnType = nullptr);
+
+    /**
+     * Removes multiple @a keys from the server specified by @a groupKey, like Memcached::mremove().
+     *
+     * @param[in] groupKey key to specify the server to remove the keys from
+     * @param[in] keys list of keys to remove
+     * @param[out] returnType optional pointer to a MemcachedReturnType variable that takes the return type of the operation
+     * @return @c true if all requests were sent; @c false otherwise
+     * @since Cutelyst 2.9.0
+     */
+    static bool mremoveByKey(const QString &groupKey, const QStringList &keys, MemcachedReturnType *returnType = nullptr);
+
     /**
      * Updates the @a expiration time on an existing @a key.
      *
@@ -946,6 +1084,30 @@ public:
      */
     static bool touchByKey(const QString &groupKey, const QString &key, time_t expiration, MemcachedReturnType *returnType = nullptr);
 
+    /**
+     * Fetches the value of @a key without blocking, @a callback is called from the event loop
+     * of the calling thread unless @a receiver, usually the Context, is deleted before.
+     *
+     * @since Cutelyst 2.9.0
+     */
+    static void getAsync(const QString &key, QObject *receiver, const GetCallback &callback);
+
+    /**
+     * Writes the @a value of @a key without blocking, like set(), @a callback is called from
+     * the event loop of the calling thread unless @a receiver is deleted before.
+     *
+     * @since Cutelyst 2.9.0
+     */
+    static void setAsync(const QString &key, const QByteArray &value, time_t expiration, QObject *receiver, const ResultCallback &callback = ResultCallback());
+
+    /**
+     * Removes @a key without blocking, like remove(), @a callback is called from the
+     * event loop of the calling thread unless @a receiver is deleted before.
+     *
+     * @since Cutelyst 2.9.0
+     */
+    static void removeAsync(const QString &key, QObject *receiver, const ResultCallback &callback = ResultCallback());
+
     /**
      * Converts the return type @a rt into human readable error string.
      */
@@ -956,6 +1118,20 @@ public:
      */
     static QVersionNumber libMemcachedVersion();
 
+    /**
+     * Returns the number of get() and getByKey() calls answered by the local cache of this process.
+     *
+     * @since Cutelyst 2.9.0
+     */
+    static quint64 localCacheHits();
+
+    /**
+     * Returns the number of get() and getByKey() calls the local cache of this process could not answer.
+     *
+     * @since Cutelyst 2.9.0
+     */
+    static quint64 localCacheMisses();
+
 protected:
     const QScopedPointer<MemcachedPrivate> d_ptr;
 
@@ -1097,6 +1273,28 @@ QHash<QString, T> Memcached::mgetByKey(const QString &groupKey, const QStringLis
     return hash;
 }
 
+template< typename T>
+bool Memcached::mset(const QHash<QString, T> &values, time_t expiration, MemcachedReturnType *returnType)
+{
+    return Memcached::msetByKey<T>(QString(), values, expiration, returnType);
+}
+
+template< typename T>
+bool Memcached::msetByKey(const QString &groupKey, const QHash<QString, T> &values, time_t expiration, MemcachedReturnType *returnType)
+{
+    QHash<QString, QByteArray> _data;
+    _data.reserve(values.size());
+    auto i = values.constBegin();
+    while (i != values.constEnd()) {
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out << i.value();
+        _data.insert(i.key(), data);
+        ++i;
+    }
+    return Memcached::msetByKey(groupKey, _data, expiration, returnType);
+}
+
 }
 
 #endif // CUTELYSTMEMCACHED_H
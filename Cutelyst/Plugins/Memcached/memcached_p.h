@@ -20,11 +20,13 @@
 #define CUTELYSTMEMCACHED_P_H
 
 #include "memcached.h"
+#include "memcachedasync_p.h"
 
 #include <libmemcached/memcached.h>
 #include <QString>
 #include <QMap>
 #include <QFlags>
+#include <QElapsedTimer>
 
 namespace Cutelyst {
 
@@ -56,13 +58,28 @@ public:
     static Memcached::MemcachedReturnType returnTypeConvert(memcached_return_t rt);
     static void setReturnType(Memcached::MemcachedReturnType *rt1, memcached_return_t rt2);
 
+    // Drops key from the local caches of all threads, a null key drops everything
+    void localCacheInvalidate(const QString &groupKey, const QString &key);
+
+    // Returns the connection of this thread to the server of key, setting the
+    // key sent to the server, or nullptr after failing the callback of request
+    MemcachedAsyncConnection *asyncConnection(const QString &key, QByteArray *serverKey, const MemcachedAsyncConnection::Request &request);
+
     QMap<int,std::pair<QString,quint16>> servers;
+    // Only used as template for the handles of the worker threads
     memcached_st *memc = nullptr;
 
     bool compression = false;
     int compressionThreshold = 100;
     int compressionLevel = -1;
     bool saslEnabled = false;
+    bool asyncSupported = true;
+    bool hashWithNamespace = false;
+    int asyncTimeout = 1000;
+    QByteArray keyPrefix;
+    QElapsedTimer localCacheClock;
+    qint64 localCacheTtl = 2000;
+    int localCacheSize = 0;
 
     QVariantMap defaultConfig;
 };
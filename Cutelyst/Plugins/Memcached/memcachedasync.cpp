@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "memcachedasync_p.h"
+#include "memcached_p.h"
+
+#include <QTcpSocket>
+#include <QLocalSocket>
+#include <QTimer>
+#include <QLoggingCategory>
+
+#include <cstring>
+
+Q_DECLARE_LOGGING_CATEGORY(C_MEMCACHED)
+
+using namespace Cutelyst;
+
+MemcachedAsyncConnection::MemcachedAsyncConnection(const QString &name, quint16 port, int timeout)
+    : m_name(name)
+    , m_timeout(timeout)
+    , m_port(port)
+{
+
+}
+
+MemcachedAsyncConnection::~MemcachedAsyncConnection()
+{
+    delete m_socket;
+    delete m_timer;
+}
+
+void MemcachedAsyncConnection::send(const QByteArray &data, const Request &request)
+{
+    if (!m_socket) {
+        connectToServer();
+
+        // QLocalSocket reports a missing server from within connectToServer()
+        if (!m_socket) {
+            fail(request, Memcached::ConnectionFailure);
+            return;
+        }
+    }
+
+    if (m_connected) {
+        m_socket->write(data);
+    } else {
+        m_pendingWrite.append(data);
+    }
+
+    m_requests.enqueue(request);
+    if (!m_timer->isActive()) {
+        m_timer->start();
+    }
+}
+
+void MemcachedAsyncConnection::fail(const Request &request, Memcached::MemcachedReturnType returnType)
+{
+    if (!request.receiver) {
+        return;
+    }
+
+    QTimer::singleShot(0, request.receiver.data(), [request, returnType] {
+        finish(request, QByteArray(), 0, 0, returnType);
+    });
+}
+
+void MemcachedAsyncConnection::connectToServer()
+{
+    if (!m_timer) {
+        m_timer = new QTimer;
+        m_timer->setSingleShot(true);
+        m_timer->setInterval(m_timeout);
+        QObject::connect(m_timer, &QTimer::timeout, m_timer, [this] {
+            qCWarning(C_MEMCACHED) << "Timeout waiting for memcached server" << m_name;
+            abort(Memcached::Timeout);
+        });
+    }
+
+    // Servers added as sockets are named by their full path
+    if (m_name.startsWith(QLatin1Char('/'))) {
+        m_localSocket = new QLocalSocket;
+        m_socket = m_localSocket;
+        QObject::connect(m_localSocket, &QLocalSocket::connected, m_localSocket, [this] {
+            connected();
+        });
+        QObject::connect(m_localSocket, static_cast<void (QLocalSocket::*)(QLocalSocket::LocalSocketError)>(&QLocalSocket::error),
+                         m_localSocket, [this] {
+            qCWarning(C_MEMCACHED) << "Connection to memcached server" << m_name << "failed:" << m_localSocket->errorString();
+            abort(Memcached::ConnectionFailure);
+        });
+        QObject::connect(m_localSocket, &QLocalSocket::readyRead, m_localSocket, [this] {
+            readResponses();
+        });
+        m_localSocket->connectToServer(m_name);
+    } else {
+        m_tcpSocket = new QTcpSocket;
+        m_socket = m_tcpSocket;
+        QObject::connect(m_tcpSocket, &QTcpSocket::connected, m_tcpSocket, [this] {
+            m_tcpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            connected();
+        });
+        QObject::connect(m_tcpSocket, static_cast<void (QTcpSocket::*)(QAbstractSocket::SocketError)>(&QTcpSocket::error),
+                         m_tcpSocket, [this] {
+            qCWarning(C_MEMCACHED) << "Connection to memcached server" << m_name << m_port << "failed:" << m_tcpSocket->errorString();
+            abort(Memcached::ConnectionFailure);
+        });
+        QObject::connect(m_tcpSocket, &QTcpSocket::readyRead, m_tcpSocket, [this] {
+            readResponses();
+        });
+        m_tcpSocket->connectToHost(m_name, m_port);
+    }
+}
+
+void MemcachedAsyncConnection::connected()
+{
+    m_connected = true;
+    if (!m_pendingWrite.isEmpty()) {
+        m_socket->write(m_pendingWrite);
+        m_pendingWrite.clear();
+    }
+}
+
+void MemcachedAsyncConnection::readResponses()
+{
+    m_buffer.append(m_socket->readAll());
+    while (!m_requests.isEmpty() && readResponse()) {
+    }
+
+    // Data is only moved once per read, not once per answer
+    if (m_offset) {
+        m_buffer.remove(0, m_offset);
+        m_offset = 0;
+    }
+
+    if (!m_socket) {
+        return;
+    } else if (m_requests.isEmpty()) {
+        m_timer->stop();
+    } else {
+        m_timer->start();
+    }
+}
+
+bool MemcachedAsyncConnection::readResponse()
+{
+    const int lineEnd = m_buffer.indexOf("\r\n", m_offset);
+    if (lineEnd == -1) {
+        return false;
+    }
+
+    const char *line = m_buffer.constData() + m_offset;
+    const int lineSize = lineEnd - m_offset;
+    auto lineIs = [line, lineSize] (const char *str) {
+        const int size = int(std::strlen(str));
+        return lineSize >= size && std::memcmp(line, str, size_t(size)) == 0 &&
+                (lineSize == size || line[size] == ' ');
+    };
+
+    int consumed = lineEnd + 2;
+    QByteArray value;
+    quint32 flags = 0;
+    quint64 cas = 0;
+    Memcached::MemcachedReturnType returnType;
+    const Request &request = m_requests.head();
+    if (request.command == Get && lineIs("VALUE")) {
+        // VALUE <key> <flags> <bytes> [<cas unique>]
+        const QList<QByteArray> parts = m_buffer.mid(m_offset, lineSize).split(' ');
+        if (parts.size() < 4) {
+            abort(Memcached::ProtocolError);
+            return false;
+        }
+        flags = parts.at(2).toUInt();
+        const int bytes = parts.at(3).toInt();
+        if (parts.size() > 4) {
+            cas = parts.at(4).toULongLong();
+        }
+
+        static const char valueEnd[] = "\r\nEND\r\n";
+        const int end = consumed + bytes + int(sizeof(valueEnd) - 1);
+        if (m_buffer.size() < end) {
+            return false;
+        }
+
+        if (std::memcmp(m_buffer.constData() + consumed + bytes, valueEnd, sizeof(valueEnd) - 1) != 0) {
+            abort(Memcached::ProtocolError);
+            return false;
+        }
+        value = m_buffer.mid(consumed, bytes);
+        consumed = end;
+        returnType = Memcached::Success;
+    } else if (lineIs("END") || lineIs("NOT_FOUND")) {
+        returnType = Memcached::NotFound;
+    } else if (lineIs("STORED") || lineIs("DELETED")) {
+        returnType = Memcached::Success;
+    } else if (lineIs("NOT_STORED")) {
+        returnType = Memcached::NotStored;
+    } else if (lineIs("EXISTS")) {
+        returnType = Memcached::DataExists;
+    } else if (lineIs("CLIENT_ERROR")) {
+        returnType = Memcached::ClientError;
+    } else if (lineIs("SERVER_ERROR")) {
+        returnType = Memcached::ServerError;
+    } else if (lineIs("ERROR")) {
+        returnType = Memcached::ProtocolError;
+    } else {
+        qCWarning(C_MEMCACHED) << "Unexpected answer from memcached server" << m_name << m_buffer.mid(m_offset, lineSize);
+        abort(Memcached::ProtocolError);
+        return false;
+    }
+    m_offset = consumed;
+
+    // The callback might send new requests
+    const Request answered = m_requests.dequeue();
+    finish(answered, value, flags, cas, returnType);
+
+    return true;
+}
+
+void MemcachedAsyncConnection::abort(Memcached::MemcachedReturnType returnType)
+{
+    // Answers might be out of sync, so all pending requests fail
+    const QQueue<Request> requests = m_requests;
+    m_requests.clear();
+    m_buffer.clear();
+    m_pendingWrite.clear();
+    m_offset = 0;
+    m_connected = false;
+    m_timer->stop();
+
+    if (m_socket) {
+        QObject::disconnect(m_socket, nullptr, nullptr, nullptr);
+        if (m_tcpSocket) {
+            m_tcpSocket->abort();
+        } else {
+            m_localSocket->abort();
+        }
+        m_socket->deleteLater();
+        m_socket = nullptr;
+        m_tcpSocket = nullptr;
+        m_localSocket = nullptr;
+    }
+
+    for (const Request &request : requests) {
+        finish(request, QByteArray(), 0, 0, returnType);
+    }
+}
+
+void MemcachedAsyncConnection::finish(const Request &request, const QByteArray &value, quint32 flags, quint64 cas, Memcached::MemcachedReturnType returnType)
+{
+    // The receiver, usually the Context, was deleted meanwhile
+    if (!request.receiver) {
+        return;
+    }
+
+    if (request.command == Get) {
+        if (request.getCallback) {
+            if (flags & MemcachedPrivate::Compressed) {
+                request.getCallback(qUncompress(value), cas, returnType);
+            } else {
+                request.getCallback(value, cas, returnType);
+            }
+        }
+    } else if (request.resultCallback) {
+        request.resultCallback(returnType);
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef CUTELYSTMEMCACHEDASYNC_P_H
+#define CUTELYSTMEMCACHEDASYNC_P_H
+
+#include "memcached.h"
+
+#include <QByteArray>
+#include <QPointer>
+#include <QQueue>
+
+class QIODevice;
+class QTcpSocket;
+class QLocalSocket;
+class QTimer;
+
+namespace Cutelyst {
+
+/**
+ * A non blocking connection to a memcached server speaking the text
+ * protocol, driven by the event loop of the thread that created it.
+ *
+ * Requests are written as soon as they are sent, without waiting for
+ * the previous answers, and the server answers them in order.
+ */
+class MemcachedAsyncConnection
+{
+public:
+    enum Command {
+        Get,
+        Store,
+        Delete
+    };
+
+    struct Request {
+        Command command;
+        QPointer<QObject> receiver;
+        Memcached::GetCallback getCallback;
+        Memcached::ResultCallback resultCallback;
+    };
+
+    MemcachedAsyncConnection(const QString &name, quint16 port, int timeout);
+    ~MemcachedAsyncConnection();
+
+    void send(const QByteArray &data, const Request &request);
+
+    // Answers request with returnType on the next event loop iteration
+    static void fail(const Request &request, Memcached::MemcachedReturnType returnType);
+
+private:
+    void connectToServer();
+    void connected();
+    void readResponses();
+    // Returns false if the answer to the oldest request is incomplete
+    bool readResponse();
+    void abort(Memcached::MemcachedReturnType returnType);
+
+    static void finish(const Request &request, const QByteArray &value, quint32 flags, quint64 cas, Memcached::MemcachedReturnType returnType);
+
+    QQueue<Request> m_requests;
+    QByteArray m_buffer;
+    QByteArray m_pendingWrite;
+    QString m_name;
+    QIODevice *m_socket = nullptr;
+    QTcpSocket *m_tcpSocket = nullptr;
+    QLocalSocket *m_localSocket = nullptr;
+    QTimer *m_timer = nullptr;
+    int m_offset = 0;
+    int m_timeout;
+    quint16 m_port;
+    bool m_connected = false;
+};
+
+}
+
+#endif // CUTELYSTMEMCACHEDASYNC_P_H
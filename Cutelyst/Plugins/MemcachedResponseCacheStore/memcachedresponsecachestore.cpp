@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "memcachedresponsecachestore_p.h"
+
+#include <Cutelyst/Application>
+#include <Cutelyst/Engine>
+#include <Cutelyst/Plugins/Memcached/Memcached>
+
+#include <QLoggingCategory>
+
+using namespace Cutelyst;
+
+Q_LOGGING_CATEGORY(C_MEMCACHEDRESPONSECACHESTORE, "cutelyst.plugin.memcachedresponsecachestore", QtWarningMsg)
+
+MemcachedResponseCacheStore::MemcachedResponseCacheStore(Application *app, QObject *parent) :
+    ResponseCacheStore(parent), d_ptr(new MemcachedResponseCacheStorePrivate)
+{
+    Q_D(MemcachedResponseCacheStore);
+    Q_ASSERT_X(app, "construct MemcachedResponseCacheStore", "you have to specifiy a pointer to the Application object");
+    const QVariantMap map = app->engine()->config(QStringLiteral("Cutelyst_MemcachedResponseCacheStore_Plugin"));
+    d->groupKey = map.value(QStringLiteral("group_key")).toString();
+}
+
+MemcachedResponseCacheStore::~MemcachedResponseCacheStore()
+{
+
+}
+
+QByteArray MemcachedResponseCacheStore::get(const QString &key)
+{
+    Q_D(MemcachedResponseCacheStore);
+    Memcached::MemcachedReturnType rt;
+    QByteArray entry;
+    if (d->groupKey.isEmpty()) {
+        entry = Memcached::get(key, nullptr, &rt);
+    } else {
+        entry = Memcached::getByKey(d->groupKey, key, nullptr, &rt);
+    }
+
+    if (rt != Memcached::Success && rt != Memcached::NotFound) {
+        qCWarning(C_MEMCACHEDRESPONSECACHESTORE) << "Failed to get response from Memcached:" << rt;
+    }
+
+    return entry;
+}
+
+bool MemcachedResponseCacheStore::set(const QString &key, const QByteArray &entry, int expires)
+{
+    Q_D(MemcachedResponseCacheStore);
+    if (d->groupKey.isEmpty()) {
+        return Memcached::set(key, entry, expires);
+    }
+    return Memcached::setByKey(d->groupKey, key, entry, expires);
+}
+
+bool MemcachedResponseCacheStore::remove(const QString &key)
+{
+    Q_D(MemcachedResponseCacheStore);
+    if (d->groupKey.isEmpty()) {
+        return Memcached::remove(key);
+    }
+    return Memcached::removeByKey(d->groupKey, key);
+}
+
+bool MemcachedResponseCacheStore::add(const QString &key, const QByteArray &entry, int expires)
+{
+    Q_D(MemcachedResponseCacheStore);
+    Memcached::MemcachedReturnType rt;
+    bool ok;
+    if (d->groupKey.isEmpty()) {
+        ok = Memcached::add(key, entry, expires, &rt);
+    } else {
+        ok = Memcached::addByKey(d->groupKey, key, entry, expires, &rt);
+    }
+
+    // Without a server a lease can not be shared, but the response
+    // must still be regenerated by someone
+    return ok || (rt != Memcached::NotStored && rt != Memcached::DataExists);
+}
+
+void MemcachedResponseCacheStore::setGroupKey(const QString &groupKey)
+{
+    Q_D(MemcachedResponseCacheStore);
+    d->groupKey = groupKey;
+}
+
+#include "moc_memcachedresponsecachestore.cpp"
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef CUTELYSTMEMCACHEDRESPONSECACHESTORE_H
+#define CUTELYSTMEMCACHEDRESPONSECACHESTORE_H
+
+#include <Cutelyst/Plugins/ResponseCache/responsecache.h>
+#include <Cutelyst/cutelyst_global.h>
+
+namespace Cutelyst {
+
+class Application;
+class MemcachedResponseCacheStorePrivate;
+
+/**
+ * @brief Memcached based response cache store.
+ *
+ * This store keeps the responses cached by the ResponseCache plugin on the memcached servers
+ * configured for the Memcached plugin, so they are shared by all worker processes and machines.
+ * The leases used to regenerate stale responses are taken with Memcached::add(), so only one
+ * request of the whole cluster regenerates a response.
+ *
+ * <H3>Blocking requests</H3>
+ *
+ * The ResponseCacheStore interface is synchronous, so every request to a cacheable action blocks
+ * its worker thread for a round trip to the memcached server to look up the response, and for
+ * another one to store it on a miss. Run enough worker threads to cover that latency, or enable
+ * the @a local_cache_size option of the Memcached plugin to answer frequent responses from memory,
+ * keeping in mind that a replaced response is then still served for up to @a local_cache_ttl.
+ *
+ * <H3>Configuration</h3>
+ *
+ * The %MemcachedResponseCacheStore can be configured in the cutelyst configuration file in the
+ * @c Cutelyst_MemcachedResponseCacheStore_Plugin section:
+ * @li @a group_key - string value, if set, all responses are stored on the server selected by this key (default: empty)
+ *
+ * <H3>Usage example</H3>
+ *
+ * @code{.cpp}
+ * #include <Cutelyst/Plugins/ResponseCache/ResponseCache>
+ * #include <Cutelyst/Plugins/MemcachedResponseCacheStore/MemcachedResponseCacheStore>
+ * #include <Cutelyst/Plugins/Memcached/Memcached>
+ *
+ * bool MyCutelystApp::init()
+ * {
+ *     new Memcached(this);
+ *
+ *     auto cache = new ResponseCache(this);
+ *     cache->setStore(new MemcachedResponseCacheStore(this));
+ * }
+ * @endcode
+ *
+ * @since Cutelyst 2.9.0
+ */
+class CUTELYST_PLUGIN_MEMCACHEDRESPONSECACHESTORE_EXPORT MemcachedResponseCacheStore : public ResponseCacheStore
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(MemcachedResponseCacheStore)
+public:
+    /**
+     * Constructs a new MemcachedResponseCacheStore object with the given @a parent,
+     * reading the configuration of the @a app.
+     */
+    explicit MemcachedResponseCacheStore(Application *app, QObject *parent = nullptr);
+
+    /**
+     * Deconstructs the MemcachedResponseCacheStore object.
+     */
+    ~MemcachedResponseCacheStore();
+
+    /**
+     * Reimplemented from ResponseCacheStore::get().
+     *
+     * Blocks until the memcached server answers.
+     */
+    virtual QByteArray get(const QString &key) final;
+
+    /**
+     * Reimplemented from ResponseCacheStore::set().
+     */
+    virtual bool set(const QString &key, const QByteArray &entry, int expires) final;
+
+    /**
+     * Reimplemented from ResponseCacheStore::remove().
+     */
+    virtual bool remove(const QString &key) final;
+
+    /**
+     * Reimplemented from ResponseCacheStore::add().
+     */
+    virtual bool add(const QString &key, const QByteArray &entry, int expires) final;
+
+    /**
+     * Sets the @a groupKey that selects the server all responses are stored on.
+     */
+    void setGroupKey(const QString &groupKey);
+
+protected:
+    QScopedPointer<MemcachedResponseCacheStorePrivate> d_ptr;
+};
+
+}
+
+#endif // CUTELYSTMEMCACHEDRESPONSECACHESTORE_H
@@ -0,0 +1,407 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "responsecache_p.h"
+
+#include "responsecachestorememory.h"
+
+#include <Cutelyst/Application>
+#include <Cutelyst/Context>
+#include <Cutelyst/Request>
+#include <Cutelyst/Response>
+#include <Cutelyst/Action>
+#include <Cutelyst/Engine>
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QTimer>
+#include <QUrl>
+#include <QLoggingCategory>
+
+using namespace Cutelyst;
+
+Q_LOGGING_CATEGORY(C_RESPONSECACHE, "cutelyst.plugin.responsecache", QtWarningMsg)
+
+#define RESPONSE_CACHE_KEY QStringLiteral("_c_responsecache_key")
+#define RESPONSE_CACHE_HIT QStringLiteral("_c_responsecache_hit")
+#define RESPONSE_CACHE_EXPIRES QStringLiteral("_c_responsecache_expires")
+#define RESPONSE_CACHE_STALE QStringLiteral("_c_responsecache_stale")
+#define RESPONSE_CACHE_LEASE QStringLiteral("_c_responsecache_lease")
+
+static const quint32 ResponseCacheMagic = 0x43524331;
+
+// Requests of a worker thread are processed by a single event
+// loop, so coalescing them needs no locking
+static thread_local QHash<QString, InFlight> inFlight;
+
+ResponseCacheStore::ResponseCacheStore(QObject *parent) : QObject(parent)
+{
+
+}
+
+bool ResponseCacheStore::add(const QString &key, const QByteArray &entry, int expires)
+{
+    Q_UNUSED(key)
+    Q_UNUSED(entry)
+    Q_UNUSED(expires)
+    return true;
+}
+
+ResponseCache::ResponseCache(Application *parent) : Plugin(parent)
+  , d_ptr(new ResponseCachePrivate)
+{
+
+}
+
+ResponseCache::~ResponseCache()
+{
+    delete d_ptr;
+}
+
+void ResponseCache::setStore(ResponseCacheStore *store)
+{
+    Q_D(ResponseCache);
+    if (d->store) {
+        qFatal("Response cache store is already defined");
+    }
+    store->setParent(this);
+    d->store = store;
+}
+
+ResponseCacheStore *ResponseCache::store() const
+{
+    Q_D(const ResponseCache);
+    return d->store;
+}
+
+QString ResponseCache::cacheKey(Context *c)
+{
+    return c->stash(RESPONSE_CACHE_KEY).toString();
+}
+
+bool ResponseCache::isCached(Context *c)
+{
+    return c->stash(RESPONSE_CACHE_HIT).toBool();
+}
+
+bool ResponseCache::setup(Application *app)
+{
+    Q_D(ResponseCache);
+
+    const QVariantMap config = app->engine()->config(QStringLiteral("Cutelyst_ResponseCache_Plugin"));
+    d->defaultExpires = config.value(QStringLiteral("expires"), 60).toInt();
+    d->defaultStale = config.value(QStringLiteral("stale"), 0).toInt();
+    d->leaseTimeout = qMax(1, config.value(QStringLiteral("lease_timeout"), 10).toInt());
+    d->coalesce = config.value(QStringLiteral("coalesce"), true).toBool();
+    d->coalesceTimeout = qMax(1, config.value(QStringLiteral("coalesce_timeout"), 5).toInt());
+    const QStringList vary = config.value(QStringLiteral("vary")).toString().split(QLatin1Char(','), QString::SkipEmptyParts);
+    for (const QString &header : vary) {
+        d->vary.append(header.trimmed());
+    }
+
+    connect(app, &Application::beforeDispatch, this, [d] (Context *c) {
+        d->beforeDispatch(c);
+    }, Qt::DirectConnection);
+    connect(app, &Application::afterDispatch, this, [d] (Context *c) {
+        d->afterDispatch(c);
+    }, Qt::DirectConnection);
+
+    if (!d->store) {
+        d->store = new ResponseCacheStoreMemory(app, this);
+    }
+
+    return true;
+}
+
+void ResponseCachePrivate::beforeDispatch(Context *c)
+{
+    Action *action = c->action();
+    Request *req = c->request();
+    if (!action || !(req->isGet() || req->isHead())) {
+        return;
+    }
+
+    const QMap<QString, QString> attributes = action->attributes();
+    auto it = attributes.constFind(QStringLiteral("Cache"));
+    if (it == attributes.constEnd()) {
+        return;
+    }
+
+    const int expires = it.value().isEmpty() ? defaultExpires : it.value().toInt();
+    if (expires <= 0) {
+        return;
+    }
+
+    it = attributes.constFind(QStringLiteral("CacheStale"));
+    const int stale = it == attributes.constEnd() ? defaultStale : qMax(0, it.value().toInt());
+
+    QStringList varyHeaders = vary;
+    it = attributes.constFind(QStringLiteral("CacheVary"));
+    if (it != attributes.constEnd()) {
+        const QStringList headers = it.value().split(QLatin1Char(','), QString::SkipEmptyParts);
+        for (const QString &header : headers) {
+            varyHeaders.append(header.trimmed());
+        }
+    }
+
+    const QString key = makeKey(c, varyHeaders);
+    c->setStash(RESPONSE_CACHE_KEY, key);
+
+    CachedResponse cached;
+    if (deserialize(store->get(key), &cached)) {
+        const qint64 age = qMax(Q_INT64_C(0), QDateTime::currentMSecsSinceEpoch() / 1000 - cached.created);
+        if (age < cached.expires + stale) {
+            // Only one request regenerates a stale response, the
+            // others are answered with it meanwhile
+            if (age < cached.expires || !store->add(key + QLatin1String("_lease"), QByteArrayLiteral("1"), leaseTimeout)) {
+                Response *res = c->response();
+                restore(res, cached);
+                res->headers().setHeader(QStringLiteral("AGE"), QString::number(age));
+                c->setStash(RESPONSE_CACHE_HIT, true);
+                c->detach();
+                return;
+            }
+            c->setStash(RESPONSE_CACHE_LEASE, true);
+        }
+    }
+
+    c->setStash(RESPONSE_CACHE_EXPIRES, expires);
+    c->setStash(RESPONSE_CACHE_STALE, stale);
+
+    // On a miss only the first request runs the action, identical ones
+    // arriving before it finishes wait for a copy of its response
+    if (coalesce && !c->stash(RESPONSE_CACHE_LEASE).toBool()) {
+        auto flight = inFlight.find(key);
+        if (flight != inFlight.end()) {
+            flight->waiters.append(c);
+            c->detachAsync();
+            QTimer::singleShot(coalesceTimeout * 1000, c, [key, c] {
+                stopWaiting(key, c);
+            });
+            return;
+        }
+
+        lead(key, c);
+    }
+}
+
+void ResponseCachePrivate::afterDispatch(Context *c)
+{
+    const QString key = c->stash(RESPONSE_CACHE_KEY).toString();
+    if (key.isEmpty() || c->stash(RESPONSE_CACHE_HIT).toBool()) {
+        return;
+    }
+
+    Response *res = c->response();
+    const qint64 created = QDateTime::currentMSecsSinceEpoch() / 1000;
+    const int expires = c->stash(RESPONSE_CACHE_EXPIRES).toInt();
+    if (isCacheable(c, res)) {
+        const int stale = c->stash(RESPONSE_CACHE_STALE).toInt();
+        const QByteArray entry = serialize(res, created, expires);
+        if (!store->set(key, entry, expires + stale)) {
+            qCWarning(C_RESPONSECACHE) << "Failed to store response for" << c->request()->path();
+        }
+    }
+
+    if (c->stash(RESPONSE_CACHE_LEASE).toBool()) {
+        store->remove(key + QLatin1String("_lease"));
+    }
+
+    auto flight = inFlight.constFind(key);
+    if (flight != inFlight.constEnd() && flight->leader == c) {
+        if (isShareable(c, res)) {
+            const CachedResponse response = {
+                created,
+                expires,
+                res->status(),
+                res->headers().data(),
+                res->body()
+            };
+            releaseWaiters(key, &response);
+        } else {
+            releaseWaiters(key, nullptr);
+        }
+    }
+}
+
+QString ResponseCachePrivate::makeKey(Context *c, const QStringList &vary)
+{
+    static const QString prefix = QCoreApplication::applicationName() + QLatin1String("_rc_");
+
+    Request *req = c->request();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(req->method().toLatin1());
+    hash.addData(" ", 1);
+    hash.addData(req->uri().toEncoded());
+    for (const QString &header : vary) {
+        hash.addData("\n", 1);
+        hash.addData(header.toLatin1());
+        hash.addData(":", 1);
+        hash.addData(req->header(header).toUtf8());
+    }
+
+    return prefix + QString::fromLatin1(hash.result().toHex());
+}
+
+bool ResponseCachePrivate::isShareable(Context *c, Response *res)
+{
+    if (c->error() || res->bodyDevice()) {
+        return false;
+    }
+
+    const Headers &headers = res->headers();
+    if (!headers.header(QStringLiteral("SET_COOKIE")).isNull()) {
+        return false;
+    }
+
+    const QString cacheControl = headers.header(QStringLiteral("CACHE_CONTROL"));
+    return !cacheControl.contains(QLatin1String("no-store"), Qt::CaseInsensitive) &&
+            !cacheControl.contains(QLatin1String("private"), Qt::CaseInsensitive);
+}
+
+bool ResponseCachePrivate::isCacheable(Context *c, Response *res)
+{
+    switch (res->status()) {
+    case Response::OK:
+    case Response::NonAuthoritativeInformation:
+    case Response::MultipleChoices:
+    case Response::MovedPermanently:
+    case Response::NotFound:
+    case Response::Gone:
+        return isShareable(c, res);
+    default:
+        return false;
+    }
+}
+
+QByteArray ResponseCachePrivate::serialize(Response *res, qint64 created, int expires)
+{
+    QByteArray entry;
+    QDataStream out(&entry, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << ResponseCacheMagic << created << qint32(expires) << res->status()
+        << res->headers().data() << res->body();
+    return entry;
+}
+
+bool ResponseCachePrivate::deserialize(const QByteArray &entry, CachedResponse *cached)
+{
+    if (entry.isEmpty()) {
+        return false;
+    }
+
+    QDataStream in(entry);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic;
+    in >> magic;
+    if (magic != ResponseCacheMagic) {
+        return false;
+    }
+
+    in >> cached->created >> cached->expires >> cached->status >> cached->headers >> cached->body;
+    return in.status() == QDataStream::Ok;
+}
+
+void ResponseCachePrivate::restore(Response *res, const CachedResponse &cached)
+{
+    res->setStatus(cached.status);
+
+    Headers &headers = res->headers();
+    headers.clear();
+    auto it = cached.headers.constBegin();
+    while (it != cached.headers.constEnd()) {
+        headers.pushRawHeader(it.key(), it.value());
+        ++it;
+    }
+
+    res->setBody(cached.body);
+}
+
+void ResponseCachePrivate::lead(const QString &key, Context *c)
+{
+    inFlight[key].leader = c;
+    QObject::connect(c, &QObject::destroyed, [key, c] {
+        // The leader went away without finishing
+        auto it = inFlight.constFind(key);
+        if (it != inFlight.constEnd() && it->leader == c) {
+            releaseWaiters(key, nullptr);
+        }
+    });
+}
+
+void ResponseCachePrivate::releaseWaiters(const QString &key, const CachedResponse *response)
+{
+    QVector<QPointer<Context>> waiters = inFlight.take(key).waiters;
+
+    // Resume from the event loop, after the leader was finalized
+    if (response) {
+        const CachedResponse copy = *response;
+        for (const QPointer<Context> &waiter : waiters) {
+            Context *c = waiter.data();
+            if (!c) {
+                continue;
+            }
+
+            QTimer::singleShot(0, c, [c, copy] {
+                restore(c->response(), copy);
+                c->setStash(RESPONSE_CACHE_HIT, true);
+                c->detach();
+                c->attachAsync();
+            });
+        }
+        return;
+    }
+
+    // Without a response to share the next waiter runs the action,
+    // the others keep waiting on it
+    while (!waiters.isEmpty()) {
+        Context *c = waiters.takeFirst().data();
+        if (!c) {
+            continue;
+        }
+
+        lead(key, c);
+        inFlight[key].waiters = waiters;
+        QTimer::singleShot(0, c, [c] {
+            c->attachAsync();
+        });
+        return;
+    }
+}
+
+void ResponseCachePrivate::stopWaiting(const QString &key, Context *c)
+{
+    auto flight = inFlight.find(key);
+    if (flight == inFlight.end()) {
+        return;
+    }
+
+    for (int i = 0; i < flight->waiters.size(); ++i) {
+        if (flight->waiters.at(i).data() == c) {
+            // Waited too long, the action is run without waiting any further
+            qCDebug(C_RESPONSECACHE) << "Timeout waiting for an identical request to" << c->request()->path();
+            flight->waiters.remove(i);
+            c->attachAsync();
+            return;
+        }
+    }
+}
+
+#include "moc_responsecache.cpp"
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef CRESPONSECACHE_H
+#define CRESPONSECACHE_H
+
+#include <Cutelyst/plugin.h>
+#include <Cutelyst/cutelyst_global.h>
+
+namespace Cutelyst {
+
+class Context;
+
+/**
+ * @brief Abstract class for the backends of the ResponseCache plugin.
+ *
+ * A store keeps opaque entries, the serialized responses, under string keys that are
+ * valid memcached keys. Entries expire on their own after the given number of seconds.
+ *
+ * @since Cutelyst 2.9.0
+ */
+class CUTELYST_PLUGIN_RESPONSECACHE_EXPORT ResponseCacheStore : public QObject {
+    Q_OBJECT
+public:
+    /**
+     * Constructs a new response cache store object with the given parent.
+     */
+    explicit ResponseCacheStore(QObject *parent = nullptr);
+
+    /**
+     * Returns the entry stored for @a key, or a null QByteArray if there is none.
+     */
+    virtual QByteArray get(const QString &key) = 0;
+
+    /**
+     * Stores @a entry for @a key, replacing the previous entry, for @a expires seconds.
+     */
+    virtual bool set(const QString &key, const QByteArray &entry, int expires) = 0;
+
+    /**
+     * Removes the entry stored for @a key.
+     */
+    virtual bool remove(const QString &key) = 0;
+
+    /**
+     * Stores @a entry for @a key for @a expires seconds only if there is no entry for @a key yet,
+     * returning true if it was stored. The check and the write must be atomic, as it is used to
+     * let a single request regenerate a stale response.
+     *
+     * The default implementation always returns true, so every request that finds a stale
+     * response regenerates it.
+     */
+    virtual bool add(const QString &key, const QByteArray &entry, int expires);
+};
+
+class ResponseCachePrivate;
+
+/**
+ * @brief Caches whole responses of actions marked as cacheable.
+ *
+ * The %ResponseCache plugin stores the status, headers and body of responses to @c GET and
+ * @c HEAD requests of actions that have the @c :Cache attribute, and answers later requests for
+ * the same URL from the cache, before any begin, auto or action method of the controllers runs.
+ *
+ * @code{.cpp}
+ * C_ATTR(news, :Local :Cache(60) :CacheStale(30) :CacheVary(Accept-Language))
+ * void news(Context *c);
+ * @endcode
+ *
+ * The attributes are:
+ * @li @a Cache - seconds a response is fresh, without value the @a expires configuration option is used
+ * @li @a CacheStale - seconds a response is still served after it expired, while a single request regenerates it
+ * @li @a CacheVary - comma separated list of request headers whose values select different responses
+ *
+ * Responses are only stored if their status is 200, 203, 300, 301, 404 or 410, if their body
+ * is not a QIODevice and if they have no @c Set-Cookie header and no @c Cache-Control header
+ * with @c private or @c no-store, so an action can opt out at runtime. Responses that depend on
+ * the session or the logged in user must vary on the @c Cookie header or not be cached at all.
+ *
+ * <H3>Stale while revalidate</H3>
+ *
+ * When a response expired but is still within its @a CacheStale time, the first request takes a
+ * short lease in the store and runs the action to regenerate it, the requests arriving meanwhile
+ * are answered with the stale response. The lease expires after @a lease_timeout seconds in case
+ * the regenerating request never finishes.
+ *
+ * <H3>Request coalescing</H3>
+ *
+ * When there is no usable response, the first request of a worker thread runs the action and
+ * identical requests arriving on the same thread before it finishes are suspended with
+ * Context::detachAsync(), without running any controller method. Once the first request is
+ * done they are answered with a copy of its response. If it could not be shared because of an
+ * error, a @c Set-Cookie header or a private @c Cache-Control, the next waiting request runs the
+ * action and the others keep waiting on it. A request that waited @a coalesce_timeout seconds
+ * runs the action itself. Worker threads and processes do not wait on each other.
+ *
+ * <H3>Configuration</H3>
+ *
+ * The plugin can be configured in the @c Cutelyst_ResponseCache_Plugin section of the application
+ * configuration file:
+ * @li @a expires - integer value, seconds a response is fresh if the @c :Cache attribute has no value (default: 60)
+ * @li @a stale - integer value, seconds a response is served stale if there is no @c :CacheStale attribute (default: 0)
+ * @li @a vary - string value, comma separated list of request headers all cached responses vary on (default: empty)
+ * @li @a lease_timeout - integer value, seconds a request may take to regenerate a stale response (default: 10)
+ * @li @a coalesce - boolean value, identical concurrent requests wait for the first one to generate the response (default: true)
+ * @li @a coalesce_timeout - integer value, seconds a request waits for an identical one before running the action itself (default: 5)
+ *
+ * <H3>Usage example</H3>
+ *
+ * @code{.cpp}
+ * #include <Cutelyst/Plugins/ResponseCache/ResponseCache>
+ * #include <Cutelyst/Plugins/ResponseCache/ResponseCacheStoreMemory>
+ *
+ * bool MyCutelystApp::init()
+ * {
+ *     auto cache = new ResponseCache(this);
+ *     cache->setStore(new ResponseCacheStoreMemory(this));
+ * }
+ * @endcode
+ *
+ * If no store is set, a ResponseCacheStoreMemory is used.
+ *
+ * @since Cutelyst 2.9.0
+ */
+class CUTELYST_PLUGIN_RESPONSECACHE_EXPORT ResponseCache : public Plugin
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(ResponseCache)
+public:
+    /**
+     * Constructs a new response cache object with the given parent.
+     */
+    ResponseCache(Application *parent);
+    virtual ~ResponseCache();
+
+    /**
+     * Sets the response cache @a store, the plugin takes its ownership.
+     */
+    void setStore(ResponseCacheStore *store);
+
+    /**
+     * Returns the response cache store.
+     */
+    ResponseCacheStore *store() const;
+
+    /**
+     * Returns the key of the cached response for the current request, or an empty
+     * string if the current action is not cacheable.
+     */
+    static QString cacheKey(Context *c);
+
+    /**
+     * Returns true if the current request was answered from the cache,
+     * or with the response of an identical concurrent request.
+     */
+    static bool isCached(Context *c);
+
+protected:
+    /**
+     * Reimplemented from Plugin::setup().
+     */
+    virtual bool setup(Application *app) override;
+
+    ResponseCachePrivate *d_ptr;
+};
+
+}
+
+#endif // CRESPONSECACHE_H
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef RESPONSECACHE_P_H
+#define RESPONSECACHE_P_H
+
+#include "responsecache.h"
+
+#include <QHash>
+#include <QPointer>
+#include <QStringList>
+#include <QVector>
+
+namespace Cutelyst {
+
+class Response;
+
+struct CachedResponse {
+    qint64 created;
+    qint32 expires;
+    quint16 status;
+    QHash<QString, QString> headers;
+    QByteArray body;
+};
+
+// A cache miss being computed by the leader context, the
+// identical requests that arrived meanwhile wait on it
+struct InFlight {
+    Context *leader = nullptr;
+    QVector<QPointer<Context>> waiters;
+};
+
+class ResponseCachePrivate
+{
+public:
+    void beforeDispatch(Context *c);
+    void afterDispatch(Context *c);
+
+    static QString makeKey(Context *c, const QStringList &vary);
+    static bool isShareable(Context *c, Response *res);
+    static bool isCacheable(Context *c, Response *res);
+    static QByteArray serialize(Response *res, qint64 created, int expires);
+    static bool deserialize(const QByteArray &entry, CachedResponse *cached);
+    static void restore(Response *res, const CachedResponse &cached);
+    static void lead(const QString &key, Context *c);
+    static void releaseWaiters(const QString &key, const CachedResponse *response);
+    static void stopWaiting(const QString &key, Context *c);
+
+    ResponseCacheStore *store = nullptr;
+    QStringList vary;
+    int defaultExpires = 60;
+    int defaultStale = 0;
+    int leaseTimeout = 10;
+    int coalesceTimeout = 5;
+    bool coalesce = true;
+};
+
+}
+
+#endif // RESPONSECACHE_P_H
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "responsecachestorememory.h"
+
+#include <Cutelyst/Application>
+#include <Cutelyst/Engine>
+
+#include <QCache>
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include <limits>
+
+using namespace Cutelyst;
+
+namespace {
+struct MemoryEntry {
+    QByteArray data;
+    qint64 expires;
+};
+
+// Every worker thread might have its own application and store
+// objects, so the responses live in a single table per process
+struct MemoryCache {
+    MemoryCache() { clock.start(); }
+
+    // Returns the entry of key unless it expired
+    MemoryEntry *entry(const QString &key)
+    {
+        MemoryEntry *entry = entries.object(key);
+        if (entry && entry->expires <= clock.elapsed()) {
+            entries.remove(key);
+            return nullptr;
+        }
+        return entry;
+    }
+
+    bool insert(const QString &key, const QByteArray &data, int expires)
+    {
+        const int cost = key.size() * 2 + data.size();
+        return entries.insert(key, new MemoryEntry{data, clock.elapsed() + qint64(expires) * 1000}, cost);
+    }
+
+    QMutex mutex;
+    QCache<QString, MemoryEntry> entries;
+    QElapsedTimer clock;
+};
+}
+Q_GLOBAL_STATIC(MemoryCache, memoryCache)
+
+ResponseCacheStoreMemory::ResponseCacheStoreMemory(Application *app, QObject *parent) : ResponseCacheStore(parent)
+{
+    Q_ASSERT_X(app, "construct ResponseCacheStoreMemory", "you have to specifiy a pointer to the Application object");
+    const QVariantMap config = app->engine()->config(QStringLiteral("Cutelyst_ResponseCacheStoreMemory_Plugin"));
+    const qint64 maxSize = config.value(QStringLiteral("max_size"), 65536).toLongLong() * 1024;
+
+    MemoryCache *cache = memoryCache;
+    QMutexLocker locker(&cache->mutex);
+    cache->entries.setMaxCost(int(qBound(Q_INT64_C(1024), maxSize, qint64(std::numeric_limits<int>::max()))));
+}
+
+QByteArray ResponseCacheStoreMemory::get(const QString &key)
+{
+    MemoryCache *cache = memoryCache;
+    QMutexLocker locker(&cache->mutex);
+    MemoryEntry *entry = cache->entry(key);
+    return entry ? entry->data : QByteArray();
+}
+
+bool ResponseCacheStoreMemory::set(const QString &key, const QByteArray &entry, int expires)
+{
+    MemoryCache *cache = memoryCache;
+    QMutexLocker locker(&cache->mutex);
+    return cache->insert(key, entry, expires);
+}
+
+bool ResponseCacheStoreMemory::remove(const QString &key)
+{
+    MemoryCache *cache = memoryCache;
+    QMutexLocker locker(&cache->mutex);
+    return cache->entries.remove(key);
+}
+
+bool ResponseCacheStoreMemory::add(const QString &key, const QByteArray &entry, int expires)
+{
+    MemoryCache *cache = memoryCache;
+    QMutexLocker locker(&cache->mutex);
+    if (cache->entry(key)) {
+        return false;
+    }
+    return cache->insert(key, entry, expires);
+}
+
+#include "moc_responsecachestorememory.cpp"
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef RESPONSECACHESTOREMEMORY_H
+#define RESPONSECACHESTOREMEMORY_H
+
+#include <Cutelyst/Plugins/ResponseCache/responsecache.h>
+#include <Cutelyst/cutelyst_global.h>
+
+namespace Cutelyst {
+
+class Application;
+
+/**
+ * @brief In process memory based response cache store.
+ *
+ * This store keeps the cached responses in memory, shared by all worker threads of
+ * a process, evicting the least recently used responses once the configured size is
+ * reached. Each worker process has its own copy, use MemcachedResponseCacheStore to
+ * share the responses between processes and machines.
+ *
+ * <H3>Configuration</h3>
+ *
+ * The %ResponseCacheStoreMemory can be configured in the cutelyst configuration file in the
+ * @c Cutelyst_ResponseCacheStoreMemory_Plugin section:
+ * @li @a max_size - integer value, the maximum size in KiB of all cached responses of a process (default: 65536)
+ *
+ * @since Cutelyst 2.9.0
+ */
+class CUTELYST_PLUGIN_RESPONSECACHE_EXPORT ResponseCacheStoreMemory : public ResponseCacheStore
+{
+    Q_OBJECT
+public:
+    /**
+     * Constructs a new ResponseCacheStoreMemory object with the given @a parent,
+     * reading the configuration of the @a app.
+     */
+    explicit ResponseCacheStoreMemory(Application *app, QObject *parent = nullptr);
+
+    /**
+     * Reimplemented from ResponseCacheStore::get().
+     */
+    virtual QByteArray get(const QString &key) final;
+
+    /**
+     * Reimplemented from ResponseCacheStore::set().
+     */
+    virtual bool set(const QString &key, const QByteArray &entry, int expires) final;
+
+    /**
+     * Reimplemented from ResponseCacheStore::remove().
+     */
+    virtual bool remove(const QString &key) final;
+
+    /**
+     * Reimplemented from ResponseCacheStore::add().
+     */
+    virtual bool add(const QString &key, const QByteArray &entry, int expires) final;
+};
+
+}
+
+#endif // RESPONSECACHESTOREMEMORY_H
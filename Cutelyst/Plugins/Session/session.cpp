@@ -28,6 +28,8 @@
 #include <QHostAddress>
 #include <QLoggingCategory>
 #include <QCoreApplication>
+#include <QThread>
+#include <QTimer>
 
 using namespace Cutelyst;
 
@@ -38,6 +40,7 @@ Q_LOGGING_CATEGORY(C_SESSION, "cutelyst.plugin.session", QtWarningMsg)
 #define SESSION_TRIED_LOADING_EXPIRES QStringLiteral("_c_session_tried_loading_expires")
 #define SESSION_EXTENDED_EXPIRES QStringLiteral("_c_session_extended_expires")
 #define SESSION_UPDATED QStringLiteral("_c_session_updated")
+#define SESSION_DIRTY_KEYS QStringLiteral("_c_session_dirty_keys")
 #define SESSION_ID QStringLiteral("_c_session_id")
 #define SESSION_TRIED_LOADING_ID QStringLiteral("_c_session_tried_loading_id")
 #define SESSION_DELETED_ID QStringLiteral("_c_session_deleted_id")
@@ -64,13 +67,21 @@ bool Session::setup(Application *app)
     const QVariantMap config = app->engine()->config(QLatin1String("Cutelyst_Session_Plugin"));
     d->sessionExpires = config.value(QLatin1String("expires"), 7200).toLongLong();
     d->expiryThreshold = config.value(QLatin1String("expiry_threshold"), 0).toLongLong();
+    d->expiryRefreshInterval = config.value(QLatin1String("expiry_refresh_interval"), 60).toLongLong();
+    d->gcInterval = config.value(QLatin1String("gc_interval"), 600).toInt();
+    d->gcBudget = qMax(1, config.value(QLatin1String("gc_budget"), 100).toInt());
     d->verifyAddress = config.value(QLatin1String("verify_address"), false).toBool();
     d->verifyUserAgent = config.value(QLatin1String("verify_user_agent"), false).toBool();
 
-    connect(app, &Application::afterDispatch, this, &SessionPrivate::_q_saveSession);
-    connect(app, &Application::postForked, this, [=] {
+    connect(app, &Application::afterDispatch, this, &SessionPrivate::_q_saveSession, Qt::DirectConnection);
+    connect(app, &Application::postForked, this, [=] (Application *forkedApp) {
         m_instance = this;
-    });
+
+        // A single worker collects the expired sessions of the store
+        if (d->gcInterval > 0 && forkedApp->engine()->isZeroWorker() && d->gcStarted.testAndSetRelaxed(0, 1)) {
+            d->startGarbageCollector();
+        }
+    }, Qt::DirectConnection);
 
     if (!d->store) {
         d->store = new SessionStoreFile(this);
@@ -188,14 +199,20 @@ void Session::setValue(Cutelyst::Context *c, const QString &key, const QVariant
 
             SessionPrivate::createSessionIdIfNeeded(m_instance, c, m_instance->d_ptr->sessionExpires);
             session = SessionPrivate::initializeSessionData(m_instance, c);
+            SessionPrivate::markDirty(c, session.toHash().keys());
         }
     }
 
     QVariantHash data = session.toHash();
+    auto it = data.constFind(key);
+    if (it != data.constEnd() && it.value() == value) {
+        c->setStash(SESSION_VALUES, data);
+        return;
+    }
     data.insert(key, value);
 
     c->setStash(SESSION_VALUES, data);
-    c->setStash(SESSION_UPDATED, true);
+    SessionPrivate::markDirty(c, { key });
 }
 
 void Session::deleteValue(Context *c, const QString &key)
@@ -211,14 +228,16 @@ void Session::deleteValue(Context *c, const QString &key)
 
             SessionPrivate::createSessionIdIfNeeded(m_instance, c, m_instance->d_ptr->sessionExpires);
             session = SessionPrivate::initializeSessionData(m_instance, c);
+            SessionPrivate::markDirty(c, session.toHash().keys());
         }
     }
 
     QVariantHash data = session.toHash();
-    data.remove(key);
+    if (data.remove(key)) {
+        SessionPrivate::markDirty(c, { key });
+    }
 
     c->setStash(SESSION_VALUES, data);
-    c->setStash(SESSION_UPDATED, true);
 }
 
 void Session::deleteValues(Context *c, const QStringList &keys)
@@ -234,16 +253,22 @@ void Session::deleteValues(Context *c, const QStringList &keys)
 
             SessionPrivate::createSessionIdIfNeeded(m_instance, c, m_instance->d_ptr->sessionExpires);
             session = SessionPrivate::initializeSessionData(m_instance, c);
+            SessionPrivate::markDirty(c, session.toHash().keys());
         }
     }
 
     QVariantHash data = session.toHash();
+    QStringList removed;
     for (const QString &key : keys) {
-        data.remove(key);
+        if (data.remove(key)) {
+            removed.append(key);
+        }
     }
 
     c->setStash(SESSION_VALUES, data);
-    c->setStash(SESSION_UPDATED, true);
+    if (!removed.isEmpty()) {
+        SessionPrivate::markDirty(c, removed);
+    }
 }
 
 bool Session::isValid(Cutelyst::Context *c)
@@ -344,11 +369,60 @@ void SessionPrivate::_q_saveSession(Context *c)
         return;
     }
     SessionStore *store = m_instance->d_ptr->store;
-    QVariantHash sessionData = c->stash(SESSION_VALUES).toHash();
-    sessionData.insert(QStringLiteral("__updated"), QDateTime::currentMSecsSinceEpoch() / 1000);
+    const QVariantHash sessionData = c->stash(SESSION_VALUES).toHash();
+
+    // Only the keys changed by this request are written
+    QVariantHash changed;
+    QStringList removed;
+    const QStringList dirtyKeys = c->stash(SESSION_DIRTY_KEYS).toStringList();
+    for (const QString &key : dirtyKeys) {
+        auto it = sessionData.constFind(key);
+        if (it != sessionData.constEnd()) {
+            changed.insert(key, it.value());
+        } else {
+            removed.append(key);
+        }
+    }
+    changed.insert(QStringLiteral("__updated"), QDateTime::currentMSecsSinceEpoch() / 1000);
 
     const QString sid = c->stash(SESSION_ID).toString();
-    store->storeSessionData(c, sid,  QStringLiteral("session"), sessionData);
+    store->updateSessionData(c, sid,  QStringLiteral("session"), changed, removed);
+}
+
+void SessionPrivate::startGarbageCollector()
+{
+    Q_Q(Session);
+
+    // Shared applications emit postForked on the worker threads
+    QTimer *timer;
+    if (q->thread() == QThread::currentThread()) {
+        timer = new QTimer(q);
+    } else {
+        timer = new QTimer;
+        QObject::connect(q, &QObject::destroyed, timer, &QObject::deleteLater);
+    }
+    timer->setSingleShot(true);
+
+    // Each step checks a budget of sessions, the remaining ones are
+    // checked on the next event loop iterations until the pass is done
+    QObject::connect(timer, &QTimer::timeout, timer, [this, timer] {
+        const quint64 now = quint64(QDateTime::currentMSecsSinceEpoch() / 1000);
+        const bool done = store->collectExpiredSessions(now, gcBudget);
+        timer->start(done ? gcInterval * 1000 : 0);
+    });
+    timer->start(gcInterval * 1000);
+}
+
+void SessionPrivate::markDirty(Context *c, const QStringList &keys)
+{
+    QStringList dirtyKeys = c->stash(SESSION_DIRTY_KEYS).toStringList();
+    for (const QString &key : keys) {
+        if (!dirtyKeys.contains(key)) {
+            dirtyKeys.append(key);
+        }
+    }
+    c->setStash(SESSION_DIRTY_KEYS, dirtyKeys);
+    c->setStash(SESSION_UPDATED, true);
 }
 
 void SessionPrivate::deleteSession(Session *session, Context *c, const QString &reason)
@@ -458,7 +532,11 @@ qint64 SessionPrivate::extendSessionExpires(Session *session, Context *c, qint64
         const qint64 cutoff = current - threshold;
         const qint64 time = QDateTime::currentMSecsSinceEpoch() / 1000;
 
-        if (!threshold || cutoff <= time || c->stash(SESSION_UPDATED).toBool()) {
+        // Refreshes closer than the interval are coalesced so that
+        // requests only reading the session do not write to the store
+        const bool due = (!threshold || cutoff <= time) &&
+                time + qint64(session->d_ptr->sessionExpires) - current >= session->d_ptr->expiryRefreshInterval;
+        if (due || c->stash(SESSION_UPDATED).toBool()) {
             qint64 updated = calculateInitialSessionExpires(session, c, sid);
             c->setStash(SESSION_EXTENDED_EXPIRES, updated);
             extendSessionId(session, c, sid, updated);
@@ -600,4 +678,27 @@ SessionStore::SessionStore(QObject *parent) : QObject(parent)
 
 }
 
+bool SessionStore::updateSessionData(Context *c, const QString &sid, const QString &key, const QVariantHash &changed, const QStringList &removed)
+{
+    QVariantHash data = getSessionData(c, sid, key).toHash();
+    for (const QString &removedKey : removed) {
+        data.remove(removedKey);
+    }
+
+    auto it = changed.constBegin();
+    while (it != changed.constEnd()) {
+        data.insert(it.key(), it.value());
+        ++it;
+    }
+
+    return storeSessionData(c, sid, key, data);
+}
+
+bool SessionStore::collectExpiredSessions(quint64 expires, int budget)
+{
+    Q_UNUSED(expires)
+    Q_UNUSED(budget)
+    return true;
+}
+
 #include "moc_session.cpp"
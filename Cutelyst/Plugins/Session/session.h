@@ -53,6 +53,37 @@ public:
      * Removes all expired sessions which are above expires.
      */
     virtual bool deleteExpiredSessions(Context *c, quint64 expires) = 0;
+
+    /**
+     * Applies the @a changed and @a removed entries to the hash stored for the given session
+     * id @a sid and @a key, the other entries of the hash are left as they are.
+     *
+     * The default implementation loads the hash with getSessionData() and writes it back
+     * with storeSessionData(), stores that can write single entries should reimplement it.
+     *
+     * @note Adding this virtual changed the virtual table of SessionStore, stores
+     * implemented outside of Cutelyst must be rebuilt against 2.9.0.
+     *
+     * @since Cutelyst 2.9.0
+     */
+    virtual bool updateSessionData(Context *c, const QString &sid, const QString &key, const QVariantHash &changed, const QStringList &removed);
+
+    /**
+     * Removes at most about @a budget sessions that expired before @a expires seconds since
+     * the epoch, continuing where the previous call stopped. Returns true once all sessions
+     * were checked, the next call then starts over.
+     *
+     * It is called without a Context by the garbage collector of the Session plugin, in
+     * small steps so it does not stall request handling. The default implementation does
+     * nothing and returns true, stores that do not expire their data themselves should
+     * reimplement it.
+     *
+     * @note Like updateSessionData() it changed the virtual table of SessionStore, stores
+     * implemented outside of Cutelyst must be rebuilt against 2.9.0.
+     *
+     * @since Cutelyst 2.9.0
+     */
+    virtual bool collectExpiredSessions(quint64 expires, int budget);
 };
 
 class SessionPrivate;
@@ -72,6 +103,14 @@ public:
      * [Cutelyst_Session_Plugin]
      * expires = 1234
      * it will change the default expires which is 7200 (two hours)
+     *
+     * The expiration of sessions is only moved forward, and written to the store,
+     * once @c expiry_refresh_interval seconds (default 60) passed since it was last
+     * refreshed, or when the session values change.
+     *
+     * Expired sessions are removed from the store every @c gc_interval seconds
+     * (default 600, 0 disables) by worker zero, checking @c gc_budget sessions
+     * (default 100) per event loop iteration, see SessionStore::collectExpiredSessions().
      */
     virtual bool setup(Application *app) final;
 
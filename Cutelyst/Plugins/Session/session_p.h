@@ -21,6 +21,7 @@
 #include "session.h"
 
 #include <QtNetwork/QNetworkCookie>
+#include <QAtomicInt>
 
 namespace Cutelyst {
 
@@ -36,6 +37,8 @@ public:
     static QString createSessionIdIfNeeded(Session *session, Context *c, qint64 expires);
     static inline QString createSessionId(Session *session, Context *c, qint64 expires);
     static void _q_saveSession(Context *c);
+    static void markDirty(Context *c, const QStringList &keys);
+    void startGarbageCollector();
     static void deleteSession(Session *session, Context *c, const QString &reason);
     static inline void deleteSessionId(Session *session, Context *c, const QString &sid);
     static QVariant loadSession(Context *c);
@@ -59,6 +62,10 @@ public:
 
     qint64 sessionExpires = 7200;
     qint64 expiryThreshold = 0;
+    qint64 expiryRefreshInterval = 60;
+    int gcInterval = 600;
+    int gcBudget = 100;
+    QAtomicInt gcStarted;
     SessionStore *store = nullptr;
     QString sessionName;
     bool cookieHttpOnly = true;
@@ -21,8 +21,12 @@
 #include <Cutelyst/Application>
 
 #include <QDir>
+#include <QDirIterator>
 #include <QFile>
-#include <QLockFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QDateTime>
+#include <QSaveFile>
 #include <QDataStream>
 #include <QLoggingCategory>
 #include <QCoreApplication>
@@ -35,6 +39,29 @@ Q_LOGGING_CATEGORY(C_SESSION_FILE, "cutelyst.plugin.sessionfile", QtWarningMsg)
 #define SESSION_STORE_FILE_DATA QStringLiteral("_c_session_store_file_data")
 
 static QVariantHash loadSessionData(Context *c, const QString &sid);
+static bool removeIfExpired(const QFileInfo &info, quint64 expires);
+static QString sessionFilePath(const QString &sid);
+static bool readSessionFile(QFile *file, QVariantHash *data, qint64 *expires);
+static bool writeSessionFile(const QString &filename, const QVariantHash &data);
+
+static const quint32 SessionFileMagic = 0x43534631;
+
+namespace {
+struct FileCollector {
+    QMutex mutex;
+    QScopedPointer<QDirIterator> it;
+};
+}
+Q_GLOBAL_STATIC(FileCollector, fileCollector)
+
+static const QString &sessionRoot()
+{
+    const static QString root = QDir::tempPath()
+            + QLatin1Char('/')
+            + QCoreApplication::applicationName()
+            + QLatin1String("/session/data");
+    return root;
+}
 
 SessionStoreFile::SessionStoreFile(QObject *parent) : SessionStore(parent)
 {
@@ -77,10 +104,127 @@ bool SessionStoreFile::deleteSessionData(Context *c, const QString &sid, const Q
 bool SessionStoreFile::deleteExpiredSessions(Context *c, quint64 expires)
 {
     Q_UNUSED(c)
-    Q_UNUSED(expires)
+    QDirIterator it(sessionRoot(), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        removeIfExpired(it.fileInfo(), expires);
+    }
     return true;
 }
 
+bool SessionStoreFile::collectExpiredSessions(quint64 expires, int budget)
+{
+    FileCollector *collector = fileCollector();
+    QMutexLocker locker(&collector->mutex);
+    if (!collector->it) {
+        collector->it.reset(new QDirIterator(sessionRoot(), QDir::Files, QDirIterator::Subdirectories));
+    }
+
+    int removed = 0;
+    QDirIterator *it = collector->it.data();
+    while (budget-- > 0 && it->hasNext()) {
+        it->next();
+        if (removeIfExpired(it->fileInfo(), expires)) {
+            ++removed;
+        }
+    }
+    qCDebug(C_SESSION_FILE) << "Removed" << removed << "expired sessions";
+
+    if (it->hasNext()) {
+        return false;
+    }
+    collector->it.reset();
+    return true;
+}
+
+bool removeIfExpired(const QFileInfo &info, quint64 expires)
+{
+    // Skips lock files of the old layout and files being saved
+    if (info.fileName().endsWith(QLatin1String(".lock")) ||
+            info.lastModified().secsTo(QDateTime::currentDateTime()) < 60) {
+        return false;
+    }
+
+    QFile file(info.filePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // Files that can not be read were left by interrupted saves
+    qint64 fileExpires = 0;
+    readSessionFile(&file, nullptr, &fileExpires);
+    if (quint64(fileExpires) < expires) {
+        qCDebug(C_SESSION_FILE) << "Removing expired session" << info.fileName();
+        return file.remove();
+    }
+    return false;
+}
+
+QString sessionFilePath(const QString &sid)
+{
+    QString ret = sessionRoot();
+    ret.reserve(ret.size() + sid.size() + 7);
+    ret.append(QLatin1Char('/'));
+    if (sid.size() > 4) {
+        ret.append(sid.midRef(0, 2)).append(QLatin1Char('/'))
+                .append(sid.midRef(2, 2)).append(QLatin1Char('/'));
+    }
+    ret.append(sid);
+    return ret;
+}
+
+bool readSessionFile(QFile *file, QVariantHash *data, qint64 *expires)
+{
+    QDataStream in(file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0;
+    in >> magic;
+    if (magic == SessionFileMagic) {
+        in >> *expires;
+        if (data) {
+            in >> *data;
+        }
+        return in.status() == QDataStream::Ok;
+    }
+
+    // Files of the previous layout only hold the hash
+    QVariantHash hash;
+    file->seek(0);
+    QDataStream legacy(file);
+    legacy >> hash;
+    *expires = hash.value(QStringLiteral("expires")).toLongLong();
+    if (data) {
+        *data = hash;
+    }
+    return legacy.status() == QDataStream::Ok;
+}
+
+bool writeSessionFile(const QString &filename, const QVariantHash &data)
+{
+    // The data is written to a temporary file that is renamed over the
+    // old one, so readers always see a complete file without locking
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        const QString path = QFileInfo(filename).path();
+        if (!QDir().mkpath(path)) {
+            qCWarning(C_SESSION_FILE) << "Failed to create path for session object" << path;
+            return false;
+        }
+
+        if (!file.open(QIODevice::WriteOnly)) {
+            qCWarning(C_SESSION_FILE) << "Failed to save session" << filename << file.errorString();
+            return false;
+        }
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << SessionFileMagic << data.value(QStringLiteral("expires")).toLongLong() << data;
+
+    return file.commit();
+}
+
 QVariantHash loadSessionData(Context *c, const QString &sid)
 {
     QVariantHash data;
@@ -90,25 +234,27 @@ QVariantHash loadSessionData(Context *c, const QString &sid)
         return data;
     }
 
-    const static QString root = QDir::tempPath()
-            + QLatin1Char('/')
-            + QCoreApplication::applicationName()
-            + QLatin1String("/session/data");
+    const QString filename = sessionFilePath(sid);
 
-    auto file = new QFile(root + QLatin1Char('/') + sid, c);
-    if (!file->open(QIODevice::ReadWrite)) {
-        if (!QDir().mkpath(root)) {
-            qCWarning(C_SESSION_FILE) << "Failed to create path for session object" << root;
-            return data;
+    // Load data, sessions saved before the sharded layout are moved on save
+    QString legacyFilename;
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        file.setFileName(sessionRoot() + QLatin1Char('/') + sid);
+        if (file.open(QIODevice::ReadOnly)) {
+            legacyFilename = file.fileName();
         }
+    }
 
-        if (!file->open(QIODevice::ReadWrite)) {
-            return data;
+    if (file.isOpen()) {
+        qint64 expires;
+        if (!readSessionFile(&file, &data, &expires)) {
+            qCWarning(C_SESSION_FILE) << "Failed to read session" << file.fileName();
         }
     }
 
     // Commit data when Context gets deleted
-    QObject::connect(c->app(), &Application::afterDispatch, c, [c,file] {
+    QObject::connect(c->app(), &Application::afterDispatch, c, [c, filename, legacyFilename] {
         if (!c->stash(SESSION_STORE_FILE_SAVE).toBool()) {
             return;
         }
@@ -116,36 +262,16 @@ QVariantHash loadSessionData(Context *c, const QString &sid)
         const QVariantHash data = c->stash(SESSION_STORE_FILE_DATA).toHash();
 
         if (data.isEmpty()) {
-            QFile::remove(file->fileName());
+            QFile::remove(filename);
         } else {
-            QLockFile lock(file->fileName() + QLatin1String(".lock"));
-            if (lock.lock()) {
-                QDataStream in(file);
-
-                if (file->pos()) {
-                    file->seek(0);
-                }
-
-                in << data;
-
-                if (file->pos() < file->size()) {
-                    file->resize(file->pos());
-                }
+            writeSessionFile(filename, data);
+        }
 
-                file->flush();
-                lock.unlock();
-            }
+        if (!legacyFilename.isEmpty()) {
+            QFile::remove(legacyFilename);
         }
     });
 
-    // Load data
-    QLockFile lock(file->fileName() + QLatin1String(".lock"));
-    if (lock.lock()) {
-        QDataStream in(file);
-        in >> data;
-        lock.unlock();
-    }
-
     c->setStash(SESSION_STORE_FILE_DATA, data);
 
     return data;
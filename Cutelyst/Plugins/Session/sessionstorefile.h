@@ -24,6 +24,16 @@
 namespace Cutelyst {
 
 class SessionStoreFilePrivate;
+/**
+ * @brief File based session store, the default one.
+ *
+ * Each session is a file below QDir::tempPath()/<application name>/session/data,
+ * in two levels of directories named after the first four characters of the
+ * session id, so directories stay small with millions of sessions.
+ *
+ * Files are saved to a temporary file renamed over the previous one, so
+ * reading a session needs no locking.
+ */
 class CUTELYST_PLUGIN_SESSION_EXPORT SessionStoreFile : public SessionStore
 {
     Q_OBJECT
@@ -53,6 +63,12 @@ public:
      * Reimplemented from SessionStore::deleteExpiredSessions().
      */
     virtual bool deleteExpiredSessions(Context *c, quint64 expires) final;
+
+    /**
+     * Reimplemented from SessionStore::collectExpiredSessions(), walks the
+     * session files reading the expiration from their header.
+     */
+    virtual bool collectExpiredSessions(quint64 expires, int budget) final;
 };
 
 }
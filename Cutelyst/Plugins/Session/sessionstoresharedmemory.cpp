@@ -0,0 +1,496 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "sessionstoresharedmemory_p.h"
+
+#include <Cutelyst/Application>
+#include <Cutelyst/Engine>
+#include <Cutelyst/Context>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QLoggingCategory>
+
+#include <cstring>
+#include <new>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace Cutelyst;
+
+Q_LOGGING_CATEGORY(C_SESSION_SHM, "cutelyst.plugin.sessionsharedmemory", QtWarningMsg)
+
+#define SESSION_STORE_SHM_SAVE QStringLiteral("_c_session_store_shm_save")
+#define SESSION_STORE_SHM_DATA QStringLiteral("_c_session_store_shm_data")
+
+static const quint32 SegmentMagic = 0x43535331;
+
+namespace {
+
+class StripeLocker
+{
+public:
+    inline StripeLocker(SessionStoreSharedMemoryPrivate *d, quint32 stripe) : m_d(d), m_stripe(stripe) {
+        m_d->lock(m_stripe);
+    }
+    inline ~StripeLocker() { m_d->unlock(m_stripe); }
+
+private:
+    SessionStoreSharedMemoryPrivate *m_d;
+    quint32 m_stripe;
+};
+
+inline int lockOwner()
+{
+#ifdef Q_OS_UNIX
+    return int(::getpid());
+#else
+    // Without fork() threads are the only ones sharing sessions
+    return 1;
+#endif
+}
+
+inline bool isOwnerDead(int owner)
+{
+#ifdef Q_OS_UNIX
+    return ::kill(pid_t(owner), 0) == -1 && errno == ESRCH;
+#else
+    Q_UNUSED(owner)
+    return false;
+#endif
+}
+
+inline bool isFree(const SharedSessionSlot *slot, qint64 now)
+{
+    return slot->hash == 0 || slot->expires <= now;
+}
+
+struct MappingRegistry {
+    QMutex mutex;
+    QHash<QString, QSharedPointer<SharedSessionMapping>> mappings;
+};
+Q_GLOBAL_STATIC(MappingRegistry, mappingRegistry)
+
+}
+
+static QVariantHash loadShmSessionData(Context *c, const QString &sid, SessionStoreSharedMemoryPrivate *d);
+
+SessionStoreSharedMemory::SessionStoreSharedMemory(Application *app, QObject *parent) : SessionStore(parent)
+  , d_ptr(new SessionStoreSharedMemoryPrivate)
+{
+    Q_D(SessionStoreSharedMemory);
+    Q_ASSERT_X(app, "construct SessionStoreSharedMemory", "you have to specifiy a pointer to the Application object");
+    const QVariantMap config = app->engine()->config(QStringLiteral("Cutelyst_SessionStoreSharedMemory_Plugin"));
+    d->defaultExpires = config.value(QStringLiteral("expires"), 7200).toLongLong();
+
+    const int slots = config.value(QStringLiteral("slots"), 4096).toInt();
+    const int slotSize = config.value(QStringLiteral("slot_size"), 4096).toInt();
+
+    // Engines create one Application per worker thread, they must all see the same table
+    const QString key = QString::number(slots) + QLatin1Char(':') + QString::number(slotSize);
+    QMutexLocker locker(&mappingRegistry->mutex);
+    QSharedPointer<SharedSessionMapping> &mapping = mappingRegistry->mappings[key];
+    if (!mapping) {
+        mapping = SharedSessionMapping::map(slots, slotSize);
+    }
+
+    if (mapping) {
+        d->mapping = mapping;
+        d->segment = mapping->segment;
+    } else {
+        mappingRegistry->mappings.remove(key);
+        qCCritical(C_SESSION_SHM) << "Failed to allocate the shared memory for" << slots << "sessions of" << slotSize << "bytes";
+    }
+}
+
+SessionStoreSharedMemory::~SessionStoreSharedMemory()
+{
+
+}
+
+QVariant SessionStoreSharedMemory::getSessionData(Context *c, const QString &sid, const QString &key, const QVariant &defaultValue)
+{
+    Q_D(SessionStoreSharedMemory);
+    const QVariantHash data = loadShmSessionData(c, sid, d);
+
+    return data.value(key, defaultValue);
+}
+
+bool SessionStoreSharedMemory::storeSessionData(Context *c, const QString &sid, const QString &key, const QVariant &value)
+{
+    Q_D(SessionStoreSharedMemory);
+    QVariantHash data = loadShmSessionData(c, sid, d);
+
+    data.insert(key, value);
+    c->setStash(SESSION_STORE_SHM_DATA, data);
+    c->setStash(SESSION_STORE_SHM_SAVE, true);
+
+    return true;
+}
+
+bool SessionStoreSharedMemory::deleteSessionData(Context *c, const QString &sid, const QString &key)
+{
+    Q_D(SessionStoreSharedMemory);
+    QVariantHash data = loadShmSessionData(c, sid, d);
+
+    data.remove(key);
+    c->setStash(SESSION_STORE_SHM_DATA, data);
+    c->setStash(SESSION_STORE_SHM_SAVE, true);
+
+    return true;
+}
+
+bool SessionStoreSharedMemory::deleteExpiredSessions(Context *c, quint64 expires)
+{
+    Q_UNUSED(c)
+    Q_D(SessionStoreSharedMemory);
+    if (!d->segment) {
+        return true;
+    }
+
+    int removed = 0;
+    for (quint32 stripe = 0; stripe < SessionStoreSharedMemoryPrivate::Stripes; ++stripe) {
+        removed += d->removeExpired(qint64(expires), stripe);
+    }
+    qCDebug(C_SESSION_SHM) << "Removed" << removed << "expired sessions";
+
+    return true;
+}
+
+bool SessionStoreSharedMemory::collectExpiredSessions(quint64 expires, int budget)
+{
+    Q_D(SessionStoreSharedMemory);
+    if (!d->segment) {
+        return true;
+    }
+
+    // Whole stripes are swept, each one under a single lock
+    int checked = 0;
+    QAtomicInt &collectStripe = d->mapping->collectStripe;
+    int stripe = collectStripe.load();
+    while (stripe < SessionStoreSharedMemoryPrivate::Stripes && checked < budget) {
+        d->removeExpired(qint64(expires), quint32(stripe++));
+        checked += int(d->segment->slotsPerStripe);
+    }
+
+    if (stripe < SessionStoreSharedMemoryPrivate::Stripes) {
+        collectStripe.store(stripe);
+        return false;
+    }
+    collectStripe.store(0);
+    return true;
+}
+
+SharedSessionMapping::~SharedSessionMapping()
+{
+    if (segment) {
+#ifdef Q_OS_UNIX
+        munmap(segment, segmentSize);
+#else
+        delete [] reinterpret_cast<char *>(segment);
+#endif
+    }
+}
+
+QSharedPointer<SharedSessionMapping> SharedSessionMapping::map(int slots, int slotSize)
+{
+    if (slots < SessionStoreSharedMemoryPrivate::Stripes || slotSize < 64) {
+        qCWarning(C_SESSION_SHM) << "At least" << int(SessionStoreSharedMemoryPrivate::Stripes) << "slots of 64 bytes are needed";
+        slots = qMax(slots, int(SessionStoreSharedMemoryPrivate::Stripes));
+        slotSize = qMax(slotSize, 64);
+    }
+
+    const quint32 slotsPerStripe = quint32(slots + SessionStoreSharedMemoryPrivate::Stripes - 1) / SessionStoreSharedMemoryPrivate::Stripes;
+    const quint32 slotStride = (quint32(sizeof(SharedSessionSlot)) + quint32(slotSize) + 7) & ~7u;
+    const size_t segmentSize = sizeof(SharedSessionSegment) + size_t(slotsPerStripe) * SessionStoreSharedMemoryPrivate::Stripes * slotStride;
+
+#ifdef Q_OS_UNIX
+    // Anonymous shared pages are zero filled and inherited by forked workers
+    void *memory = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return QSharedPointer<SharedSessionMapping>();
+    }
+#else
+    // Without fork() threads are the only ones sharing sessions
+    void *memory = new (std::nothrow) char[segmentSize]();
+    if (!memory) {
+        return QSharedPointer<SharedSessionMapping>();
+    }
+#endif
+
+    QSharedPointer<SharedSessionMapping> mapping(new SharedSessionMapping);
+    mapping->segmentSize = segmentSize;
+
+    SharedSessionSegment *segment = new (memory) SharedSessionSegment;
+    mapping->segment = segment;
+    segment->magic = SegmentMagic;
+    segment->slotsPerStripe = slotsPerStripe;
+    segment->slotStride = slotStride;
+    segment->valueCapacity = quint32(slotSize);
+    for (SharedSessionStripe &stripe : segment->stripes) {
+        stripe.lock.store(0);
+    }
+
+    return mapping;
+}
+
+void SessionStoreSharedMemoryPrivate::lock(quint32 stripe)
+{
+    QAtomicInt &lock = segment->stripes[stripe].lock;
+    const int self = lockOwner();
+    int spins = 0;
+    int owner;
+    while ((owner = lock.loadAcquire()) != 0 || !lock.testAndSetAcquire(0, self)) {
+        // Slots are small copies, yield only if the holder was preempted
+        if (++spins <= 100) {
+            continue;
+        }
+        QThread::yieldCurrentThread();
+
+        // A worker killed while holding the lock would block the stripe forever
+        if (spins % 1000 == 0 && owner != 0 && owner != self && isOwnerDead(owner) &&
+                lock.testAndSetAcquire(owner, self)) {
+            qCWarning(C_SESSION_SHM) << "Process" << owner << "died holding the lock of stripe" << stripe
+                                     << "dropping its sessions";
+            clearStripe(stripe);
+            return;
+        }
+    }
+}
+
+void SessionStoreSharedMemoryPrivate::unlock(quint32 stripe)
+{
+    segment->stripes[stripe].lock.storeRelease(0);
+}
+
+void SessionStoreSharedMemoryPrivate::clearStripe(quint32 stripe)
+{
+    // The dead owner might have left a slot half written
+    for (quint32 i = 0; i < segment->slotsPerStripe; ++i) {
+        SharedSessionSlot *current = slot(stripe, i);
+        current->hash = 0;
+        current->expires = 0;
+        current->keySize = 0;
+        current->valueSize = 0;
+    }
+}
+
+SharedSessionSlot *SessionStoreSharedMemoryPrivate::slot(quint64 hash, quint32 index) const
+{
+    const quint32 stripe = quint32(hash % Stripes);
+    const size_t offset = sizeof(SharedSessionSegment) +
+            (size_t(stripe) * segment->slotsPerStripe + index) * segment->slotStride;
+    return reinterpret_cast<SharedSessionSlot *>(reinterpret_cast<char *>(segment) + offset);
+}
+
+QByteArray SessionStoreSharedMemoryPrivate::load(const QByteArray &key, quint64 hash)
+{
+    QByteArray ret;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    const quint32 slots = segment->slotsPerStripe;
+    const quint32 start = quint32((hash / Stripes) % slots);
+
+    StripeLocker locker(this, quint32(hash % Stripes));
+    for (quint32 i = 0; i < slots; ++i) {
+        SharedSessionSlot *current = slot(hash, (start + i) % slots);
+        if (current->hash == 0 && current->expires == 0) {
+            break;
+        }
+
+        if (current->hash == hash && current->keySize == quint32(key.size()) &&
+                std::memcmp(current->key, key.constData(), size_t(key.size())) == 0) {
+            if (current->expires <= now) {
+                current->hash = 0;
+                current->expires = -1;
+            } else {
+                ret = QByteArray(reinterpret_cast<const char *>(current + 1), int(current->valueSize));
+            }
+            break;
+        }
+    }
+
+    return ret;
+}
+
+bool SessionStoreSharedMemoryPrivate::store(const QByteArray &key, quint64 hash, const QByteArray &value, qint64 expires)
+{
+    if (quint32(value.size()) > segment->valueCapacity) {
+        qCWarning(C_SESSION_SHM) << "Session data of" << value.size() << "bytes does not fit the slot size of"
+                                 << segment->valueCapacity << "bytes";
+        return false;
+    }
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    const quint32 slots = segment->slotsPerStripe;
+    const quint32 start = quint32((hash / Stripes) % slots);
+
+    StripeLocker locker(this, quint32(hash % Stripes));
+    SharedSessionSlot *target = nullptr;
+    SharedSessionSlot *reusable = nullptr;
+    SharedSessionSlot *victim = nullptr;
+    bool found = false;
+    for (quint32 i = 0; i < slots; ++i) {
+        SharedSessionSlot *current = slot(hash, (start + i) % slots);
+        if (current->hash == 0 && current->expires == 0) {
+            target = current;
+            break;
+        }
+
+        if (current->hash == hash && current->keySize == quint32(key.size()) &&
+                std::memcmp(current->key, key.constData(), size_t(key.size())) == 0) {
+            target = current;
+            found = true;
+            break;
+        }
+
+        if (isFree(current, now)) {
+            if (!reusable) {
+                reusable = current;
+            }
+        } else if (!victim || current->expires < victim->expires) {
+            victim = current;
+        }
+    }
+
+    // New keys take the first reusable slot so chains stay short
+    if (!found && reusable) {
+        target = reusable;
+    } else if (!target) {
+        qCDebug(C_SESSION_SHM) << "Evicting the session that expires at" << victim->expires;
+        target = victim;
+    }
+
+    target->hash = hash;
+    target->expires = expires;
+    target->keySize = quint32(key.size());
+    target->valueSize = quint32(value.size());
+    std::memcpy(target->key, key.constData(), size_t(key.size()));
+    std::memcpy(target + 1, value.constData(), size_t(value.size()));
+
+    return true;
+}
+
+void SessionStoreSharedMemoryPrivate::remove(const QByteArray &key, quint64 hash)
+{
+    const quint32 slots = segment->slotsPerStripe;
+    const quint32 start = quint32((hash / Stripes) % slots);
+
+    StripeLocker locker(this, quint32(hash % Stripes));
+    for (quint32 i = 0; i < slots; ++i) {
+        SharedSessionSlot *current = slot(hash, (start + i) % slots);
+        if (current->hash == 0 && current->expires == 0) {
+            break;
+        }
+
+        if (current->hash == hash && current->keySize == quint32(key.size()) &&
+                std::memcmp(current->key, key.constData(), size_t(key.size())) == 0) {
+            current->hash = 0;
+            current->expires = -1;
+            break;
+        }
+    }
+}
+
+int SessionStoreSharedMemoryPrivate::removeExpired(qint64 before, quint32 stripe)
+{
+    int removed = 0;
+    StripeLocker locker(this, stripe);
+    for (quint32 i = 0; i < segment->slotsPerStripe; ++i) {
+        SharedSessionSlot *current = slot(stripe, i);
+        if (current->hash && current->expires < before) {
+            current->hash = 0;
+            current->expires = -1;
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+quint64 SessionStoreSharedMemoryPrivate::hashKey(const QByteArray &key)
+{
+    // FNV-1a, qHash() is seeded per process
+    quint64 hash = 14695981039346656037ULL;
+    for (char ch : key) {
+        hash ^= quint8(ch);
+        hash *= 1099511628211ULL;
+    }
+    // Zero marks free slots
+    return hash ? hash : 1;
+}
+
+QVariantHash loadShmSessionData(Context *c, const QString &sid, SessionStoreSharedMemoryPrivate *d)
+{
+    QVariantHash data;
+    const QVariant sessionVariant = c->stash(SESSION_STORE_SHM_DATA);
+    if (!sessionVariant.isNull()) {
+        data = sessionVariant.toHash();
+        return data;
+    }
+
+    const QByteArray key = sid.toLatin1();
+    if (!d->segment || key.size() > int(sizeof(SharedSessionSlot::key))) {
+        return data;
+    }
+    const quint64 hash = SessionStoreSharedMemoryPrivate::hashKey(key);
+
+    QObject::connect(c->app(), &Application::afterDispatch, c, [=] () {
+        if (!c->stash(SESSION_STORE_SHM_SAVE).toBool()) {
+            return;
+        }
+
+        const QVariantHash data = c->stash(SESSION_STORE_SHM_DATA).toHash();
+
+        if (data.isEmpty()) {
+            d->remove(key, hash);
+        } else {
+            QByteArray value;
+            QDataStream out(&value, QIODevice::WriteOnly);
+            out.setVersion(QDataStream::Qt_5_6);
+            out << data;
+
+            qint64 expires = data.value(QStringLiteral("expires")).toLongLong();
+            if (!expires) {
+                expires = QDateTime::currentMSecsSinceEpoch() / 1000 + d->defaultExpires;
+            }
+
+            if (!d->store(key, hash, value, expires)) {
+                qCWarning(C_SESSION_SHM, "Failed to store session to shared memory.");
+            }
+        }
+    });
+
+    const QByteArray value = d->load(key, hash);
+    if (!value.isNull()) {
+        QDataStream in(value);
+        in.setVersion(QDataStream::Qt_5_6);
+        in >> data;
+    }
+
+    c->setStash(SESSION_STORE_SHM_DATA, data);
+
+    return data;
+}
+
+#include "moc_sessionstoresharedmemory.cpp"
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef SESSIONSTORESHAREDMEMORY_H
+#define SESSIONSTORESHAREDMEMORY_H
+
+#include <Cutelyst/Plugins/Session/session.h>
+#include <Cutelyst/cutelyst_global.h>
+
+namespace Cutelyst {
+
+class Application;
+class SessionStoreSharedMemoryPrivate;
+
+/**
+ * @brief Shared memory based session store.
+ *
+ * This session store keeps the sessions in a fixed size hash table living in a
+ * shared memory segment, so all threads and forked worker processes of a single
+ * machine see the same sessions without any external service or file access.
+ *
+ * Every session takes one slot of the table, holding its id, its expiration time
+ * and the session data serialized with QDataStream. Sessions that expired are
+ * removed when found, and when all the slots a session can use are taken the one
+ * closest to expire is evicted, so like with memcached the existence of session
+ * data is not guaranteed if the table is too small for the number of sessions.
+ *
+ * The table is split in stripes guarded by spin locks that record the pid of their
+ * owner. If a worker dies while holding one, like when it is killed by a signal, the
+ * lock is taken over once the owner is found to be gone and the sessions of that
+ * stripe, about one in 64, are dropped since one of them might be half written.
+ *
+ * The segment is mapped once per process for each @a slots and @a slot_size configuration,
+ * the stores of all Application instances of the process, like the ones created for each
+ * worker thread, share it.
+ *
+ * @note The segment is anonymous, it must be created before the application forks,
+ * which means on Application::init() without the lazy option of cutelyst-wsgi,
+ * otherwise each process has its own table. The sessions do not survive restarts.
+ *
+ * <H3>Configuration</h3>
+ *
+ * The %SessionStoreSharedMemory can be configured in the cutelyst configuration file in the
+ * @c Cutelyst_SessionStoreSharedMemory_Plugin section.
+ *
+ * Currently there are the following configuration options:
+ * @li @a slots - integer value, the maximum number of sessions (default: 4096)
+ * @li @a slot_size - integer value, the maximum size in bytes of the serialized session data (default: 4096)
+ * @li @a expires - integer value, seconds to keep sessions that have no expiration time set (default: 7200)
+ *
+ * <H4>Configuration example</H4>
+ *
+ * @code{.ini}
+ * [Cutelyst_SessionStoreSharedMemory_Plugin]
+ * slots=16384
+ * slot_size=2048
+ * @endcode
+ *
+ * <H3>Usage example</H3>
+ *
+ * @code{.cpp}
+ * #include <Cutelyst/Plugins/Session/SessionStoreSharedMemory>
+ *
+ * bool MyCutelystApp::init()
+ * {
+ *     auto sess = new Session(this);
+ *     sess->setStorage(new SessionStoreSharedMemory(this));
+ * }
+ * @endcode
+ *
+ * @since Cutelyst 2.9.0
+ */
+class CUTELYST_PLUGIN_SESSION_EXPORT SessionStoreSharedMemory : public SessionStore
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(SessionStoreSharedMemory)
+public:
+    /**
+     * Constructs a new SessionStoreSharedMemory object with the given @a parent, allocating
+     * the shared memory segment as configured in the @c Cutelyst_SessionStoreSharedMemory_Plugin
+     * section of the @a app configuration.
+     */
+    explicit SessionStoreSharedMemory(Application *app, QObject *parent = nullptr);
+
+    /**
+     * Deconstructs the SessionStoreSharedMemory object, unmapping the segment of this process.
+     */
+    ~SessionStoreSharedMemory();
+
+    /**
+     * Reimplemented from SessionStore::getSessionData().
+     */
+    virtual QVariant getSessionData(Context *c, const QString &sid, const QString &key, const QVariant &defaultValue) final;
+
+    /**
+     * Reimplemented from SessionStore::storeSessionData().
+     */
+    virtual bool storeSessionData(Context *c, const QString &sid, const QString &key, const QVariant &value) final;
+
+    /**
+     * Reimplemented from SessionStore::deleteSessionData().
+     */
+    virtual bool deleteSessionData(Context *c, const QString &sid, const QString &key) final;
+
+    /**
+     * Reimplemented from SessionStore::deleteExpiredSessions(), removes the
+     * sessions that expire before @a expires seconds since the epoch.
+     */
+    virtual bool deleteExpiredSessions(Context *c, quint64 expires) final;
+
+    /**
+     * Reimplemented from SessionStore::collectExpiredSessions(), sweeps
+     * the table one stripe at a time.
+     */
+    virtual bool collectExpiredSessions(quint64 expires, int budget) final;
+
+protected:
+    QScopedPointer<SessionStoreSharedMemoryPrivate> d_ptr;
+};
+
+}
+
+#endif // SESSIONSTORESHAREDMEMORY_H
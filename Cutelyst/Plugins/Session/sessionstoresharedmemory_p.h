@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef SESSIONSTORESHAREDMEMORY_P_H
+#define SESSIONSTORESHAREDMEMORY_P_H
+
+#include "sessionstoresharedmemory.h"
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QSharedPointer>
+
+namespace Cutelyst {
+
+// The table lives in the shared segment, so it only holds plain data
+// and lock-free atomics, which are address free across processes.
+// Keys are hashed to a stripe and probed linearly inside of it, so the
+// spin lock of the stripe guards every slot a key can use. The lock holds
+// the pid of its owner, so a worker that dies holding it can be detected
+// and the lock taken over.
+struct SharedSessionSlot {
+    // Zero on never used and on removed slots
+    quint64 hash;
+    // Seconds since the epoch, -1 marks a removed slot
+    qint64 expires;
+    quint32 keySize;
+    quint32 valueSize;
+    char key[64];
+    // Followed by slot_size bytes of value
+};
+
+struct alignas(64) SharedSessionStripe {
+    // Zero when free, otherwise the pid of the owner
+    QAtomicInt lock;
+};
+
+struct SharedSessionSegment {
+    quint32 magic;
+    quint32 slotsPerStripe;
+    quint32 slotStride;
+    quint32 valueCapacity;
+    SharedSessionStripe stripes[64];
+    // Followed by the slots of all stripes
+};
+
+// A segment mapped once per process and configuration, the stores of all
+// Application instances of the process use it and forked workers inherit it
+class SharedSessionMapping
+{
+public:
+    ~SharedSessionMapping();
+
+    static QSharedPointer<SharedSessionMapping> map(int slots, int slotSize);
+
+    SharedSessionSegment *segment = nullptr;
+    size_t segmentSize = 0;
+    QAtomicInt collectStripe;
+};
+
+class SessionStoreSharedMemoryPrivate
+{
+public:
+    enum {
+        Stripes = 64
+    };
+
+    QByteArray load(const QByteArray &key, quint64 hash);
+    bool store(const QByteArray &key, quint64 hash, const QByteArray &value, qint64 expires);
+    void remove(const QByteArray &key, quint64 hash);
+    int removeExpired(qint64 before, quint32 stripe);
+
+    void lock(quint32 stripe);
+    inline void unlock(quint32 stripe);
+    void clearStripe(quint32 stripe);
+
+    inline SharedSessionSlot *slot(quint64 hash, quint32 index) const;
+
+    static quint64 hashKey(const QByteArray &key);
+
+    QSharedPointer<SharedSessionMapping> mapping;
+    SharedSessionSegment *segment = nullptr;
+    qint64 defaultExpires = 7200;
+};
+
+}
+
+#endif // SESSIONSTORESHAREDMEMORY_P_H
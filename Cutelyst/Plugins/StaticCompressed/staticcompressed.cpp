@@ -23,8 +23,8 @@
 #include <Cutelyst/Response>
 #include <Cutelyst/Context>
 #include <Cutelyst/Engine>
+#include <Cutelyst/utils.h>
 
-#include <QMimeDatabase>
 #include <QFile>
 #include <QDateTime>
 #include <QStandardPaths>
@@ -33,6 +33,18 @@
 #include <QLoggingCategory>
 #include <QDataStream>
 #include <QLockFile>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QDirIterator>
+#include <QMutex>
+#include <QSet>
+#include <QAtomicInt>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QThread>
+
+#include <cstdio>
+#include <algorithm>
 
 #ifdef CUTELYST_STATICCOMPRESSED_WITH_ZOPFLI
 #include <zopfli/gzip_container.h>
@@ -42,10 +54,149 @@
 #include <brotli/encode.h>
 #endif
 
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_ZSTD
+#include <zstd.h>
+#endif
+
 using namespace Cutelyst;
 
 Q_LOGGING_CATEGORY(C_STATICCOMPRESSED, "cutelyst.plugin.staticcompressed", QtWarningMsg)
 
+namespace {
+
+// Process wide, threads are only started on the first compression
+// which happens after forking
+Q_GLOBAL_STATIC(QThreadPool, compressionPool)
+
+struct PendingCompressions {
+    QMutex mutex;
+    QSet<QString> paths;
+};
+Q_GLOBAL_STATIC(PendingCompressions, pendingCompressions)
+
+QAtomicInt preCompressStarted;
+
+bool replaceFile(const QString &from, const QString &to)
+{
+    // rename() atomically replaces the target on POSIX systems
+    if (std::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0) {
+        return true;
+    }
+
+    // Windows refuses to replace existing files
+    QFile::remove(to);
+    return QFile::rename(from, to);
+}
+
+class CompressionJob : public QRunnable
+{
+public:
+    CompressionJob(const StaticCompressedPrivate *d, const QString &origPath, const QString &path, const QDateTime &origLastModified, StaticCompressedPrivate::Compression compression)
+        : m_d(d)
+        , m_origPath(origPath)
+        , m_path(path)
+        , m_origLastModified(origLastModified)
+        , m_compression(compression)
+    { }
+
+    ~CompressionJob() override
+    {
+        // Also reached when the pool is cleared before running us
+        QMutexLocker locker(&pendingCompressions->mutex);
+        pendingCompressions->paths.remove(m_path);
+    }
+
+    void run() override
+    {
+        // Other worker processes might be compressing the same file
+        QLockFile lock(m_path + QLatin1String(".lock"));
+        if (!lock.tryLock(0)) {
+            return;
+        }
+
+        const QFileInfo info(m_path);
+        if (info.exists() && (info.lastModified() > m_origLastModified)) {
+            return;
+        }
+
+        // Requests must never see a partially written file
+        const QString tmpPath = m_path + QLatin1String(".tmp");
+        if (m_d->compress(m_compression, m_origPath, tmpPath, m_origLastModified)) {
+            if (Q_UNLIKELY(!replaceFile(tmpPath, m_path))) {
+                qCWarning(C_STATICCOMPRESSED) << "Can not move compressed file into place:" << m_path;
+                QFile::remove(tmpPath);
+            }
+        } else {
+            QFile::remove(tmpPath);
+        }
+    }
+
+private:
+    const StaticCompressedPrivate *m_d;
+    QString m_origPath;
+    QString m_path;
+    QDateTime m_origLastModified;
+    StaticCompressedPrivate::Compression m_compression;
+};
+
+class PreCompressJob : public QRunnable
+{
+public:
+    explicit PreCompressJob(const StaticCompressedPrivate *d) : m_d(d) { }
+
+    void run() override
+    {
+        m_d->preCompress();
+    }
+
+private:
+    const StaticCompressedPrivate *m_d;
+};
+
+struct IndexRegistry {
+    QMutex mutex;
+    QHash<QString, QSharedPointer<StaticCompressedIndex>> indexes;
+};
+Q_GLOBAL_STATIC(IndexRegistry, indexRegistry)
+
+StaticCompressedPrivate::Variant variantIndex(StaticCompressedPrivate::Compression compression)
+{
+    switch (compression) {
+    case StaticCompressedPrivate::Brotli:
+        return StaticCompressedPrivate::VariantBrotli;
+    case StaticCompressedPrivate::Zstd:
+        return StaticCompressedPrivate::VariantZstd;
+    case StaticCompressedPrivate::Deflate:
+        return StaticCompressedPrivate::VariantDeflate;
+    default:
+        return StaticCompressedPrivate::VariantGzip;
+    }
+}
+
+QString compressionSuffix(StaticCompressedPrivate::Compression compression)
+{
+    switch (compression) {
+    case StaticCompressedPrivate::Zopfli:
+    case StaticCompressedPrivate::Gzip:
+        return QStringLiteral(".gz");
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_BROTLI
+    case StaticCompressedPrivate::Brotli:
+        return QStringLiteral(".br");
+#endif
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_ZSTD
+    case StaticCompressedPrivate::Zstd:
+        return QStringLiteral(".zst");
+#endif
+    case StaticCompressedPrivate::Deflate:
+        return QStringLiteral(".deflate");
+    default:
+        Q_ASSERT_X(false, "locate cache file", "invalid compression type");
+        return QString();
+    }
+}
+
+}
+
 StaticCompressed::StaticCompressed(Application *parent) :
     Plugin(parent), d_ptr(new StaticCompressedPrivate)
 {
@@ -55,7 +206,11 @@ StaticCompressed::StaticCompressed(Application *parent) :
 
 StaticCompressed::~StaticCompressed()
 {
-
+    // Queued and running compressions refer to our private data
+    if (!compressionPool.isDestroyed()) {
+        compressionPool->clear();
+        compressionPool->waitForDone();
+    }
 }
 
 void StaticCompressed::setIncludePaths(const QStringList &paths)
@@ -104,9 +259,27 @@ bool StaticCompressed::setup(Application *app)
     d->onTheFlyCompression = config.value(QStringLiteral("on_the_fly_compression"), true).toBool();
     qCInfo(C_STATICCOMPRESSED, "Compress static files on the fly: %s", d->onTheFlyCompression ? "true" : "false");
 
+    d->preCompressFiles = config.value(QStringLiteral("pre_compress"), false).toBool();
+    qCInfo(C_STATICCOMPRESSED, "Pre-compress static files: %s", d->preCompressFiles ? "true" : "false");
+
+    d->immutablePattern.setPattern(config.value(QStringLiteral("immutable_pattern")).toString());
+    if (Q_UNLIKELY(!d->immutablePattern.isValid())) {
+        qCWarning(C_STATICCOMPRESSED) << "Invalid immutable_pattern" << d->immutablePattern.errorString();
+        d->immutablePattern.setPattern(QString());
+    }
+
+    const bool useManifest = config.value(QStringLiteral("use_manifest"), false).toBool();
+    qCInfo(C_STATICCOMPRESSED, "Use a manifest of static files: %s", useManifest ? "true" : "false");
+
     QStringList supportedCompressions{QStringLiteral("deflate"), QStringLiteral("gzip")};
 
     bool ok = false;
+    d->compressionThreads = config.value(QStringLiteral("compression_threads"), 1).toInt(&ok);
+    if (!ok || (d->compressionThreads < 1)) {
+        d->compressionThreads = 1;
+    }
+    compressionPool->setMaxThreadCount(d->compressionThreads);
+
     d->zlibCompressionLevel = config.value(QStringLiteral("zlib_compression_level"), 9).toInt(&ok);
     if (!ok || (d->zlibCompressionLevel < -1) || (d->zlibCompressionLevel > 9)) {
         d->zlibCompressionLevel = -1;
@@ -129,11 +302,53 @@ bool StaticCompressed::setup(Application *app)
     supportedCompressions << QStringLiteral("brotli");
 #endif
 
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_ZSTD
+    d->zstdCompressionLevel = config.value(QStringLiteral("zstd_compression_level"), 19).toInt(&ok);
+    if (!ok || (d->zstdCompressionLevel < 1) || (d->zstdCompressionLevel > ZSTD_maxCLevel())) {
+        d->zstdCompressionLevel = 19;
+    }
+    d->zstdLongDistanceMatching = config.value(QStringLiteral("zstd_long_distance_matching"), true).toBool();
+    supportedCompressions << QStringLiteral("zstd");
+#endif
+
     qCInfo(C_STATICCOMPRESSED, "Supported compressions: %s", qPrintable(supportedCompressions.join(QLatin1Char(','))));
 
+    if (useManifest) {
+        // Shared by the instances of all worker threads, built before forking
+        QStringList key;
+        for (const QDir &includePath : d->includePaths) {
+            key.append(includePath.absolutePath());
+        }
+        key << d->cacheDir.absolutePath() << d->mimeTypes.join(QLatin1Char(',')) << d->suffixes.join(QLatin1Char(','))
+            << QString::number(d->checkPreCompressed) << d->immutablePattern.pattern();
+
+        QMutexLocker locker(&indexRegistry->mutex);
+        QSharedPointer<StaticCompressedIndex> &index = indexRegistry->indexes[key.join(QLatin1Char('\n'))];
+        if (!index) {
+            index.reset(new StaticCompressedIndex(*d));
+            index->build();
+        }
+        d->index = index;
+
+        connect(app, &Application::postForked, this, [this, d] {
+            d->index->watch(this);
+        }, Qt::DirectConnection);
+    }
+
     connect(app, &Application::beforePrepareAction, this, [d](Context *c, bool *skipMethod) {
         d->beforePrepareAction(c, skipMethod);
-    });
+    }, Qt::DirectConnection);
+
+    Utils::registerMimeTypes(d->includePaths);
+
+    // Once per process, and only after forking as threads do not survive it
+    if (d->onTheFlyCompression && d->preCompressFiles) {
+        connect(app, &Application::postForked, this, [d] {
+            if (preCompressStarted.testAndSetRelaxed(0, 1)) {
+                compressionPool->start(new PreCompressJob(d));
+            }
+        }, Qt::DirectConnection);
+    }
 
     return true;
 }
@@ -167,67 +382,94 @@ void StaticCompressedPrivate::beforePrepareAction(Context *c, bool *skipMethod)
     }
 }
 
-bool StaticCompressedPrivate::locateCompressedFile(Context *c, const QString &relPath) const
+bool StaticCompressedPrivate::locateCompressedFile(Context *c, const QString &requestPath) const
 {
+    const QString relPath = Utils::cleanRelativePath(requestPath);
+    if (relPath.isEmpty()) {
+        qCDebug(C_STATICCOMPRESSED) << "Refusing to serve" << requestPath;
+        return false;
+    }
+
+    if (index) {
+        const QSharedPointer<const StaticCompressedManifest> manifest = index->manifest();
+        const auto it = manifest->constFind(relPath);
+        if (it != manifest->constEnd()) {
+            // Only directories are watched, files overwritten in place
+            // keep their entry until the next rescan and are served below
+            const StaticCompressedEntry &entry = *it.value();
+            const QFileInfo fileInfo(entry.path);
+            if (fileInfo.size() == entry.size && fileInfo.lastModified() == entry.lastModifiedDateTime) {
+                return serveEntry(c, entry);
+            }
+            qCDebug(C_STATICCOMPRESSED) << "Changed since indexed" << entry.path;
+        }
+        // Files created after the last index are looked up below
+    }
+
     for (const QDir &includePath : includePaths) {
         const QString path = includePath.absoluteFilePath(relPath);
         const QFileInfo fileInfo(path);
         if (fileInfo.exists()) {
             Response *res = c->res();
             const QDateTime currentDateTime = fileInfo.lastModified();
-            if (!c->req()->headers().ifModifiedSince(currentDateTime)) {
-                res->setStatus(Response::NotModified);
-                return true;
-            }
 
-            static QMimeDatabase db;
+            // Hashed once per file version, so revalidation does not open the file
+            const QString etag = Utils::fileContentETag(path, currentDateTime, fileInfo.size());
+
             // use the extension to match to be faster
-            const QMimeType mimeType = db.mimeTypeForFile(path, QMimeDatabase::MatchExtension);
+            const QString mimeTypeName = Utils::mimeTypeForFile(path);
+            const bool compressible = isCompressible(mimeTypeName, fileInfo);
             QString contentEncoding;
             QString compressedPath;
-            QString _mimeTypeName;
 
-            if (mimeType.isValid()) {
+            // The variant is chosen first so that 304s carry the tag of the 200
+            if (compressible) {
 
-                // QMimeDatabase might not find the correct mime type for some specific types
-                // especially for map files for CSS and JS
-                if (mimeType.isDefault()) {
-                    if (path.endsWith(QLatin1String("css.map"), Qt::CaseInsensitive) || path.endsWith(QLatin1String("js.map"), Qt::CaseInsensitive)) {
-                        _mimeTypeName = QStringLiteral("application/json");
-                    }
-                }
-
-                if (mimeTypes.contains(mimeType.name(), Qt::CaseInsensitive) || suffixes.contains(fileInfo.completeSuffix(), Qt::CaseInsensitive)) {
-
-                    const QString acceptEncoding = c->req()->header(QStringLiteral("Accept-Encoding"));
-                    qCDebug(C_STATICCOMPRESSED) << "Accept-Encoding:" << acceptEncoding;
+                const QString acceptEncoding = c->req()->header(QStringLiteral("Accept-Encoding"));
+                qCDebug(C_STATICCOMPRESSED) << "Accept-Encoding:" << acceptEncoding;
 
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_ZSTD
+                if (acceptEncoding.contains(QLatin1String("zstd"), Qt::CaseInsensitive)) {
+                    compressedPath = locateCacheFile(path, currentDateTime, Zstd);
+                    if (!compressedPath.isEmpty()) {
+                        qCDebug(C_STATICCOMPRESSED, "Serving zstd compressed data from \"%s\".", qPrintable(compressedPath));
+                        contentEncoding = QStringLiteral("zstd");
+                    }
+                } else
+#endif
 #ifdef CUTELYST_STATICCOMPRESSED_WITH_BROTLI
-                    if (acceptEncoding.contains(QLatin1String("br"), Qt::CaseInsensitive)) {
-                        compressedPath = locateCacheFile(path, currentDateTime, Brotli)                        ;
-                        if (!compressedPath.isEmpty()) {
-                            qCDebug(C_STATICCOMPRESSED, "Serving brotli compressed data from \"%s\".", qPrintable(compressedPath));
-                            contentEncoding = QStringLiteral("br");
-                        }
-                    } else
+                if (acceptEncoding.contains(QLatin1String("br"), Qt::CaseInsensitive)) {
+                    compressedPath = locateCacheFile(path, currentDateTime, Brotli)                        ;
+                    if (!compressedPath.isEmpty()) {
+                        qCDebug(C_STATICCOMPRESSED, "Serving brotli compressed data from \"%s\".", qPrintable(compressedPath));
+                        contentEncoding = QStringLiteral("br");
+                    }
+                } else
 #endif
-                    if (acceptEncoding.contains(QLatin1String("gzip"), Qt::CaseInsensitive)) {
-                        compressedPath = locateCacheFile(path, currentDateTime, useZopfli ? Zopfli : Gzip);
-                        if (!compressedPath.isEmpty()) {
-                            qCDebug(C_STATICCOMPRESSED, "Serving %s compressed data from \"%s\".", useZopfli ? "zopfli" : "gzip", qPrintable(compressedPath));
-                            contentEncoding = QStringLiteral("gzip");
-                        }
-                    } else if (acceptEncoding.contains(QLatin1String("deflate"), Qt::CaseInsensitive)) {
-                        compressedPath = locateCacheFile(path, currentDateTime, Deflate);
-                        if (!compressedPath.isEmpty()) {
-                            qCDebug(C_STATICCOMPRESSED, "Serving deflate compressed data from \"%s\".", qPrintable(compressedPath));
-                            contentEncoding = QStringLiteral("deflate");
-                        }
+                if (acceptEncoding.contains(QLatin1String("gzip"), Qt::CaseInsensitive)) {
+                    compressedPath = locateCacheFile(path, currentDateTime, useZopfli ? Zopfli : Gzip);
+                    if (!compressedPath.isEmpty()) {
+                        qCDebug(C_STATICCOMPRESSED, "Serving %s compressed data from \"%s\".", useZopfli ? "zopfli" : "gzip", qPrintable(compressedPath));
+                        contentEncoding = QStringLiteral("gzip");
+                    }
+                } else if (acceptEncoding.contains(QLatin1String("deflate"), Qt::CaseInsensitive)) {
+                    compressedPath = locateCacheFile(path, currentDateTime, Deflate);
+                    if (!compressedPath.isEmpty()) {
+                        qCDebug(C_STATICCOMPRESSED, "Serving deflate compressed data from \"%s\".", qPrintable(compressedPath));
+                        contentEncoding = QStringLiteral("deflate");
                     }
-
                 }
             }
 
+            const Headers &reqHeaders = c->req()->headers();
+            const bool notModified = reqHeaders.header(QStringLiteral("IF_NONE_MATCH")).isEmpty() ?
+                        !reqHeaders.ifModifiedSince(currentDateTime) : reqHeaders.ifNoneMatch(etag);
+            if (notModified) {
+                res->setStatus(Response::NotModified);
+                setVariantHeaders(res->headers(), etag, !contentEncoding.isEmpty(), compressible);
+                return true;
+            }
+
             QFile *file = !compressedPath.isEmpty() ? new QFile(compressedPath) : new QFile(path);
             if (file->open(QFile::ReadOnly)) {
                 qCDebug(C_STATICCOMPRESSED) << "Serving" << path;
@@ -236,31 +478,23 @@ bool StaticCompressedPrivate::locateCompressedFile(Context *c, const QString &re
                 // set our open file
                 res->setBody(file);
 
-                // if we have a mime type determine from the extension,
-                // do not use the name from the mime database
-                if (!_mimeTypeName.isEmpty()) {
-                    headers.setContentType(_mimeTypeName);
-                } else if (mimeType.isValid()) {
-                    headers.setContentType(mimeType.name());
-                }
+                headers.setContentType(mimeTypeName);
                 headers.setContentLength(file->size());
 
                 headers.setLastModified(currentDateTime);
-                // Tell Firefox & friends its OK to cache, even over SSL
-                headers.setHeader(QStringLiteral("CACHE_CONTROL"), QStringLiteral("public"));
+                headers.setHeader(QStringLiteral("CACHE_CONTROL"), Utils::staticFileCacheControl(immutablePattern, relPath));
 
                 if (!contentEncoding.isEmpty()) {
                     // serve correct encoding type
                     headers.setContentEncoding(contentEncoding);
-
-                    // force proxies to cache compressed and non-compressed files separately
-                    headers.pushHeader(QStringLiteral("Vary"), QStringLiteral("Accept-Encoding"));
                 }
+                setVariantHeaders(headers, etag, !contentEncoding.isEmpty(), compressible);
 
                 return true;
             }
 
             qCWarning(C_STATICCOMPRESSED) << "Could not serve" << path << file->errorString();
+            delete file;
             return false;
         }
     }
@@ -269,30 +503,138 @@ bool StaticCompressedPrivate::locateCompressedFile(Context *c, const QString &re
     return false;
 }
 
-QString StaticCompressedPrivate::locateCacheFile(const QString &origPath, const QDateTime &origLastModified, Compression compression) const
+bool StaticCompressedPrivate::serveEntry(Context *c, const StaticCompressedEntry &entry) const
 {
-    QString compressedPath;
+    Response *res = c->res();
+    Headers &headers = res->headers();
 
-    QString suffix;
-
-    switch (compression) {
-    case Zopfli:
-    case Gzip:
-        suffix = QStringLiteral(".gz");
-        break;
+    // The variant is chosen first so that 304s carry the tag of the 200
+    QString contentEncoding;
+    QString compressedPath;
+    Compression compression = Gzip;
+    if (entry.compressible) {
+        const QString acceptEncoding = c->req()->header(QStringLiteral("Accept-Encoding"));
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_ZSTD
+        if (acceptEncoding.contains(QLatin1String("zstd"), Qt::CaseInsensitive)) {
+            compression = Zstd;
+            contentEncoding = QStringLiteral("zstd");
+        } else
+#endif
 #ifdef CUTELYST_STATICCOMPRESSED_WITH_BROTLI
-    case Brotli:
-        suffix = QStringLiteral(".br");
-        break;
+        if (acceptEncoding.contains(QLatin1String("br"), Qt::CaseInsensitive)) {
+            compression = Brotli;
+            contentEncoding = QStringLiteral("br");
+        } else
 #endif
-    case Deflate:
-        suffix = QStringLiteral(".deflate");
-        break;
-    default:
-        Q_ASSERT_X(false, "locate cache file", "invalid compression type");
-        break;
+        if (acceptEncoding.contains(QLatin1String("gzip"), Qt::CaseInsensitive)) {
+            compression = useZopfli ? Zopfli : Gzip;
+            contentEncoding = QStringLiteral("gzip");
+        } else if (acceptEncoding.contains(QLatin1String("deflate"), Qt::CaseInsensitive)) {
+            compression = Deflate;
+            contentEncoding = QStringLiteral("deflate");
+        }
+
+        if (!contentEncoding.isEmpty()) {
+            compressedPath = locateEntryVariant(entry, compression);
+            if (compressedPath.isEmpty()) {
+                contentEncoding.clear();
+            }
+        }
+    }
+
+    const Headers &reqHeaders = c->req()->headers();
+    const bool notModified = reqHeaders.header(QStringLiteral("IF_NONE_MATCH")).isEmpty() ?
+                !reqHeaders.ifModifiedSince(entry.lastModifiedDateTime) : reqHeaders.ifNoneMatch(entry.etag);
+    if (notModified) {
+        res->setStatus(Response::NotModified);
+        setVariantHeaders(headers, entry.etag, !contentEncoding.isEmpty(), entry.compressible);
+        return true;
+    }
+
+    auto file = new QFile(compressedPath.isEmpty() ? entry.path : compressedPath);
+    if (!file->open(QFile::ReadOnly) && !compressedPath.isEmpty()) {
+        // The cache directory was cleaned
+        entry.freshCache.fetchAndAndRelaxed(~(1 << variantIndex(compression)));
+        contentEncoding.clear();
+        file->setFileName(entry.path);
+        file->open(QFile::ReadOnly);
+    }
+
+    if (!file->isOpen()) {
+        qCWarning(C_STATICCOMPRESSED) << "Could not serve" << entry.path << file->errorString();
+        delete file;
+        return false;
+    }
+
+    qCDebug(C_STATICCOMPRESSED) << "Serving" << file->fileName();
+    res->setBody(file);
+
+    if (!entry.contentType.isEmpty()) {
+        headers.setContentType(entry.contentType);
+    }
+    headers.setContentLength(file->size());
+    headers.setLastModified(entry.lastModified);
+    headers.setHeader(QStringLiteral("CACHE_CONTROL"), entry.cacheControl);
+
+    if (!contentEncoding.isEmpty()) {
+        headers.setContentEncoding(contentEncoding);
+    }
+    setVariantHeaders(headers, entry.etag, !contentEncoding.isEmpty(), entry.compressible);
+
+    return true;
+}
+
+void StaticCompressedPrivate::setVariantHeaders(Headers &headers, const QString &etag, bool encoded, bool compressible)
+{
+    if (!etag.isEmpty()) {
+        if (encoded) {
+            // The encoded variants are only semantically equivalent
+            headers.setHeader(QStringLiteral("ETAG"), QLatin1String("W/\"") + etag + QLatin1Char('"'));
+        } else {
+            headers.setETag(etag);
+        }
+    }
+
+    if (compressible) {
+        // force proxies to cache compressed and non-compressed files separately
+        headers.pushHeader(QStringLiteral("Vary"), QStringLiteral("Accept-Encoding"));
+    }
+}
+
+QString StaticCompressedPrivate::locateEntryVariant(const StaticCompressedEntry &entry, Compression compression) const
+{
+    const Variant variant = variantIndex(compression);
+    if (!entry.preCompressed[variant].isEmpty()) {
+        return entry.preCompressed[variant];
+    }
+
+    if (!onTheFlyCompression) {
+        return QString();
+    }
+
+    const QString &path = entry.cachePaths[variant];
+    const int bit = 1 << variant;
+    if (entry.freshCache.load() & bit) {
+        return path;
+    }
+
+    // Only stat until it's known to be up to date
+    const QFileInfo info(path);
+    if (info.exists() && (info.lastModified() > entry.lastModifiedDateTime)) {
+        entry.freshCache.fetchAndOrRelaxed(bit);
+        return path;
     }
 
+    queueCompression(entry.path, path, entry.lastModifiedDateTime, compression);
+    return QString();
+}
+
+QString StaticCompressedPrivate::locateCacheFile(const QString &origPath, const QDateTime &origLastModified, Compression compression) const
+{
+    QString compressedPath;
+
+    const QString suffix = compressionSuffix(compression);
+
     if (checkPreCompressed) {
         const QFileInfo origCompressed(origPath + suffix);
         if (origCompressed.exists()) {
@@ -303,48 +645,346 @@ QString StaticCompressedPrivate::locateCacheFile(const QString &origPath, const
 
     if (onTheFlyCompression) {
 
-        const QString path = cacheDir.absoluteFilePath(QString::fromLatin1(QCryptographicHash::hash(origPath.toUtf8(), QCryptographicHash::Md5).toHex()) + suffix);
+        const QString path = cacheFilePath(origPath, suffix);
         const QFileInfo info(path);
 
         if (info.exists() && (info.lastModified() > origLastModified)) {
             compressedPath = path;
         } else {
-            QLockFile lock(path + QLatin1String(".lock"));
-            if (lock.tryLock(10)) {
-                switch (compression) {
+            // This request gets the uncompressed file
+            queueCompression(origPath, path, origLastModified, compression);
+        }
+    }
+
+    return compressedPath;
+}
+
+QString StaticCompressedPrivate::cacheFilePath(const QString &origPath, const QString &suffix) const
+{
+    return cacheDir.absoluteFilePath(QString::fromLatin1(QCryptographicHash::hash(origPath.toUtf8(), QCryptographicHash::Md5).toHex()) + suffix);
+}
+
+bool StaticCompressedPrivate::isCompressible(const QString &mimeTypeName, const QFileInfo &fileInfo) const
+{
+    return mimeTypes.contains(mimeTypeName, Qt::CaseInsensitive) || suffixes.contains(fileInfo.completeSuffix(), Qt::CaseInsensitive);
+}
+
+void StaticCompressedPrivate::queueCompression(const QString &origPath, const QString &path, const QDateTime &origLastModified, Compression compression) const
+{
+    {
+        QMutexLocker locker(&pendingCompressions->mutex);
+        if (pendingCompressions->paths.contains(path)) {
+            return;
+        }
+        pendingCompressions->paths.insert(path);
+    }
+
+    qCDebug(C_STATICCOMPRESSED, "Queueing compression of \"%s\" to \"%s\".", qPrintable(origPath), qPrintable(path));
+    compressionPool->start(new CompressionJob(this, origPath, path, origLastModified, compression));
+}
+
+void StaticCompressedPrivate::preCompress() const
+{
+    // Deflate is left for on demand compression as
+    // every user agent accepting it also accepts gzip
+    QVector<Compression> compressions{useZopfli ? Zopfli : Gzip};
 #ifdef CUTELYST_STATICCOMPRESSED_WITH_BROTLI
-                case Brotli:
-                    if (compressBrotli(origPath, path)) {
-                        compressedPath = path;
-                    }
-                    break;
+    compressions.append(Brotli);
+#endif
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_ZSTD
+    compressions.append(Zstd);
 #endif
-                case Zopfli:
+
+    for (const QDir &includePath : includePaths) {
+        qCInfo(C_STATICCOMPRESSED, "Pre-compressing static files in \"%s\".", qPrintable(includePath.absolutePath()));
+
+        QDirIterator it(includePath.absolutePath(), QDir::Files | QDir::Readable, QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+        while (it.hasNext()) {
+            const QString path = it.next();
+            const QFileInfo fileInfo = it.fileInfo();
+            if (!isCompressible(Utils::mimeTypeForFile(path), fileInfo)) {
+                continue;
+            }
+
+            const QDateTime origLastModified = fileInfo.lastModified();
+            for (Compression compression : compressions) {
+                const QString suffix = compressionSuffix(compression);
+                if (checkPreCompressed && QFileInfo::exists(path + suffix)) {
+                    continue;
+                }
+
+                const QString compressedPath = cacheFilePath(path, suffix);
+                const QFileInfo info(compressedPath);
+                if (!info.exists() || (info.lastModified() <= origLastModified)) {
+                    queueCompression(path, compressedPath, origLastModified, compression);
+                }
+            }
+        }
+    }
+}
+
+bool StaticCompressedPrivate::compress(Compression compression, const QString &inputPath, const QString &outputPath, const QDateTime &origLastModified) const
+{
+    switch (compression) {
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_BROTLI
+    case Brotli:
+        return compressBrotli(inputPath, outputPath);
+#endif
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_ZSTD
+    case Zstd:
+        return compressZstd(inputPath, outputPath);
+#endif
+    case Zopfli:
 #ifdef CUTELYST_STATICCOMPRESSED_WITH_ZOPFLI
-                    if (compressZopfli(origPath, path)) {
-                        compressedPath = path;
-                    }
-                    break;
+        return compressZopfli(inputPath, outputPath);
 #endif
-                case Gzip:
-                    if (compressGzip(origPath, path, origLastModified)) {
-                        compressedPath = path;
-                    }
-                    break;
-                case Deflate:
-                    if (compressDeflate(origPath, path)) {
-                        compressedPath = path;
-                    }
-                    break;
-                default:
-                    break;
+    case Gzip:
+        return compressGzip(inputPath, outputPath, origLastModified);
+    case Deflate:
+        return compressDeflate(inputPath, outputPath);
+    default:
+        return false;
+    }
+}
+
+StaticCompressedIndex::StaticCompressedIndex(const StaticCompressedPrivate &settings)
+    : m_settings(settings)
+{
+}
+
+void StaticCompressedIndex::build()
+{
+    auto manifest = new StaticCompressedManifest;
+    QStringList dirs;
+    scan(QString(), StaticCompressedManifest(), *manifest, dirs);
+
+    qCInfo(C_STATICCOMPRESSED, "Indexed %d static files.", manifest->size());
+
+    QWriteLocker locker(&m_lock);
+    m_manifest.reset(manifest);
+    m_watchDirs = dirs;
+}
+
+void StaticCompressedIndex::scan(const QString &relDir, const StaticCompressedManifest &previous, StaticCompressedManifest &manifest, QStringList &dirs) const
+{
+    for (const QDir &includePath : m_settings.includePaths) {
+        const QString root = relDir.isEmpty() ? includePath.absolutePath() : includePath.absoluteFilePath(relDir);
+        if (!QFileInfo(root).isDir()) {
+            continue;
+        }
+        dirs.append(root);
+
+        QDirIterator it(root, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Readable, QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+        while (it.hasNext()) {
+            const QString path = it.next();
+            const QFileInfo fileInfo = it.fileInfo();
+            if (fileInfo.isDir()) {
+                dirs.append(path);
+                continue;
+            } else if (!fileInfo.isFile()) {
+                continue;
+            }
+
+            // The first include path has precedence
+            const QString relPath = includePath.relativeFilePath(path);
+            if (manifest.contains(relPath)) {
+                continue;
+            }
+
+            manifest.insert(relPath, createEntry(path, relPath, fileInfo, previous.value(relPath)));
+        }
+    }
+}
+
+QSharedPointer<const StaticCompressedEntry> StaticCompressedIndex::createEntry(const QString &path, const QString &relPath, const QFileInfo &fileInfo, const QSharedPointer<const StaticCompressedEntry> &previous) const
+{
+    QVector<StaticCompressedPrivate::Compression> compressions{StaticCompressedPrivate::Gzip, StaticCompressedPrivate::Deflate};
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_BROTLI
+    compressions.append(StaticCompressedPrivate::Brotli);
+#endif
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_ZSTD
+    compressions.append(StaticCompressedPrivate::Zstd);
+#endif
+
+    auto entry = new StaticCompressedEntry;
+    entry->path = path;
+    entry->lastModifiedDateTime = fileInfo.lastModified();
+    entry->size = fileInfo.size();
+
+    // use the extension to match to be faster
+    entry->contentType = Utils::mimeTypeForFile(path);
+    entry->compressible = m_settings.isCompressible(entry->contentType, fileInfo);
+
+    if (entry->compressible) {
+        for (StaticCompressedPrivate::Compression compression : compressions) {
+            const QString suffix = compressionSuffix(compression);
+            const StaticCompressedPrivate::Variant variant = variantIndex(compression);
+            if (m_settings.checkPreCompressed && QFileInfo::exists(path + suffix)) {
+                entry->preCompressed[variant] = path + suffix;
+            }
+            entry->cachePaths[variant] = m_settings.cacheFilePath(path, suffix);
+        }
+    }
+
+    const bool unchanged = previous && previous->path == path && previous->size == entry->size &&
+            previous->lastModifiedDateTime == entry->lastModifiedDateTime;
+    if (unchanged) {
+        bool samePreCompressed = true;
+        for (int i = 0; i < StaticCompressedPrivate::VariantCount; ++i) {
+            samePreCompressed &= previous->preCompressed[i] == entry->preCompressed[i];
+        }
+
+        if (samePreCompressed) {
+            delete entry;
+            return previous;
+        }
+        entry->etag = previous->etag;
+    } else {
+        entry->etag = Utils::fileContentETag(path, entry->lastModifiedDateTime, entry->size);
+    }
+    entry->cacheControl = Utils::staticFileCacheControl(m_settings.immutablePattern, relPath);
+
+    Headers headers;
+    entry->lastModified = headers.setLastModified(entry->lastModifiedDateTime);
+
+    return QSharedPointer<const StaticCompressedEntry>(entry);
+}
+
+void StaticCompressedIndex::update(const QSet<QString> &changedDirs)
+{
+    // Relative to the include paths, rescanning a directory covers its subdirectories
+    QStringList relDirs;
+    for (const QString &dir : changedDirs) {
+        for (const QDir &includePath : m_settings.includePaths) {
+            const QString root = includePath.absolutePath();
+            if (dir == root) {
+                relDirs.append(QString());
+                break;
+            } else if (dir.startsWith(root + QLatin1Char('/'))) {
+                relDirs.append(dir.mid(root.size() + 1));
+                break;
+            }
+        }
+    }
+    std::sort(relDirs.begin(), relDirs.end());
+
+    QStringList roots;
+    for (const QString &relDir : relDirs) {
+        bool covered = false;
+        for (const QString &root : roots) {
+            if (root.isEmpty() || relDir == root || relDir.startsWith(root + QLatin1Char('/'))) {
+                covered = true;
+                break;
+            }
+        }
+        if (!covered) {
+            roots.append(relDir);
+        }
+    }
+
+    const QSharedPointer<const StaticCompressedManifest> previous = manifest();
+    auto updated = new StaticCompressedManifest(*previous);
+    QStringList dirs = m_watchDirs;
+    for (const QString &relDir : roots) {
+        const QString prefix = relDir.isEmpty() ? QString() : relDir + QLatin1Char('/');
+        auto it = updated->begin();
+        while (it != updated->end()) {
+            if (it.key().startsWith(prefix)) {
+                it = updated->erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        for (const QDir &includePath : m_settings.includePaths) {
+            const QString root = relDir.isEmpty() ? includePath.absolutePath() : includePath.absoluteFilePath(relDir);
+            const QString rootPrefix = root + QLatin1Char('/');
+            auto dirIt = dirs.begin();
+            while (dirIt != dirs.end()) {
+                if (*dirIt == root || dirIt->startsWith(rootPrefix)) {
+                    dirIt = dirs.erase(dirIt);
+                } else {
+                    ++dirIt;
                 }
-                lock.unlock();
             }
         }
+
+        scan(relDir, *previous, *updated, dirs);
     }
 
-    return compressedPath;
+    qCDebug(C_STATICCOMPRESSED, "Rescanned %d static directories, %d files indexed.", roots.size(), updated->size());
+
+    QWriteLocker locker(&m_lock);
+    m_manifest.reset(updated);
+    m_watchDirs = dirs;
+}
+
+void StaticCompressedIndex::watch(QObject *owner)
+{
+    // A single watcher per process
+    if (!m_watching.testAndSetRelaxed(0, 1)) {
+        return;
+    }
+
+    // Rescanning stats every file of a directory, keep it away from the workers
+    auto thread = new QThread;
+    thread->setObjectName(QStringLiteral("StaticCompressed"));
+
+    auto watcher = new QFileSystemWatcher;
+    QObject::connect(thread, &QThread::finished, watcher, &QObject::deleteLater);
+    QObject::connect(owner, &QObject::destroyed, [this, thread] {
+        thread->quit();
+        thread->wait();
+        delete thread;
+        m_watching.store(0);
+    });
+
+    // Deployments change many files at once, rescan once they settle,
+    // files are only watched through their directories, so requests
+    // stat the file to notice in place modifications
+    auto timer = new QTimer(watcher);
+    timer->setSingleShot(true);
+    timer->setInterval(200);
+    QObject::connect(watcher, &QFileSystemWatcher::directoryChanged, timer, [this, timer] (const QString &path) {
+        m_changedDirs.insert(path);
+        timer->start();
+    });
+    QObject::connect(timer, &QTimer::timeout, watcher, [this] {
+        qCDebug(C_STATICCOMPRESSED) << "Static files changed, updating the manifest" << m_changedDirs;
+        const QSet<QString> changedDirs = m_changedDirs;
+        m_changedDirs.clear();
+        update(changedDirs);
+        updateWatcher();
+    });
+
+    m_watcher = watcher;
+    updateWatcher();
+
+    watcher->moveToThread(thread);
+    thread->start();
+}
+
+void StaticCompressedIndex::updateWatcher()
+{
+    QSet<QString> added;
+    for (const QString &dir : m_watchDirs) {
+        added.insert(dir);
+    }
+
+    QStringList removed;
+    const QStringList watched = m_watcher->directories();
+    for (const QString &dir : watched) {
+        if (!added.remove(dir)) {
+            removed.append(dir);
+        }
+    }
+
+    if (!removed.isEmpty()) {
+        m_watcher->removePaths(removed);
+    }
+    if (!added.isEmpty()) {
+        m_watcher->addPaths(added.toList());
+    }
 }
 
 static const quint32 crc_32_tab[] = { /* CRC polynomial 0xedb88320 */
@@ -645,4 +1285,62 @@ bool StaticCompressedPrivate::compressBrotli(const QString &inputPath, const QSt
 }
 #endif
 
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_ZSTD
+bool StaticCompressedPrivate::compressZstd(const QString &inputPath, const QString &outputPath) const
+{
+    qCDebug(C_STATICCOMPRESSED, "Compressing \"%s\" with zstd to \"%s\".", qPrintable(inputPath), qPrintable(outputPath));
+
+    QFile input(inputPath);
+    if (Q_UNLIKELY(!input.open(QIODevice::ReadOnly))) {
+        qCWarning(C_STATICCOMPRESSED) << "Can not open input file to compress with zstd:" << inputPath;
+        return false;
+    }
+
+    const QByteArray data = input.readAll();
+    if (Q_UNLIKELY(data.isEmpty())) {
+        qCWarning(C_STATICCOMPRESSED) << "Can not read input file or input file is empty:" << inputPath;
+        return false;
+    }
+
+    input.close();
+
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    if (Q_UNLIKELY(!cctx)) {
+        qCWarning(C_STATICCOMPRESSED, "Can not create zstd compression context.");
+        return false;
+    }
+
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, zstdCompressionLevel);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+    if (zstdLongDistanceMatching) {
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_enableLongDistanceMatching, 1);
+    }
+    // User agents refuse windows larger than 8MiB for the zstd content encoding (RFC 9659)
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, 23);
+
+    QByteArray compressedData;
+    compressedData.resize(int(ZSTD_compressBound(size_t(data.size()))));
+    const size_t outSize = ZSTD_compress2(cctx, compressedData.data(), size_t(compressedData.size()), data.constData(), size_t(data.size()));
+    ZSTD_freeCCtx(cctx);
+
+    if (Q_UNLIKELY(ZSTD_isError(outSize))) {
+        qCWarning(C_STATICCOMPRESSED, "Failed to compress \"%s\" with zstd: %s", qPrintable(inputPath), ZSTD_getErrorName(outSize));
+        return false;
+    }
+
+    QFile output(outputPath);
+    if (Q_UNLIKELY(!output.open(QIODevice::WriteOnly))) {
+        qCWarning(C_STATICCOMPRESSED) << "Can not open output file to compress with zstd:" << outputPath;
+        return false;
+    }
+
+    if (Q_UNLIKELY(output.write(compressedData.constData(), qint64(outSize)) < 0)) {
+        qCCritical(C_STATICCOMPRESSED, "Failed to write compressed zstd file \"%s\": %s", qPrintable(inputPath), qPrintable(output.errorString()));
+        return false;
+    }
+
+    return true;
+}
+#endif
+
 #include "moc_staticcompressed.cpp"
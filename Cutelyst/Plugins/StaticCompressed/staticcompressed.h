@@ -52,18 +52,32 @@ class StaticCompressedPrivate;
  * rate than default @a gzip but is also much slower. So @a Zopfli is disabled by default even if it is
  * enabled at compilation time.
  *
+ * Since Cutelyst 2.9.0 <A HREF="https://facebook.github.io/zstd/">Zstandard</A> is supported when built with
+ * @c-DPLUGIN_STATICCOMPRESSED_ZSTD@c:BOOL=ON and having libzstd 1.4.0 or newer available, user agents
+ * accepting @a zstd get it in preference to the other encodings. The window is limited to 8MiB as
+ * required for the @a zstd content encoding, so long distance matching only helps within it.
+ *
  * <H3>On the fly compression</H3>
  *
  * Static files of the configured @c mime_types or with the configured @c suffixes can be compressed on the
  * fly into a format that is accepted by the requesting user agent. The compressed data is saved into files
  * in the @c cache_diretory specified in the configuration. The cache file name will be the MD5 hash sum
  * of the original local file path together with the file extension indicating the compression format
- * (.br for Brotli, .gz for gzip/Zopfli and .deflate for DEFLATE). If the modification time of the original
+ * (.br for Brotli, .gz for gzip/Zopfli, .zst for Zstandard and .deflate for DEFLATE). If the modification time of the original
  * file is newer than the modification time of the cached compressed file, the file will be compressed again.
  * It is safe to clean the content of the cache directory - the files will than be recompressed on the next
  * request. On the fly compression can be disabled by setting @c on_the_fly_compression to @c false in the
  * configuration file.
  *
+ * Since Cutelyst 2.9.0 the compression does not happen inside the request anymore, a request for a file
+ * that has no up to date compressed variant is served uncompressed while the variant is produced by a
+ * background thread pool and atomically renamed into the cache directory, later requests will then get
+ * the compressed file. Setting @c pre_compress to @c true queues the compression of all matching files
+ * below the include paths once the application has been started.
+ *
+ * Since Cutelyst 2.9.0 files are sent with an ETag based on their content, computed once per
+ * file version, weak for the compressed variants.
+ *
  * <H3>Pre-compressed files</H3>
  *
  * Beside the cached on the fly compression it is also possible to deliver pre-comrpessed static files that
@@ -79,6 +93,7 @@ class StaticCompressedPrivate;
  * @li .br - Brotli compressed files
  * @li .gz - gzip/Zopfli compressed files
  * @li .deflate - DEFLATE compressed files
+ * @li .zst - Zstandard compressed files
  *
  * <H3>Runtime configuration</H3>
  *
@@ -92,6 +107,17 @@ class StaticCompressedPrivate;
  * (default: js.map,css.map,min.js.map,min.css.map)
  * @li @c check_pre_compressed - boolean value, enables or disables the check for pre compressed files (default: true)
  * @li @c on_the_fly_compression - boolean value, enables or disables the compression on the fly (default: true)
+ * @li @c compression_threads - integer value, maximum number of background threads per process used for
+ * on the fly compression (default: 1, since Cutelyst 2.9.0)
+ * @li @c pre_compress - boolean value, compresses all matching files below the include paths in the background
+ * after startup (default: false, since Cutelyst 2.9.0)
+ * @li @c immutable_pattern - string value, regular expression matching the paths of fingerprinted files, like
+ * app.3f2a9c1d.js, that are sent with "Cache-Control: public, max-age=31536000, immutable" (default: empty, disabled,
+ * since Cutelyst 2.9.0)
+ * @li @c use_manifest - boolean value, indexes the include paths once at startup so that requests are resolved
+ * by a single hash lookup instead of checking the file system. The directories are watched and the ones that
+ * change are rescanned in the background, files edited in place are only noticed with the next change of their
+ * directory, so deployments should replace files instead (default: false, since Cutelyst 2.9.0)
  * @li @c zlib_compression_level - integer value, compression level for built in zlib based compression between
  * 0 and 9, with 9 corresponding to the greatest compression (default: 9)
  * @li @c brotli_quality_level - integer value, quality level for optional @a Brotli compression between 0 and 11,
@@ -99,6 +125,9 @@ class StaticCompressedPrivate;
  * @li @c use_zopfli - boolean value, enables the optional use of @a Zopfli for the @a gzip compression if available
  * @li @c zopfli_iterations - integer value, number of iterations used for @a Zopfli compression, more gives more
  * compression but is slower (default: 15)
+ * @li @c zstd_compression_level - integer value, compression level for optional @a Zstandard compression between 1
+ * and 22 (default: 19)
+ * @li @c zstd_long_distance_matching - boolean value, enables long distance matching for @a Zstandard (default: true)
  *
  * <H3>Usage example</H3>
  *
@@ -127,10 +156,13 @@ class StaticCompressedPrivate;
  * @li @c -DPLUGIN_STATICCOMPRESSED_BROTLI@c:BOOL=ON - enables the @a Brotli support,
  * <A HREF="https://github.com/google/brotli">libbrotlienc</A> development and header files have to
  * be present (default: @c off)
+ * @li @c -DPLUGIN_STATICCOMPRESSED_ZSTD@c:BOOL=ON - enables the @a Zstandard support,
+ * <A HREF="https://github.com/facebook/zstd">libzstd</A> development and header files have to
+ * be present (default: @c off)
  *
  * Since Cutelyst 2.0.0 you can check if \c CUTELYST_STATICCOMPRESSED_WITH_ZOPFLI and/or
  * \c CUTELYST_STATICCOMPRESSED_WITH_BROTLI are defined if you need to know that the plugin supports
- * that compressions.
+ * that compressions, \c CUTELYST_STATICCOMPRESSED_WITH_ZSTD is available since Cutelyst 2.9.0.
  *
  * @since Cutelyst 1.11.0
  * @headerfile "" <Cutelyst/Plugins/StaticCompressed/StaticCompressed>
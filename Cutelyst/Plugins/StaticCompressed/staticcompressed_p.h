@@ -23,10 +23,23 @@
 #include <QRegularExpression>
 #include <QVector>
 #include <QDir>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
+#include <QSharedPointer>
+#include <QReadWriteLock>
+#include <QPointer>
+#include <QAtomicInt>
+
+class QFileInfo;
+class QFileSystemWatcher;
 
 namespace Cutelyst {
 
 class Context;
+class Headers;
+class StaticCompressedIndex;
+struct StaticCompressedEntry;
 
 class StaticCompressedPrivate
 {
@@ -35,12 +48,29 @@ public:
         Gzip,
         Zopfli,
         Brotli,
-        Deflate
+        Deflate,
+        Zstd
+    };
+
+    enum Variant {
+        VariantGzip,
+        VariantBrotli,
+        VariantDeflate,
+        VariantZstd,
+        VariantCount
     };
 
     void beforePrepareAction(Context *c, bool *skipMethod);
     bool locateCompressedFile(Context *c, const QString &relPath) const;
+    bool serveEntry(Context *c, const StaticCompressedEntry &entry) const;
+    QString locateEntryVariant(const StaticCompressedEntry &entry, Compression compression) const;
+    static void setVariantHeaders(Headers &headers, const QString &etag, bool encoded, bool compressible);
     QString locateCacheFile(const QString &origPath, const QDateTime &origLastModified, Compression compression) const;
+    QString cacheFilePath(const QString &origPath, const QString &suffix) const;
+    bool isCompressible(const QString &mimeTypeName, const QFileInfo &fileInfo) const;
+    void queueCompression(const QString &origPath, const QString &path, const QDateTime &origLastModified, Compression compression) const;
+    void preCompress() const;
+    bool compress(Compression compression, const QString &inputPath, const QString &outputPath, const QDateTime &origLastModified) const;
     bool compressGzip(const QString &inputPath, const QString &outputPath, const QDateTime &origLastModified) const;
     bool compressDeflate(const QString &inputPath, const QString &outputPath) const;
 #ifdef CUTELYST_STATICCOMPRESSED_WITH_ZOPFLI
@@ -49,19 +79,85 @@ public:
 #ifdef CUTELYST_STATICCOMPRESSED_WITH_BROTLI
     bool compressBrotli(const QString &inputPath, const QString &outputPath) const;
 #endif
+#ifdef CUTELYST_STATICCOMPRESSED_WITH_ZSTD
+    bool compressZstd(const QString &inputPath, const QString &outputPath) const;
+#endif
 
     QStringList dirs;
     QStringList mimeTypes;
     QStringList suffixes;
     QVector<QDir> includePaths;
     QRegularExpression re = QRegularExpression(QStringLiteral("\\.[^/]+$"));
+    QRegularExpression immutablePattern;
     QDir cacheDir;
     int zlibCompressionLevel = 9;
     int zopfliIterations = 15;
     int brotliQualityLevel = 11;
+    int zstdCompressionLevel = 19;
     bool useZopfli = false;
+    bool zstdLongDistanceMatching = true;
+    int compressionThreads = 1;
     bool checkPreCompressed = true;
     bool onTheFlyCompression = true;
+    bool preCompressFiles = false;
+    QSharedPointer<StaticCompressedIndex> index;
+};
+
+struct StaticCompressedEntry
+{
+    QString path;
+    QString contentType;
+    QString lastModified;
+    QString etag;
+    QString cacheControl;
+    // Pre-compressed files found next to the original
+    QString preCompressed[StaticCompressedPrivate::VariantCount];
+    QString cachePaths[StaticCompressedPrivate::VariantCount];
+    QDateTime lastModifiedDateTime;
+    qint64 size = 0;
+    // Bits of the cachePaths known to be up to date
+    mutable QAtomicInt freshCache;
+    bool compressible = false;
+};
+
+typedef QHash<QString, QSharedPointer<const StaticCompressedEntry>> StaticCompressedManifest;
+
+/**
+ * Immutable manifest of the files below the include paths, built once
+ * before forking and shared by all threads. A file system watcher on the
+ * directories rescans the ones that changed on a thread of its own and
+ * replaces the manifest, reusing the entries of unchanged files. Entries
+ * whose file no longer has their size and modification time are ignored.
+ */
+class StaticCompressedIndex
+{
+public:
+    explicit StaticCompressedIndex(const StaticCompressedPrivate &settings);
+
+    inline QSharedPointer<const StaticCompressedManifest> manifest() const {
+        QReadLocker locker(&m_lock);
+        return m_manifest;
+    }
+
+    void build();
+
+    // Must be called after forking, stops watching when owner is destroyed
+    void watch(QObject *owner);
+
+private:
+    void update(const QSet<QString> &changedDirs);
+    void scan(const QString &relDir, const StaticCompressedManifest &previous, StaticCompressedManifest &manifest, QStringList &dirs) const;
+    QSharedPointer<const StaticCompressedEntry> createEntry(const QString &path, const QString &relPath, const QFileInfo &fileInfo, const QSharedPointer<const StaticCompressedEntry> &previous) const;
+    void updateWatcher();
+
+    StaticCompressedPrivate m_settings;
+    mutable QReadWriteLock m_lock;
+    QSharedPointer<const StaticCompressedManifest> m_manifest;
+    // Only used by the watcher thread once watching
+    QStringList m_watchDirs;
+    QSet<QString> m_changedDirs;
+    QPointer<QFileSystemWatcher> m_watcher;
+    QAtomicInt m_watching;
 };
 
 }
@@ -21,8 +21,8 @@
 #include "request.h"
 #include "response.h"
 #include "context.h"
+#include "utils.h"
 
-#include <QMimeDatabase>
 #include <QFile>
 #include <QDir>
 #include <QDateTime>
@@ -59,10 +59,20 @@ void StaticSimple::setDirs(const QStringList &dirs)
     d->dirs = dirs;
 }
 
+void StaticSimple::setImmutablePattern(const QString &pattern)
+{
+    Q_D(StaticSimple);
+    d->immutablePattern.setPattern(pattern);
+}
+
 bool StaticSimple::setup(Cutelyst::Application *app)
 {
     connect(app, &Application::beforePrepareAction,
-            this, &StaticSimple::beforePrepareAction);
+            this, &StaticSimple::beforePrepareAction, Qt::DirectConnection);
+
+    Q_D(StaticSimple);
+    Utils::registerMimeTypes(d->includePaths);
+
     return true;
 }
 
@@ -75,7 +85,6 @@ void StaticSimple::beforePrepareAction(Context *c, bool *skipMethod)
     }
 
     const QString path = c->req()->path();
-    const QRegularExpression re = d->re; // Thread-safe
 
     for (const QString &dir : d->dirs) {
         if (path.startsWith(dir)) {
@@ -91,24 +100,38 @@ void StaticSimple::beforePrepareAction(Context *c, bool *skipMethod)
         }
     }
 
-    QRegularExpressionMatch match = re.match(path);
-    if (match.hasMatch() && locateStaticFile(c, path)) {
+    // Only paths of files with an extension, the last segment has a dot not at its end
+    const int dot = path.lastIndexOf(QLatin1Char('.'));
+    if (dot != -1 && dot + 1 < path.size() && path.indexOf(QLatin1Char('/'), dot) == -1 && locateStaticFile(c, path)) {
         *skipMethod = true;
     }
 }
 
-bool StaticSimple::locateStaticFile(Context *c, const QString &relPath)
+bool StaticSimple::locateStaticFile(Context *c, const QString &requestPath)
 {
     Q_D(const StaticSimple);
 
+    const QString relPath = Utils::cleanRelativePath(requestPath);
+    if (relPath.isEmpty()) {
+        qCDebug(C_STATICSIMPLE) << "Refusing to serve" << requestPath;
+        return false;
+    }
+
     for (const QDir &includePath : d->includePaths) {
         QString path = includePath.absoluteFilePath(relPath);
         QFileInfo fileInfo(path);
         if (fileInfo.exists()) {
             Response *res = c->res();
             const QDateTime currentDateTime = fileInfo.lastModified();
-            if (!c->req()->headers().ifModifiedSince(currentDateTime)) {
+
+            // Hashed once per file version, so revalidation does not open the file
+            const QString etag = Utils::fileContentETag(path, currentDateTime, fileInfo.size());
+            const Headers &reqHeaders = c->req()->headers();
+            const bool notModified = reqHeaders.header(QStringLiteral("IF_NONE_MATCH")).isEmpty() ?
+                        !reqHeaders.ifModifiedSince(currentDateTime) : reqHeaders.ifNoneMatch(etag);
+            if (notModified) {
                 res->setStatus(Response::NotModified);
+                res->headers().setETag(etag);
                 return true;
             }
 
@@ -120,17 +143,15 @@ bool StaticSimple::locateStaticFile(Context *c, const QString &relPath)
                 // set our open file
                 res->setBody(file);
 
-                static QMimeDatabase db;
-                // use the extension to match to be faster
-                QMimeType mimeType = db.mimeTypeForFile(path, QMimeDatabase::MatchExtension);
-                if (mimeType.isValid()) {
-                    headers.setContentType(mimeType.name());
-                }
+                headers.setContentType(Utils::mimeTypeForFile(path));
                 headers.setContentLength(file->size());
 
                 headers.setLastModified(currentDateTime);
-                // Tell Firefox & friends its OK to cache, even over SSL
-                headers.setHeader(QStringLiteral("CACHE_CONTROL"), QStringLiteral("public"));
+                if (!etag.isEmpty()) {
+                    headers.setETag(etag);
+                }
+
+                headers.setHeader(QStringLiteral("CACHE_CONTROL"), Utils::staticFileCacheControl(d->immutablePattern, relPath));
 
                 return true;
             }
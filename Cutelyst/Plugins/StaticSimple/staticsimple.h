@@ -50,6 +50,17 @@ public:
      */
     void setDirs(const QStringList &dirs);
 
+    /**
+     * Sets a regular expression matching the paths of fingerprinted files, like
+     * app.3f2a9c1d.js, whose content never changes for a given path. Those are
+     * sent with "Cache-Control: public, max-age=31536000, immutable" so browsers
+     * do not revalidate them. An empty \p pattern, the default, disables it.
+     *
+     * All files are sent with a strong ETag based on their content.
+     * @since Cutelyst 2.9.0
+     */
+    void setImmutablePattern(const QString &pattern);
+
     /**
      * Reimplemented from Plugin::setup().
      */
@@ -30,7 +30,7 @@ class StaticSimplePrivate
 public:
     QVector<QDir> includePaths;
     QStringList dirs;
-    QRegularExpression re = QRegularExpression(QStringLiteral("\\.[^/]+$"));
+    QRegularExpression immutablePattern;
 };
 
 }
@@ -204,7 +204,7 @@ ParamsMultiMap StatusMessage::statusQuery(Context *c, const QString &msg, Params
 
 bool StatusMessage::setup(Application *app)
 {
-    connect(app, &Application::postForked, this, &StatusMessagePrivate::_q_postFork);
+    connect(app, &Application::postForked, this, &StatusMessagePrivate::_q_postFork, Qt::DirectConnection);
     return true;
 }
 
@@ -88,12 +88,12 @@ bool LangSelect::setup(Application *app)
         }
         connect(app, &Application::beforePrepareAction, this, [d](Context *c, bool *skipMethod) {
             d->beforePrepareAction(c, skipMethod);
-        });
+        }, Qt::DirectConnection);
     }
     if (!d->locales.contains(d->fallbackLocale)) {
         d->locales.append(d->fallbackLocale);
     }
-    connect(app, &Application::postForked, this, &LangSelectPrivate::_q_postFork);
+    connect(app, &Application::postForked, this, &LangSelectPrivate::_q_postFork, Qt::DirectConnection);
 
     qCDebug(C_LANGSELECT) << "Initialized LangSelect plugin with the following settings:";
     qCDebug(C_LANGSELECT) << "Supported locales:" << d->locales;
@@ -56,6 +56,14 @@ GrantleeView::GrantleeView(QObject *parent, const QString &name) : View(parent,
         d->cutelystVar = app->config(QStringLiteral("CUTELYST_VAR"), QStringLiteral("c")).toString();
 
         app->loadTranslations(QStringLiteral("plugin_view_grantlee"));
+
+        // Parse the cached templates on the master so the
+        // workers share them instead of parsing on first render
+        connect(app, &Application::preForked, this, [=] {
+            if (isCaching()) {
+                preloadTemplates();
+            }
+        });
     } else {
         // make sure templates can be found on the current directory
         setIncludePaths({ QDir::currentPath() });
@@ -213,6 +221,9 @@ QByteArray GrantleeView::render(Context *c) const
 
     gc.setLocalizer(localizer);
 
+    // Grantlee's engine, loaders and templates are not reentrant
+    QMutexLocker locker(c->app()->isThreadShared() ? &d->mutex : nullptr);
+
     Grantlee::Template tmpl = d->engine->loadByName(templateFile);
     if (tmpl->error() != Grantlee::NoError) {
         c->res()->setBody(c->translate("Cutelyst::GrantleeView", "Internal server error."));
@@ -100,6 +100,9 @@ public:
     /*!
      * Sets if template caching should be done, this increases
      * performance at the cost of higher memory usage.
+     *
+     * When enabled all templates are loaded once the application
+     * emits preForked(), so forked workers share the parsed templates.
      */
     void setCache(bool enable);
 
@@ -24,6 +24,8 @@
 #include <grantlee/templateloader.h>
 #include <grantlee/cachingloaderdecorator.h>
 
+#include <QMutex>
+
 namespace Cutelyst {
 
 class GrantleeViewPrivate
@@ -38,6 +40,7 @@ public:
     QSharedPointer<Grantlee::CachingLoaderDecorator> cache;
     QHash<QLocale, QTranslator*> translators;
     QHash<QString, QString> translationCatalogs;
+    mutable QMutex mutex;
 };
 
 }
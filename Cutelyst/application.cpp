@@ -240,6 +240,18 @@ Cutelyst::Engine *Cutelyst::Application::engine() const
     return d->engine;
 }
 
+void Application::setThreadShared(bool enable)
+{
+    Q_D(Application);
+    d->threadShared = enable;
+}
+
+bool Application::isThreadShared() const
+{
+    Q_D(const Application);
+    return d->threadShared;
+}
+
 void Application::setConfig(const QString &key, const QVariant &value)
 {
     Q_D(Application);
@@ -260,6 +272,8 @@ bool Application::setup(Engine *engine)
     d->config = engine->config(QLatin1String("Cutelyst"));
 
     d->setupHome();
+    d->setupCompression();
+    d->setupMimeTypes();
 
     // Call the virtual application init
     // to setup Controllers plugins stuff
@@ -359,12 +373,10 @@ bool Application::setup(Engine *engine)
     return false;
 }
 
-void Application::handleRequest(EngineRequest *request)
+void Application::handleRequest(EngineRequest *request, Engine *engine)
 {
     Q_D(Application);
 
-    Engine *engine = d->engine;
-
     auto priv = new ContextPrivate(this, engine, d->dispatcher, d->plugins);
     auto c = new Context(priv);
 
@@ -391,8 +403,17 @@ void Application::handleRequest(EngineRequest *request)
 
         d->dispatcher->prepareAction(c);
 
+        // attachAsync() dispatches while this is set, even if it is
+        // called before beforeDispatch() returns
+        priv->dispatchPending = true;
         Q_EMIT beforeDispatch(c);
 
+        if (!priv->dispatchPending || priv->asyncDetached) {
+            // Already dispatched or dispatched once attachAsync() is called
+            return;
+        }
+        priv->dispatchPending = false;
+
         d->dispatcher->dispatch(c);
 
         if (request->status & EngineRequest::Async) {
@@ -622,6 +643,57 @@ void Cutelyst::ApplicationPrivate::setupHome()
     }
 }
 
+void ApplicationPrivate::setupCompression()
+{
+    bool ok;
+    compressionMinSize = config.value(QStringLiteral("compression_min_size"), -1).toLongLong(&ok);
+    if (!ok) {
+        compressionMinSize = -1;
+    }
+
+    const QString mimeTypes = config.value(QStringLiteral("compression_mime_types"),
+                                           QStringLiteral("text/html,text/css,text/plain,text/xml,text/javascript,"
+                                                          "application/javascript,application/json,application/xml,"
+                                                          "image/svg+xml")).toString();
+    compressionMimeTypes = mimeTypes.split(QLatin1Char(','), QString::SkipEmptyParts);
+
+    compressionMaxBufferSize = config.value(QStringLiteral("compression_max_buffer_size"), 1024 * 1024).toLongLong(&ok);
+    if (!ok) {
+        compressionMaxBufferSize = 1024 * 1024;
+    }
+
+    compressionLevel = config.value(QStringLiteral("compression_level"), 6).toInt(&ok);
+    if (!ok || compressionLevel < -1 || compressionLevel > 9) {
+        compressionLevel = 6;
+    }
+
+    compressionBrotliQuality = config.value(QStringLiteral("compression_brotli_quality"), 5).toInt(&ok);
+    if (!ok || compressionBrotliQuality < 0 || compressionBrotliQuality > 11) {
+        compressionBrotliQuality = 5;
+    }
+
+    compressionZstdLevel = config.value(QStringLiteral("compression_zstd_level"), 3).toInt(&ok);
+    if (!ok || compressionZstdLevel < 1 || compressionZstdLevel > 19) {
+        compressionZstdLevel = 3;
+    }
+}
+
+void ApplicationPrivate::setupMimeTypes()
+{
+    const QVariantMap config = engine->config(QStringLiteral("Cutelyst_MimeTypes"));
+    if (config.isEmpty()) {
+        return;
+    }
+
+    QHash<QString, QString> overrides;
+    auto it = config.constBegin();
+    while (it != config.constEnd()) {
+        overrides.insert(it.key(), it.value().toString());
+        ++it;
+    }
+    Utils::registerMimeTypes(QStringList(), overrides);
+}
+
 void ApplicationPrivate::setupChildren(const QObjectList &children)
 {
     Q_Q(Application);
@@ -51,6 +51,40 @@ class ApplicationPrivate;
  * @brief The %Cutelyst %Application
  *
  * This is the main class of a Cutelyst appplication
+ *
+ * <H3>Response compression</H3>
+ *
+ * Responses can be compressed by the engine right before being sent,
+ * negotiating gzip, brotli (when built with @c -DRESPONSE_COMPRESSION_BROTLI=ON)
+ * or zstd (when built with @c -DRESPONSE_COMPRESSION_ZSTD=ON) with the
+ * Accept-Encoding request header, on equal q values zstd is preferred over brotli
+ * and brotli over gzip. Bodies set in memory or as seekable
+ * devices are compressed at once and keep an exact Content-Length, output written
+ * with Response::write() is compressed as it is streamed. Responses that already
+ * have a Content-Encoding, or that are partial, are left untouched. Strong ETags
+ * of compressed responses are turned into weak ones. It is configured in the
+ * @c Cutelyst section of the configuration file:
+ * @li @c compression_min_size - integer value, minimal body size in bytes to be
+ * compressed, negative values disable compression (default: -1)
+ * @li @c compression_mime_types - string value, comma separated list of MIME types
+ * to be compressed (default: text/html,text/css,text/plain,text/xml,text/javascript,
+ * application/javascript,application/json,application/xml,image/svg+xml)
+ * @li @c compression_max_buffer_size - integer value, body devices larger than this are
+ * not compressed as they would need to be read into memory (default: 1048576)
+ * @li @c compression_level - integer value, zlib compression level (default: 6)
+ * @li @c compression_brotli_quality - integer value, brotli quality level (default: 5)
+ * @li @c compression_zstd_level - integer value, zstd compression level from 1 to 19,
+ * higher levels would need a window larger than user agents accept (default: 3)
+ *
+ * Since Cutelyst 2.9.0
+ *
+ * <H3>MIME types</H3>
+ *
+ * Static file plugins get the Content-Type of files from Utils::mimeTypeForFile(),
+ * a table of extensions built at startup. Entries of the @c Cutelyst_MimeTypes
+ * section of the configuration file override it, like @c map=application/json
+ *
+ * Since Cutelyst 2.9.0
  */
 class CUTELYST_LIBRARY Application : public QObject
 {
@@ -147,9 +181,58 @@ public:
 
     /**
      * Returns current engine that is generating requests.
+     *
+     * \note When the application is thread shared this is the engine
+     * of worker core 0, use Context::engine() to get the engine of the
+     * current request.
      */
     Engine *engine() const;
 
+    /**
+     * Marks this application as shared by all worker threads of a process,
+     * it must be called on the constructor.
+     *
+     * By default the engine creates a new Application instance for each
+     * worker thread, duplicating controllers, dispatcher tables, plugins,
+     * views and configuration. When enabled a single instance is setup and
+     * used by all threads, which requires that:
+     * \li controllers, plugins and views are reentrant, all state kept
+     * between requests must be protected, thread local or read-only
+     * \li connections to request signals (beforePrepareAction(), beforeDispatch(),
+     * afterDispatch()) and postForked() use Qt::DirectConnection as they are
+     * emitted on the worker threads
+     * \li postFork() is called only once, from worker core 0, while postForked()
+     * is emitted on every worker thread
+     *
+     * The engines do not own a shared application, it lives on the thread that
+     * created it and must be deleted by its creator once all engines are gone,
+     * WSGI does that for the applications it loads.
+     *
+     * Of the bundled components these can be used with a shared application:
+     * \li StaticSimple, StaticCompressed and WSGI's static map, the immutable
+     * pattern is a const QRegularExpression matched directly by
+     * Utils::staticFileCacheControl(), as const matching is thread-safe, and the
+     * compression queue, manifest and MIME table are locked or atomically swapped
+     * \li Session, with its file, memcached and shared memory stores
+     * \li Memcached, which keeps a connection handle per thread, and
+     * MemcachedSessionStore and MemcachedResponseCacheStore built on it
+     * \li ResponseCache, the in-flight requests are tracked per thread
+     * \li Authentication, CSRFProtection, StatusMessage, UserAgent and Pagination
+     * as long as the realms, stores and credentials given to them are reentrant
+     * \li the JSON and Email views, and GrantleeView which serializes rendering,
+     * as Grantlee's engine is not reentrant
+     *
+     * ClearSilverView has not been verified and should not be used.
+     *
+     * @since Cutelyst 2.9.0
+     */
+    void setThreadShared(bool enable);
+
+    /**
+     * Returns true if this application is shared by all worker threads.
+     */
+    bool isThreadShared() const;
+
     /**
      * Tries to load a plugin in Cutelyst default plugin directory with \p parent as it's parent.
      * A nullptr is returned in case of failure.
@@ -394,6 +477,9 @@ Q_SIGNALS:
     /**
      * This signal is emitted right after the Dispatcher
      * returns the Action that will be executed.
+     *
+     * Calling Context::detachAsync() from here postpones
+     * the dispatch until Context::attachAsync() is called.
      */
     void beforeDispatch(Context *c);
 
@@ -406,6 +492,10 @@ Q_SIGNALS:
     /**
      * This signal is emitted right after application has been setup
      * and before application forks and \sa postFork() is called.
+     *
+     * It is the place to warm up read-only data (parsed templates,
+     * lookup tables, caches) as it runs on the master process when
+     * not in lazy mode, thus the memory is shared with the workers.
      */
     void preForked(Application *app);
 
@@ -431,6 +521,7 @@ protected:
     void setConfig(const QString &key, const QVariant &value);
 
     friend class Engine;
+    friend class EngineRequest;
     friend class Context;
 
     /*!
@@ -441,7 +532,7 @@ protected:
     /*!
      * Called by the Engine to handle a new Request object
      */
-    void handleRequest(Cutelyst::EngineRequest *request);
+    void handleRequest(Cutelyst::EngineRequest *request, Engine *engine);
 
     /*!
      * Called by the Engine once post fork happened
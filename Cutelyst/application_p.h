@@ -32,6 +32,8 @@ class ApplicationPrivate
     Q_DECLARE_PUBLIC(Application)
 public:
     void setupHome();
+    void setupCompression();
+    void setupMimeTypes();
     void setupChildren(const QObjectList &children);
 
     void logRequest(Request *req);
@@ -49,9 +51,16 @@ public:
     QMap<QString, ComponentFactory *> factories;
     Headers headers;
     QVariantMap config;
+    QStringList compressionMimeTypes;
     Engine *engine;
+    qint64 compressionMinSize = -1;
+    qint64 compressionMaxBufferSize = 1024 * 1024;
+    int compressionLevel = 6;
+    int compressionBrotliQuality = 5;
+    int compressionZstdLevel = 3;
     bool useStats;
     bool init = false;
+    bool threadShared = false;
     QHash<QLocale, QVector<QTranslator*>> translators;
 };
 
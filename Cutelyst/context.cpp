@@ -366,6 +366,14 @@ void Context::attachAsync()
     bool &asyncDetached = d->asyncDetached;
     asyncDetached = false;
 
+    if (d->dispatchPending) {
+        d->dispatchPending = false;
+        // Controller::_DISPATCH() runs the action chain with attachAsync()
+        if (d->dispatcher->dispatch(this)) {
+            return;
+        }
+    }
+
     while (!d->pendingAsync.isEmpty()) {
         Component *action = d->pendingAsync.takeLast();
         if (!execute(action)) {
@@ -372,6 +372,9 @@ public:
      * created prior to calling this.
      *
      * Once done call attachAsync() in order to process the remaining of the action chain.
+     *
+     * When called from Application::beforeDispatch() the request is not dispatched
+     * until attachAsync() is called.
      */
     void detachAsync();
 
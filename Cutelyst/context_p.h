@@ -64,6 +64,7 @@ public:
     View *view = nullptr;
     Stats *stats = nullptr;
     bool asyncDetached = false;
+    bool dispatchPending = false;
     bool detached = false;
     bool state = false;
 };
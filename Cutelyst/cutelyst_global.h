@@ -64,6 +64,16 @@
 #else
 #  define CUTELYST_PLUGIN_MEMCACHEDSESSIONSTORE_EXPORT Q_DECL_IMPORT
 #endif
+#if defined(Cutelyst2Qt5ResponseCache_EXPORTS)
+#  define CUTELYST_PLUGIN_RESPONSECACHE_EXPORT Q_DECL_EXPORT
+#else
+#  define CUTELYST_PLUGIN_RESPONSECACHE_EXPORT Q_DECL_IMPORT
+#endif
+#if defined(Cutelyst2Qt5MemcachedResponseCacheStore_EXPORTS)
+#  define CUTELYST_PLUGIN_MEMCACHEDRESPONSECACHESTORE_EXPORT Q_DECL_EXPORT
+#else
+#  define CUTELYST_PLUGIN_MEMCACHEDRESPONSECACHESTORE_EXPORT Q_DECL_IMPORT
+#endif
 #if defined(Cutelyst2Qt5CSRFProtection_EXPORTS)
 #  define CUTELYST_PLUGIN_CSRFPROTECTION_EXPORT Q_DECL_EXPORT
 #else
@@ -47,6 +47,9 @@ using namespace Cutelyst;
  greater than 0 it will issue a new Application instance, failing
  to do so a fatal error is generated (usually indicating that
  the Application does not have a Q_INVOKABLE constructor).
+ Applications that are Application::isThreadShared() are used
+ by all engines instead, and are not owned by any of them, the
+ code creating the engines must delete it after they are gone.
 */
 
 /*!
@@ -64,8 +67,9 @@ Engine::Engine(Cutelyst::Application *app, int workerCore, const QVariantMap &op
     d->opts = opts;
     d->workerCore = workerCore;
 
-    // If workerCore is greater than 0 we need a new application instance
-    if (workerCore) {
+    // If workerCore is greater than 0 we need a new application
+    // instance, unless it's shared among the worker threads
+    if (workerCore && !app->isThreadShared()) {
         auto newApp = qobject_cast<Application *>(app->metaObject()->newInstance());
         if (!newApp) {
             qFatal("*** FATAL *** Could not create a NEW instance of your Cutelyst::Application, "
@@ -77,8 +81,11 @@ Engine::Engine(Cutelyst::Application *app, int workerCore, const QVariantMap &op
     }
 
     // To make easier for engines to clean up
-    // the app must be a child of it
-    d->app->setParent(this);
+    // the app must be a child of it, a shared app
+    // outlives the engines so it belongs to its creator
+    if (d->app != app || !app->isThreadShared()) {
+        d->app->setParent(this);
+    }
 }
 
 Engine::~Engine()
@@ -150,6 +157,13 @@ bool Engine::postForkApplication()
 
     QThread::currentThread()->setObjectName(QString::number(d->workerCore));
 
+    // A shared application only post forks once, but
+    // postForked() is still emitted on every worker thread
+    if (d->workerCore && d->app->isThreadShared()) {
+        Q_EMIT d->app->postForked(d->app);
+        return true;
+    }
+
     return d->app->enginePostFork();
 }
 
@@ -308,7 +322,7 @@ Headers &Engine::defaultHeaders()
 void Engine::processRequest(EngineRequest *request)
 {
     Q_D(Engine);
-    d->app->handleRequest(request);
+    d->app->handleRequest(request, this);
 }
 
 QVariantMap Engine::opts() const
@@ -18,10 +18,13 @@
 #include "enginerequest.h"
 
 #include "common.h"
+#include "application_p.h"
+#include "responsecompressor_p.h"
 
 #include <Cutelyst/response_p.h>
 #include <Cutelyst/Context>
 
+#include <QUuid>
 #include <QLoggingCategory>
 Q_LOGGING_CATEGORY(CUTELYST_ENGINEREQUEST, "cutelyst.engine_request", QtWarningMsg)
 
@@ -39,11 +42,36 @@ EngineRequest::~EngineRequest()
 
 void EngineRequest::finalizeBody()
 {
+    Response *response = context->response();
+    ResponsePrivate *priv = response->d_ptr;
+    if (priv->compressor) {
+        // Streamed output must end with the encoder trailer
+        QByteArray trailer;
+        if (priv->compressor->compress(nullptr, 0, trailer, true) && !trailer.isEmpty()) {
+            writeFramed(trailer.constData(), trailer.size());
+        }
+        delete priv->compressor;
+        priv->compressor = nullptr;
+    }
+
     if (!(status & EngineRequest::Chunked)) {
-        Response *response = context->response();
         QIODevice *body = response->bodyDevice();
 
-        if (body) {
+        const QVector<QPair<qint64, qint64>> &ranges = priv->bodyRanges;
+        if (body && !ranges.isEmpty()) {
+            const QVector<QByteArray> &parts = priv->bodyRangesParts;
+            if (parts.isEmpty()) {
+                writeBodyRange(body, ranges.first().first, ranges.first().second);
+            } else {
+                for (int i = 0; i < ranges.size(); ++i) {
+                    const QByteArray &part = parts.at(i);
+                    write(part.constData(), part.size());
+                    writeBodyRange(body, ranges.at(i).first, ranges.at(i).second);
+                }
+                const QByteArray &closing = parts.last();
+                write(closing.constData(), closing.size());
+            }
+        } else if (body) {
             body->seek(0);
             char block[64 * 1024];
             while (!body->atEnd()) {
@@ -110,11 +138,246 @@ void EngineRequest::finalizeCookies()
     }
 }
 
+void EngineRequest::writeBodyRange(QIODevice *body, qint64 offset, qint64 length)
+{
+    // Seeking skips data without reading it
+    if (!body->seek(offset)) {
+        qCWarning(CUTELYST_ENGINEREQUEST) << "Failed to seek body to" << offset;
+        return;
+    }
+
+    char block[64 * 1024];
+    while (length > 0) {
+        qint64 in = body->read(block, qMin(length, qint64(sizeof(block))));
+        if (in <= 0) {
+            break;
+        }
+
+        if (write(block, in) != in) {
+            qCWarning(CUTELYST_ENGINEREQUEST) << "Failed to write body";
+            break;
+        }
+        length -= in;
+    }
+}
+
+void EngineRequest::prepareBodyRanges(Response *response, qint64 size)
+{
+    Headers &headers = response->headers();
+    headers.setHeader(QStringLiteral("ACCEPT_RANGES"), QStringLiteral("bytes"));
+
+    const QString range = this->headers.header(QStringLiteral("RANGE"));
+    if (range.isEmpty() || (method != QLatin1String("GET") && method != QLatin1String("HEAD"))) {
+        return;
+    }
+
+    // If-Range only allows strong validators, otherwise the full body is sent
+    const QString ifRange = this->headers.header(QStringLiteral("IF_RANGE"));
+    if (!ifRange.isEmpty()) {
+        if (ifRange.startsWith(QLatin1Char('"'))) {
+            if (ifRange != headers.header(QStringLiteral("ETAG"))) {
+                return;
+            }
+        } else if (ifRange.startsWith(QLatin1String("W/")) || ifRange != headers.lastModified()) {
+            return;
+        }
+    }
+
+    if (!range.startsWith(QLatin1String("bytes="))) {
+        return;
+    }
+
+    // Too many ranges are more likely an abuse than a real client
+    const QStringList specs = range.mid(6).split(QLatin1Char(','));
+    if (specs.size() > 16) {
+        return;
+    }
+
+    QVector<QPair<qint64, qint64>> ranges;
+    for (const QString &spec : specs) {
+        const QString trimmed = spec.trimmed();
+        const int dash = trimmed.indexOf(QLatin1Char('-'));
+        if (dash < 0) {
+            return;
+        }
+
+        bool ok;
+        qint64 first;
+        qint64 last = size - 1;
+        if (dash == 0) {
+            // Suffix range, the last N bytes
+            const qint64 suffix = trimmed.midRef(1).toLongLong(&ok);
+            if (!ok || suffix < 0) {
+                return;
+            } else if (suffix == 0) {
+                continue;
+            }
+            first = qMax(qint64(0), size - suffix);
+        } else {
+            first = trimmed.leftRef(dash).toLongLong(&ok);
+            if (!ok || first < 0) {
+                return;
+            }
+
+            if (dash + 1 < trimmed.size()) {
+                last = trimmed.midRef(dash + 1).toLongLong(&ok);
+                if (!ok || last < first) {
+                    return;
+                }
+                last = qMin(last, size - 1);
+            }
+        }
+
+        if (first < size) {
+            ranges.append({ first, last - first + 1 });
+        }
+    }
+
+    if (ranges.isEmpty()) {
+        response->setStatus(Response::RequestedRangeNotSatisfiable);
+        headers.setHeader(QStringLiteral("CONTENT_RANGE"), QLatin1String("bytes */") + QString::number(size));
+        response->setBody(QByteArray());
+        return;
+    }
+
+    response->setStatus(Response::PartialContent);
+    ResponsePrivate *priv = response->d_ptr;
+    priv->bodyRanges = ranges;
+
+    if (ranges.size() == 1) {
+        const QPair<qint64, qint64> &r = ranges.first();
+        headers.setHeader(QStringLiteral("CONTENT_RANGE"),
+                          QLatin1String("bytes ") + QString::number(r.first) + QLatin1Char('-') +
+                          QString::number(r.first + r.second - 1) + QLatin1Char('/') + QString::number(size));
+        headers.setContentLength(r.second);
+        return;
+    }
+
+    const QByteArray boundary = QUuid::createUuid().toRfc4122().toHex();
+    const QByteArray contentType = headers.header(QStringLiteral("CONTENT_TYPE")).toLatin1();
+    const QByteArray totalSize = QByteArray::number(size);
+
+    qint64 length = 0;
+    for (const QPair<qint64, qint64> &r : ranges) {
+        QByteArray part = "\r\n--" + boundary + "\r\n";
+        if (!contentType.isEmpty()) {
+            part += "Content-Type: " + contentType + "\r\n";
+        }
+        part += "Content-Range: bytes " + QByteArray::number(r.first) + '-' +
+                QByteArray::number(r.first + r.second - 1) + '/' + totalSize + "\r\n\r\n";
+        length += part.size() + r.second;
+        priv->bodyRangesParts.append(part);
+    }
+    priv->bodyRangesParts.append("\r\n--" + boundary + "--\r\n");
+    length += priv->bodyRangesParts.last().size();
+
+    headers.setContentType(QLatin1String("multipart/byteranges; boundary=") + QString::fromLatin1(boundary));
+    headers.setContentLength(length);
+}
+
+bool EngineRequest::prepareCompression(Response *response)
+{
+    const ApplicationPrivate *app = context->app()->d_func();
+    if (app->compressionMinSize < 0) {
+        return false;
+    }
+
+    const quint16 code = response->status();
+    if (code < 200 || code == Response::NoContent || code == Response::PartialContent || code == Response::NotModified) {
+        return false;
+    }
+
+    Headers &headers = response->headers();
+    if (!headers.contentEncoding().isEmpty() || !app->compressionMimeTypes.contains(headers.contentType(), Qt::CaseInsensitive)) {
+        return false;
+    }
+
+    // Caches must store a variant per encoding even when this one is not compressed
+    bool hasVary = false;
+    const QStringList vary = headers.data().values(QStringLiteral("VARY"));
+    for (const QString &value : vary) {
+        if (value.contains(QLatin1String("Accept-Encoding"), Qt::CaseInsensitive)) {
+            hasVary = true;
+            break;
+        }
+    }
+    if (!hasVary) {
+        headers.pushHeader(QStringLiteral("Vary"), QStringLiteral("Accept-Encoding"));
+    }
+
+    const ResponseCompressor::Encoding encoding = ResponseCompressor::negotiate(this->headers.header(QStringLiteral("ACCEPT_ENCODING")));
+    if (encoding == ResponseCompressor::Identity) {
+        return false;
+    }
+
+    int level = app->compressionLevel;
+    if (encoding == ResponseCompressor::Brotli) {
+        level = app->compressionBrotliQuality;
+    } else if (encoding == ResponseCompressor::Zstd) {
+        level = app->compressionZstdLevel;
+    }
+    if (status & EngineRequest::IOWrite) {
+        // The size is unknown, the stream is compressed as it is written
+        response->d_ptr->compressor = new ResponseCompressor(encoding, level);
+        headers.removeHeader(QStringLiteral("CONTENT_LENGTH"));
+    } else {
+        QByteArray data;
+        QIODevice *body = response->bodyDevice();
+        if (body) {
+            const qint64 size = body->size();
+            if (body->isSequential() || size < app->compressionMinSize || size > app->compressionMaxBufferSize || !body->seek(0)) {
+                return false;
+            }
+            data = body->readAll();
+        } else {
+            data = response->body();
+            if (data.size() < app->compressionMinSize) {
+                return false;
+            }
+        }
+
+        QByteArray compressed;
+        ResponseCompressor *encoder = ResponseCompressor::threadCompressor(encoding, level);
+        if (!encoder || !encoder->compress(data.constData(), data.size(), compressed, true)) {
+            qCWarning(CUTELYST_ENGINEREQUEST) << "Failed to compress body";
+            return false;
+        }
+
+        if (compressed.size() >= data.size()) {
+            return false;
+        }
+        // Also sets the Content-Length
+        response->setBody(compressed);
+    }
+
+    headers.setContentEncoding(ResponseCompressor::encodingName(encoding));
+
+    // The compressed representation is not byte identical
+    const QString etag = headers.header(QStringLiteral("ETAG"));
+    if (etag.startsWith(QLatin1Char('"'))) {
+        headers.setHeader(QStringLiteral("ETAG"), QLatin1String("W/") + etag);
+    }
+
+    return true;
+}
+
 bool EngineRequest::finalizeHeaders()
 {
     Response *response = context->response();
     Headers &headers = response->headers();
 
+    ResponsePrivate *priv = response->d_ptr;
+    priv->bodyRanges.clear();
+    priv->bodyRangesParts.clear();
+    delete priv->compressor;
+    priv->compressor = nullptr;
+    if (!prepareCompression(response) && response->status() == Response::OK) {
+        QIODevice *body = response->bodyDevice();
+        if (body && !body->isSequential()) {
+            prepareBodyRanges(response, body->size());
+        }
+    }
+
     // Fix missing content length
     if (headers.contentLength() < 0) {
         qint64 size = response->size();
@@ -131,6 +394,26 @@ bool EngineRequest::finalizeHeaders()
 }
 
 qint64 EngineRequest::write(const char *data, qint64 len)
+{
+    ResponseCompressor *compressor = context ? context->response()->d_ptr->compressor : nullptr;
+    if (compressor) {
+        QByteArray encoded;
+        if (!compressor->compress(data, len, encoded, false)) {
+            qCWarning(CUTELYST_ENGINEREQUEST) << "Failed to compress body";
+            return -1;
+        }
+
+        // An empty chunk would end the response
+        if (encoded.isEmpty()) {
+            return len;
+        }
+        return writeFramed(encoded.constData(), encoded.size()) == encoded.size() ? len : -1;
+    }
+
+    return writeFramed(data, len);
+}
+
+qint64 EngineRequest::writeFramed(const char *data, qint64 len)
 {
     if (!(status & EngineRequest::Chunked)) {
         return doWrite(data, len);
@@ -28,6 +28,7 @@ namespace Cutelyst {
 
 class Engine;
 class Context;
+class Response;
 class CUTELYST_LIBRARY EngineRequest
 {
     Q_GADGET
@@ -49,7 +50,8 @@ public:
 
     /*!
      * Engines must reimplement this to write the
-     * response body back to the caller
+     * response body back to the caller, when a Range
+     * was satisfied only those ranges of the body device are sent
      */
     virtual void finalizeBody();
 
@@ -78,6 +80,14 @@ public:
      * Finalize the headers, and call
      * doWriteHeader(), reimplemententions
      * must call this first
+     *
+     * Responses with a seekable body device honour the
+     * Range and If-Range request headers, replying with
+     * 206 Partial Content, multipart/byteranges or
+     * 416 Requested Range Not Satisfiable
+     *
+     * When response compression is enabled on the Application
+     * the body is compressed here, see Application
      */
     virtual bool finalizeHeaders();
 
@@ -182,6 +192,12 @@ public:
 
     /*! The elapsed timer since the start of request */
     QElapsedTimer elapsed;
+
+private:
+    inline void prepareBodyRanges(Response *response, qint64 size);
+    inline void writeBodyRange(QIODevice *body, qint64 offset, qint64 length);
+    inline bool prepareCompression(Response *response);
+    inline qint64 writeFramed(const char *data, qint64 len);
 };
 
 }
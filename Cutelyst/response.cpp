@@ -20,6 +20,7 @@
 #include "context_p.h"
 #include "engine.h"
 #include "enginerequest.h"
+#include "responsecompressor_p.h"
 #include "common.h"
 
 #include <QtCore/QJsonDocument>
@@ -72,6 +73,7 @@ qint64 Response::writeData(const char *data, qint64 len)
 
 Response::~Response()
 {
+    delete d_ptr->compressor;
     delete d_ptr->bodyIODevice;
     delete d_ptr;
 }
@@ -357,6 +357,7 @@ protected:
     friend class Application;
     friend class Engine;
     friend class EngineConnection;
+    friend class EngineRequest;
     friend class Context;
     friend class ContextPrivate;
 };
@@ -23,6 +23,8 @@
 #include <QtCore/QUrl>
 #include <QtCore/QMap>
 #include <QtCore/QVariant>
+#include <QtCore/QVector>
+#include <QtCore/QPair>
 #include <QtNetwork/QNetworkCookie>
 
 namespace Cutelyst {
@@ -30,6 +32,7 @@ namespace Cutelyst {
 class Context;
 class Engine;
 class EngineRequest;
+class ResponseCompressor;
 class ResponsePrivate
 {
 public:
@@ -42,6 +45,12 @@ public:
     QUrl location;
     QIODevice *bodyIODevice = nullptr;
     EngineRequest *engineRequest;
+    // The byte ranges (offset, length) of the body device to be sent and
+    // for multipart/byteranges the part headers followed by the closing boundary
+    QVector<QPair<qint64, qint64>> bodyRanges;
+    QVector<QByteArray> bodyRangesParts;
+    // Set while compressing output written with Response::write()
+    ResponseCompressor *compressor = nullptr;
     quint16 status = Response::OK;
 };
 
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "responsecompressor_p.h"
+
+#include <QStringList>
+#include <QLoggingCategory>
+
+#include <memory>
+
+Q_LOGGING_CATEGORY(CUTELYST_COMPRESSOR, "cutelyst.response_compressor", QtWarningMsg)
+
+using namespace Cutelyst;
+
+ResponseCompressor::ResponseCompressor(Encoding encoding, int level)
+    : m_encoding(encoding)
+    , m_level(level)
+{
+    if (Q_UNLIKELY(!reset())) {
+        qCWarning(CUTELYST_COMPRESSOR) << "Failed to initialize" << encodingName(encoding) << "encoder";
+    }
+}
+
+ResponseCompressor::~ResponseCompressor()
+{
+    if (m_zstreamInit) {
+        deflateEnd(&m_zstream);
+    }
+#ifdef CUTELYST_WITH_BROTLI
+    if (m_brotli) {
+        BrotliEncoderDestroyInstance(m_brotli);
+    }
+#endif
+#ifdef CUTELYST_WITH_ZSTD
+    ZSTD_freeCCtx(m_zstd);
+#endif
+}
+
+bool ResponseCompressor::reset()
+{
+    switch (m_encoding) {
+    case Gzip:
+        if (m_zstreamInit) {
+            return deflateReset(&m_zstream) == Z_OK;
+        }
+
+        m_zstream.zalloc = Z_NULL;
+        m_zstream.zfree = Z_NULL;
+        m_zstream.opaque = Z_NULL;
+        // 16 + MAX_WBITS selects the gzip wrapper
+        m_zstreamInit = deflateInit2(&m_zstream, m_level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        return m_zstreamInit;
+#ifdef CUTELYST_WITH_BROTLI
+    case Brotli:
+        // The encoder can not be reset, creating a new one is cheap
+        if (m_brotli) {
+            BrotliEncoderDestroyInstance(m_brotli);
+        }
+        m_brotli = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        if (!m_brotli) {
+            return false;
+        }
+        BrotliEncoderSetParameter(m_brotli, BROTLI_PARAM_QUALITY, uint32_t(m_level));
+        return true;
+#endif
+#ifdef CUTELYST_WITH_ZSTD
+    case Zstd:
+        if (m_zstd) {
+            ZSTD_CCtx_reset(m_zstd, ZSTD_reset_session_only);
+            return true;
+        }
+
+        m_zstd = ZSTD_createCCtx();
+        if (!m_zstd) {
+            return false;
+        }
+        // Levels up to 19 keep the window within the 8 MiB user agents accept
+        return !ZSTD_isError(ZSTD_CCtx_setParameter(m_zstd, ZSTD_c_compressionLevel, m_level));
+#endif
+    default:
+        return false;
+    }
+}
+
+bool ResponseCompressor::compress(const char *data, qint64 len, QByteArray &output, bool finish)
+{
+    switch (m_encoding) {
+    case Gzip:
+    {
+        if (Q_UNLIKELY(!m_zstreamInit)) {
+            return false;
+        }
+
+        m_zstream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        m_zstream.avail_in = uInt(len);
+
+        const int flush = finish ? Z_FINISH : Z_SYNC_FLUSH;
+        const int chunk = int(qMin(deflateBound(&m_zstream, uLong(len)) + 64, uLong(256 * 1024)));
+        int ret;
+        do {
+            const int offset = output.size();
+            output.resize(offset + chunk);
+            m_zstream.next_out = reinterpret_cast<Bytef *>(output.data() + offset);
+            m_zstream.avail_out = uInt(chunk);
+
+            ret = deflate(&m_zstream, flush);
+            output.resize(offset + chunk - int(m_zstream.avail_out));
+            if (Q_UNLIKELY(ret == Z_STREAM_ERROR)) {
+                return false;
+            }
+        } while (m_zstream.avail_out == 0 && ret != Z_STREAM_END);
+        return true;
+    }
+#ifdef CUTELYST_WITH_BROTLI
+    case Brotli:
+    {
+        if (Q_UNLIKELY(!m_brotli)) {
+            return false;
+        }
+
+        size_t availIn = size_t(len);
+        const uint8_t *nextIn = reinterpret_cast<const uint8_t *>(data);
+        const BrotliEncoderOperation op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+        do {
+            size_t availOut = 0;
+            if (Q_UNLIKELY(!BrotliEncoderCompressStream(m_brotli, op, &availIn, &nextIn, &availOut, nullptr, nullptr))) {
+                return false;
+            }
+
+            size_t size = 0;
+            const uint8_t *out = BrotliEncoderTakeOutput(m_brotli, &size);
+            output.append(reinterpret_cast<const char *>(out), int(size));
+        } while (availIn || BrotliEncoderHasMoreOutput(m_brotli) || (finish && !BrotliEncoderIsFinished(m_brotli)));
+        return true;
+    }
+#endif
+#ifdef CUTELYST_WITH_ZSTD
+    case Zstd:
+    {
+        if (Q_UNLIKELY(!m_zstd)) {
+            return false;
+        }
+
+        ZSTD_inBuffer in = { data, size_t(len), 0 };
+        const ZSTD_EndDirective mode = finish ? ZSTD_e_end : ZSTD_e_flush;
+        const int chunk = int(ZSTD_CStreamOutSize());
+        size_t remaining;
+        do {
+            const int offset = output.size();
+            output.resize(offset + chunk);
+            ZSTD_outBuffer out = { output.data() + offset, size_t(chunk), 0 };
+
+            remaining = ZSTD_compressStream2(m_zstd, &out, &in, mode);
+            output.resize(offset + int(out.pos));
+            if (Q_UNLIKELY(ZSTD_isError(remaining))) {
+                return false;
+            }
+        } while (remaining);
+        return true;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+ResponseCompressor::Encoding ResponseCompressor::negotiate(const QString &acceptEncoding)
+{
+    Encoding ret = Identity;
+    double best = 0;
+
+    const QStringList codings = acceptEncoding.split(QLatin1Char(','), QString::SkipEmptyParts);
+    for (const QString &coding : codings) {
+        const int semicolon = coding.indexOf(QLatin1Char(';'));
+        const QStringRef name = coding.leftRef(semicolon).trimmed();
+
+        double q = 1;
+        if (semicolon != -1) {
+            const int qPos = coding.indexOf(QLatin1String("q="), semicolon, Qt::CaseInsensitive);
+            if (qPos != -1) {
+                bool ok;
+                q = coding.midRef(qPos + 2).trimmed().toDouble(&ok);
+                if (!ok) {
+                    q = 0;
+                }
+            }
+        }
+
+        Encoding encoding;
+        if (name.compare(QLatin1String("gzip"), Qt::CaseInsensitive) == 0 || name == QLatin1String("*")) {
+            encoding = Gzip;
+#ifdef CUTELYST_WITH_BROTLI
+        } else if (name.compare(QLatin1String("br"), Qt::CaseInsensitive) == 0) {
+            encoding = Brotli;
+#endif
+#ifdef CUTELYST_WITH_ZSTD
+        } else if (name.compare(QLatin1String("zstd"), Qt::CaseInsensitive) == 0) {
+            encoding = Zstd;
+#endif
+        } else {
+            continue;
+        }
+
+        // On equal weights zstd and then brotli win as they compress better
+        if (q > best || (q > 0 && q == best && encoding > ret)) {
+            best = q;
+            ret = encoding;
+        }
+    }
+
+    return ret;
+}
+
+QString ResponseCompressor::encodingName(Encoding encoding)
+{
+    switch (encoding) {
+    case Gzip:
+        return QStringLiteral("gzip");
+    case Brotli:
+        return QStringLiteral("br");
+    case Zstd:
+        return QStringLiteral("zstd");
+    default:
+        return QStringLiteral("identity");
+    }
+}
+
+ResponseCompressor *ResponseCompressor::threadCompressor(Encoding encoding, int level)
+{
+    static thread_local std::unique_ptr<ResponseCompressor> compressors[Zstd + 1];
+
+    std::unique_ptr<ResponseCompressor> &compressor = compressors[encoding];
+    if (!compressor || compressor->m_level != level) {
+        compressor.reset(new ResponseCompressor(encoding, level));
+    } else if (!compressor->reset()) {
+        return nullptr;
+    }
+    return compressor.get();
+}
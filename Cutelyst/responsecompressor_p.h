@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef CUTELYST_RESPONSECOMPRESSOR_P_H
+#define CUTELYST_RESPONSECOMPRESSOR_P_H
+
+#include <QString>
+#include <QByteArray>
+
+#include <zlib.h>
+
+#ifdef CUTELYST_WITH_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#ifdef CUTELYST_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace Cutelyst {
+
+/**
+ * Streaming encoder for the Content-Encoding of responses,
+ * every write is flushed so clients can decode partial output.
+ */
+class ResponseCompressor
+{
+public:
+    enum Encoding {
+        Identity,
+        Gzip,
+        Brotli,
+        Zstd
+    };
+
+    ResponseCompressor(Encoding encoding, int level);
+    ~ResponseCompressor();
+
+    inline Encoding encoding() const { return m_encoding; }
+
+    // Starts a new stream reusing the allocated state
+    bool reset();
+
+    // Appends the encoded len bytes of data to output, finish
+    // terminates the stream after which reset() must be called
+    bool compress(const char *data, qint64 len, QByteArray &output, bool finish);
+
+    // Returns the preferred supported encoding of an Accept-Encoding header
+    static Encoding negotiate(const QString &acceptEncoding);
+
+    static QString encodingName(Encoding encoding);
+
+    // A reset compressor owned by the calling thread, only valid until
+    // the next call, so it must not be kept across event loop iterations
+    static ResponseCompressor *threadCompressor(Encoding encoding, int level);
+
+private:
+    z_stream m_zstream;
+#ifdef CUTELYST_WITH_BROTLI
+    BrotliEncoderState *m_brotli = nullptr;
+#endif
+#ifdef CUTELYST_WITH_ZSTD
+    ZSTD_CCtx *m_zstd = nullptr;
+#endif
+    Encoding m_encoding;
+    int m_level;
+    bool m_zstreamInit = false;
+};
+
+}
+
+#endif // CUTELYST_RESPONSECOMPRESSOR_P_H
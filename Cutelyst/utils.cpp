@@ -19,9 +19,129 @@
 
 #include <QTextStream>
 #include <QVector>
+#include <QFile>
+#include <QCache>
+#include <QMutex>
+#include <QCryptographicHash>
+#include <QMimeDatabase>
+#include <QDir>
+#include <QDirIterator>
+#include <QSet>
+#include <QAtomicPointer>
+#include <QRegularExpression>
+
+#include <memory>
+#include <vector>
 
 using namespace Cutelyst;
 
+namespace {
+
+struct FileETag {
+    QDateTime lastModified;
+    qint64 size;
+    QString etag;
+};
+
+struct FileETagCache {
+    FileETagCache() : cache(4096) { }
+
+    QMutex mutex;
+    QCache<QString, FileETag> cache;
+};
+Q_GLOBAL_STATIC(FileETagCache, fileETagCache)
+
+static const qint64 FileContentETagMaxSize = 256 * 1024;
+
+typedef QHash<QString, QString> MimeTable;
+
+// Readers only load the current table, registerMimeTypes() copies it and
+// publishes the copy, replaced tables are kept alive as readers might still
+// hold them, which is bounded as that only happens at setup
+struct MimeTypes {
+    MimeTypes();
+
+    const MimeTable *current() const { return table.loadAcquire(); }
+    QString resolve(const QString &suffix);
+    void publish(MimeTable *newTable);
+
+    QMimeDatabase db;
+    QMutex mutex;
+    QAtomicPointer<const MimeTable> table;
+    std::vector<std::unique_ptr<const MimeTable>> tables;
+    MimeTable overrides;
+    QSet<QString> scannedDirs;
+    // Extensions resolved while serving, kept apart so that they never copy
+    // the table, the next registerMimeTypes() moves them into it
+    MimeTable onDemand;
+};
+Q_GLOBAL_STATIC(MimeTypes, mimeTypes)
+
+// Unknown extensions requested by clients must not grow the table forever
+const int MaxOnDemandMimeTypes = 256;
+
+MimeTypes::MimeTypes()
+{
+    auto newTable = new MimeTable;
+    const char *webSuffixes[] = {
+        "html", "htm", "xhtml", "css", "js", "json", "xml", "txt", "csv", "md",
+        "svg", "png", "jpg", "jpeg", "gif", "webp", "ico", "bmp", "tif", "tiff",
+        "woff", "woff2", "ttf", "otf", "eot", "pdf", "zip", "gz", "tar",
+        "mp3", "mp4", "ogg", "ogv", "oga", "wav", "webm", "avi", "mpeg", "flac"
+    };
+    for (const char *suffix : webSuffixes) {
+        const QString name = db.mimeTypeForFile(QLatin1String("file.") + QLatin1String(suffix), QMimeDatabase::MatchExtension).name();
+        newTable->insert(QLatin1String(suffix), name);
+    }
+
+    // Missing or wrong on older shared-mime-info databases
+    newTable->insert(QStringLiteral("map"), QStringLiteral("application/json"));
+    newTable->insert(QStringLiteral("mjs"), newTable->value(QStringLiteral("js")));
+    newTable->insert(QStringLiteral("wasm"), QStringLiteral("application/wasm"));
+    newTable->insert(QStringLiteral("webmanifest"), QStringLiteral("application/manifest+json"));
+
+    publish(newTable);
+}
+
+QString MimeTypes::resolve(const QString &suffix)
+{
+    QMutexLocker locker(&mutex);
+    auto it = onDemand.constFind(suffix);
+    if (it != onDemand.constEnd()) {
+        return it.value();
+    }
+
+    // It might have been registered meanwhile
+    const MimeTable *table = current();
+    it = table->constFind(suffix);
+    if (it != table->constEnd()) {
+        return it.value();
+    }
+
+    const QString name = db.mimeTypeForFile(QLatin1String("file.") + suffix, QMimeDatabase::MatchExtension).name();
+    if (onDemand.size() < MaxOnDemandMimeTypes) {
+        onDemand.insert(suffix, name);
+    }
+    return name;
+}
+
+void MimeTypes::publish(MimeTable *newTable)
+{
+    tables.emplace_back(newTable);
+    table.storeRelease(newTable);
+}
+
+QString fileSuffix(const QString &filename)
+{
+    const int dot = filename.lastIndexOf(QLatin1Char('.'));
+    if (dot == -1 || filename.indexOf(QLatin1Char('/'), dot) != -1) {
+        return QString();
+    }
+    return filename.mid(dot + 1).toLower();
+}
+
+}
+
 QByteArray buildTableDivision(const QVector<int> &columnsSize)
 {
     QByteArray buffer;
@@ -204,3 +324,193 @@ QString Utils::decodePercentEncoding(QByteArray *ba)
         return QString::fromUtf8(ba->data(), outlen);
     }
 }
+
+QString Utils::contentETag(const QByteArray &data)
+{
+    // Only used to validate caches, speed matters more than collision resistance
+    return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex());
+}
+
+QString Utils::cleanRelativePath(const QString &path)
+{
+    const int size = path.size();
+    if (size == 0) {
+        return QStringLiteral("");
+    }
+    const QChar *data = path.constData();
+
+    // Most paths are already clean, return them without copying
+    bool clean = data[0] != QLatin1Char('/') && data[size - 1] != QLatin1Char('/');
+    int segmentStart = 0;
+    for (int i = 0; i <= size; ++i) {
+        if (i == size || data[i] == QLatin1Char('/')) {
+            const int len = i - segmentStart;
+            if (len == 2 && data[segmentStart] == QLatin1Char('.') && data[segmentStart + 1] == QLatin1Char('.')) {
+                return QString();
+            } else if (len == 0 || (len == 1 && data[segmentStart] == QLatin1Char('.'))) {
+                clean = false;
+            }
+            segmentStart = i + 1;
+        } else if (data[i].isNull()
+#ifdef Q_OS_WIN
+                   || data[i] == QLatin1Char('\\')
+#endif
+                   ) {
+            return QString();
+        }
+    }
+
+    if (clean) {
+        return path;
+    }
+
+    QString ret(size, Qt::Uninitialized);
+    ret.resize(0);
+    segmentStart = 0;
+    for (int i = 0; i <= size; ++i) {
+        if (i == size || data[i] == QLatin1Char('/')) {
+            const int len = i - segmentStart;
+            if (len > 1 || (len == 1 && data[segmentStart] != QLatin1Char('.'))) {
+                if (!ret.isEmpty()) {
+                    ret.append(QLatin1Char('/'));
+                }
+                ret.append(data + segmentStart, len);
+            }
+            segmentStart = i + 1;
+        }
+    }
+    return ret;
+}
+
+QString Utils::mimeTypeForFile(const QString &filename)
+{
+    MimeTypes *types = mimeTypes();
+    const QString suffix = fileSuffix(filename);
+
+    const MimeTable *table = types->current();
+    auto it = table->constFind(suffix);
+    if (it != table->constEnd()) {
+        return it.value();
+    }
+
+    return types->resolve(suffix);
+}
+
+void Utils::registerMimeTypes(const QStringList &dirs, const QHash<QString, QString> &overrides)
+{
+    MimeTypes *types = mimeTypes();
+
+    QMutexLocker locker(&types->mutex);
+    MimeTable newTable = *types->current();
+    bool changed = false;
+    for (const QString &dir : dirs) {
+        const QString canonicalDir = QDir(dir).canonicalPath();
+        if (canonicalDir.isEmpty() || types->scannedDirs.contains(canonicalDir)) {
+            continue;
+        }
+        types->scannedDirs.insert(canonicalDir);
+
+        QDirIterator it(canonicalDir, QDir::Files | QDir::Readable, QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+        while (it.hasNext()) {
+            const QString suffix = fileSuffix(it.next());
+            if (!newTable.contains(suffix)) {
+                newTable.insert(suffix, types->db.mimeTypeForFile(QLatin1String("file.") + suffix, QMimeDatabase::MatchExtension).name());
+                changed = true;
+            }
+        }
+    }
+
+    // Batches the extensions resolved on demand since the last call
+    for (auto resolved = types->onDemand.constBegin(); resolved != types->onDemand.constEnd(); ++resolved) {
+        if (!newTable.contains(resolved.key())) {
+            newTable.insert(resolved.key(), resolved.value());
+            changed = true;
+        }
+    }
+
+    auto it = overrides.constBegin();
+    while (it != overrides.constEnd()) {
+        QString suffix = it.key().toLower();
+        if (suffix.startsWith(QLatin1String("*."))) {
+            suffix.remove(0, 2);
+        } else if (suffix.startsWith(QLatin1Char('.'))) {
+            suffix.remove(0, 1);
+        }
+        types->overrides.insert(suffix, it.value());
+        ++it;
+    }
+
+    // Overrides win over the suffixes found in any call
+    for (auto override = types->overrides.constBegin(); override != types->overrides.constEnd(); ++override) {
+        auto current = newTable.constFind(override.key());
+        if (current == newTable.constEnd() || current.value() != override.value()) {
+            newTable.insert(override.key(), override.value());
+            changed = true;
+        }
+    }
+
+    // Replaced tables are never freed, so only publish actual changes
+    if (changed) {
+        types->publish(new MimeTable(newTable));
+        types->onDemand.clear();
+    }
+}
+
+void Utils::registerMimeTypes(const QVector<QDir> &dirs)
+{
+    QStringList paths;
+    for (const QDir &dir : dirs) {
+        paths.append(dir.absolutePath());
+    }
+    registerMimeTypes(paths);
+}
+
+QString Utils::fileContentETag(const QString &path, const QDateTime &lastModified, qint64 size, QIODevice *device)
+{
+    const QString cached = cachedFileContentETag(path, lastModified, size);
+    if (!cached.isEmpty()) {
+        return cached;
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    if (device) {
+        const bool ok = device->seek(0) && hash.addData(device);
+        if (!device->seek(0) || !ok) {
+            return QString();
+        }
+    } else {
+        QFile file(path);
+        if (!file.open(QFile::ReadOnly) || !hash.addData(&file)) {
+            return QString();
+        }
+    }
+    const QString etag = QString::fromLatin1(hash.result().toHex());
+
+    QMutexLocker locker(&fileETagCache->mutex);
+    fileETagCache->cache.insert(path, new FileETag{ lastModified, size, etag });
+    return etag;
+}
+
+QString Utils::cachedFileContentETag(const QString &path, const QDateTime &lastModified, qint64 size)
+{
+    // Hashing is done on the request thread, keep it bounded
+    if (size > FileContentETagMaxSize) {
+        return QString::number(lastModified.toMSecsSinceEpoch(), 16) + QLatin1Char('-') + QString::number(size, 16);
+    }
+
+    QMutexLocker locker(&fileETagCache->mutex);
+    const FileETag *cached = fileETagCache->cache.object(path);
+    if (cached && cached->size == size && cached->lastModified == lastModified) {
+        return cached->etag;
+    }
+    return QString();
+}
+
+QString Utils::staticFileCacheControl(const QRegularExpression &immutablePattern, const QString &path)
+{
+    if (!immutablePattern.pattern().isEmpty() && immutablePattern.match(path).hasMatch()) {
+        return QStringLiteral("public, max-age=31536000, immutable");
+    }
+    // Tell Firefox & friends its OK to cache, even over SSL
+    return QStringLiteral("public");
+}
@@ -19,6 +19,13 @@
 #define UTILS_H
 
 #include <QtCore/QStringList>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+
+class QDir;
+class QIODevice;
+class QRegularExpression;
 
 #include <Cutelyst/cutelyst_global.h>
 
@@ -30,6 +37,86 @@ namespace Utils {
     CUTELYST_LIBRARY QString decodePercentEncoding(QString *s);
 
     CUTELYST_LIBRARY QString decodePercentEncoding(QByteArray *ba);
+
+    /**
+     * Returns a strong entity tag (without quotes) for \p data based on its content.
+     * @since Cutelyst 2.9.0
+     */
+    CUTELYST_LIBRARY QString contentETag(const QByteArray &data);
+
+    /**
+     * Returns a strong entity tag (without quotes) for the file at \p path. Files up to 256 KiB
+     * are hashed once per version (\p lastModified and \p size) and kept in a process wide
+     * thread-safe cache, so the tag survives deployments that only touch the files. Larger
+     * files are not read, their tag is built from \p size and \p lastModified instead.
+     * If \p device is set the content is read from it, rewinding it afterwards, so the tag
+     * matches the file already opened to be served instead of whatever \p path points to now.
+     * Returns an empty string if the file can not be read.
+     * @since Cutelyst 2.9.0
+     */
+    CUTELYST_LIBRARY QString fileContentETag(const QString &path, const QDateTime &lastModified, qint64 size, QIODevice *device = nullptr);
+
+    /**
+     * Returns the tag fileContentETag() would return for \p path if it is known without
+     * reading the file, that is when this version was hashed before or is too large to
+     * be hashed, otherwise an empty string. Used to answer revalidations without opening
+     * the file.
+     * @since Cutelyst 2.9.0
+     */
+    CUTELYST_LIBRARY QString cachedFileContentETag(const QString &path, const QDateTime &lastModified, qint64 size);
+
+    /**
+     * Returns the Cache-Control value for the static file at \p path: "public, max-age=31536000, immutable"
+     * when it matches \p immutablePattern, used for fingerprinted files like app.3f2a9c1d.js, otherwise
+     * "public". An empty pattern matches nothing.
+     * @since Cutelyst 2.9.0
+     */
+    CUTELYST_LIBRARY QString staticFileCacheControl(const QRegularExpression &immutablePattern, const QString &path);
+
+    /**
+     * Returns \p path as a relative path with its empty and "." segments removed, or
+     * a null string if it has ".." segments or NUL characters (and backslashes on
+     * Windows), so that the result can not escape the directory it is appended to.
+     *
+     * Static file plugins use this on the decoded request path before touching
+     * the file system, where "%2e%2e/" would otherwise reach parent directories.
+     * @since Cutelyst 2.9.0
+     */
+    CUTELYST_LIBRARY QString cleanRelativePath(const QString &path);
+
+    /**
+     * Returns the name of the MIME type for the extension of \p filename, like
+     * QMimeDatabase::mimeTypeForFile() with QMimeDatabase::MatchExtension but from
+     * a process wide table that is read without locking, unknown extensions
+     * resolve to application/octet-stream.
+     *
+     * The table holds the common web extensions and is extended by registerMimeTypes(),
+     * extensions not found there are looked up in QMimeDatabase and cached apart, behind
+     * a mutex, up to 256 of them, until the next registerMimeTypes() moves them into it.
+     * @since Cutelyst 2.9.0
+     */
+    CUTELYST_LIBRARY QString mimeTypeForFile(const QString &filename);
+
+    /**
+     * Adds the extensions of the files found under \p dirs to the table used by
+     * mimeTypeForFile(), followed by the \p overrides that map an extension (without
+     * the dot) to a MIME type name and take precedence over QMimeDatabase.
+     *
+     * Each directory is only walked once per process, however many plugins or
+     * application instances register it, and a new table is only published if
+     * an extension was added or changed.
+     *
+     * This is meant to be called at setup, before requests are served, so that
+     * in non-lazy mode the table is built once on the master before forking.
+     * @since Cutelyst 2.9.0
+     */
+    CUTELYST_LIBRARY void registerMimeTypes(const QStringList &dirs, const QHash<QString, QString> &overrides = QHash<QString, QString>());
+
+    /**
+     * Same as registerMimeTypes() for the static file directories of a plugin.
+     * @since Cutelyst 2.9.0
+     */
+    CUTELYST_LIBRARY void registerMimeTypes(const QVector<QDir> &dirs);
 }
 
 }
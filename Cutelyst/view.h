@@ -61,6 +61,10 @@ public:
      * When @p minSize is not negative and view render output is larger than @p minSize,
      * if ACCEPT_ENCODING contains 'deflate', then deflate view render output.
      * To disable Deflate, set @p minSize to a negative integer.
+     *
+     * \note The response compression of the engine, configured with
+     * @c compression_min_size on Application, supports gzip, brotli and zstd
+     * and also compresses bodies not rendered by views.
      */
     void setMinimalSizeToDeflate(qint32 minSize = -1);
 private:
@@ -4,6 +4,8 @@
 #include <QTest>
 #include <QObject>
 #include <QUrlQuery>
+#include <QEventLoop>
+#include <QTimer>
 
 #include "headers.h"
 #include "coverageobject.h"
@@ -125,6 +127,26 @@ private:
     bool End(Context *) { return true; }
 };
 
+static void appendLog(Context *c, const QString &entry)
+{
+    QStringList log = c->stash(QStringLiteral("log")).toStringList();
+    log.append(entry);
+    c->setStash(QStringLiteral("log"), log);
+}
+
+class ContextDetachTest : public Controller
+{
+    Q_OBJECT
+    C_NAMESPACE("context/detach")
+public:
+    explicit ContextDetachTest(QObject *parent) : Controller(parent) {}
+
+    C_ATTR(run, :Local :AutoArgs)
+    void run(Context *c) {
+        appendLog(c, QStringLiteral("action"));
+    }
+};
+
 void TestContext::initTestCase()
 {
     m_engine = getEngine();
@@ -138,6 +160,40 @@ TestEngine* TestContext::getEngine()
     auto engine = new TestEngine(app, QVariantMap());
     new ContextGetActionsTest(app);
     new ContextTest_NS(app);
+    new ContextDetachTest(app);
+
+    // Logs the order of the dispatch steps of requests with a mode
+    connect(app, &Application::beforeDispatch, this, [] (Context *c) {
+        const QString mode = c->request()->queryParam(QStringLiteral("mode"));
+        if (mode.isEmpty()) {
+            return;
+        }
+
+        appendLog(c, QStringLiteral("before"));
+        if (mode == QLatin1String("detach")) {
+            c->detachAsync();
+            appendLog(c, QStringLiteral("attach"));
+            c->attachAsync();
+        } else if (mode == QLatin1String("deferred")) {
+            c->detachAsync();
+            QEventLoop loop;
+            QTimer::singleShot(0, c, [c, &loop] {
+                appendLog(c, QStringLiteral("attach"));
+                c->attachAsync();
+                loop.quit();
+            });
+            loop.exec();
+        }
+    }, Qt::DirectConnection);
+    connect(app, &Application::afterDispatch, this, [] (Context *c) {
+        if (c->request()->queryParam(QStringLiteral("mode")).isEmpty()) {
+            return;
+        }
+
+        appendLog(c, QStringLiteral("after"));
+        c->response()->setBody(c->stash(QStringLiteral("log")).toStringList().join(QLatin1Char(',')));
+    }, Qt::DirectConnection);
+
     if (!engine->init()) {
         return nullptr;
     }
@@ -472,6 +528,14 @@ void TestContext::testController_data()
     query.addQueryItem(QStringLiteral("ns"), QStringLiteral("context/test_ns/with/this/extra/invalid/namespace/will/match"));
     QTest::newRow("getactions-test00") << QStringLiteral("/context/test_ns/getActions?") + query.toString(QUrl::FullyEncoded)
                                        << QByteArrayLiteral("context/test_ns/ns;");
+
+    // Context::detachAsync() from Application::beforeDispatch defers the dispatch
+    QTest::newRow("detachasync-test00") << QStringLiteral("/context/detach/run?mode=none")
+                                        << QByteArrayLiteral("before,action,after");
+    QTest::newRow("detachasync-test01") << QStringLiteral("/context/detach/run?mode=detach")
+                                        << QByteArrayLiteral("before,attach,action,after");
+    QTest::newRow("detachasync-test02") << QStringLiteral("/context/detach/run?mode=deferred")
+                                        << QByteArrayLiteral("before,attach,action,after");
 }
 
 QTEST_MAIN(TestContext)
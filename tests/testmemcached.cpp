@@ -4,6 +4,16 @@
 #include <QTest>
 #include <QObject>
 #include <QUrlQuery>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <QMutex>
+#include <QDir>
+#include <QFile>
+#include <functional>
 #include <utility>
 
 #include "headers.h"
@@ -17,6 +27,35 @@
 
 using namespace Cutelyst;
 
+class FunctionThread : public QThread
+{
+    Q_OBJECT
+public:
+    explicit FunctionThread(const std::function<void()> &function) : m_function(function) {}
+
+protected:
+    virtual void run() override { m_function(); }
+
+private:
+    std::function<void()> m_function;
+};
+
+namespace {
+QMutex threadWarningsMutex;
+QStringList threadWarnings;
+}
+
+// Qt complains when sockets or timers outlive the dispatcher of their thread
+static void recordThreadWarning(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    Q_UNUSED(type)
+    Q_UNUSED(context)
+    if (msg.contains(QLatin1String("thread"), Qt::CaseInsensitive)) {
+        QMutexLocker locker(&threadWarningsMutex);
+        threadWarnings.append(msg);
+    }
+}
+
 class TestMemcached : public CoverageObject
 {
     Q_OBJECT
@@ -31,13 +70,22 @@ private Q_SLOTS:
         doTest();
     }
     void testLibMemcachedVersion();
+    void testAsync();
+    void testBatch();
+    void testThreadHandles();
+    // Replace the engine of the other tests, so they run last
+    void testLocalCache();
+    void testAsyncTimeout();
+    void testAsyncConnectionFailure();
+    void testAsyncThreadExit();
 
     void cleanupTestCase();
 
 private:
     TestEngine *m_engine = nullptr;
+    QVector<TestEngine *> m_otherEngines;
 
-    TestEngine* getEngine();
+    TestEngine* getEngine(const QVariantMap &config = QVariantMap());
 
     void doTest();
 
@@ -908,7 +956,7 @@ void TestMemcached::initTestCase()
     QVERIFY(m_engine);
 }
 
-TestEngine* TestMemcached::getEngine()
+TestEngine* TestMemcached::getEngine(const QVariantMap &config)
 {
     qputenv("RECURSION", QByteArrayLiteral("100"));
     auto app = new TestApplication;
@@ -924,6 +972,11 @@ TestEngine* TestMemcached::getEngine()
         {QStringLiteral("compression_threshold"), 10},
         {QStringLiteral("servers"), servers}
     };
+    auto it = config.constBegin();
+    while (it != config.constEnd()) {
+        pluginConfig.insert(it.key(), it.value());
+        ++it;
+    }
     plugin->setDefaultConfig(pluginConfig);
     new MemcachedTest(app);
     if (!engine->init()) {
@@ -934,6 +987,7 @@ TestEngine* TestMemcached::getEngine()
 
 void TestMemcached::cleanupTestCase()
 {
+    qDeleteAll(m_otherEngines);
     delete m_engine;
 }
 
@@ -1136,6 +1190,410 @@ void TestMemcached::testLibMemcachedVersion()
     QVERIFY(!version.isNull());
 }
 
+void TestMemcached::testAsync()
+{
+    QObject receiver;
+    const QString key = QStringLiteral("asyncKey");
+    const QByteArray value = QByteArrayLiteral("Lorem ipsum dolor sit amet");
+
+    int results = 0;
+    Memcached::MemcachedReturnType setRt = Memcached::Failure;
+    Memcached::setAsync(key, value, 60, &receiver, [&] (Memcached::MemcachedReturnType rt) {
+        setRt = rt;
+        ++results;
+    });
+    // Answers only come from the event loop
+    QCOMPARE(results, 0);
+    QTRY_COMPARE(results, 1);
+    QCOMPARE(setRt, Memcached::Success);
+
+    // Values written asynchronously are compressed like the blocking ones
+    QCOMPARE(Memcached::get(key), value);
+
+    QByteArray got;
+    Memcached::MemcachedReturnType getRt = Memcached::Failure;
+    Memcached::getAsync(key, &receiver, [&] (const QByteArray &v, uint64_t cas, Memcached::MemcachedReturnType rt) {
+        Q_UNUSED(cas)
+        got = v;
+        getRt = rt;
+        ++results;
+    });
+    QTRY_COMPARE(results, 2);
+    QCOMPARE(getRt, Memcached::Success);
+    QCOMPARE(got, value);
+
+    // Pipelined requests are answered in order
+    QStringList order;
+    for (int i = 0; i < 20; ++i) {
+        const QString pipelined = key + QString::number(i);
+        Memcached::setAsync(pipelined, QByteArray::number(i), 60, &receiver);
+        Memcached::getAsync(pipelined, &receiver, [&order, i] (const QByteArray &v, uint64_t cas, Memcached::MemcachedReturnType rt) {
+            Q_UNUSED(cas)
+            order.append(rt == Memcached::Success && v == QByteArray::number(i) ? QString::number(i) : QStringLiteral("error"));
+        });
+    }
+    QTRY_COMPARE(order.size(), 20);
+    for (int i = 0; i < 20; ++i) {
+        QCOMPARE(order.at(i), QString::number(i));
+    }
+
+    Memcached::MemcachedReturnType removeRt = Memcached::Failure;
+    Memcached::removeAsync(key, &receiver, [&] (Memcached::MemcachedReturnType rt) {
+        removeRt = rt;
+        ++results;
+    });
+    QTRY_COMPARE(results, 3);
+    QCOMPARE(removeRt, Memcached::Success);
+
+    Memcached::getAsync(key, &receiver, [&] (const QByteArray &v, uint64_t cas, Memcached::MemcachedReturnType rt) {
+        Q_UNUSED(cas)
+        got = v;
+        getRt = rt;
+        ++results;
+    });
+    QTRY_COMPARE(results, 4);
+    QCOMPARE(getRt, Memcached::NotFound);
+    QVERIFY(got.isEmpty());
+
+    // Keys the text protocol can not carry fail without being sent
+    Memcached::getAsync(QStringLiteral("with space"), &receiver, [&] (const QByteArray &v, uint64_t cas, Memcached::MemcachedReturnType rt) {
+        Q_UNUSED(v)
+        Q_UNUSED(cas)
+        getRt = rt;
+        ++results;
+    });
+    QCOMPARE(results, 4);
+    QTRY_COMPARE(results, 5);
+    QCOMPARE(getRt, Memcached::BadKeyProvided);
+
+    // Receivers deleted before the answer arrives are not called back
+    auto gone = new QObject;
+    bool called = false;
+    Memcached::getAsync(key, gone, [&called] (const QByteArray &v, uint64_t cas, Memcached::MemcachedReturnType rt) {
+        Q_UNUSED(v)
+        Q_UNUSED(cas)
+        Q_UNUSED(rt)
+        called = true;
+    });
+    delete gone;
+    Memcached::getAsync(key, &receiver, [&] (const QByteArray &v, uint64_t cas, Memcached::MemcachedReturnType rt) {
+        Q_UNUSED(v)
+        Q_UNUSED(cas)
+        Q_UNUSED(rt)
+        ++results;
+    });
+    QTRY_COMPARE(results, 6);
+    QVERIFY(!called);
+}
+
+void TestMemcached::testBatch()
+{
+    QHash<QString, QByteArray> values;
+    for (int i = 0; i < 50; ++i) {
+        // Every other value is large enough to be compressed
+        values.insert(QStringLiteral("batchKey") + QString::number(i), QByteArray::number(i).repeated(i % 2 ? 20 : 1));
+    }
+    const QStringList keys = values.keys();
+
+    Memcached::MemcachedReturnType rt = Memcached::Failure;
+    QVERIFY(Memcached::mset(values, 60, &rt));
+    QCOMPARE(rt, Memcached::Success);
+    // The writes are not acknowledged, reading them back is the only check
+    QCOMPARE(Memcached::mget(keys), values);
+
+    rt = Memcached::Failure;
+    QVERIFY(Memcached::mremove(keys, &rt));
+    QCOMPARE(rt, Memcached::Success);
+    QVERIFY(Memcached::mget(keys).isEmpty());
+
+    // Single requests still wait for their answers after a batch
+    QVERIFY(!Memcached::remove(keys.first(), &rt));
+    QCOMPARE(rt, Memcached::NotFound);
+
+    const QString groupKey = QStringLiteral("batchGroup");
+    QVERIFY(Memcached::msetByKey(groupKey, values, 60, &rt));
+    QCOMPARE(Memcached::mgetByKey(groupKey, keys), values);
+    QVERIFY(Memcached::mremoveByKey(groupKey, keys, &rt));
+    QVERIFY(Memcached::mgetByKey(groupKey, keys).isEmpty());
+
+    QHash<QString, QVariantList> lists;
+    lists.insert(QStringLiteral("batchList1"), QVariantList{1, QStringLiteral("one")});
+    lists.insert(QStringLiteral("batchList2"), QVariantList{2, QStringLiteral("two")});
+    QVERIFY(Memcached::mset<QVariantList>(lists, 60, &rt));
+    QCOMPARE(Memcached::mget<QVariantList>(lists.keys()), lists);
+    QVERIFY(Memcached::mremove(lists.keys()));
+
+    QVERIFY(!Memcached::mset(QHash<QString, QByteArray>(), 60, &rt));
+    QCOMPARE(rt, Memcached::BadKeyProvided);
+    QVERIFY(!Memcached::mremove(QStringList(), &rt));
+    QCOMPARE(rt, Memcached::BadKeyProvided);
+}
+
+void TestMemcached::testThreadHandles()
+{
+    Application *app = m_engine->app();
+    const int threadCount = 4;
+    QVector<int> failures(threadCount, -1);
+    QVector<Memcached::MemcachedReturnType> unregistered(threadCount, Memcached::Success);
+    QVector<FunctionThread *> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        int *failed = &failures[t];
+        Memcached::MemcachedReturnType *beforeFork = &unregistered[t];
+        threads.append(new FunctionThread([app, t, failed, beforeFork] {
+            // Threads only get a handle once the worker setup ran on them
+            Memcached::get(QStringLiteral("threadKey"), nullptr, beforeFork);
+
+            Q_EMIT app->postForked(app);
+
+            *failed = 0;
+            for (int i = 0; i < 200; ++i) {
+                const QString key = QStringLiteral("threadKey") + QString::number(t) + QLatin1Char('_') + QString::number(i % 10);
+                const QByteArray value = QByteArray::number(t) + '-' + QByteArray::number(i);
+                if (!Memcached::set(key, value, 60) || Memcached::get(key) != value) {
+                    ++*failed;
+                }
+            }
+        }));
+    }
+
+    for (FunctionThread *thread : threads) {
+        thread->start();
+    }
+    for (FunctionThread *thread : threads) {
+        QVERIFY(thread->wait(30000));
+    }
+    qDeleteAll(threads);
+
+    for (int t = 0; t < threadCount; ++t) {
+        QCOMPARE(unregistered.at(t), Memcached::PluginNotRegisterd);
+        QCOMPARE(failures.at(t), 0);
+    }
+
+    // The thread of the engine kept its own handle
+    QVERIFY(Memcached::set(QStringLiteral("threadKey"), QByteArrayLiteral("main"), 60));
+    QCOMPARE(Memcached::get(QStringLiteral("threadKey")), QByteArrayLiteral("main"));
+}
+
+void TestMemcached::testLocalCache()
+{
+    TestEngine *engine = getEngine({
+                                       {QStringLiteral("local_cache_size"), 16},
+                                       {QStringLiteral("local_cache_ttl"), 300}
+                                   });
+    QVERIFY(engine);
+    m_otherEngines.append(engine);
+
+    const QString key = QStringLiteral("localCacheKey");
+    QVERIFY(Memcached::set(key, QByteArrayLiteral("first"), 60));
+
+    const quint64 hits = Memcached::localCacheHits();
+    const quint64 misses = Memcached::localCacheMisses();
+    QCOMPARE(Memcached::get(key), QByteArrayLiteral("first"));
+    QCOMPARE(Memcached::localCacheMisses(), misses + 1);
+    QCOMPARE(Memcached::get(key), QByteArrayLiteral("first"));
+    QCOMPARE(Memcached::localCacheHits(), hits + 1);
+
+    // Writes of this thread drop the local copy
+    QVERIFY(Memcached::set(key, QByteArrayLiteral("second"), 60));
+    QCOMPARE(Memcached::get(key), QByteArrayLiteral("second"));
+    QCOMPARE(Memcached::localCacheMisses(), misses + 2);
+
+    // And so do the writes of other worker threads
+    Application *app = engine->app();
+    bool written = false;
+    FunctionThread thread([app, key, &written] {
+        Q_EMIT app->postForked(app);
+        written = Memcached::set(key, QByteArrayLiteral("third"), 60);
+    });
+    thread.start();
+    QVERIFY(thread.wait(10000));
+    QVERIFY(written);
+    QCOMPARE(Memcached::get(key), QByteArrayLiteral("third"));
+    QCOMPARE(Memcached::localCacheMisses(), misses + 3);
+    QCOMPARE(Memcached::get(key), QByteArrayLiteral("third"));
+    QCOMPARE(Memcached::localCacheHits(), hits + 2);
+
+    QVERIFY(Memcached::remove(key));
+    QCOMPARE(Memcached::get(key), QByteArray());
+
+    // Writes that do not go through the plugin are only seen once the copy expired
+    QString server = QString::fromLocal8Bit(qgetenv("CUTELYST_MEMCACHED_TEST_SERVERS"));
+    if (server.isEmpty()) {
+        server = QStringLiteral("localhost");
+    }
+    if (server.contains(QLatin1Char(';')) || server.startsWith(QLatin1Char('/'))) {
+        QSKIP("Writing out of band needs a single TCP server");
+    }
+    const QStringList serverParts = server.split(QLatin1Char(','));
+    QVERIFY(Memcached::set(key, QByteArrayLiteral("fourth"), 60));
+    QCOMPARE(Memcached::get(key), QByteArrayLiteral("fourth"));
+
+    QTcpSocket socket;
+    socket.connectToHost(serverParts.at(0), serverParts.size() > 1 ? quint16(serverParts.at(1).toUInt()) : quint16(11211));
+    QVERIFY(socket.waitForConnected());
+    socket.write("set " + key.toLatin1() + " 0 60 5\r\nfifth\r\n");
+    while (!socket.canReadLine()) {
+        QVERIFY(socket.waitForReadyRead());
+    }
+    QCOMPARE(socket.readLine(), QByteArrayLiteral("STORED\r\n"));
+    socket.close();
+
+    QCOMPARE(Memcached::get(key), QByteArrayLiteral("fourth"));
+    QTest::qWait(350);
+    QCOMPARE(Memcached::get(key), QByteArrayLiteral("fifth"));
+    QVERIFY(Memcached::remove(key));
+}
+
+void TestMemcached::testAsyncTimeout()
+{
+    // Accepts connections but never answers
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    TestEngine *engine = getEngine({
+                                       {QStringLiteral("binary_protocol"), false},
+                                       {QStringLiteral("servers"), QStringLiteral("127.0.0.1,") + QString::number(server.serverPort())},
+                                       {QStringLiteral("async_timeout"), 200}
+                                   });
+    QVERIFY(engine);
+    m_otherEngines.append(engine);
+
+    QObject receiver;
+    QElapsedTimer timer;
+    timer.start();
+    QVector<Memcached::MemcachedReturnType> results;
+    for (int i = 0; i < 3; ++i) {
+        Memcached::getAsync(QStringLiteral("timeoutKey"), &receiver, [&results] (const QByteArray &v, uint64_t cas, Memcached::MemcachedReturnType rt) {
+            Q_UNUSED(v)
+            Q_UNUSED(cas)
+            results.append(rt);
+        });
+    }
+
+    // All pending requests fail at once
+    QTRY_COMPARE(results.size(), 3);
+    QVERIFY(timer.elapsed() >= 150);
+    for (Memcached::MemcachedReturnType rt : results) {
+        QCOMPARE(rt, Memcached::Timeout);
+    }
+
+    // A deleted receiver is not called back when its request times out
+    auto gone = new QObject;
+    bool called = false;
+    Memcached::removeAsync(QStringLiteral("timeoutKey"), gone, [&called] (Memcached::MemcachedReturnType rt) {
+        Q_UNUSED(rt)
+        called = true;
+    });
+    delete gone;
+    Memcached::getAsync(QStringLiteral("timeoutKey"), &receiver, [&results] (const QByteArray &v, uint64_t cas, Memcached::MemcachedReturnType rt) {
+        Q_UNUSED(v)
+        Q_UNUSED(cas)
+        results.append(rt);
+    });
+    QTRY_COMPARE(results.size(), 4);
+    QCOMPARE(results.last(), Memcached::Timeout);
+    QVERIFY(!called);
+}
+
+void TestMemcached::testAsyncConnectionFailure()
+{
+    // A port nothing listens on
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    const quint16 port = server.serverPort();
+    server.close();
+
+    TestEngine *engine = getEngine({
+                                       {QStringLiteral("binary_protocol"), false},
+                                       {QStringLiteral("servers"), QStringLiteral("127.0.0.1,") + QString::number(port)},
+                                       {QStringLiteral("async_timeout"), 5000}
+                                   });
+    QVERIFY(engine);
+    m_otherEngines.append(engine);
+
+    QObject receiver;
+    Memcached::MemcachedReturnType result = Memcached::Success;
+    bool done = false;
+    Memcached::setAsync(QStringLiteral("refusedKey"), QByteArrayLiteral("value"), 60, &receiver, [&] (Memcached::MemcachedReturnType rt) {
+        result = rt;
+        done = true;
+    });
+    QTRY_VERIFY(done);
+    QCOMPARE(result, Memcached::ConnectionFailure);
+
+    // A missing socket fails within connectToServer(), the request must
+    // still be answered right away instead of waiting for the timeout
+    const QString socketPath = QDir::tempPath() + QLatin1String("/cutelyst-test-missing-memcached.sock");
+    QFile::remove(socketPath);
+    TestEngine *socketEngine = getEngine({
+                                             {QStringLiteral("binary_protocol"), false},
+                                             {QStringLiteral("servers"), socketPath},
+                                             {QStringLiteral("async_timeout"), 5000}
+                                         });
+    QVERIFY(socketEngine);
+    m_otherEngines.append(socketEngine);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < 2; ++i) {
+        result = Memcached::Success;
+        done = false;
+        Memcached::getAsync(QStringLiteral("missingSocketKey"), &receiver, [&] (const QByteArray &v, uint64_t cas, Memcached::MemcachedReturnType rt) {
+            Q_UNUSED(v)
+            Q_UNUSED(cas)
+            result = rt;
+            done = true;
+        });
+        QTRY_VERIFY_WITH_TIMEOUT(done, 2000);
+        QCOMPARE(result, Memcached::ConnectionFailure);
+    }
+    QVERIFY(timer.elapsed() < 2000);
+}
+
+void TestMemcached::testAsyncThreadExit()
+{
+    // Accepts connections but never answers
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    TestEngine *engine = getEngine({
+                                       {QStringLiteral("binary_protocol"), false},
+                                       {QStringLiteral("servers"), QStringLiteral("127.0.0.1,") + QString::number(server.serverPort())},
+                                       {QStringLiteral("async_timeout"), 5000}
+                                   });
+    QVERIFY(engine);
+    m_otherEngines.append(engine);
+    Application *app = engine->app();
+
+    // The connection of the thread is left with a pending request when it finishes
+    QtMessageHandler previous = qInstallMessageHandler(recordThreadWarning);
+    bool sent = false;
+    auto thread = new FunctionThread([app, &sent] {
+        Q_EMIT app->postForked(app);
+
+        QObject receiver;
+        Memcached::getAsync(QStringLiteral("threadExitKey"), &receiver, [] (const QByteArray &v, uint64_t cas, Memcached::MemcachedReturnType rt) {
+            Q_UNUSED(v)
+            Q_UNUSED(cas)
+            Q_UNUSED(rt)
+        });
+
+        QEventLoop loop;
+        QTimer::singleShot(100, &loop, &QEventLoop::quit);
+        loop.exec();
+        sent = true;
+    });
+    thread->start();
+    const bool finished = thread->wait(10000);
+    delete thread;
+    qInstallMessageHandler(previous);
+
+    QVERIFY(finished);
+    QVERIFY(sent);
+    QMutexLocker locker(&threadWarningsMutex);
+    QVERIFY2(threadWarnings.isEmpty(), qPrintable(threadWarnings.join(QLatin1Char('\n'))));
+}
+
 QTEST_MAIN(TestMemcached)
 
 #include "testmemcached.moc"
@@ -11,6 +11,9 @@
 #include <QNetworkCookie>
 #include <QCryptographicHash>
 #include <QUrlQuery>
+#include <QBuffer>
+
+#include <zlib.h>
 
 #include "headers.h"
 #include "coverageobject.h"
@@ -36,12 +39,19 @@ private Q_SLOTS:
         doTest();
     }
 
+    void testMultipartRanges();
+
+    void testCompression_data();
+    void testCompression();
+
     void cleanupTestCase();
 
 private:
     TestEngine *m_engine;
+    TestEngine *m_compressionEngine;
 
     TestEngine* getEngine();
+    TestEngine* getCompressionEngine();
 
     void doTest();
 
@@ -106,6 +116,50 @@ public:
         c->response()->body() = QByteArrayLiteral("abcd").repeated(1024 * 1024);
     }
 
+    C_ATTR(range, :Local :AutoArgs)
+    void range(Context *c) {
+        auto buffer = new QBuffer;
+        buffer->setData(QByteArrayLiteral("0123456789"));
+        buffer->open(QIODevice::ReadOnly);
+        c->response()->headers().setETag(QStringLiteral("range"));
+        c->response()->setBody(buffer);
+    }
+
+    C_ATTR(rangeText, :Local :AutoArgs)
+    void rangeText(Context *c) {
+        range(c);
+        c->response()->setContentType(QStringLiteral("text/plain"));
+    }
+
+    C_ATTR(compressible, :Local :AutoArgs)
+    void compressible(Context *c) {
+        c->response()->setContentType(QStringLiteral("text/plain"));
+        c->response()->setBody(compressibleBody());
+    }
+
+    C_ATTR(compressibleSmall, :Local :AutoArgs)
+    void compressibleSmall(Context *c) {
+        c->response()->setContentType(QStringLiteral("text/plain"));
+        c->response()->setBody(QByteArrayLiteral("tiny"));
+    }
+
+    C_ATTR(compressibleEncoded, :Local :AutoArgs)
+    void compressibleEncoded(Context *c) {
+        c->response()->setContentType(QStringLiteral("text/plain"));
+        c->response()->setContentEncoding(QStringLiteral("gzip"));
+        c->response()->setBody(compressibleBody());
+    }
+
+    C_ATTR(incompressible, :Local :AutoArgs)
+    void incompressible(Context *c) {
+        c->response()->setContentType(QStringLiteral("image/png"));
+        c->response()->setBody(compressibleBody());
+    }
+
+    static QByteArray compressibleBody() {
+        return QByteArrayLiteral("Cutelyst compresses responses. ").repeated(32);
+    }
+
     C_ATTR(redirect, :Local :AutoArgs)
     void redirect(Context *c) {
         c->response()->redirect(c->request()->queryParam(QStringLiteral("url")));
@@ -180,6 +234,9 @@ void TestResponse::initTestCase()
 {
     m_engine = getEngine();
     QVERIFY(m_engine);
+
+    m_compressionEngine = getCompressionEngine();
+    QVERIFY(m_compressionEngine);
 }
 
 TestEngine* TestResponse::getEngine()
@@ -195,9 +252,149 @@ TestEngine* TestResponse::getEngine()
 }
 
 
+void TestResponse::testMultipartRanges()
+{
+    Headers headers;
+    headers.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=0-1,-2"));
+    QByteArray body;
+    const QVariantMap result = m_engine->createRequest(QStringLiteral("GET"),
+                                                       QStringLiteral("response/test/rangeText"),
+                                                       QByteArray(),
+                                                       headers,
+                                                       &body);
+
+    QCOMPARE(result.value(QStringLiteral("status")).toByteArray(), QByteArrayLiteral("206 Partial Content"));
+    const auto resultHeaders = result.value(QStringLiteral("headers")).value<Headers>();
+    QVERIFY(resultHeaders.header(QStringLiteral("Content-Range")).isEmpty());
+
+    const QString contentType = resultHeaders.contentType();
+    const QString prefix = QStringLiteral("multipart/byteranges; boundary=");
+    QVERIFY2(contentType.startsWith(prefix), qPrintable(contentType));
+    const QByteArray boundary = contentType.mid(prefix.size()).toLatin1();
+    QVERIFY(!boundary.isEmpty());
+
+    const QByteArray expected = "\r\n--" + boundary + "\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Range: bytes 0-1/10\r\n\r\n"
+            "01"
+            "\r\n--" + boundary + "\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Range: bytes 8-9/10\r\n\r\n"
+            "89"
+            "\r\n--" + boundary + "--\r\n";
+    const QByteArray output = result.value(QStringLiteral("body")).toByteArray();
+    QCOMPARE(output, expected);
+    QCOMPARE(resultHeaders.contentLength(), qint64(output.size()));
+}
+
+TestEngine* TestResponse::getCompressionEngine()
+{
+    auto app = new TestApplication;
+    auto engine = new TestEngine(app, QVariantMap());
+    engine->setConfig({
+                          {QStringLiteral("Cutelyst"), QVariantMap{
+                               {QStringLiteral("compression_min_size"), 64}
+                           }}
+                      });
+    new ResponseTest(app);
+    if (!engine->init()) {
+        return nullptr;
+    }
+    return engine;
+}
+
+void TestResponse::testCompression_data()
+{
+    QTest::addColumn<QString>("url");
+    QTest::addColumn<QString>("acceptEncoding");
+    QTest::addColumn<QString>("contentEncoding");
+    QTest::addColumn<bool>("compressed");
+    QTest::addColumn<bool>("vary");
+
+    const QString compressible = QStringLiteral("/response/test/compressible");
+    QTest::newRow("compression-test00") << compressible << QStringLiteral("gzip") << QStringLiteral("gzip") << true << true;
+    QTest::newRow("compression-test01") << compressible << QStringLiteral("GZIP") << QStringLiteral("gzip") << true << true;
+    QTest::newRow("compression-test02") << compressible << QString() << QString() << false << true;
+    QTest::newRow("compression-test03") << compressible << QStringLiteral("gzip;q=0") << QString() << false << true;
+    QTest::newRow("compression-test04") << compressible << QStringLiteral("deflate, compress") << QString() << false << true;
+    QTest::newRow("compression-test05") << compressible << QStringLiteral("identity;q=0, gzip;q=0.5") << QStringLiteral("gzip") << true << true;
+    QTest::newRow("compression-test06") << compressible << QStringLiteral("identity, gzip;q=0.001") << QStringLiteral("gzip") << true << true;
+    QTest::newRow("compression-test07") << compressible << QStringLiteral("*") << QStringLiteral("gzip") << true << true;
+    QTest::newRow("compression-test08") << compressible << QStringLiteral("*;q=0") << QString() << false << true;
+    QTest::newRow("compression-test09") << compressible << QStringLiteral("br;q=0.1, zstd;q=0.2, gzip;q=0.9") << QStringLiteral("gzip") << true << true;
+    QTest::newRow("compression-test10") << compressible << QStringLiteral("gzip;q=invalid") << QString() << false << true;
+
+    // Too small to be worth it, caches must still vary on the encoding
+    QTest::newRow("compression-test11") << QStringLiteral("/response/test/compressibleSmall") << QStringLiteral("gzip") << QString() << false << true;
+
+    // Already encoded by the application
+    QTest::newRow("compression-test12") << QStringLiteral("/response/test/compressibleEncoded") << QStringLiteral("gzip") << QStringLiteral("gzip") << false << false;
+
+    // Not one of the compression MIME types
+    QTest::newRow("compression-test13") << QStringLiteral("/response/test/incompressible") << QStringLiteral("gzip") << QString() << false << false;
+}
+
+void TestResponse::testCompression()
+{
+    QFETCH(QString, url);
+    QFETCH(QString, acceptEncoding);
+    QFETCH(QString, contentEncoding);
+    QFETCH(bool, compressed);
+    QFETCH(bool, vary);
+
+    Headers headers;
+    if (!acceptEncoding.isNull()) {
+        headers.setHeader(QStringLiteral("Accept-Encoding"), acceptEncoding);
+    }
+    QByteArray body;
+    const QVariantMap result = m_compressionEngine->createRequest(QStringLiteral("GET"),
+                                                                  url.mid(1),
+                                                                  QByteArray(),
+                                                                  headers,
+                                                                  &body);
+
+    QCOMPARE(result.value(QStringLiteral("status")).toByteArray(), QByteArrayLiteral("200 OK"));
+    const auto resultHeaders = result.value(QStringLiteral("headers")).value<Headers>();
+    QCOMPARE(resultHeaders.contentEncoding(), contentEncoding);
+    QCOMPARE(resultHeaders.header(QStringLiteral("Vary")), vary ? QStringLiteral("Accept-Encoding") : QString());
+
+    const QByteArray output = result.value(QStringLiteral("body")).toByteArray();
+    QCOMPARE(resultHeaders.contentLength(), qint64(output.size()));
+    if (!compressed) {
+        if (url.endsWith(QLatin1String("Small"))) {
+            QCOMPARE(output, QByteArrayLiteral("tiny"));
+        } else {
+            QCOMPARE(output, ResponseTest::compressibleBody());
+        }
+        return;
+    }
+
+    QVERIFY(output.size() < ResponseTest::compressibleBody().size());
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(output.constData()));
+    stream.avail_in = uInt(output.size());
+    // 16 + MAX_WBITS only accepts the gzip wrapper
+    QCOMPARE(inflateInit2(&stream, 16 + MAX_WBITS), Z_OK);
+
+    QByteArray inflated(64 * 1024, Qt::Uninitialized);
+    stream.next_out = reinterpret_cast<Bytef *>(inflated.data());
+    stream.avail_out = uInt(inflated.size());
+    const int ret = inflate(&stream, Z_FINISH);
+    inflated.resize(inflated.size() - int(stream.avail_out));
+    inflateEnd(&stream);
+
+    QCOMPARE(ret, Z_STREAM_END);
+    QCOMPARE(inflated, ResponseTest::compressibleBody());
+}
+
 void TestResponse::cleanupTestCase()
 {
     delete m_engine;
+    delete m_compressionEngine;
 }
 
 void TestResponse::doTest()
@@ -306,6 +503,56 @@ void TestResponse::testController_data()
                                                << Headers{ {QStringLiteral("Content-Length"), QStringLiteral("5")}, {QStringLiteral("Content-Type"), QStringLiteral("TEXT/PLAIN; charset=utf-8")} }
                                                << QByteArrayLiteral("UTF-8");
 
+    QTest::newRow("range-test00") << get << QStringLiteral("/response/test/range") << headers << QByteArray()
+                                  << QByteArrayLiteral("200 OK")
+                                  << Headers{ {QStringLiteral("Content-Length"), QStringLiteral("10")}, {QStringLiteral("Accept-Ranges"), QStringLiteral("bytes")},
+                                              {QStringLiteral("ETag"), QStringLiteral("\"range\"")} }
+                                  << QByteArrayLiteral("0123456789");
+
+    headers.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=2-4"));
+    QTest::newRow("range-test01") << get << QStringLiteral("/response/test/range") << headers << QByteArray()
+                                  << QByteArrayLiteral("206 Partial Content")
+                                  << Headers{ {QStringLiteral("Content-Length"), QStringLiteral("3")}, {QStringLiteral("Accept-Ranges"), QStringLiteral("bytes")},
+                                              {QStringLiteral("ETag"), QStringLiteral("\"range\"")}, {QStringLiteral("Content-Range"), QStringLiteral("bytes 2-4/10")} }
+                                  << QByteArrayLiteral("234");
+
+    headers.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=-3"));
+    QTest::newRow("range-test02") << get << QStringLiteral("/response/test/range") << headers << QByteArray()
+                                  << QByteArrayLiteral("206 Partial Content")
+                                  << Headers{ {QStringLiteral("Content-Length"), QStringLiteral("3")}, {QStringLiteral("Accept-Ranges"), QStringLiteral("bytes")},
+                                              {QStringLiteral("ETag"), QStringLiteral("\"range\"")}, {QStringLiteral("Content-Range"), QStringLiteral("bytes 7-9/10")} }
+                                  << QByteArrayLiteral("789");
+
+    headers.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=8-20"));
+    QTest::newRow("range-test03") << get << QStringLiteral("/response/test/range") << headers << QByteArray()
+                                  << QByteArrayLiteral("206 Partial Content")
+                                  << Headers{ {QStringLiteral("Content-Length"), QStringLiteral("2")}, {QStringLiteral("Accept-Ranges"), QStringLiteral("bytes")},
+                                              {QStringLiteral("ETag"), QStringLiteral("\"range\"")}, {QStringLiteral("Content-Range"), QStringLiteral("bytes 8-9/10")} }
+                                  << QByteArrayLiteral("89");
+
+    headers.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=20-"));
+    QTest::newRow("range-test04") << get << QStringLiteral("/response/test/range") << headers << QByteArray()
+                                  << QByteArrayLiteral("416 Requested Range Not Satisfiable")
+                                  << Headers{ {QStringLiteral("Content-Length"), QStringLiteral("0")}, {QStringLiteral("Accept-Ranges"), QStringLiteral("bytes")},
+                                              {QStringLiteral("ETag"), QStringLiteral("\"range\"")}, {QStringLiteral("Content-Range"), QStringLiteral("bytes */10")} }
+                                  << QByteArray();
+
+    headers.setHeader(QStringLiteral("Range"), QStringLiteral("bytes=2-4"));
+    headers.setHeader(QStringLiteral("If-Range"), QStringLiteral("\"other\""));
+    QTest::newRow("range-test05") << get << QStringLiteral("/response/test/range") << headers << QByteArray()
+                                  << QByteArrayLiteral("200 OK")
+                                  << Headers{ {QStringLiteral("Content-Length"), QStringLiteral("10")}, {QStringLiteral("Accept-Ranges"), QStringLiteral("bytes")},
+                                              {QStringLiteral("ETag"), QStringLiteral("\"range\"")} }
+                                  << QByteArrayLiteral("0123456789");
+
+    headers.setHeader(QStringLiteral("If-Range"), QStringLiteral("\"range\""));
+    QTest::newRow("range-test06") << get << QStringLiteral("/response/test/range") << headers << QByteArray()
+                                  << QByteArrayLiteral("206 Partial Content")
+                                  << Headers{ {QStringLiteral("Content-Length"), QStringLiteral("3")}, {QStringLiteral("Accept-Ranges"), QStringLiteral("bytes")},
+                                              {QStringLiteral("ETag"), QStringLiteral("\"range\"")}, {QStringLiteral("Content-Range"), QStringLiteral("bytes 2-4/10")} }
+                                  << QByteArrayLiteral("234");
+    headers = Headers();
+
     query.clear();
     QTest::newRow("largeBody-test00") << get << QStringLiteral("/response/test/largeBody") << headers << QByteArray()
                                         << QByteArrayLiteral("200 OK")
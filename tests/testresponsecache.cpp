@@ -0,0 +1,258 @@
+#ifndef RESPONSECACHETEST_H
+#define RESPONSECACHETEST_H
+
+#include <QTest>
+#include <QObject>
+#include <QDataStream>
+
+#include "headers.h"
+#include "coverageobject.h"
+
+#include <Cutelyst/application.h>
+#include <Cutelyst/controller.h>
+#include <Cutelyst/headers.h>
+#include <Cutelyst/Plugins/ResponseCache/ResponseCache>
+
+using namespace Cutelyst;
+
+class ResponseCacheTest : public Controller
+{
+    Q_OBJECT
+public:
+    explicit ResponseCacheTest(QObject *parent) : Controller(parent) {}
+
+    C_ATTR(fresh, :Local :Cache(60))
+    void fresh(Context *c) {
+        count(c);
+    }
+
+    C_ATTR(vary, :Local :Cache(60) :CacheVary(Accept-Language))
+    void vary(Context *c) {
+        count(c);
+    }
+
+    C_ATTR(stale, :Local :Cache(60) :CacheStale(600))
+    void stale(Context *c) {
+        c->response()->setHeader(QStringLiteral("X-Cache-Key"), ResponseCache::cacheKey(c));
+        count(c);
+    }
+
+    C_ATTR(status, :Local :AutoArgs :Cache(60))
+    void status(Context *c, const QString &code) {
+        c->response()->setStatus(code.toUShort());
+        count(c);
+    }
+
+    C_ATTR(cookie, :Local :Cache(60))
+    void cookie(Context *c) {
+        c->response()->setHeader(QStringLiteral("Set-Cookie"), QStringLiteral("user=1"));
+        count(c);
+    }
+
+    C_ATTR(cacheControl, :Local :AutoArgs :Cache(60))
+    void cacheControl(Context *c, const QString &value) {
+        c->response()->setHeader(QStringLiteral("Cache-Control"), value);
+        count(c);
+    }
+
+    C_ATTR(uncached, :Local)
+    void uncached(Context *c) {
+        count(c);
+    }
+
+private:
+    // The body tells how many times the action ran for this path
+    void count(Context *c) {
+        c->response()->setBody(QByteArray::number(++m_runs[c->request()->path()]));
+    }
+
+    QHash<QString, int> m_runs;
+};
+
+class TestResponseCache : public CoverageObject
+{
+    Q_OBJECT
+public:
+    explicit TestResponseCache(QObject *parent = nullptr) : CoverageObject(parent) {}
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testHit();
+    void testVary();
+    void testStaleLease();
+    void testStatus_data();
+    void testStatus();
+    void testUnshareable_data();
+    void testUnshareable();
+
+    void cleanupTestCase();
+
+private:
+    TestEngine *m_engine = nullptr;
+    ResponseCache *m_cache = nullptr;
+
+    TestEngine* getEngine();
+
+    QByteArray request(const QString &path, const Headers &headers = Headers(), int *status = nullptr, Headers *responseHeaders = nullptr);
+};
+
+void TestResponseCache::initTestCase()
+{
+    m_engine = getEngine();
+    QVERIFY(m_engine);
+}
+
+TestEngine* TestResponseCache::getEngine()
+{
+    auto app = new TestApplication;
+    auto engine = new TestEngine(app, QVariantMap());
+    new ResponseCacheTest(app);
+    m_cache = new ResponseCache(app);
+    if (!engine->init()) {
+        return nullptr;
+    }
+    return engine;
+}
+
+QByteArray TestResponseCache::request(const QString &path, const Headers &headers, int *status, Headers *responseHeaders)
+{
+    const QVariantMap result = m_engine->createRequest(QStringLiteral("GET"),
+                                                       path,
+                                                       QByteArray(),
+                                                       headers,
+                                                       nullptr);
+    if (status) {
+        *status = result.value(QStringLiteral("statusCode")).toInt();
+    }
+    if (responseHeaders) {
+        *responseHeaders = result.value(QStringLiteral("headers")).value<Headers>();
+    }
+    return result.value(QStringLiteral("body")).toByteArray();
+}
+
+void TestResponseCache::cleanupTestCase()
+{
+    delete m_engine;
+}
+
+void TestResponseCache::testHit()
+{
+    QCOMPARE(request(QStringLiteral("/response/cache/test/fresh")), QByteArrayLiteral("1"));
+
+    Headers headers;
+    QCOMPARE(request(QStringLiteral("/response/cache/test/fresh"), Headers(), nullptr, &headers), QByteArrayLiteral("1"));
+    QVERIFY(!headers.header(QStringLiteral("AGE")).isNull());
+
+    // Different URLs are different responses
+    QCOMPARE(request(QStringLiteral("/response/cache/test/fresh?page=2")), QByteArrayLiteral("2"));
+    QCOMPARE(request(QStringLiteral("/response/cache/test/fresh?page=2")), QByteArrayLiteral("2"));
+
+    // Actions without the attribute always run
+    QCOMPARE(request(QStringLiteral("/response/cache/test/uncached")), QByteArrayLiteral("1"));
+    QCOMPARE(request(QStringLiteral("/response/cache/test/uncached")), QByteArrayLiteral("2"));
+}
+
+void TestResponseCache::testVary()
+{
+    Headers english;
+    english.setHeader(QStringLiteral("Accept-Language"), QStringLiteral("en"));
+    Headers german;
+    german.setHeader(QStringLiteral("Accept-Language"), QStringLiteral("de"));
+
+    QCOMPARE(request(QStringLiteral("/response/cache/test/vary"), english), QByteArrayLiteral("1"));
+    QCOMPARE(request(QStringLiteral("/response/cache/test/vary"), german), QByteArrayLiteral("2"));
+    QCOMPARE(request(QStringLiteral("/response/cache/test/vary"), english), QByteArrayLiteral("1"));
+    QCOMPARE(request(QStringLiteral("/response/cache/test/vary"), german), QByteArrayLiteral("2"));
+    QCOMPARE(request(QStringLiteral("/response/cache/test/vary")), QByteArrayLiteral("3"));
+}
+
+void TestResponseCache::testStaleLease()
+{
+    Headers headers;
+    QCOMPARE(request(QStringLiteral("/response/cache/test/stale"), Headers(), nullptr, &headers), QByteArrayLiteral("1"));
+    const QString key = headers.header(QStringLiteral("X-Cache-Key"));
+    QVERIFY(!key.isEmpty());
+
+    // Moves the response two minutes back, past its 60 fresh seconds
+    ResponseCacheStore *store = m_cache->store();
+    QByteArray entry = store->get(key);
+    QVERIFY(!entry.isEmpty());
+    QDataStream in(entry);
+    in.setVersion(QDataStream::Qt_5_6);
+    quint32 magic;
+    qint64 created;
+    in >> magic >> created;
+    QByteArray aged;
+    QDataStream out(&aged, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << magic << created - 120;
+    aged.append(entry.mid(int(sizeof(magic) + sizeof(created))));
+    QVERIFY(store->set(key, aged, 660));
+
+    // While another request holds the lease the stale response is served
+    QVERIFY(store->add(key + QLatin1String("_lease"), QByteArrayLiteral("1"), 10));
+    QCOMPARE(request(QStringLiteral("/response/cache/test/stale"), Headers(), nullptr, &headers), QByteArrayLiteral("1"));
+    QVERIFY(headers.header(QStringLiteral("AGE")).toInt() >= 120);
+    QVERIFY(store->remove(key + QLatin1String("_lease")));
+
+    // The request taking the lease regenerates it and releases the lease
+    QCOMPARE(request(QStringLiteral("/response/cache/test/stale")), QByteArrayLiteral("2"));
+    QCOMPARE(request(QStringLiteral("/response/cache/test/stale"), Headers(), nullptr, &headers), QByteArrayLiteral("2"));
+    QVERIFY(headers.header(QStringLiteral("AGE")).toInt() < 60);
+    QVERIFY(store->add(key + QLatin1String("_lease"), QByteArrayLiteral("1"), 10));
+    QVERIFY(store->remove(key + QLatin1String("_lease")));
+}
+
+void TestResponseCache::testStatus_data()
+{
+    QTest::addColumn<int>("status");
+    QTest::addColumn<bool>("cached");
+
+    QTest::newRow("200") << 200 << true;
+    QTest::newRow("201") << 201 << false;
+    QTest::newRow("203") << 203 << true;
+    QTest::newRow("300") << 300 << true;
+    QTest::newRow("301") << 301 << true;
+    QTest::newRow("302") << 302 << false;
+    QTest::newRow("404") << 404 << true;
+    QTest::newRow("410") << 410 << true;
+    QTest::newRow("500") << 500 << false;
+    QTest::newRow("503") << 503 << false;
+}
+
+void TestResponseCache::testStatus()
+{
+    QFETCH(int, status);
+    QFETCH(bool, cached);
+
+    const QString path = QStringLiteral("/response/cache/test/status/") + QString::number(status);
+    int statusCode;
+    QCOMPARE(request(path, Headers(), &statusCode), QByteArrayLiteral("1"));
+    QCOMPARE(statusCode, status);
+    QCOMPARE(request(path, Headers(), &statusCode), cached ? QByteArrayLiteral("1") : QByteArrayLiteral("2"));
+    QCOMPARE(statusCode, status);
+}
+
+void TestResponseCache::testUnshareable_data()
+{
+    QTest::addColumn<QString>("path");
+
+    QTest::newRow("set-cookie") << QStringLiteral("/response/cache/test/cookie");
+    QTest::newRow("private") << QStringLiteral("/response/cache/test/cacheControl/private");
+    QTest::newRow("no-store") << QStringLiteral("/response/cache/test/cacheControl/no-store");
+}
+
+void TestResponseCache::testUnshareable()
+{
+    QFETCH(QString, path);
+
+    QCOMPARE(request(path), QByteArrayLiteral("1"));
+    QCOMPARE(request(path), QByteArrayLiteral("2"));
+}
+
+QTEST_MAIN(TestResponseCache)
+
+#include "testresponsecache.moc"
+
+#endif
@@ -0,0 +1,395 @@
+#ifndef SESSIONTEST_H
+#define SESSIONTEST_H
+
+#include <QTest>
+#include <QObject>
+#include <QDir>
+#include <QFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QNetworkCookie>
+
+#include "headers.h"
+#include "coverageobject.h"
+
+#include <Cutelyst/application.h>
+#include <Cutelyst/controller.h>
+#include <Cutelyst/headers.h>
+#include <Cutelyst/Plugins/Session/Session>
+#include <Cutelyst/Plugins/Session/sessionstorefile.h>
+
+#ifdef Q_OS_UNIX
+#include <utime.h>
+#endif
+
+using namespace Cutelyst;
+
+class RecordingStore : public SessionStore
+{
+    Q_OBJECT
+public:
+    explicit RecordingStore(QObject *parent = nullptr) : SessionStore(parent) {}
+
+    virtual QVariant getSessionData(Context *c, const QString &sid, const QString &key, const QVariant &defaultValue) override {
+        Q_UNUSED(c)
+        return sessions.value(sid).value(key, defaultValue);
+    }
+
+    virtual bool storeSessionData(Context *c, const QString &sid, const QString &key, const QVariant &value) override {
+        Q_UNUSED(c)
+        storedKeys.append(key);
+        sessions[sid].insert(key, value);
+        return true;
+    }
+
+    virtual bool deleteSessionData(Context *c, const QString &sid, const QString &key) override {
+        Q_UNUSED(c)
+        sessions[sid].remove(key);
+        return true;
+    }
+
+    virtual bool deleteExpiredSessions(Context *c, quint64 expires) override {
+        Q_UNUSED(c)
+        Q_UNUSED(expires)
+        return true;
+    }
+
+    virtual bool updateSessionData(Context *c, const QString &sid, const QString &key, const QVariantHash &changed, const QStringList &removed) override {
+        ++updates;
+        lastChanged = changed;
+        lastRemoved = removed;
+        return SessionStore::updateSessionData(c, sid, key, changed, removed);
+    }
+
+    void reset() {
+        storedKeys.clear();
+        updates = 0;
+        lastChanged.clear();
+        lastRemoved.clear();
+    }
+
+    QHash<QString, QVariantHash> sessions;
+    QStringList storedKeys;
+    int updates = 0;
+    QVariantHash lastChanged;
+    QStringList lastRemoved;
+};
+
+class SessionTest : public Controller
+{
+    Q_OBJECT
+public:
+    explicit SessionTest(QObject *parent) : Controller(parent) {}
+
+    C_ATTR(set, :Local :AutoArgs)
+    void set(Context *c, const QString &key, const QString &value) {
+        Session::setValue(c, key, value);
+        c->response()->setBody(Session::id(c));
+    }
+
+    C_ATTR(remove, :Local :AutoArgs)
+    void remove(Context *c, const QString &key) {
+        Session::deleteValue(c, key);
+        c->response()->setBody(Session::id(c));
+    }
+
+    C_ATTR(get, :Local :AutoArgs)
+    void get(Context *c, const QString &key) {
+        c->response()->setBody(Session::value(c, key).toString());
+    }
+};
+
+class TestSession : public CoverageObject
+{
+    Q_OBJECT
+public:
+    explicit TestSession(QObject *parent = nullptr) : CoverageObject(parent) {}
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testDirtyKeys();
+    void testRefreshInterval();
+    void testFileCollectGrace();
+    void testFileSharded();
+    void testFileLegacyMigration();
+
+    void cleanupTestCase();
+
+private:
+    TestEngine *m_engine = nullptr;
+    TestEngine *m_fileEngine = nullptr;
+    RecordingStore *m_store = nullptr;
+
+    TestEngine* getEngine(SessionStore *store);
+
+    QByteArray request(const QString &path, const QByteArray &cookie = QByteArray(), QByteArray *setCookie = nullptr, TestEngine *engine = nullptr);
+    static QString sessionRoot();
+    static bool writeSessionFile(const QString &root, const QString &sid, qint64 expires, qint64 age);
+};
+
+void TestSession::initTestCase()
+{
+    m_store = new RecordingStore;
+    m_engine = getEngine(m_store);
+    QVERIFY(m_engine);
+}
+
+TestEngine* TestSession::getEngine(SessionStore *store)
+{
+    auto app = new TestApplication;
+    auto engine = new TestEngine(app, QVariantMap());
+    engine->setConfig({
+                          {QStringLiteral("Cutelyst_Session_Plugin"), QVariantMap{
+                               {QStringLiteral("expires"), 7200},
+                               {QStringLiteral("expiry_refresh_interval"), 60},
+                               {QStringLiteral("gc_interval"), 0}
+                           }}
+                      });
+    new SessionTest(app);
+
+    auto session = new Session(app);
+    session->setStorage(store);
+
+    if (!engine->init()) {
+        return nullptr;
+    }
+    return engine;
+}
+
+QByteArray TestSession::request(const QString &path, const QByteArray &cookie, QByteArray *setCookie, TestEngine *engine)
+{
+    Headers headers;
+    if (!cookie.isEmpty()) {
+        headers.setHeader(QStringLiteral("COOKIE"), QString::fromLatin1(cookie));
+    }
+    const QVariantMap result = (engine ? engine : m_engine)->createRequest(QStringLiteral("GET"),
+                                                                           path,
+                                                                           QByteArray(),
+                                                                           headers,
+                                                                           nullptr);
+    if (setCookie) {
+        const QString header = result.value(QStringLiteral("headers")).value<Headers>().header(QStringLiteral("SET_COOKIE"));
+        const QList<QNetworkCookie> cookies = QNetworkCookie::parseCookies(header.toLatin1());
+        *setCookie = cookies.isEmpty() ? QByteArray() : cookies.first().toRawForm(QNetworkCookie::NameAndValueOnly);
+    }
+    return result.value(QStringLiteral("body")).toByteArray();
+}
+
+QString TestSession::sessionRoot()
+{
+    return QDir::tempPath() + QLatin1Char('/') + QCoreApplication::applicationName() + QLatin1String("/session/data");
+}
+
+bool TestSession::writeSessionFile(const QString &root, const QString &sid, qint64 expires, qint64 age)
+{
+    const QString dir = root + QLatin1Char('/') + sid.left(2) + QLatin1Char('/') + sid.mid(2, 2);
+    if (!QDir().mkpath(dir)) {
+        return false;
+    }
+
+    // Same layout SessionStoreFile writes
+    QFile file(dir + QLatin1Char('/') + sid);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << quint32(0x43534631) << expires << QVariantHash{ {QStringLiteral("expires"), expires} };
+    file.close();
+
+#ifdef Q_OS_UNIX
+    struct utimbuf times;
+    times.actime = time_t(QDateTime::currentMSecsSinceEpoch() / 1000 - age);
+    times.modtime = times.actime;
+    return utime(QFile::encodeName(file.fileName()).constData(), &times) == 0;
+#else
+    return age == 0;
+#endif
+}
+
+void TestSession::cleanupTestCase()
+{
+    delete m_engine;
+    delete m_fileEngine;
+    QDir(sessionRoot()).removeRecursively();
+}
+
+void TestSession::testDirtyKeys()
+{
+    m_store->reset();
+    QByteArray cookie;
+    const QString sid = QString::fromLatin1(request(QStringLiteral("/session/test/set/a/1"), QByteArray(), &cookie));
+    QVERIFY(!cookie.isEmpty());
+    QCOMPARE(m_store->updates, 1);
+    QVERIFY(m_store->lastChanged.contains(QStringLiteral("a")));
+    QVERIFY(m_store->lastChanged.contains(QStringLiteral("__created")));
+
+    // Setting the current value changes nothing
+    m_store->reset();
+    request(QStringLiteral("/session/test/set/a/1"), cookie);
+    QCOMPARE(m_store->updates, 0);
+    QVERIFY(m_store->storedKeys.isEmpty());
+
+    // Only the changed key is handed to the store, the others are kept
+    m_store->reset();
+    request(QStringLiteral("/session/test/set/b/2"), cookie);
+    QCOMPARE(m_store->updates, 1);
+    QCOMPARE(m_store->lastChanged.keys().toSet(), QSet<QString>({QStringLiteral("b"), QStringLiteral("__updated")}));
+    QVERIFY(m_store->lastRemoved.isEmpty());
+    const QVariantHash data = m_store->sessions.value(sid).value(QStringLiteral("session")).toHash();
+    QCOMPARE(data.value(QStringLiteral("a")).toString(), QStringLiteral("1"));
+    QCOMPARE(data.value(QStringLiteral("b")).toString(), QStringLiteral("2"));
+
+    m_store->reset();
+    request(QStringLiteral("/session/test/remove/a"), cookie);
+    QCOMPARE(m_store->updates, 1);
+    QCOMPARE(m_store->lastRemoved, QStringList{QStringLiteral("a")});
+    QCOMPARE(request(QStringLiteral("/session/test/get/a"), cookie), QByteArray());
+    QCOMPARE(request(QStringLiteral("/session/test/get/b"), cookie), QByteArrayLiteral("2"));
+
+    // Removing a missing key changes nothing
+    m_store->reset();
+    request(QStringLiteral("/session/test/remove/a"), cookie);
+    QCOMPARE(m_store->updates, 0);
+}
+
+void TestSession::testRefreshInterval()
+{
+    QByteArray cookie;
+    const QString sid = QString::fromLatin1(request(QStringLiteral("/session/test/set/x/1"), QByteArray(), &cookie));
+    QVERIFY(m_store->sessions.contains(sid));
+
+    // Reads within the interval do not write the expiration
+    m_store->reset();
+    QCOMPARE(request(QStringLiteral("/session/test/get/x"), cookie), QByteArrayLiteral("1"));
+    QVERIFY(!m_store->storedKeys.contains(QStringLiteral("expires")));
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    m_store->sessions[sid].insert(QStringLiteral("expires"), now + 7200 - 30);
+    m_store->reset();
+    QCOMPARE(request(QStringLiteral("/session/test/get/x"), cookie), QByteArrayLiteral("1"));
+    QVERIFY(!m_store->storedKeys.contains(QStringLiteral("expires")));
+
+    // Once the interval passed the expiration is moved forward
+    m_store->sessions[sid].insert(QStringLiteral("expires"), now + 7200 - 120);
+    m_store->reset();
+    QCOMPARE(request(QStringLiteral("/session/test/get/x"), cookie), QByteArrayLiteral("1"));
+    QCOMPARE(m_store->storedKeys.count(QStringLiteral("expires")), 1);
+    QVERIFY(m_store->sessions.value(sid).value(QStringLiteral("expires")).toLongLong() >= now + 7200);
+    QCOMPARE(m_store->updates, 0);
+}
+
+void TestSession::testFileCollectGrace()
+{
+#ifdef Q_OS_UNIX
+    const QString root = sessionRoot();
+    QDir(root).removeRecursively();
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    const QString fresh = QStringLiteral("0123456789abcdef0123456789abcdef");
+    const QString expired = QStringLiteral("0123456789abcdef0123456789abcde0");
+    const QString valid = QStringLiteral("abcd456789abcdef0123456789abcdef");
+    QVERIFY(writeSessionFile(root, fresh, now - 10, 0));
+    QVERIFY(writeSessionFile(root, expired, now - 10, 120));
+    QVERIFY(writeSessionFile(root, valid, now + 3600, 120));
+
+    // One file per step until the pass is done
+    SessionStoreFile store;
+    int steps = 1;
+    while (!store.collectExpiredSessions(quint64(now), 1)) {
+        ++steps;
+        QVERIFY(steps < 10);
+    }
+    QCOMPARE(steps, 3);
+
+    // Files written in the last 60 seconds might still be saved, they are kept
+    QVERIFY(QFile::exists(root + QLatin1String("/01/23/") + fresh));
+    QVERIFY(!QFile::exists(root + QLatin1String("/01/23/") + expired));
+    QVERIFY(QFile::exists(root + QLatin1String("/ab/cd/") + valid));
+
+    // Once the grace period is over the next pass removes it
+    struct utimbuf times;
+    times.actime = time_t(now - 61);
+    times.modtime = times.actime;
+    QVERIFY(utime(QFile::encodeName(root + QLatin1String("/01/23/") + fresh).constData(), &times) == 0);
+    while (!store.collectExpiredSessions(quint64(now), 10)) {
+    }
+    QVERIFY(!QFile::exists(root + QLatin1String("/01/23/") + fresh));
+    QVERIFY(QFile::exists(root + QLatin1String("/ab/cd/") + valid));
+
+    QVERIFY(QDir(root).removeRecursively());
+#else
+    QSKIP("Modification times are set with utime()");
+#endif
+}
+
+void TestSession::testFileSharded()
+{
+    QDir(sessionRoot()).removeRecursively();
+    m_fileEngine = getEngine(new SessionStoreFile);
+    QVERIFY(m_fileEngine);
+
+    QByteArray cookie;
+    const QString sid = QString::fromLatin1(request(QStringLiteral("/session/test/set/color/blue"), QByteArray(), &cookie, m_fileEngine));
+    QVERIFY(sid.size() > 4);
+    QVERIFY(!cookie.isEmpty());
+
+    // Stored two directory levels down, named after the id
+    const QString path = sessionRoot() + QLatin1Char('/') + sid.left(2) + QLatin1Char('/') + sid.mid(2, 2) + QLatin1Char('/') + sid;
+    QVERIFY(QFile::exists(path));
+    QVERIFY(!QFile::exists(sessionRoot() + QLatin1Char('/') + sid));
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+    quint32 magic;
+    qint64 expires;
+    QVariantHash data;
+    in >> magic >> expires >> data;
+    QCOMPARE(in.status(), QDataStream::Ok);
+    QCOMPARE(magic, quint32(0x43534631));
+    QCOMPARE(expires, data.value(QStringLiteral("expires")).toLongLong());
+    QCOMPARE(data.value(QStringLiteral("session")).toHash().value(QStringLiteral("color")).toString(), QStringLiteral("blue"));
+
+    QCOMPARE(request(QStringLiteral("/session/test/get/color"), cookie, nullptr, m_fileEngine), QByteArrayLiteral("blue"));
+
+    request(QStringLiteral("/session/test/set/color/red"), cookie, nullptr, m_fileEngine);
+    QCOMPARE(request(QStringLiteral("/session/test/get/color"), cookie, nullptr, m_fileEngine), QByteArrayLiteral("red"));
+}
+
+void TestSession::testFileLegacyMigration()
+{
+    QVERIFY(m_fileEngine);
+
+    // Sessions saved before the sharded layout only hold the hash in a flat file
+    const QString sid = QStringLiteral("fedcba9876543210fedcba9876543210");
+    const QString legacy = sessionRoot() + QLatin1Char('/') + sid;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    {
+        QVERIFY(QDir().mkpath(sessionRoot()));
+        QFile file(legacy);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QDataStream out(&file);
+        out << QVariantHash{
+               {QStringLiteral("expires"), now + 600},
+               {QStringLiteral("session"), QVariantHash{ {QStringLiteral("color"), QStringLiteral("green")} }}
+        };
+    }
+
+    // Reading it extends the expiration, which saves it in the new layout
+    const QByteArray cookie = QCoreApplication::applicationName().toLatin1() + "_session=" + sid.toLatin1();
+    QCOMPARE(request(QStringLiteral("/session/test/get/color"), cookie, nullptr, m_fileEngine), QByteArrayLiteral("green"));
+
+    const QString path = sessionRoot() + QLatin1String("/fe/dc/") + sid;
+    QVERIFY(QFile::exists(path));
+    QVERIFY(!QFile::exists(legacy));
+    QCOMPARE(request(QStringLiteral("/session/test/get/color"), cookie, nullptr, m_fileEngine), QByteArrayLiteral("green"));
+}
+
+QTEST_MAIN(TestSession)
+
+#include "testsession.moc"
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef SESSIONSHAREDMEMORYTEST_H
+#define SESSIONSHAREDMEMORYTEST_H
+
+#include <QTest>
+#include <QObject>
+#include <QDateTime>
+#include <QNetworkCookie>
+
+#include "headers.h"
+#include "coverageobject.h"
+
+#include <Cutelyst/application.h>
+#include <Cutelyst/controller.h>
+#include <Cutelyst/headers.h>
+#include <Cutelyst/Plugins/Session/Session>
+#include <Cutelyst/Plugins/Session/SessionStoreSharedMemory>
+
+#include "../Cutelyst/Plugins/Session/sessionstoresharedmemory_p.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace Cutelyst;
+
+class SharedMemoryStore : public SessionStoreSharedMemory
+{
+    Q_OBJECT
+public:
+    explicit SharedMemoryStore(Application *app) : SessionStoreSharedMemory(app, app) {}
+
+    SharedSessionSegment *segment() const { return d_ptr->segment; }
+};
+
+class SessionSharedMemoryTest : public Controller
+{
+    Q_OBJECT
+public:
+    explicit SessionSharedMemoryTest(QObject *parent) : Controller(parent) {}
+
+    C_ATTR(set, :Local :AutoArgs)
+    void set(Context *c, const QString &key, const QString &value) {
+        Session::setValue(c, key, value);
+        c->response()->setBody(Session::id(c));
+    }
+
+    C_ATTR(setLarge, :Local :AutoArgs)
+    void setLarge(Context *c, const QString &key) {
+        Session::setValue(c, key, QString(4096, QLatin1Char('x')));
+        c->response()->setBody(Session::id(c));
+    }
+
+    C_ATTR(get, :Local :AutoArgs)
+    void get(Context *c, const QString &key) {
+        c->response()->setBody(Session::value(c, key).toString());
+    }
+};
+
+class TestSessionSharedMemory : public CoverageObject
+{
+    Q_OBJECT
+public:
+    explicit TestSessionSharedMemory(QObject *parent = nullptr) : CoverageObject(parent) {}
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testStoreLoad();
+    void testOversized();
+    void testEvict();
+    void testExpire();
+    void testCollect();
+    void testSharedBetweenApplications();
+    void testDeadLockOwner();
+
+    void cleanupTestCase();
+
+private:
+    TestEngine *m_engine = nullptr;
+    SharedMemoryStore *m_store = nullptr;
+
+    TestEngine* getEngine(SharedMemoryStore **store);
+
+    QByteArray request(const QString &path, const QByteArray &cookie = QByteArray(), QByteArray *setCookie = nullptr, TestEngine *engine = nullptr);
+};
+
+void TestSessionSharedMemory::initTestCase()
+{
+    m_engine = getEngine(&m_store);
+    QVERIFY(m_engine);
+    QVERIFY(m_store->segment());
+}
+
+TestEngine* TestSessionSharedMemory::getEngine(SharedMemoryStore **store)
+{
+    auto app = new TestApplication;
+    auto engine = new TestEngine(app, QVariantMap());
+    // One slot per stripe makes evictions predictable
+    engine->setConfig({
+                          {QStringLiteral("Cutelyst_SessionStoreSharedMemory_Plugin"), QVariantMap{
+                               {QStringLiteral("slots"), 64},
+                               {QStringLiteral("slot_size"), 1024}
+                           }}
+                      });
+    new SessionSharedMemoryTest(app);
+
+    auto session = new Session(app);
+    *store = new SharedMemoryStore(app);
+    session->setStorage(*store);
+
+    if (!engine->init()) {
+        return nullptr;
+    }
+    return engine;
+}
+
+QByteArray TestSessionSharedMemory::request(const QString &path, const QByteArray &cookie, QByteArray *setCookie, TestEngine *engine)
+{
+    Headers headers;
+    if (!cookie.isEmpty()) {
+        headers.setHeader(QStringLiteral("COOKIE"), QString::fromLatin1(cookie));
+    }
+    if (!engine) {
+        engine = m_engine;
+    }
+    const QVariantMap result = engine->createRequest(QStringLiteral("GET"),
+                                                     path,
+                                                     QByteArray(),
+                                                     headers,
+                                                     nullptr);
+    if (setCookie) {
+        const QString header = result.value(QStringLiteral("headers")).value<Headers>().header(QStringLiteral("SET_COOKIE"));
+        const QList<QNetworkCookie> cookies = QNetworkCookie::parseCookies(header.toLatin1());
+        *setCookie = cookies.isEmpty() ? QByteArray() : cookies.first().toRawForm(QNetworkCookie::NameAndValueOnly);
+    }
+    return result.value(QStringLiteral("body")).toByteArray();
+}
+
+void TestSessionSharedMemory::cleanupTestCase()
+{
+    delete m_engine;
+}
+
+void TestSessionSharedMemory::testStoreLoad()
+{
+    QByteArray cookie;
+    QVERIFY(!request(QStringLiteral("/session/shared/memory/test/set/color/blue"), QByteArray(), &cookie).isEmpty());
+    QVERIFY(!cookie.isEmpty());
+
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), cookie), QByteArrayLiteral("blue"));
+
+    // Updates replace the slot of the session
+    request(QStringLiteral("/session/shared/memory/test/set/color/red"), cookie);
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), cookie), QByteArrayLiteral("red"));
+
+    // Unknown sessions have no data
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color")), QByteArray());
+}
+
+void TestSessionSharedMemory::testOversized()
+{
+    QByteArray cookie;
+    request(QStringLiteral("/session/shared/memory/test/setLarge/big"), QByteArray(), &cookie);
+    QVERIFY(!cookie.isEmpty());
+
+    // Data larger than slot_size is not stored
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/big"), cookie), QByteArray());
+}
+
+void TestSessionSharedMemory::testEvict()
+{
+    QVector<QByteArray> cookies;
+    for (int i = 0; i < 256; ++i) {
+        QByteArray cookie;
+        request(QStringLiteral("/session/shared/memory/test/set/n/") + QString::number(i), QByteArray(), &cookie);
+        QVERIFY(!cookie.isEmpty());
+        cookies.append(cookie);
+    }
+
+    int found = 0;
+    for (int i = 0; i < cookies.size(); ++i) {
+        const QByteArray body = request(QStringLiteral("/session/shared/memory/test/get/n"), cookies.at(i));
+        if (!body.isEmpty()) {
+            QCOMPARE(body, QByteArray::number(i));
+            ++found;
+        }
+    }
+
+    // The table holds 64 sessions, the newest one always has a slot
+    QVERIFY2(found > 0 && found <= 64, QByteArray::number(found));
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/n"), cookies.last()), QByteArray::number(cookies.size() - 1));
+}
+
+void TestSessionSharedMemory::testExpire()
+{
+    QByteArray cookie;
+    request(QStringLiteral("/session/shared/memory/test/set/color/green"), QByteArray(), &cookie);
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), cookie), QByteArrayLiteral("green"));
+
+    // Sessions expiring after the cut are kept
+    const quint64 now = quint64(QDateTime::currentMSecsSinceEpoch() / 1000);
+    QVERIFY(m_store->deleteExpiredSessions(nullptr, now));
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), cookie), QByteArrayLiteral("green"));
+
+    QVERIFY(m_store->deleteExpiredSessions(nullptr, now + 86400));
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), cookie), QByteArray());
+}
+
+void TestSessionSharedMemory::testCollect()
+{
+    QByteArray cookie;
+    request(QStringLiteral("/session/shared/memory/test/set/color/yellow"), QByteArray(), &cookie);
+
+    // One stripe of a single slot per step
+    const quint64 expires = quint64(QDateTime::currentMSecsSinceEpoch() / 1000) + 86400;
+    int steps = 1;
+    while (!m_store->collectExpiredSessions(expires, 1)) {
+        ++steps;
+        QVERIFY(steps <= SessionStoreSharedMemoryPrivate::Stripes);
+    }
+    QCOMPARE(steps, int(SessionStoreSharedMemoryPrivate::Stripes));
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), cookie), QByteArray());
+
+    // A large budget sweeps everything at once
+    QVERIFY(m_store->collectExpiredSessions(expires, 1 << 20));
+}
+
+void TestSessionSharedMemory::testSharedBetweenApplications()
+{
+    QByteArray cookie;
+    request(QStringLiteral("/session/shared/memory/test/set/color/orange"), QByteArray(), &cookie);
+    QVERIFY(!cookie.isEmpty());
+
+    // Like the Application of another worker thread
+    SharedMemoryStore *store = nullptr;
+    TestEngine *engine = getEngine(&store);
+    QVERIFY(engine);
+    QCOMPARE(store->segment(), m_store->segment());
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), cookie, nullptr, engine), QByteArrayLiteral("orange"));
+
+    QByteArray otherCookie;
+    request(QStringLiteral("/session/shared/memory/test/set/color/purple"), QByteArray(), &otherCookie, engine);
+    delete engine;
+
+    // The segment outlives the stores using it
+    Application *app = m_engine->app();
+    Q_EMIT app->postForked(app);
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), otherCookie), QByteArrayLiteral("purple"));
+}
+
+void TestSessionSharedMemory::testDeadLockOwner()
+{
+#ifdef Q_OS_UNIX
+    QByteArray cookie;
+    request(QStringLiteral("/session/shared/memory/test/set/color/white"), QByteArray(), &cookie);
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), cookie), QByteArrayLiteral("white"));
+
+    // A worker that exited without releasing the locks
+    const pid_t child = fork();
+    if (child == 0) {
+        _exit(0);
+    }
+    QVERIFY(child > 0);
+    int status;
+    QCOMPARE(waitpid(child, &status, 0), child);
+
+    SharedSessionSegment *segment = m_store->segment();
+    for (SharedSessionStripe &stripe : segment->stripes) {
+        stripe.lock.store(int(child));
+    }
+
+    // The lock is taken over and the stripe it guarded is dropped
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), cookie), QByteArray());
+
+    QByteArray newCookie;
+    request(QStringLiteral("/session/shared/memory/test/set/color/black"), QByteArray(), &newCookie);
+    QCOMPARE(request(QStringLiteral("/session/shared/memory/test/get/color"), newCookie), QByteArrayLiteral("black"));
+
+    for (SharedSessionStripe &stripe : segment->stripes) {
+        stripe.lock.testAndSetRelaxed(int(child), 0);
+    }
+#else
+    QSKIP("Locks are only shared between processes on Unix");
+#endif
+}
+
+QTEST_MAIN(TestSessionSharedMemory)
+
+#include "testsessionsharedmemory.moc"
+
+#endif
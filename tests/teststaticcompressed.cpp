@@ -0,0 +1,370 @@
+#ifndef TESTSTATICCOMPRESSED_H
+#define TESTSTATICCOMPRESSED_H
+
+#include <QTest>
+#include <QObject>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QCryptographicHash>
+
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
+
+#include "headers.h"
+#include "coverageobject.h"
+
+#include <Cutelyst/application.h>
+#include <Cutelyst/headers.h>
+#include <Cutelyst/utils.h>
+#include <Cutelyst/Plugins/StaticCompressed/StaticCompressed>
+
+using namespace Cutelyst;
+
+class TestStaticCompressed : public CoverageObject
+{
+    Q_OBJECT
+public:
+    explicit TestStaticCompressed(QObject *parent = nullptr) : CoverageObject(parent) {}
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testZstd_data();
+    void testZstd();
+
+    void testVariantHeaders_data();
+    void testVariantHeaders();
+
+    void testManifestOverwrite();
+    void testManifestRescan();
+
+    void testPreCompress();
+
+    void cleanupTestCase();
+
+private:
+    TestEngine *m_engine = nullptr;
+    // Serves the same files from a manifest
+    TestEngine *m_indexEngine = nullptr;
+    TestEngine *m_preCompressEngine = nullptr;
+
+    TestEngine* getEngine(const QString &root, const QVariantMap &config = QVariantMap());
+    QString fetch(const QString &path, const QString &acceptEncoding, QByteArray *body);
+    static QVariantMap request(TestEngine *engine, const QString &path, const Headers &headers);
+    bool writeFile(const QString &path, const QByteArray &data);
+
+    QTemporaryDir m_dir;
+    QByteArray m_small;
+    QByteArray m_large;
+};
+
+void TestStaticCompressed::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    QVERIFY(QDir(m_dir.path()).mkpath(QStringLiteral("static/css")));
+
+    m_small = QByteArrayLiteral("body { margin: 0; padding: 0; }\n").repeated(256);
+
+    // Larger than the 8 MiB window user agents accept, long distance matching
+    // would otherwise pick a 128 MiB window
+    m_large.reserve(12 * 1024 * 1024);
+    for (int i = 0; m_large.size() < 12 * 1024 * 1024; ++i) {
+        m_large.append(".rule-" + QByteArray::number(i) + " { color: #" + QByteArray::number(i % 4096, 16) + "; }\n");
+    }
+
+    QFile small(m_dir.path() + QLatin1String("/static/css/small.css"));
+    QVERIFY(small.open(QIODevice::WriteOnly));
+    QCOMPARE(small.write(m_small), qint64(m_small.size()));
+
+    QFile large(m_dir.path() + QLatin1String("/static/css/large.css"));
+    QVERIFY(large.open(QIODevice::WriteOnly));
+    QCOMPARE(large.write(m_large), qint64(m_large.size()));
+
+    // Present in both roots, the pre-compressed one is not real gzip
+    // so that it can be told apart from on the fly compression
+    for (const QString &root : {QStringLiteral("static"), QStringLiteral("indexed")}) {
+        QVERIFY(writeFile(root + QLatin1String("/css/pre.css"), QByteArrayLiteral("h1 { font-weight: bold; }\n")));
+        QVERIFY(writeFile(root + QLatin1String("/css/pre.css.gz"), QByteArrayLiteral("pre-compressed")));
+        QVERIFY(writeFile(root + QLatin1String("/data.txt"), QByteArrayLiteral("plain text\n")));
+    }
+    QVERIFY(writeFile(QStringLiteral("indexed/css/site.css"), QByteArrayLiteral("a { color: red; }\n")));
+    QVERIFY(writeFile(QStringLiteral("indexed/css/late.css"), QByteArrayLiteral("p { margin: 1em; }\n")));
+    QVERIFY(writeFile(QStringLiteral("indexed/css/gone.css"), QByteArrayLiteral("div { display: none; }\n")));
+
+    QVERIFY(writeFile(QStringLiteral("precompress/css/app.css"), m_small));
+
+    // Compressed variants must be newer than the original
+    QTest::qWait(50);
+
+    m_engine = getEngine(QStringLiteral("static"));
+    QVERIFY(m_engine);
+
+    // Without compressing on the fly only pre-compressed variants are served
+    m_indexEngine = getEngine(QStringLiteral("indexed"), {
+                                  {QStringLiteral("use_manifest"), true},
+                                  {QStringLiteral("on_the_fly_compression"), false}
+                              });
+    QVERIFY(m_indexEngine);
+
+    m_preCompressEngine = getEngine(QStringLiteral("precompress"), {
+                                        {QStringLiteral("pre_compress"), true}
+                                    });
+    QVERIFY(m_preCompressEngine);
+}
+
+TestEngine* TestStaticCompressed::getEngine(const QString &root, const QVariantMap &config)
+{
+    QVariantMap pluginConfig{
+        {QStringLiteral("cache_directory"), m_dir.path() + QLatin1Char('/') + root + QLatin1String("-cache")},
+        {QStringLiteral("mime_types"), QStringLiteral("text/css")},
+        {QStringLiteral("zstd_compression_level"), 1},
+        {QStringLiteral("zstd_long_distance_matching"), true}
+    };
+    for (auto it = config.constBegin(); it != config.constEnd(); ++it) {
+        pluginConfig.insert(it.key(), it.value());
+    }
+
+    auto app = new TestApplication;
+    auto engine = new TestEngine(app, QVariantMap());
+    engine->setConfig({
+                          {QStringLiteral("Cutelyst_StaticCompressed_Plugin"), pluginConfig}
+                      });
+    auto plugin = new StaticCompressed(app);
+    plugin->setIncludePaths({m_dir.path() + QLatin1Char('/') + root});
+    if (!engine->init()) {
+        return nullptr;
+    }
+    return engine;
+}
+
+bool TestStaticCompressed::writeFile(const QString &path, const QByteArray &data)
+{
+    const QString filename = m_dir.path() + QLatin1Char('/') + path;
+    if (!QDir().mkpath(QFileInfo(filename).absolutePath())) {
+        return false;
+    }
+
+    QFile file(filename);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(data) == data.size();
+}
+
+QVariantMap TestStaticCompressed::request(TestEngine *engine, const QString &path, const Headers &headers)
+{
+    return engine->createRequest(QStringLiteral("GET"),
+                                 path,
+                                 QByteArray(),
+                                 headers,
+                                 nullptr);
+}
+
+QString TestStaticCompressed::fetch(const QString &path, const QString &acceptEncoding, QByteArray *body)
+{
+    Headers headers;
+    headers.setHeader(QStringLiteral("Accept-Encoding"), acceptEncoding);
+    const QVariantMap result = m_engine->createRequest(QStringLiteral("GET"),
+                                                       path,
+                                                       QByteArray(),
+                                                       headers,
+                                                       nullptr);
+    *body = result.value(QStringLiteral("body")).toByteArray();
+    return result.value(QStringLiteral("headers")).value<Headers>().contentEncoding();
+}
+
+void TestStaticCompressed::cleanupTestCase()
+{
+    delete m_engine;
+    delete m_indexEngine;
+    delete m_preCompressEngine;
+}
+
+void TestStaticCompressed::testZstd_data()
+{
+    QTest::addColumn<QString>("path");
+
+    QTest::newRow("zstd-small") << QStringLiteral("css/small.css");
+    QTest::newRow("zstd-large") << QStringLiteral("css/large.css");
+}
+
+void TestStaticCompressed::testZstd()
+{
+    QFETCH(QString, path);
+    const QByteArray original = path.contains(QLatin1String("large")) ? m_large : m_small;
+
+    // The first request queues the compression and gets the original file
+    QByteArray body;
+    if (fetch(path, QStringLiteral("gzip, zstd"), &body).isEmpty()) {
+        QCOMPARE(body, original);
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(fetch(path, QStringLiteral("gzip, zstd"), &body), QStringLiteral("zstd"), 30000);
+
+    ZSTD_frameHeader header;
+    QCOMPARE(ZSTD_getFrameHeader(&header, body.constData(), size_t(body.size())), size_t(0));
+    QVERIFY2(header.windowSize <= 8 * 1024 * 1024, qPrintable(QString::number(header.windowSize)));
+    QCOMPARE(header.frameContentSize, static_cast<unsigned long long>(original.size()));
+    QVERIFY(header.checksumFlag);
+
+    QByteArray decompressed(original.size(), Qt::Uninitialized);
+    const size_t size = ZSTD_decompress(decompressed.data(), size_t(decompressed.size()), body.constData(), size_t(body.size()));
+    QVERIFY2(!ZSTD_isError(size), ZSTD_getErrorName(size));
+    QCOMPARE(size, size_t(original.size()));
+    QCOMPARE(decompressed, original);
+
+    // User agents without zstd still get the file
+    QCOMPARE(fetch(path, QStringLiteral("identity"), &body), QString());
+    QCOMPARE(body, original);
+}
+
+void TestStaticCompressed::testVariantHeaders_data()
+{
+    QTest::addColumn<bool>("manifest");
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QString>("acceptEncoding");
+    QTest::addColumn<QString>("contentEncoding");
+    QTest::addColumn<QString>("etag");
+    QTest::addColumn<QString>("vary");
+    QTest::addColumn<QByteArray>("body");
+
+    const QString pre = Utils::contentETag(QByteArrayLiteral("h1 { font-weight: bold; }\n"));
+    const QString data = Utils::contentETag(QByteArrayLiteral("plain text\n"));
+    for (bool manifest : {false, true}) {
+        const QByteArray prefix = manifest ? "manifest-" : "file-";
+        QTest::newRow(prefix + "pre-compressed") << manifest << QStringLiteral("css/pre.css") << QStringLiteral("gzip")
+                                                 << QStringLiteral("gzip") << QLatin1String("W/\"") + pre + QLatin1Char('"')
+                                                 << QStringLiteral("Accept-Encoding") << QByteArrayLiteral("pre-compressed");
+        QTest::newRow(prefix + "identity") << manifest << QStringLiteral("css/pre.css") << QStringLiteral("identity")
+                                           << QString() << QLatin1Char('"') + pre + QLatin1Char('"')
+                                           << QStringLiteral("Accept-Encoding") << QByteArrayLiteral("h1 { font-weight: bold; }\n");
+        QTest::newRow(prefix + "not-compressible") << manifest << QStringLiteral("data.txt") << QStringLiteral("gzip")
+                                                   << QString() << QLatin1Char('"') + data + QLatin1Char('"')
+                                                   << QString() << QByteArrayLiteral("plain text\n");
+    }
+}
+
+void TestStaticCompressed::testVariantHeaders()
+{
+    QFETCH(bool, manifest);
+    QFETCH(QString, path);
+    QFETCH(QString, acceptEncoding);
+    QFETCH(QString, contentEncoding);
+    QFETCH(QString, etag);
+    QFETCH(QString, vary);
+    QFETCH(QByteArray, body);
+
+    TestEngine *engine = manifest ? m_indexEngine : m_engine;
+    Headers headers;
+    headers.setHeader(QStringLiteral("Accept-Encoding"), acceptEncoding);
+
+    QVariantMap result = request(engine, path, headers);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), body);
+    Headers responseHeaders = result.value(QStringLiteral("headers")).value<Headers>();
+    QCOMPARE(responseHeaders.contentEncoding(), contentEncoding);
+    QCOMPARE(responseHeaders.header(QStringLiteral("ETag")), etag);
+    QCOMPARE(responseHeaders.header(QStringLiteral("Vary")), vary);
+
+    // Revalidations describe the same variant
+    headers.setHeader(QStringLiteral("If-None-Match"), etag);
+    result = request(engine, path, headers);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 304);
+    QVERIFY(result.value(QStringLiteral("body")).toByteArray().isEmpty());
+    responseHeaders = result.value(QStringLiteral("headers")).value<Headers>();
+    QCOMPARE(responseHeaders.header(QStringLiteral("ETag")), etag);
+    QCOMPARE(responseHeaders.header(QStringLiteral("Vary")), vary);
+}
+
+void TestStaticCompressed::testManifestOverwrite()
+{
+    const QString path = QStringLiteral("css/site.css");
+    Headers headers;
+    headers.setHeader(QStringLiteral("Accept-Encoding"), QStringLiteral("identity"));
+    QVariantMap result = request(m_indexEngine, path, headers);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), QByteArrayLiteral("a { color: red; }\n"));
+    const QString oldETag = result.value(QStringLiteral("headers")).value<Headers>().header(QStringLiteral("ETag"));
+
+    // Writing a file does not change its directory, so nothing is rescanned
+    const QByteArray data = QByteArrayLiteral("a { color: blue; text-decoration: none; }\n");
+    QVERIFY(writeFile(QStringLiteral("indexed/css/site.css"), data));
+    const QString etag = QLatin1Char('"') + Utils::contentETag(data) + QLatin1Char('"');
+
+    result = request(m_indexEngine, path, headers);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), data);
+    QCOMPARE(result.value(QStringLiteral("headers")).value<Headers>().header(QStringLiteral("ETag")), etag);
+
+    headers.setHeader(QStringLiteral("If-None-Match"), oldETag);
+    result = request(m_indexEngine, path, headers);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), data);
+
+    headers.setHeader(QStringLiteral("If-None-Match"), etag);
+    result = request(m_indexEngine, path, headers);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 304);
+}
+
+void TestStaticCompressed::testManifestRescan()
+{
+    // Indexed without a pre-compressed variant
+    Headers headers;
+    headers.setHeader(QStringLiteral("Accept-Encoding"), QStringLiteral("gzip"));
+    QVariantMap result = request(m_indexEngine, QStringLiteral("css/late.css"), headers);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QVERIFY(result.value(QStringLiteral("headers")).value<Headers>().contentEncoding().isEmpty());
+
+    // Served from the manifest once the rescan found it
+    QVERIFY(writeFile(QStringLiteral("indexed/css/late.css.gz"), QByteArrayLiteral("late pre-compressed")));
+    QTRY_COMPARE(request(m_indexEngine, QStringLiteral("css/late.css"), headers).value(QStringLiteral("body")).toByteArray(),
+                 QByteArrayLiteral("late pre-compressed"));
+    result = request(m_indexEngine, QStringLiteral("css/late.css"), headers);
+    QCOMPARE(result.value(QStringLiteral("headers")).value<Headers>().contentEncoding(), QStringLiteral("gzip"));
+
+    // Files added or removed are noticed before the rescan
+    QVERIFY(writeFile(QStringLiteral("indexed/css/new.css"), QByteArrayLiteral("span { color: green; }\n")));
+    QVERIFY(QFile::remove(m_dir.path() + QLatin1String("/indexed/css/gone.css")));
+    result = request(m_indexEngine, QStringLiteral("css/new.css"), headers);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), QByteArrayLiteral("span { color: green; }\n"));
+    QVERIFY(request(m_indexEngine, QStringLiteral("css/gone.css"), headers).value(QStringLiteral("statusCode")).toInt() != 200);
+
+    // And after it
+    QTest::qWait(500);
+    result = request(m_indexEngine, QStringLiteral("css/new.css"), headers);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), QByteArrayLiteral("span { color: green; }\n"));
+    QVERIFY(request(m_indexEngine, QStringLiteral("css/gone.css"), headers).value(QStringLiteral("statusCode")).toInt() != 200);
+}
+
+void TestStaticCompressed::testPreCompress()
+{
+    // Compressed in the background after forking, without being requested
+    const QString origPath = m_dir.path() + QLatin1String("/precompress/css/app.css");
+    const QString cachePath = m_dir.path() + QLatin1String("/precompress-cache/") +
+            QString::fromLatin1(QCryptographicHash::hash(origPath.toUtf8(), QCryptographicHash::Md5).toHex());
+    QTRY_VERIFY_WITH_TIMEOUT(QFileInfo::exists(cachePath + QLatin1String(".zst")), 30000);
+    QTRY_VERIFY_WITH_TIMEOUT(QFileInfo::exists(cachePath + QLatin1String(".gz")), 30000);
+
+    // So the first request already gets them
+    Headers headers;
+    headers.setHeader(QStringLiteral("Accept-Encoding"), QStringLiteral("zstd"));
+    QVariantMap result = request(m_preCompressEngine, QStringLiteral("css/app.css"), headers);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(result.value(QStringLiteral("headers")).value<Headers>().contentEncoding(), QStringLiteral("zstd"));
+
+    const QByteArray body = result.value(QStringLiteral("body")).toByteArray();
+    QByteArray decompressed(m_small.size(), Qt::Uninitialized);
+    const size_t size = ZSTD_decompress(decompressed.data(), size_t(decompressed.size()), body.constData(), size_t(body.size()));
+    QVERIFY2(!ZSTD_isError(size), ZSTD_getErrorName(size));
+    QCOMPARE(decompressed, m_small);
+
+    headers.setHeader(QStringLiteral("Accept-Encoding"), QStringLiteral("gzip"));
+    result = request(m_preCompressEngine, QStringLiteral("css/app.css"), headers);
+    QCOMPARE(result.value(QStringLiteral("headers")).value<Headers>().contentEncoding(), QStringLiteral("gzip"));
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray().left(2), QByteArray("\x1f\x8b"));
+}
+
+QTEST_MAIN(TestStaticCompressed)
+
+#include "teststaticcompressed.moc"
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef TESTSTATICFILECACHE_H
+#define TESTSTATICFILECACHE_H
+
+#include <QTest>
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include "coverageobject.h"
+
+#include <Cutelyst/utils.h>
+
+#include "wsgi/staticfilecache.h"
+
+using namespace Cutelyst;
+using namespace CWSGI;
+
+class TestStaticFileCache : public CoverageObject
+{
+    Q_OBJECT
+public:
+    explicit TestStaticFileCache(QObject *parent = nullptr) : CoverageObject(parent) {}
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testHit();
+    void testLargeFile();
+    void testEviction();
+    void testInvalidation();
+    void testChangedBeforeWatched();
+
+private:
+    QTemporaryDir m_dir;
+
+    QString writeFile(const QString &name, const QByteArray &data);
+    StaticFileCache::EntryPtr insert(StaticFileCache *cache, const QString &filename);
+};
+
+void TestStaticFileCache::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+QString TestStaticFileCache::writeFile(const QString &name, const QByteArray &data)
+{
+    const QString filename = m_dir.path() + QLatin1Char('/') + name;
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        return QString();
+    }
+    return filename;
+}
+
+StaticFileCache::EntryPtr TestStaticFileCache::insert(StaticFileCache *cache, const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return StaticFileCache::EntryPtr();
+    }
+    const QFileInfo info(filename);
+    return cache->insert(filename, &file, info.size(), info.lastModified());
+}
+
+void TestStaticFileCache::testHit()
+{
+    StaticFileCache cache(1024 * 1024, 64 * 1024);
+    const QByteArray data = QByteArrayLiteral("body { margin: 0; }\n");
+    const QString filename = writeFile(QStringLiteral("hit.css"), data);
+    QVERIFY(!filename.isEmpty());
+
+    QVERIFY(!cache.entry(filename));
+    const StaticFileCache::EntryPtr inserted = insert(&cache, filename);
+    QVERIFY(inserted);
+    QCOMPARE(inserted->data, data);
+    QCOMPARE(inserted->size, qint64(data.size()));
+    QCOMPARE(inserted->contentType, QStringLiteral("text/css"));
+    QCOMPARE(inserted->etag, Utils::contentETag(data));
+    QCOMPARE(inserted->lastModifiedDateTime, QFileInfo(filename).lastModified());
+    QVERIFY(!inserted->lastModified.isEmpty());
+
+    // Hits share the entry
+    const StaticFileCache::EntryPtr hit = cache.entry(filename);
+    QCOMPARE(hit.data(), inserted.data());
+    QTest::qWait(50);
+    QCOMPARE(cache.entry(filename).data(), inserted.data());
+}
+
+void TestStaticFileCache::testLargeFile()
+{
+    StaticFileCache cache(1024 * 1024, 1024);
+    const QByteArray data(4096, 'x');
+    const QString filename = writeFile(QStringLiteral("large.txt"), data);
+    QVERIFY(!filename.isEmpty());
+
+    // Only the headers are kept, the body is read from the file
+    const StaticFileCache::EntryPtr entry = insert(&cache, filename);
+    QVERIFY(entry);
+    QVERIFY(entry->data.isNull());
+    QCOMPARE(entry->size, qint64(data.size()));
+    QCOMPARE(entry->etag, Utils::contentETag(data));
+    QCOMPARE(cache.entry(filename).data(), entry.data());
+}
+
+void TestStaticFileCache::testEviction()
+{
+    // Costs are whole KiB, each 2 KiB file costs 3 of the 8 available
+    StaticFileCache cache(8 * 1024, 64 * 1024);
+    const QString first = writeFile(QStringLiteral("first.js"), QByteArray(2048, 'a'));
+    const QString second = writeFile(QStringLiteral("second.js"), QByteArray(2048, 'b'));
+    const QString third = writeFile(QStringLiteral("third.js"), QByteArray(2048, 'c'));
+    QVERIFY(insert(&cache, first));
+    QVERIFY(insert(&cache, second));
+
+    // Looking it up makes the first one the most recently used
+    QVERIFY(cache.entry(first));
+    QVERIFY(insert(&cache, third));
+    QVERIFY(cache.entry(first));
+    QVERIFY(!cache.entry(second));
+    QVERIFY(cache.entry(third));
+
+    // Files larger than the whole cache are served but not kept
+    const QString huge = writeFile(QStringLiteral("huge.js"), QByteArray(16 * 1024, 'd'));
+    const StaticFileCache::EntryPtr entry = insert(&cache, huge);
+    QVERIFY(entry);
+    QCOMPARE(entry->data.size(), 16 * 1024);
+    QVERIFY(!cache.entry(huge));
+    QVERIFY(cache.entry(first));
+}
+
+void TestStaticFileCache::testInvalidation()
+{
+    StaticFileCache cache(1024 * 1024, 64 * 1024);
+    const QString filename = writeFile(QStringLiteral("changed.js"), QByteArrayLiteral("var version = 1;\n"));
+    QVERIFY(insert(&cache, filename));
+
+    // Watched once the cache thread runs its event loop
+    QTest::qWait(50);
+    QVERIFY(cache.entry(filename));
+
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QVERIFY(file.write("var version = 22;\n") > 0);
+    file.close();
+
+    QTRY_VERIFY(!cache.entry(filename));
+
+    const StaticFileCache::EntryPtr entry = insert(&cache, filename);
+    QVERIFY(entry);
+    QCOMPARE(entry->data, QByteArrayLiteral("var version = 22;\n"));
+    QCOMPARE(entry->etag, Utils::contentETag(QByteArrayLiteral("var version = 22;\n")));
+}
+
+void TestStaticFileCache::testChangedBeforeWatched()
+{
+    StaticFileCache cache(1024 * 1024, 64 * 1024);
+    const QString filename = writeFile(QStringLiteral("raced.js"), QByteArrayLiteral("var raced = 1;\n"));
+
+    // Inserted with the modification time seen before the file was replaced
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QFileInfo info(filename);
+    QVERIFY(cache.insert(filename, &file, info.size(), info.lastModified().addSecs(-5)));
+    QVERIFY(cache.entry(filename));
+
+    QTRY_VERIFY(!cache.entry(filename));
+}
+
+QTEST_MAIN(TestStaticFileCache)
+
+#include "teststaticfilecache.moc"
+
+#endif
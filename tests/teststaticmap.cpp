@@ -0,0 +1,172 @@
+#ifndef TESTSTATICMAP_H
+#define TESTSTATICMAP_H
+
+#include <QTest>
+#include <QObject>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "headers.h"
+#include "coverageobject.h"
+
+#include <Cutelyst/application.h>
+#include <Cutelyst/headers.h>
+#include <Cutelyst/utils.h>
+
+#include "wsgi/staticmap.h"
+#include "wsgi/staticfilecache.h"
+
+using namespace Cutelyst;
+using namespace CWSGI;
+
+class TestStaticMap : public CoverageObject
+{
+    Q_OBJECT
+public:
+    explicit TestStaticMap(QObject *parent = nullptr) : CoverageObject(parent) {}
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testCacheControl_data();
+    void testCacheControl();
+
+    void testRevalidation_data();
+    void testRevalidation();
+
+    void cleanupTestCase();
+
+private:
+    TestEngine *m_engine = nullptr;
+    TestEngine *m_cachedEngine = nullptr;
+    StaticFileCache *m_cache = nullptr;
+
+    TestEngine* getEngine(StaticFileCache *cache);
+    QVariantMap request(TestEngine *engine, const QString &path, const Headers &headers = Headers());
+
+    QTemporaryDir m_dir;
+};
+
+void TestStaticMap::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    QVERIFY(QDir(m_dir.path()).mkpath(QStringLiteral("static/js")));
+
+    QFile plain(m_dir.path() + QLatin1String("/static/js/app.js"));
+    QVERIFY(plain.open(QIODevice::WriteOnly));
+    QVERIFY(plain.write("var app = 1;\n") > 0);
+
+    QFile fingerprinted(m_dir.path() + QLatin1String("/static/js/app.3f2a9c1d.js"));
+    QVERIFY(fingerprinted.open(QIODevice::WriteOnly));
+    QVERIFY(fingerprinted.write("var app = 2;\n") > 0);
+
+    m_engine = getEngine(nullptr);
+    QVERIFY(m_engine);
+
+    m_cache = new StaticFileCache(1024 * 1024, 64 * 1024, this);
+    m_cachedEngine = getEngine(m_cache);
+    QVERIFY(m_cachedEngine);
+}
+
+TestEngine* TestStaticMap::getEngine(StaticFileCache *cache)
+{
+    auto app = new TestApplication;
+    auto engine = new TestEngine(app, QVariantMap());
+    auto staticMap = new StaticMap(app, cache);
+    staticMap->addStaticMap(QStringLiteral("/static"), m_dir.path() + QLatin1String("/static"), false);
+    staticMap->setImmutablePattern(QStringLiteral("\\.[0-9a-f]{8}\\.(js|css)$"));
+    if (!engine->init()) {
+        return nullptr;
+    }
+    return engine;
+}
+
+QVariantMap TestStaticMap::request(TestEngine *engine, const QString &path, const Headers &headers)
+{
+    return engine->createRequest(QStringLiteral("GET"),
+                                 path,
+                                 QByteArray(),
+                                 headers,
+                                 nullptr);
+}
+
+void TestStaticMap::cleanupTestCase()
+{
+    delete m_engine;
+    delete m_cachedEngine;
+}
+
+void TestStaticMap::testCacheControl_data()
+{
+    QTest::addColumn<bool>("cached");
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QString>("cacheControl");
+
+    for (bool cached : {false, true}) {
+        const QByteArray prefix = cached ? "cached-" : "";
+        QTest::newRow(prefix + "plain") << cached << QStringLiteral("/static/js/app.js")
+                                        << QStringLiteral("public");
+        QTest::newRow(prefix + "fingerprinted") << cached << QStringLiteral("/static/js/app.3f2a9c1d.js")
+                                                << QStringLiteral("public, max-age=31536000, immutable");
+    }
+}
+
+void TestStaticMap::testCacheControl()
+{
+    QFETCH(bool, cached);
+    QFETCH(QString, path);
+    QFETCH(QString, cacheControl);
+
+    const QVariantMap result = request(cached ? m_cachedEngine : m_engine, path);
+    QCOMPARE(result.value(QStringLiteral("statusCode")).toInt(), 200);
+    const Headers headers = result.value(QStringLiteral("headers")).value<Headers>();
+    QCOMPARE(headers.header(QStringLiteral("Cache-Control")), cacheControl);
+}
+
+void TestStaticMap::testRevalidation_data()
+{
+    QTest::addColumn<bool>("cached");
+
+    QTest::newRow("file") << false;
+    QTest::newRow("cached") << true;
+}
+
+void TestStaticMap::testRevalidation()
+{
+    QFETCH(bool, cached);
+    TestEngine *engine = cached ? m_cachedEngine : m_engine;
+    const QString path = QStringLiteral("/static/js/app.js");
+
+    const QVariantMap result = request(engine, path);
+    QCOMPARE(result.value(QStringLiteral("body")).toByteArray(), QByteArrayLiteral("var app = 1;\n"));
+    const Headers headers = result.value(QStringLiteral("headers")).value<Headers>();
+    const QString etag = headers.header(QStringLiteral("ETag"));
+    QVERIFY(!etag.isEmpty());
+    QCOMPARE(etag, QLatin1Char('"') + Utils::contentETag(QByteArrayLiteral("var app = 1;\n")) + QLatin1Char('"'));
+
+    Headers ifNoneMatch;
+    ifNoneMatch.setHeader(QStringLiteral("If-None-Match"), etag);
+    QVariantMap revalidated = request(engine, path, ifNoneMatch);
+    QCOMPARE(revalidated.value(QStringLiteral("statusCode")).toInt(), 304);
+    QVERIFY(revalidated.value(QStringLiteral("body")).toByteArray().isEmpty());
+    QCOMPARE(revalidated.value(QStringLiteral("headers")).value<Headers>().header(QStringLiteral("ETag")), etag);
+
+    Headers ifModifiedSince;
+    ifModifiedSince.setHeader(QStringLiteral("If-Modified-Since"), headers.header(QStringLiteral("Last-Modified")));
+    revalidated = request(engine, path, ifModifiedSince);
+    QCOMPARE(revalidated.value(QStringLiteral("statusCode")).toInt(), 304);
+    QCOMPARE(revalidated.value(QStringLiteral("headers")).value<Headers>().header(QStringLiteral("ETag")), etag);
+
+    // A different tag gets the file
+    ifNoneMatch.setHeader(QStringLiteral("If-None-Match"), QStringLiteral("\"other\""));
+    revalidated = request(engine, path, ifNoneMatch);
+    QCOMPARE(revalidated.value(QStringLiteral("statusCode")).toInt(), 200);
+    QCOMPARE(revalidated.value(QStringLiteral("body")).toByteArray(), QByteArrayLiteral("var app = 1;\n"));
+}
+
+QTEST_MAIN(TestStaticMap)
+
+#include "teststaticmap.moc"
+
+#endif
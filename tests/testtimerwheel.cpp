@@ -0,0 +1,203 @@
+#ifndef TESTTIMERWHEEL_H
+#define TESTTIMERWHEEL_H
+
+#include <QTest>
+#include <QObject>
+#include <QElapsedTimer>
+
+#include <functional>
+
+#include "coverageobject.h"
+
+#include "wsgi/timerwheel.h"
+
+using namespace CWSGI;
+
+class TestNode : public TimerWheelNode
+{
+public:
+    TestNode(int id, QVector<int> *expired) : m_id(id), m_expired(expired) {}
+
+    std::function<void()> onExpired;
+
+protected:
+    virtual void timerWheelExpired() override {
+        m_expired->append(m_id);
+        if (onExpired) {
+            onExpired();
+        }
+    }
+
+private:
+    int m_id;
+    QVector<int> *m_expired;
+};
+
+class TestTimerWheel : public CoverageObject
+{
+    Q_OBJECT
+public:
+    explicit TestTimerWheel(QObject *parent = nullptr) : CoverageObject(parent) {}
+
+private Q_SLOTS:
+    void testExpiryOrder();
+    void testWrapAround();
+    void testRearm();
+    void testCancel();
+    void testCancelWhileExpiring();
+    void testRearmWhileExpiring();
+};
+
+void TestTimerWheel::testExpiryOrder()
+{
+    TimerWheel wheel(5);
+    QVector<int> expired;
+    TestNode first(1, &expired);
+    TestNode second(2, &expired);
+    TestNode third(3, &expired);
+
+    wheel.start(&third, 150);
+    wheel.start(&first, 50);
+    wheel.start(&second, 100);
+    QCOMPARE(wheel.count(), 3);
+    QVERIFY(first.isTimerArmed());
+
+    QTRY_COMPARE(expired.size(), 3);
+    QCOMPARE(expired, QVector<int>({1, 2, 3}));
+    QCOMPARE(wheel.count(), 0);
+    QVERIFY(!first.isTimerArmed());
+}
+
+void TestTimerWheel::testWrapAround()
+{
+    // With 1 ms ticks the wheel turns every 512 ms, so both
+    // nodes hash to the same slot one round apart
+    TimerWheel wheel(1);
+    QVector<int> expired;
+    TestNode near(1, &expired);
+    TestNode far(2, &expired);
+
+    QElapsedTimer timer;
+    timer.start();
+    wheel.start(&far, 600);
+    wheel.start(&near, 88);
+
+    QTRY_COMPARE(expired, QVector<int>({1}));
+    QVERIFY(far.isTimerArmed());
+    QCOMPARE(wheel.count(), 1);
+
+    QTRY_COMPARE(expired, QVector<int>({1, 2}));
+    QVERIFY(timer.elapsed() >= 600);
+
+    // Deadlines of more than one round still wait for all of them
+    timer.restart();
+    wheel.start(&far, 1300);
+    QTest::qWait(800);
+    QVERIFY(far.isTimerArmed());
+    QTRY_COMPARE_WITH_TIMEOUT(expired.size(), 3, 5000);
+    QVERIFY(timer.elapsed() >= 1300);
+}
+
+void TestTimerWheel::testRearm()
+{
+    TimerWheel wheel(5);
+    QVector<int> expired;
+    TestNode node(1, &expired);
+
+    QElapsedTimer timer;
+    timer.start();
+    wheel.start(&node, 50);
+    wheel.start(&node, 300);
+    QCOMPARE(wheel.count(), 1);
+
+    QTest::qWait(150);
+    QVERIFY(expired.isEmpty());
+    QVERIFY(node.isTimerArmed());
+
+    QTRY_COMPARE(expired.size(), 1);
+    QVERIFY(timer.elapsed() >= 300);
+
+    // Expired only once
+    QTest::qWait(100);
+    QCOMPARE(expired.size(), 1);
+}
+
+void TestTimerWheel::testCancel()
+{
+    TimerWheel wheel(5);
+    QVector<int> expired;
+    TestNode cancelled(1, &expired);
+    TestNode kept(2, &expired);
+
+    wheel.start(&cancelled, 50);
+    wheel.start(&kept, 100);
+    wheel.cancel(&cancelled);
+    QVERIFY(!cancelled.isTimerArmed());
+    QCOMPARE(wheel.count(), 1);
+
+    {
+        // Destroyed nodes cancel themselves
+        TestNode destroyed(3, &expired);
+        wheel.start(&destroyed, 50);
+        QCOMPARE(wheel.count(), 2);
+    }
+    QCOMPARE(wheel.count(), 1);
+
+    QTRY_COMPARE(expired, QVector<int>({2}));
+    QTest::qWait(50);
+    QCOMPARE(expired, QVector<int>({2}));
+
+    // Cancelling an unarmed node does nothing
+    wheel.cancel(&cancelled);
+    QCOMPARE(wheel.count(), 0);
+}
+
+void TestTimerWheel::testCancelWhileExpiring()
+{
+    // Both expire on the same tick, whichever runs first cancels the other
+    TimerWheel wheel(50);
+    QVector<int> expired;
+    TestNode first(1, &expired);
+    TestNode second(2, &expired);
+    first.onExpired = [&wheel, &second] { wheel.cancel(&second); };
+    second.onExpired = [&wheel, &first] { wheel.cancel(&first); };
+
+    wheel.start(&first, 50);
+    wheel.start(&second, 50);
+
+    QTRY_COMPARE(expired.size(), 1);
+    QTest::qWait(150);
+    QCOMPARE(expired.size(), 1);
+    QCOMPARE(wheel.count(), 0);
+}
+
+void TestTimerWheel::testRearmWhileExpiring()
+{
+    TimerWheel wheel(5);
+    QVector<int> expired;
+    TestNode node(1, &expired);
+    TestNode other(2, &expired);
+
+    // A node re-arming itself and another one from its expiration
+    node.onExpired = [&wheel, &node, &other, &expired] {
+        if (expired.size() < 3) {
+            wheel.start(&node, 20);
+        }
+        if (!other.isTimerArmed() && expired.count(2) == 0) {
+            wheel.start(&other, 200);
+        }
+    };
+    wheel.start(&node, 20);
+
+    QTRY_COMPARE(expired.count(1), 3);
+    QVERIFY(other.isTimerArmed());
+    QTRY_COMPARE(expired.count(2), 1);
+    QCOMPARE(expired.count(1), 3);
+    QCOMPARE(wheel.count(), 0);
+}
+
+QTEST_MAIN(TestTimerWheel)
+
+#include "testtimerwheel.moc"
+
+#endif
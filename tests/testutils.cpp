@@ -0,0 +1,250 @@
+#ifndef UTILSTEST_H
+#define UTILSTEST_H
+
+#include <QtTest/QTest>
+#include <QtCore/QObject>
+#include <QtCore/QBuffer>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QDir>
+#include <QtCore/QMimeDatabase>
+
+#include "coverageobject.h"
+
+#include <Cutelyst/utils.h>
+
+using namespace Cutelyst;
+
+class TestUtils : public CoverageObject
+{
+    Q_OBJECT
+public:
+    explicit TestUtils(QObject *parent = nullptr) : CoverageObject(parent) {}
+
+private Q_SLOTS:
+    void testCleanRelativePath_data();
+    void testCleanRelativePath();
+
+    void testCleanRelativePathShared();
+
+    void testFileContentETagDevice();
+
+    void testCachedFileContentETag();
+
+    void testStaticFileCacheControl_data();
+    void testStaticFileCacheControl();
+
+    void testMimeTypeForFile_data();
+    void testMimeTypeForFile();
+
+    void testMimeTypeOnDemand();
+
+    void testRegisterMimeTypes();
+};
+
+void TestUtils::testCleanRelativePath_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QString>("output");
+    QTest::addColumn<bool>("refused");
+
+    QTest::newRow("empty") << QString() << QStringLiteral("") << false;
+    QTest::newRow("clean") << QStringLiteral("css/style.css") << QStringLiteral("css/style.css") << false;
+    QTest::newRow("leading-slash") << QStringLiteral("/css/style.css") << QStringLiteral("css/style.css") << false;
+    QTest::newRow("trailing-slash") << QStringLiteral("css/") << QStringLiteral("css") << false;
+    QTest::newRow("double-slash") << QStringLiteral("css//style.css") << QStringLiteral("css/style.css") << false;
+    QTest::newRow("dot-prefix") << QStringLiteral("./css/style.css") << QStringLiteral("css/style.css") << false;
+    QTest::newRow("dot-middle") << QStringLiteral("css/./style.css") << QStringLiteral("css/style.css") << false;
+    QTest::newRow("dot-only") << QStringLiteral(".") << QStringLiteral("") << false;
+    QTest::newRow("dots-in-name") << QStringLiteral("css/..style.css") << QStringLiteral("css/..style.css") << false;
+    QTest::newRow("dot-dot") << QStringLiteral("..") << QString() << true;
+    QTest::newRow("dot-dot-prefix") << QStringLiteral("../etc/passwd") << QString() << true;
+    QTest::newRow("dot-dot-middle") << QStringLiteral("css/../../etc/passwd") << QString() << true;
+    QTest::newRow("dot-dot-suffix") << QStringLiteral("css/..") << QString() << true;
+    QTest::newRow("nul") << (QStringLiteral("style.css") + QChar(0) + QStringLiteral(".png")) << QString() << true;
+}
+
+void TestUtils::testCleanRelativePath()
+{
+    QFETCH(QString, path);
+    QFETCH(QString, output);
+    QFETCH(bool, refused);
+
+    const QString result = Utils::cleanRelativePath(path);
+    QCOMPARE(result.isNull(), refused);
+    QCOMPARE(result, output);
+
+    // Percent encoded paths are only checked after they are decoded
+    QString encoded = path;
+    encoded.replace(QLatin1Char('.'), QLatin1String("%2e"));
+    encoded.replace(QChar(0), QLatin1String("%00"));
+    const QString decoded = Utils::decodePercentEncoding(&encoded);
+    QCOMPARE(decoded, path);
+    QCOMPARE(Utils::cleanRelativePath(decoded).isNull(), refused);
+    QCOMPARE(Utils::cleanRelativePath(decoded), output);
+}
+
+void TestUtils::testCleanRelativePathShared()
+{
+    // Already clean paths are not copied
+    const QString path = QStringLiteral("css/style.css").repeated(2);
+    const QString result = Utils::cleanRelativePath(path);
+    QCOMPARE(result, path);
+    QCOMPARE(result.constData(), path.constData());
+}
+
+void TestUtils::testFileContentETagDevice()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QVERIFY(file.write("body { margin: 0; }\n") > 0);
+    QVERIFY(file.flush());
+
+    const QDateTime lastModified = QDateTime::fromMSecsSinceEpoch(1000);
+    const QString etag = Utils::contentETag(QByteArrayLiteral("body { margin: 0; }\n"));
+
+    // The tag comes from the device even if the path points to something else now
+    QBuffer buffer;
+    buffer.setData(QByteArrayLiteral("body { margin: 0; }\n"));
+    QVERIFY(buffer.open(QBuffer::ReadOnly));
+    QCOMPARE(Utils::fileContentETag(file.fileName() + QLatin1String(".missing"), lastModified, buffer.size(), &buffer), etag);
+    QCOMPARE(buffer.pos(), qint64(0));
+
+    QCOMPARE(Utils::fileContentETag(file.fileName(), lastModified.addSecs(1), file.size()), etag);
+}
+
+void TestUtils::testCachedFileContentETag()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QVERIFY(file.write("html { color: black; }\n") > 0);
+    QVERIFY(file.flush());
+
+    const QDateTime lastModified = QDateTime::fromMSecsSinceEpoch(2000);
+    QCOMPARE(Utils::cachedFileContentETag(file.fileName(), lastModified, file.size()), QString());
+
+    const QString etag = Utils::fileContentETag(file.fileName(), lastModified, file.size());
+    QCOMPARE(etag, Utils::contentETag(QByteArrayLiteral("html { color: black; }\n")));
+    QCOMPARE(Utils::cachedFileContentETag(file.fileName(), lastModified, file.size()), etag);
+
+    // Other versions of the file are not known
+    QCOMPARE(Utils::cachedFileContentETag(file.fileName(), lastModified.addSecs(1), file.size()), QString());
+    QCOMPARE(Utils::cachedFileContentETag(file.fileName(), lastModified, file.size() + 1), QString());
+
+    // Large files are never hashed
+    const qint64 large = 1024 * 1024;
+    QCOMPARE(Utils::cachedFileContentETag(file.fileName(), lastModified, large),
+             Utils::fileContentETag(file.fileName(), lastModified, large));
+    QVERIFY(!Utils::cachedFileContentETag(file.fileName(), lastModified, large).isEmpty());
+}
+
+void TestUtils::testStaticFileCacheControl_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<bool>("immutable");
+
+    const QString fingerprint = QStringLiteral("\\.[0-9a-f]{8}\\.(js|css)$");
+    QTest::newRow("no-pattern") << QString() << QStringLiteral("js/app.3f2a9c1d.js") << false;
+    QTest::newRow("fingerprinted-js") << fingerprint << QStringLiteral("js/app.3f2a9c1d.js") << true;
+    QTest::newRow("fingerprinted-css") << fingerprint << QStringLiteral("/static/css/site.0123abcd.css") << true;
+    QTest::newRow("plain") << fingerprint << QStringLiteral("js/app.js") << false;
+    QTest::newRow("short-hash") << fingerprint << QStringLiteral("js/app.3f2a.js") << false;
+    QTest::newRow("other-suffix") << fingerprint << QStringLiteral("img/logo.3f2a9c1d.png") << false;
+    QTest::newRow("directory") << QStringLiteral("^/?assets/") << QStringLiteral("assets/logo.png") << true;
+}
+
+void TestUtils::testStaticFileCacheControl()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QString, path);
+    QFETCH(bool, immutable);
+
+    const QRegularExpression re(pattern);
+    QVERIFY(re.isValid());
+    QCOMPARE(Utils::staticFileCacheControl(re, path),
+             immutable ? QStringLiteral("public, max-age=31536000, immutable") : QStringLiteral("public"));
+}
+
+void TestUtils::testMimeTypeForFile_data()
+{
+    QTest::addColumn<QString>("filename");
+    QTest::addColumn<QString>("mimeType");
+
+    QTest::newRow("css") << QStringLiteral("/static/css/site.css") << QStringLiteral("text/css");
+    QTest::newRow("html") << QStringLiteral("index.html") << QStringLiteral("text/html");
+    QTest::newRow("png") << QStringLiteral("img/logo.png") << QStringLiteral("image/png");
+    QTest::newRow("map") << QStringLiteral("js/app.js.map") << QStringLiteral("application/json");
+    QTest::newRow("wasm") << QStringLiteral("app.wasm") << QStringLiteral("application/wasm");
+    QTest::newRow("webmanifest") << QStringLiteral("site.webmanifest") << QStringLiteral("application/manifest+json");
+    QTest::newRow("mjs") << QStringLiteral("module.mjs") << Utils::mimeTypeForFile(QStringLiteral("module.js"));
+    QTest::newRow("no-suffix") << QStringLiteral("static/README") << QStringLiteral("application/octet-stream");
+}
+
+void TestUtils::testMimeTypeForFile()
+{
+    QFETCH(QString, filename);
+    QFETCH(QString, mimeType);
+
+    QCOMPARE(Utils::mimeTypeForFile(filename), mimeType);
+}
+
+void TestUtils::testMimeTypeOnDemand()
+{
+    // Extensions missing from the table agree with QMimeDatabase and stay stable
+    QMimeDatabase db;
+    const QString odt = db.mimeTypeForFile(QStringLiteral("file.odt"), QMimeDatabase::MatchExtension).name();
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("doc/manual.odt")), odt);
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("doc/other.odt")), odt);
+
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("file.cutelyst-unknown")), QStringLiteral("application/octet-stream"));
+
+    // Far more unknown extensions than are cached still resolve
+    for (int i = 0; i < 1000; ++i) {
+        QCOMPARE(Utils::mimeTypeForFile(QLatin1String("file.unknown") + QString::number(i)),
+                 QStringLiteral("application/octet-stream"));
+    }
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("doc/manual.odt")), odt);
+}
+
+void TestUtils::testRegisterMimeTypes()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(QDir(dir.path()).mkpath(QStringLiteral("fonts")));
+    QFile font(dir.path() + QLatin1String("/fonts/icons.otc"));
+    QVERIFY(font.open(QIODevice::WriteOnly));
+    font.close();
+
+    QMimeDatabase db;
+    const QString otc = db.mimeTypeForFile(QStringLiteral("file.otc"), QMimeDatabase::MatchExtension).name();
+    Utils::registerMimeTypes({dir.path()});
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("fonts/icons.otc")), otc);
+
+    // Overrides win over the database and what was resolved on demand
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("file.odg")),
+             db.mimeTypeForFile(QStringLiteral("file.odg"), QMimeDatabase::MatchExtension).name());
+    Utils::registerMimeTypes(QStringList(), {
+                                 {QStringLiteral("*.ODG"), QStringLiteral("application/x-cutelyst-drawing")},
+                                 {QStringLiteral(".cutelyst"), QStringLiteral("application/x-cutelyst")},
+                                 {QStringLiteral("css"), QStringLiteral("text/x-cutelyst-css")}
+                             });
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("file.odg")), QStringLiteral("application/x-cutelyst-drawing"));
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("file.cutelyst")), QStringLiteral("application/x-cutelyst"));
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("site.css")), QStringLiteral("text/x-cutelyst-css"));
+
+    // Overrides survive later registrations, directories are only walked once
+    Utils::registerMimeTypes({dir.path()});
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("site.css")), QStringLiteral("text/x-cutelyst-css"));
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("fonts/icons.otc")), otc);
+
+    Utils::registerMimeTypes(QStringList(), {{QStringLiteral("css"), QStringLiteral("text/css")}});
+    QCOMPARE(Utils::mimeTypeForFile(QStringLiteral("site.css")), QStringLiteral("text/css"));
+}
+
+QTEST_MAIN(TestUtils)
+
+#include "testutils.moc"
+
+#endif
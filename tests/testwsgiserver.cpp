@@ -0,0 +1,354 @@
+#ifndef TESTWSGISERVER_H
+#define TESTWSGISERVER_H
+
+#include <QTest>
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QSignalSpy>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "headers.h"
+#include "coverageobject.h"
+
+#include <Cutelyst/application.h>
+#include <Cutelyst/controller.h>
+#include <Cutelyst/headers.h>
+#include <Cutelyst/request.h>
+#include <Cutelyst/response.h>
+#include <Cutelyst/utils.h>
+
+#include "wsgi/wsgi.h"
+#include "wsgi/staticmap.h"
+
+using namespace Cutelyst;
+using namespace CWSGI;
+
+class WsgiServerTest : public Controller
+{
+    Q_OBJECT
+public:
+    explicit WsgiServerTest(QObject *parent) : Controller(parent) {}
+
+    C_ATTR(echo, :Local)
+    void echo(Context *c) {
+        QIODevice *body = c->request()->body();
+        c->response()->setBody(QByteArray::number(body ? body->size() : 0));
+    }
+};
+
+class WsgiServerApplication : public Application
+{
+    Q_OBJECT
+public:
+    explicit WsgiServerApplication(QObject *parent = nullptr) : Application(parent) {}
+
+    virtual bool init() override {
+        new WsgiServerTest(this);
+        return true;
+    }
+};
+
+class TestWsgiServer : public CoverageObject
+{
+    Q_OBJECT
+public:
+    explicit TestWsgiServer(QObject *parent = nullptr) : CoverageObject(parent) {}
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testMaxConnectionsPerIp();
+    void testBodyMinRate();
+
+    void testStaticFastPath_data();
+    void testStaticFastPath();
+
+    void cleanupTestCase();
+
+private:
+    WSGI *m_wsgi = nullptr;
+    WsgiServerApplication *m_app = nullptr;
+    quint16 m_port = 0;
+    int m_appRequests = 0;
+
+    // Serves the same static map through the application
+    TestEngine *m_staticEngine = nullptr;
+    QTemporaryDir m_dir;
+
+    bool connectToServer(QTcpSocket *socket);
+    // Reads a response without blocking the event loop the server runs on
+    static QByteArray readResponse(QTcpSocket *socket, bool head = false);
+    QByteArray get(QTcpSocket *socket, const QByteArray &path);
+    static int parseResponse(const QByteArray &response, Headers *headers, QByteArray *body);
+};
+
+void TestWsgiServer::initTestCase()
+{
+    // The server refuses ports above 35554
+    QTcpServer probe;
+    for (quint16 port = 20000 + quint16(QCoreApplication::applicationPid() % 10000); port < 35000; ++port) {
+        if (probe.listen(QHostAddress::LocalHost, port)) {
+            m_port = port;
+            probe.close();
+            break;
+        }
+    }
+    QVERIFY(m_port);
+
+    QVERIFY(m_dir.isValid());
+    const QString staticDir = m_dir.path() + QLatin1String("/static");
+    QVERIFY(QDir(m_dir.path()).mkpath(QStringLiteral("static/js")));
+    QFile script(staticDir + QLatin1String("/js/app.js"));
+    QVERIFY(script.open(QIODevice::WriteOnly));
+    QVERIFY(script.write("var app = 1;\n") > 0);
+    script.close();
+    // Above what the protocols send without the application
+    QFile large(staticDir + QLatin1String("/large.txt"));
+    QVERIFY(large.open(QIODevice::WriteOnly));
+    QVERIFY(large.write(QByteArray(STATIC_REPLY_MAX_SIZE + 1024, 'x')) > 0);
+    large.close();
+
+    auto staticApp = new TestApplication;
+    m_staticEngine = new TestEngine(staticApp, QVariantMap());
+    auto staticMap = new StaticMap(staticApp);
+    staticMap->addStaticMap(QStringLiteral("/static"), staticDir, false);
+    QVERIFY(m_staticEngine->init());
+
+    m_wsgi = new WSGI(this);
+    m_wsgi->setHttpSocket({QStringLiteral("127.0.0.1:") + QString::number(m_port)});
+    m_wsgi->setThreads(QStringLiteral("1"));
+    m_wsgi->setMaxConnectionsPerIp(2);
+    m_wsgi->setBodyMinRate(1000);
+    m_wsgi->setStaticMap({QStringLiteral("/static=") + staticDir});
+    m_wsgi->setStaticMapFastPath(true);
+
+    m_app = new WsgiServerApplication;
+    QVERIFY(m_wsgi->start(m_app));
+    connect(m_app, &Application::beforePrepareAction, this, [this] {
+        ++m_appRequests;
+    });
+
+    QTcpSocket socket;
+    QVERIFY(connectToServer(&socket));
+    QVERIFY(get(&socket, "/wsgi/server/test/echo").startsWith("HTTP/1.1 200"));
+    socket.disconnectFromHost();
+    QTRY_COMPARE(socket.state(), QAbstractSocket::UnconnectedState);
+    QTest::qWait(100);
+}
+
+void TestWsgiServer::cleanupTestCase()
+{
+    QSignalSpy stopped(m_wsgi, &WSGI::stopped);
+    m_wsgi->stop();
+    QTRY_COMPARE(stopped.count(), 1);
+    delete m_wsgi;
+    delete m_app;
+    delete m_staticEngine;
+}
+
+bool TestWsgiServer::connectToServer(QTcpSocket *socket)
+{
+    socket->connectToHost(QHostAddress::LocalHost, m_port);
+    QElapsedTimer timer;
+    timer.start();
+    while (socket->state() != QAbstractSocket::ConnectedState && timer.elapsed() < 5000) {
+        QTest::qWait(10);
+    }
+    return socket->state() == QAbstractSocket::ConnectedState;
+}
+
+QByteArray TestWsgiServer::readResponse(QTcpSocket *socket, bool head)
+{
+    QByteArray response;
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < 5000) {
+        response.append(socket->readAll());
+        const int headerEnd = response.indexOf("\r\n\r\n");
+        if (headerEnd != -1) {
+            int length = 0;
+            const int pos = response.toLower().indexOf("\r\ncontent-length: ");
+            if (!head && pos != -1 && pos < headerEnd) {
+                const int start = pos + 18;
+                length = response.mid(start, response.indexOf("\r\n", start) - start).toInt();
+            }
+            if (response.size() >= headerEnd + 4 + length) {
+                return response;
+            }
+        }
+
+        if (socket->state() != QAbstractSocket::ConnectedState && !socket->bytesAvailable()) {
+            break;
+        }
+        QTest::qWait(10);
+    }
+    return response;
+}
+
+QByteArray TestWsgiServer::get(QTcpSocket *socket, const QByteArray &path)
+{
+    socket->write("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    return readResponse(socket);
+}
+
+int TestWsgiServer::parseResponse(const QByteArray &response, Headers *headers, QByteArray *body)
+{
+    const int headerEnd = response.indexOf("\r\n\r\n");
+    if (headerEnd == -1) {
+        return 0;
+    }
+
+    const QList<QByteArray> lines = response.left(headerEnd).split('\n');
+    for (int i = 1; i < lines.size(); ++i) {
+        const QByteArray line = lines.at(i).trimmed();
+        const int colon = line.indexOf(':');
+        if (colon != -1) {
+            headers->setHeader(QString::fromLatin1(line.left(colon)), QString::fromLatin1(line.mid(colon + 1).trimmed()));
+        }
+    }
+    *body = response.mid(headerEnd + 4);
+    return lines.first().split(' ').value(1).toInt();
+}
+
+void TestWsgiServer::testMaxConnectionsPerIp()
+{
+    QTcpSocket first;
+    QTcpSocket second;
+    QVERIFY(connectToServer(&first));
+    QVERIFY(get(&first, "/wsgi/server/test/echo").startsWith("HTTP/1.1 200"));
+    QVERIFY(connectToServer(&second));
+    QVERIFY(get(&second, "/wsgi/server/test/echo").startsWith("HTTP/1.1 200"));
+
+    // The third connection of the address is closed without an answer
+    QTcpSocket third;
+    third.connectToHost(QHostAddress::LocalHost, m_port);
+    QTRY_COMPARE(third.state(), QAbstractSocket::UnconnectedState);
+    QVERIFY(third.readAll().isEmpty());
+
+    // The kept connections still work
+    QVERIFY(get(&first, "/wsgi/server/test/echo").startsWith("HTTP/1.1 200"));
+
+    // Once one of them is gone another one is accepted
+    second.disconnectFromHost();
+    QTRY_COMPARE(second.state(), QAbstractSocket::UnconnectedState);
+    QTest::qWait(100);
+
+    QTcpSocket fourth;
+    QVERIFY(connectToServer(&fourth));
+    QVERIFY(get(&fourth, "/wsgi/server/test/echo").startsWith("HTTP/1.1 200"));
+
+    first.disconnectFromHost();
+    fourth.disconnectFromHost();
+    QTRY_COMPARE(first.state(), QAbstractSocket::UnconnectedState);
+    QTRY_COMPARE(fourth.state(), QAbstractSocket::UnconnectedState);
+    QTest::qWait(100);
+}
+
+void TestWsgiServer::testBodyMinRate()
+{
+    // A body sent at once is well above the rate
+    QTcpSocket fast;
+    QVERIFY(connectToServer(&fast));
+    const QByteArray body(20000, 'x');
+    fast.write("POST /wsgi/server/test/echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: 20000\r\n\r\n" + body);
+    const QByteArray response = readResponse(&fast);
+    QVERIFY(response.startsWith("HTTP/1.1 200"));
+    QVERIFY(response.endsWith("\r\n\r\n20000"));
+    fast.disconnectFromHost();
+
+    // 20 bytes in more than a second is below 1000 bytes per second
+    QTcpSocket slow;
+    QVERIFY(connectToServer(&slow));
+    slow.write("POST /wsgi/server/test/echo HTTP/1.1\r\nHost: localhost\r\nContent-Length: 20000\r\n\r\n" + body.left(10));
+    QTest::qWait(1200);
+    QCOMPARE(slow.state(), QAbstractSocket::ConnectedState);
+    slow.write(body.left(10));
+    QTRY_COMPARE(slow.state(), QAbstractSocket::UnconnectedState);
+    QVERIFY(slow.readAll().isEmpty());
+}
+
+void TestWsgiServer::testStaticFastPath_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QString>("header");
+    QTest::addColumn<QString>("value");
+    QTest::addColumn<bool>("fastPath");
+
+    const QString script = QStringLiteral("/static/js/app.js");
+    const QString etag = QLatin1Char('"') + Utils::contentETag(QByteArrayLiteral("var app = 1;\n")) + QLatin1Char('"');
+    QTest::newRow("get") << QStringLiteral("GET") << script << QString() << QString() << true;
+    QTest::newRow("head") << QStringLiteral("HEAD") << script << QString() << QString() << true;
+    QTest::newRow("if-none-match") << QStringLiteral("GET") << script << QStringLiteral("If-None-Match") << etag << true;
+    QTest::newRow("if-none-match-other") << QStringLiteral("GET") << script << QStringLiteral("If-None-Match") << QStringLiteral("\"other\"") << true;
+    QTest::newRow("if-modified-since") << QStringLiteral("GET") << script << QStringLiteral("If-Modified-Since")
+                                       << QStringLiteral("Fri, 01 Jan 2100 00:00:00 GMT") << true;
+    QTest::newRow("range") << QStringLiteral("GET") << script << QStringLiteral("Range") << QStringLiteral("bytes=4-6") << false;
+    QTest::newRow("large") << QStringLiteral("GET") << QStringLiteral("/static/large.txt") << QString() << QString() << false;
+    QTest::newRow("large-head") << QStringLiteral("HEAD") << QStringLiteral("/static/large.txt") << QString() << QString() << true;
+}
+
+void TestWsgiServer::testStaticFastPath()
+{
+    QFETCH(QString, method);
+    QFETCH(QString, path);
+    QFETCH(QString, header);
+    QFETCH(QString, value);
+    QFETCH(bool, fastPath);
+
+    Headers requestHeaders;
+    QByteArray request = method.toLatin1() + ' ' + path.toLatin1() + " HTTP/1.1\r\nHost: localhost\r\n";
+    if (!header.isEmpty()) {
+        requestHeaders.setHeader(header, value);
+        request += header.toLatin1() + ": " + value.toLatin1() + "\r\n";
+    }
+
+    const QVariantMap expected = m_staticEngine->createRequest(method, path, QByteArray(), requestHeaders, nullptr);
+    const Headers expectedHeaders = expected.value(QStringLiteral("headers")).value<Headers>();
+    const int expectedStatus = expected.value(QStringLiteral("statusCode")).toInt();
+    QVERIFY(expectedStatus == 200 || expectedStatus == 206 || expectedStatus == 304);
+
+    QTcpSocket socket;
+    QVERIFY(connectToServer(&socket));
+    const int appRequests = m_appRequests;
+    socket.write(request + "\r\n");
+    const QByteArray response = readResponse(&socket, method == QLatin1String("HEAD"));
+    QCOMPARE(m_appRequests - appRequests, fastPath ? 0 : 1);
+
+    Headers headers;
+    QByteArray body;
+    QCOMPARE(parseResponse(response, &headers, &body), expectedStatus);
+    if (method == QLatin1String("HEAD")) {
+        QVERIFY(body.isEmpty());
+    } else {
+        QCOMPARE(body, expected.value(QStringLiteral("body")).toByteArray());
+    }
+
+    const QStringList compared = {
+        QStringLiteral("ETag"),
+        QStringLiteral("Last-Modified"),
+        QStringLiteral("Content-Type"),
+        QStringLiteral("Content-Length"),
+        QStringLiteral("Content-Range"),
+        QStringLiteral("Accept-Ranges"),
+        QStringLiteral("Cache-Control"),
+    };
+    for (const QString &name : compared) {
+        QCOMPARE(headers.header(name), expectedHeaders.header(name));
+    }
+
+    socket.disconnectFromHost();
+    QTRY_COMPARE(socket.state(), QAbstractSocket::UnconnectedState);
+    QTest::qWait(100);
+}
+
+QTEST_MAIN(TestWsgiServer)
+
+#include "testwsgiserver.moc"
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef WSGISOCKETTEST_H
+#define WSGISOCKETTEST_H
+
+#include <QTest>
+#include <QObject>
+
+#include "coverageobject.h"
+
+#include "wsgi/socket.h"
+
+using namespace CWSGI;
+
+class TestWsgiSocket : public CoverageObject
+{
+    Q_OBJECT
+public:
+    explicit TestWsgiSocket(QObject *parent = nullptr) : CoverageObject(parent) {}
+
+private Q_SLOTS:
+    void testTimeoutFor_data();
+    void testTimeoutFor();
+};
+
+void TestWsgiSocket::testTimeoutFor_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("state");
+    QTest::addColumn<int>("bufSize");
+    QTest::addColumn<int>("timeout");
+
+    // HTTP/1, only the request and header lines have a fixed deadline
+    QTest::newRow("http1-idle") << int(Protocol::Http11) << int(ProtocolData::MethodLine) << 0
+                                << int(Socket::TimeoutKeepAlive);
+    QTest::newRow("http1-method-line") << int(Protocol::Http11) << int(ProtocolData::MethodLine) << 10
+                                       << int(Socket::TimeoutHeader);
+    QTest::newRow("http1-header-line") << int(Protocol::Http11) << int(ProtocolData::HeaderLine) << 0
+                                       << int(Socket::TimeoutHeader);
+    QTest::newRow("http1-header-line-partial") << int(Protocol::Http11) << int(ProtocolData::HeaderLine) << 10
+                                               << int(Socket::TimeoutHeader);
+    QTest::newRow("http1-body") << int(Protocol::Http11) << int(ProtocolData::ContentBody) << 0
+                                << int(Socket::TimeoutBody);
+
+    // HTTP/2, a partial frame might be part of a long upload
+    QTest::newRow("http2-preface") << int(Protocol::Http2) << int(ProtocolData::MethodLine) << 10
+                                   << int(Socket::TimeoutBody);
+    QTest::newRow("http2-idle") << int(Protocol::Http2) << int(ProtocolData::H2Frames) << 0
+                                << int(Socket::TimeoutKeepAlive);
+    QTest::newRow("http2-partial-frame") << int(Protocol::Http2) << int(ProtocolData::H2Frames) << 10
+                                         << int(Socket::TimeoutBody);
+
+    // FastCGI, a partial record might be part of a slow body
+    QTest::newRow("fastcgi-idle") << int(Protocol::FastCGI1) << int(ProtocolData::MethodLine) << 0
+                                  << int(Socket::TimeoutKeepAlive);
+    QTest::newRow("fastcgi-partial-record") << int(Protocol::FastCGI1) << int(ProtocolData::MethodLine) << 10
+                                            << int(Socket::TimeoutBody);
+    QTest::newRow("fastcgi-body") << int(Protocol::FastCGI1) << int(ProtocolData::ContentBody) << 10
+                                  << int(Socket::TimeoutBody);
+
+    // Upgraded websocket connections
+    QTest::newRow("websocket-idle") << int(Protocol::Unknown) << int(ProtocolData::MethodLine) << 0
+                                    << int(Socket::TimeoutKeepAlive);
+    QTest::newRow("websocket-partial-frame") << int(Protocol::Unknown) << int(ProtocolData::MethodLine) << 10
+                                             << int(Socket::TimeoutBody);
+}
+
+void TestWsgiSocket::testTimeoutFor()
+{
+    QFETCH(int, type);
+    QFETCH(int, state);
+    QFETCH(int, bufSize);
+    QFETCH(int, timeout);
+
+    QCOMPARE(int(Socket::timeoutFor(Protocol::Type(type), ProtocolData::ParserState(state), bufSize)), timeout);
+}
+
+QTEST_MAIN(TestWsgiSocket)
+
+#include "testwsgisocket.moc"
+
+#endif
@@ -26,6 +26,7 @@
 #include "wsgi.h"
 #include "staticmap.h"
 #include "socket.h"
+#include "timerwheel.h"
 
 #include "protocolwebsocket.h"
 #include "protocolhttp.h"
@@ -55,7 +56,8 @@ using namespace Cutelyst;
 
 QByteArray dateHeader();
 
-CWsgiEngine::CWsgiEngine(Application *localApp, int workerCore, const QVariantMap &opts, WSGI *wsgi) : Engine(localApp, workerCore, opts)
+CWsgiEngine::CWsgiEngine(Application *localApp, int workerCore, const QVariantMap &opts, WSGI *wsgi, StaticFileCache *staticCache) : Engine(localApp, workerCore, opts)
+  , m_timerWheel(new TimerWheel(1000, this))
   , m_wsgi(wsgi)
 {
     defaultHeaders().setServer(QLatin1String("cutelyst/") + QLatin1String(VERSION));
@@ -63,10 +65,16 @@ CWsgiEngine::CWsgiEngine(Application *localApp, int workerCore, const QVariantMa
     m_lastDate = dateHeader();
     m_lastDateTimer.start();
 
+    // A thread shared application only needs to be setup by the first engine
+    const bool ownsApp = !workerCore || !localApp->isThreadShared();
+
     const QStringList staticMap = m_wsgi->staticMap();
     const QStringList staticMap2 = m_wsgi->staticMap2();
-    if (!staticMap.isEmpty() || !staticMap2.isEmpty()) {
-        auto staticMapPlugin = new StaticMap(app());
+    StaticMap *staticMapPlugin = nullptr;
+    if (ownsApp && (!staticMap.isEmpty() || !staticMap2.isEmpty())) {
+        staticMapPlugin = new StaticMap(app(), staticCache);
+        staticMapPlugin->setImmutablePattern(m_wsgi->staticMapImmutable());
+        staticMapPlugin->setFollowSymlinks(!m_wsgi->staticMapRefuseSymlinks());
 
         for (const QString &part : staticMap) {
             staticMapPlugin->addStaticMap(part.section(QLatin1Char('='), 0, 0), part.section(QLatin1Char('='), 1, 1), false);
@@ -75,16 +83,25 @@ CWsgiEngine::CWsgiEngine(Application *localApp, int workerCore, const QVariantMa
         for (const QString &part : staticMap2) {
             staticMapPlugin->addStaticMap(part.section(QLatin1Char('='), 0, 0), part.section(QLatin1Char('='), 1, 1), true);
         }
+    } else if (!ownsApp) {
+        staticMapPlugin = app()->findChild<StaticMap *>(QString(), Qt::FindDirectChildrenOnly);
     }
 
-    if (m_wsgi->socketTimeout()) {
-        m_socketTimeout = new QTimer(this);
-        m_socketTimeout->setInterval(m_wsgi->socketTimeout() * 1000);
+    if (m_wsgi->staticMapFastPath()) {
+        m_staticMapFastPath = staticMapPlugin;
     }
 
-    connect(this, &CWsgiEngine::shutdown, this, [localApp] {
-        Q_EMIT localApp->shuttingDown(localApp);
-    });
+    // A zero budget disables that deadline, header and body
+    // budgets fallback to the keep-alive one when not set
+    m_keepAliveTimeout = qint64(m_wsgi->socketTimeout()) * 1000;
+    m_headerTimeout = m_wsgi->headerTimeout() ? qint64(m_wsgi->headerTimeout()) * 1000 : m_keepAliveTimeout;
+    m_bodyTimeout = m_wsgi->bodyTimeout() ? qint64(m_wsgi->bodyTimeout()) * 1000 : m_keepAliveTimeout;
+
+    if (ownsApp) {
+        connect(this, &CWsgiEngine::shutdown, this, [localApp] {
+            Q_EMIT localApp->shuttingDown(localApp);
+        });
+    }
 }
 
 CWsgiEngine::~CWsgiEngine()
@@ -107,9 +124,6 @@ void CWsgiEngine::setServers(const std::vector<QObject *> &servers)
             TcpServer *server = balancer->createServer(this);
             if (server) {
                 ++m_runningServers;
-                if (m_socketTimeout) {
-                    connect(m_socketTimeout, &QTimer::timeout, server, &TcpServer::timeoutConnections);
-                }
 
                 if (server->protocol()->type() == Protocol::Http11) {
                     server->setProtocol(getProtoHttp());
@@ -135,9 +149,6 @@ void CWsgiEngine::setServers(const std::vector<QObject *> &servers)
             LocalServer *server = localServer->createServer(this);
             if (server) {
                 ++m_runningServers;
-                if (m_socketTimeout) {
-                    connect(m_socketTimeout, &QTimer::timeout, server, &LocalServer::timeoutConnections);
-                }
 
                 if (server->protocol()->type() == Protocol::Http11) {
                     server->setProtocol(getProtoHttp());
@@ -183,6 +194,7 @@ Protocol *CWsgiEngine::getProtoHttp()
         } else {
             m_protoHttp = new ProtocolHttp(m_wsgi);
         }
+        m_protoHttp->m_staticMap = m_staticMapFastPath;
     }
     return m_protoHttp;
 }
@@ -191,6 +203,7 @@ ProtocolHttp2 *CWsgiEngine::getProtoHttp2()
 {
     if (!m_protoHttp2) {
         m_protoHttp2 = new ProtocolHttp2(m_wsgi);
+        m_protoHttp2->m_staticMap = m_staticMapFastPath;
     }
     return m_protoHttp2;
 }
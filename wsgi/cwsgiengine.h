@@ -20,7 +20,6 @@
 
 #include <QObject>
 #include <QElapsedTimer>
-#include <QTimer>
 
 #include <Cutelyst/Engine>
 
@@ -29,16 +28,19 @@ class QTcpServer;
 namespace CWSGI {
 
 class TcpServer;
+class TimerWheel;
 class Protocol;
 class ProtocolFastCGI;
 class ProtocolHttp;
 class ProtocolHttp2;
+class StaticFileCache;
+class StaticMap;
 class WSGI;
 class CWsgiEngine : public Cutelyst::Engine
 {
     Q_OBJECT
 public:
-    CWsgiEngine(Cutelyst::Application *localApp, int workerCore, const QVariantMap &opts, WSGI *wsgi);
+    CWsgiEngine(Cutelyst::Application *localApp, int workerCore, const QVariantMap &opts, WSGI *wsgi, StaticFileCache *staticCache = nullptr);
     virtual ~CWsgiEngine() override;
 
     virtual int workerId() const override;
@@ -65,18 +67,6 @@ Q_SIGNALS:
     void shutdownCompleted(CWsgiEngine *engine);
 
 protected:
-    inline void startSocketTimeout() {
-        if (m_socketTimeout && ++m_serversTimeout == 1) {
-            m_socketTimeout->start();
-        }
-    }
-
-    inline void stopSocketTimeout() {
-        if (m_socketTimeout && --m_serversTimeout == 0) {
-            m_socketTimeout->stop();
-        }
-    }
-
     inline void serverShutdown() {
         if (--m_runningServers == 0) {
             Q_EMIT shutdownCompleted(this);
@@ -101,13 +91,16 @@ private:
 
     QByteArray m_lastDate;
     QElapsedTimer m_lastDateTimer;
-    QTimer *m_socketTimeout = nullptr;
+    TimerWheel *m_timerWheel;
     WSGI *m_wsgi;
     ProtocolHttp *m_protoHttp = nullptr;
     ProtocolHttp2 *m_protoHttp2 = nullptr;
     ProtocolFastCGI *m_protoFcgi = nullptr;
+    StaticMap *m_staticMapFastPath = nullptr;
+    qint64 m_keepAliveTimeout;
+    qint64 m_headerTimeout;
+    qint64 m_bodyTimeout;
     int m_runningServers = 0;
-    int m_serversTimeout = 0;
 };
 
 }
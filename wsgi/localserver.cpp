@@ -104,15 +104,14 @@ void LocalServer::incomingConnection(quintptr handle)
         sock->protoData = m_protocol->createData(sock);
 
         connect(sock, &QIODevice::readyRead, [sock] () {
-            sock->timeout = false;
             sock->proto->parse(sock, sock);
+            sock->startTimeout();
         });
         connect(sock, &LocalSocket::finished, this, [this, sock] () {
+            sock->stopTimeout();
             sock->resetSocket();
             m_socks.push_back(sock);
-            if (--m_processing == 0) {
-                m_engine->stopSocketTimeout();
-            }
+            --m_processing;
         }, Qt::QueuedConnection);
     }
 
@@ -120,9 +119,8 @@ void LocalServer::incomingConnection(quintptr handle)
         sock->proto = m_protocol;
 
         sock->serverAddress = QStringLiteral("localhost");
-        if (++m_processing) {
-            m_engine->startSocketTimeout();
-        }
+        ++m_processing;
+        sock->startTimeout();
     } else {
         m_socks.push_back(sock);
     }
@@ -160,23 +158,6 @@ void LocalServer::shutdown()
     }
 }
 
-void LocalServer::timeoutConnections()
-{
-    if (m_processing) {
-        const auto childrenL = children();
-        for (auto child : childrenL) {
-            auto socket = qobject_cast<LocalSocket*>(child);
-            if (socket && !socket->processing && socket->state() == QLocalSocket::ConnectedState) {
-                if (socket->timeout) {
-                    socket->connectionClose();
-                } else {
-                    socket->timeout = true;
-                }
-            }
-        }
-    }
-}
-
 Protocol *LocalServer::protocol() const
 {
     return m_protocol;
@@ -45,7 +45,6 @@ public:
     qintptr socket() const;
 
     void shutdown();
-    void timeoutConnections();
 
     Protocol *protocol() const;
 
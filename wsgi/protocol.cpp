@@ -43,6 +43,7 @@ ProtocolData::~ProtocolData()
 Protocol::Protocol(WSGI *wsgi)
 {
     m_bufferSize = wsgi->bufferSize();
+    m_bodyMinRate = wsgi->bodyMinRate();
     m_postBuffering = wsgi->postBuffering();
     m_postBufferSize = qMax(static_cast<qint64>(32), wsgi->postBufferingBufsize());
     m_postBuffer = new char[wsgi->postBufferingBufsize()];
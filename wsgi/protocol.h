@@ -19,6 +19,7 @@
 #define PROTOCOL_H
 
 #include <QObject>
+#include <QElapsedTimer>
 #include <QDebug>
 
 class QIODevice;
@@ -27,6 +28,7 @@ namespace CWSGI {
 
 class WSGI;
 class Socket;
+class StaticMap;
 class Protocol;
 class ProtocolData
 {
@@ -99,6 +101,19 @@ public:
 
     QIODevice *createBody(qint64 contentLength) const;
 
+    // Returns true if the request body arrives slower than body_min_rate
+    inline bool bodyRateTooLow(const QElapsedTimer &elapsed, qint64 received) const {
+        if (m_bodyMinRate && elapsed.isValid()) {
+            const qint64 msec = elapsed.elapsed();
+            // Give the client a second before enforcing the rate
+            return msec > 1000 && received * 1000 < m_bodyMinRate * msec;
+        }
+        return false;
+    }
+
+    // Set when static map files are served without the application
+    StaticMap *m_staticMap = nullptr;
+    qint64 m_bodyMinRate;
     qint64 m_postBufferSize;
     qint64 m_postBuffering;
     int m_bufferSize;
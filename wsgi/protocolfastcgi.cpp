@@ -348,6 +348,10 @@ qint64 ProtocolFastCGI::readBody(Socket *sock, QIODevice *io, qint64 bytesAvaila
 
     if ( request->pktsize + pad == 0) {
         request->connState = ProtoRequestFastCGI::MethodLine;
+    } else if (bodyRateTooLow(request->elapsed, body->size())) {
+        qCDebug(CWSGI_FCGI) << "Request body below minimum rate, closing" << sock->remoteAddress.toString();
+        sock->connectionClose();
+        return -1;
     }
 
     return bytesAvailable;
@@ -389,6 +393,7 @@ void ProtocolFastCGI::parse(Socket *sock, QIODevice *io) const
             if (ret == WSGI_AGAIN) {
                 continue;
             } else if (ret == WSGI_OK) {
+                sock->stopTimeout();
                 sock->processing++;
                 if (request->body) {
                     request->body->seek(0);
@@ -20,6 +20,7 @@
 #include "protocolwebsocket.h"
 #include "wsgi.h"
 #include "protocolhttp2.h"
+#include "staticmap.h"
 
 #include <Cutelyst/Headers>
 #include <Cutelyst/Context>
@@ -107,6 +108,9 @@ void ProtocolHttp::parse(Socket *sock, QIODevice *io) const
 
         if (remaining == len) {
             processRequest(sock, io);
+        } else if (bodyRateTooLow(protoRequest->elapsed, body->size())) {
+            qCDebug(CWSGI_HTTP) << "Request body below minimum rate, closing" << sock->remoteAddress.toString();
+            sock->connectionClose();
         }
 
         return;
@@ -206,7 +210,15 @@ bool ProtocolHttp::processRequest(Socket *sock, QIODevice *io) const
         return false;
     }
 
+    // Headers are complete, a pipelined request gets its own deadline
+    sock->stopTimeout();
+
     ++sock->processing;
+    if (m_staticMap && serveStatic(sock, request)) {
+        request->processingFinished();
+        return true;
+    }
+
     sock->engine->processRequest(request);
 
     if (request->websocketUpgraded) {
@@ -220,6 +232,41 @@ bool ProtocolHttp::processRequest(Socket *sock, QIODevice *io) const
     return true;
 }
 
+bool ProtocolHttp::serveStatic(Socket *sock, ProtoRequestHttp *request) const
+{
+    StaticReply reply;
+    if (!m_staticMap->prepareReply(*request, sock->engine->defaultHeaders(), STATIC_REPLY_MAX_SIZE, reply)) {
+        return false;
+    }
+
+    request->writeHeaders(reply.status, reply.headers);
+    if (request->method == QLatin1String("HEAD")) {
+        return true;
+    }
+
+    if (reply.file) {
+        char block[64 * 1024];
+        qint64 remaining = reply.size;
+        while (remaining > 0) {
+            const qint64 in = reply.file->read(block, qMin(remaining, qint64(sizeof(block))));
+            if (in <= 0 || request->doWrite(block, in) != in) {
+                break;
+            }
+            remaining -= in;
+        }
+
+        // The file shrunk, the announced Content-Length can not be honored
+        if (remaining > 0) {
+            qCWarning(CWSGI_HTTP) << "Failed to write" << reply.file->fileName();
+            request->headerConnection = ProtoRequestHttp::HeaderConnectionClose;
+        }
+    } else if (!reply.data.isEmpty()) {
+        request->doWrite(reply.data);
+    }
+
+    return true;
+}
+
 void ProtocolHttp::parseMethod(const char *ptr, const char *end, Socket *sock) const
 {
     auto protoRequest = static_cast<ProtoRequestHttp *>(sock->protoData);
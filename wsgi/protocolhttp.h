@@ -146,6 +146,7 @@ public:
 
 private:
     inline bool processRequest(Socket *sock, QIODevice *io) const;
+    inline bool serveStatic(Socket *sock, ProtoRequestHttp *request) const;
     inline void parseMethod(const char *ptr, const char *end, Socket *sock) const;
     inline void parseHeader(const char *ptr, const char *end, Socket *sock) const;
 
@@ -20,6 +20,7 @@
 #include "socket.h"
 #include "hpack.h"
 #include "wsgi.h"
+#include "staticmap.h"
 
 #include <QEventLoop>
 
@@ -373,6 +374,9 @@ int ProtocolHttp2::parseData(ProtoRequestHttp2 *request, QIODevice *io, const H2
 
     if (fr.flags & FlagDataEndStream) {
         queueStream(request->sock, stream);
+    } else if (bodyRateTooLow(stream->elapsed, stream->consumedData)) {
+        qCDebug(CWSGI_H2) << "Request body below minimum rate" << request->sock->remoteAddress.toString();
+        return sendGoAway(io, request->maxStreamId, ErrorEnhanceYourCalm);
     }
 
     return ErrorNoError;
@@ -736,12 +740,72 @@ int ProtocolHttp2::sendFrame(QIODevice *io, quint8 type, quint8 flags, quint32 s
 void ProtocolHttp2::queueStream(Socket *socket, H2Stream *stream) const
 {
     ++socket->processing;
+    if (m_staticMap && serveStatic(socket, stream)) {
+        stream->processingFinished();
+        return;
+    }
+
     if (stream->body) {
         stream->body->seek(0);
     }
     Q_EMIT socket->engine->processRequestAsync(stream);
 }
 
+bool ProtocolHttp2::serveStatic(Socket *socket, H2Stream *stream) const
+{
+    // Waiting for WINDOW_UPDATE frames needs the event loop, so only
+    // bodies that fit the flow control windows are sent from here
+    ProtoRequestHttp2 *request = stream->protoRequest;
+    const qint64 maxSize = qMin(qint64(STATIC_REPLY_MAX_SIZE), qint64(qMin(stream->windowSize, request->windowSize)));
+
+    StaticReply reply;
+    if (!m_staticMap->prepareReply(*stream, socket->engine->defaultHeaders(), maxSize, reply)) {
+        return false;
+    }
+
+    const qint32 length = stream->method == QLatin1String("HEAD") ? 0 : qint32(reply.size);
+
+    QByteArray buf;
+    request->hpack->encodeHeaders(reply.status, reply.headers.data(), buf, static_cast<CWsgiEngine *>(socket->engine));
+    const quint8 flags = length ? FlagHeadersEndHeaders : FlagHeadersEndHeaders | FlagHeadersEndStream;
+    if (sendFrame(request->io, FrameHeaders, flags,
+                  stream->streamId, buf.constData(), buf.size())) {
+        return true;
+    }
+
+    // DATA frames can not be larger than what the peer accepts,
+    // files are read one frame at a time
+    const qint32 maxFrameSize = qint32(request->settingsMaxFrameSize);
+    if (reply.data.isNull() && length) {
+        buf.resize(qMin(maxFrameSize, length));
+    }
+
+    qint32 offset = 0;
+    while (offset < length) {
+        const qint32 len = qMin(maxFrameSize, length - offset);
+        const char *data = reply.data.constData() + offset;
+        if (reply.data.isNull()) {
+            if (reply.file->read(buf.data(), len) != len) {
+                // The file shrunk, the announced length can not be honored
+                qCWarning(CWSGI_H2) << "Failed to read" << reply.file->fileName();
+                sendRstStream(request->io, stream->streamId, ErrorInternalError);
+                break;
+            }
+            data = buf.constData();
+        }
+
+        const quint8 flags = offset + len == length ? FlagDataEndStream : 0;
+        if (sendFrame(request->io, FrameData, flags, stream->streamId, data, len)) {
+            break;
+        }
+        offset += len;
+    }
+    stream->windowSize -= offset;
+    request->windowSize -= offset;
+
+    return true;
+}
+
 bool ProtocolHttp2::upgradeH2C(Socket *socket, QIODevice *io, const Cutelyst::EngineRequest &request)
 {
     const Cutelyst::Headers &headers = request.headers;
@@ -147,6 +147,8 @@ public:
 
     void queueStream(Socket *socket, H2Stream *stream) const;
 
+    bool serveStatic(Socket *socket, H2Stream *stream) const;
+
     bool upgradeH2C(Socket *socket, QIODevice *io, const Cutelyst::EngineRequest &request);
 
 public:
@@ -35,6 +35,51 @@ Socket::~Socket()
     delete protoData;
 }
 
+void Socket::startTimeout()
+{
+    auto wsgiEngine = static_cast<CWsgiEngine *>(engine);
+
+    qint64 msec;
+    const Timeout kind = timeoutFor(proto->type(), protoData->connState, protoData->buf_size);
+    if (kind == TimeoutBody) {
+        msec = wsgiEngine->m_bodyTimeout;
+    } else if (kind == TimeoutHeader) {
+        // The header deadline counts from the first byte, so
+        // trickling a byte at a time does not extend it
+        if (timeoutKind == TimeoutHeader && isTimerArmed()) {
+            return;
+        }
+        msec = wsgiEngine->m_headerTimeout;
+    } else {
+        msec = wsgiEngine->m_keepAliveTimeout;
+    }
+    timeoutKind = kind;
+
+    if (msec) {
+        wsgiEngine->m_timerWheel->start(this, msec);
+    } else {
+        stopTimeout();
+    }
+}
+
+void Socket::stopTimeout()
+{
+    if (isTimerArmed()) {
+        static_cast<CWsgiEngine *>(engine)->m_timerWheel->cancel(this);
+    }
+}
+
+void Socket::timerWheelExpired()
+{
+    if (processing) {
+        // Requests being processed are never timed out,
+        // keep polling until the application is done
+        startTimeout();
+    } else {
+        connectionClose();
+    }
+}
+
 TcpSocket::TcpSocket(Cutelyst::Engine *engine, QObject *parent) : QTcpSocket(parent), Socket(false, engine)
 {
     connect(this, &QTcpSocket::disconnected, this, &TcpSocket::socketDisconnected, Qt::DirectConnection);
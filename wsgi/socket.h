@@ -28,6 +28,7 @@
 #include "cwsgiengine.h"
 
 #include "protocol.h"
+#include "timerwheel.h"
 
 class QIODevice;
 
@@ -38,13 +39,39 @@ class Engine;
 namespace CWSGI {
 
 class WSGI;
-class Socket
+class Socket : public TimerWheelNode
 {
     Q_GADGET
 public:
+    enum Timeout : quint8 {
+        TimeoutKeepAlive = 0,
+        TimeoutHeader,
+        TimeoutBody
+    };
+
     Socket(bool secure, Cutelyst::Engine *_engine);
     virtual ~Socket();
 
+    // Returns the deadline that applies to a connection of the given protocol
+    // in the given parser state, only HTTP/1 headers have a fixed deadline,
+    // partial HTTP/2 frames and FastCGI records are paced like a body
+    static inline Timeout timeoutFor(Protocol::Type type, ProtocolData::ParserState state, int bufSize) {
+        if (state == ProtocolData::ContentBody) {
+            return TimeoutBody;
+        } else if (type == Protocol::Http11) {
+            if (state == ProtocolData::HeaderLine || (state == ProtocolData::MethodLine && bufSize)) {
+                return TimeoutHeader;
+            }
+        } else if (bufSize) {
+            return TimeoutBody;
+        }
+        return TimeoutKeepAlive;
+    }
+
+    // (Re)arms the deadline that matches the parser state
+    void startTimeout();
+    void stopTimeout();
+
     virtual void connectionClose() = 0;
 
     // Returns false if disconnected
@@ -68,8 +95,11 @@ public:
     Protocol *proto = nullptr;
     ProtocolData *protoData = nullptr;
     qint8 processing = 0;
+    quint8 timeoutKind = TimeoutKeepAlive;
     bool isSecure;
-    bool timeout = false;
+
+protected:
+    virtual void timerWheelExpired() override;
 };
 
 class TcpSocket : public QTcpSocket, public Socket
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "staticfilecache.h"
+
+#include <Cutelyst/Headers>
+#include <Cutelyst/utils.h>
+
+#include <QIODevice>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QLoggingCategory>
+
+#include <limits>
+
+Q_LOGGING_CATEGORY(CWSGI_STATICCACHE, "cwsgi.staticcache", QtWarningMsg)
+
+using namespace CWSGI;
+
+StaticFileCache::StaticFileCache(qint64 maxSize, qint64 maxFileSize, QObject *parent) : QObject(parent)
+  , m_maxFileSize(maxFileSize)
+{
+    // Costs are in KiB so the cache can be larger than 2GiB
+    m_cache.setMaxCost(int(qMin(maxSize / 1024, qint64(std::numeric_limits<int>::max()))));
+
+    // The watcher is created on our thread, lazily so that forked
+    // workers do not share the inotify descriptor of the master
+    connect(this, &StaticFileCache::watchRequested, this, &StaticFileCache::watch, Qt::QueuedConnection);
+}
+
+StaticFileCache::EntryPtr StaticFileCache::entry(const QString &filename)
+{
+    QMutexLocker locker(&m_mutex);
+    EntryPtr *cached = m_cache.object(filename);
+    if (cached) {
+        return *cached;
+    }
+    return EntryPtr();
+}
+
+StaticFileCache::EntryPtr StaticFileCache::insert(const QString &filename, QIODevice *file, qint64 size, const QDateTime &lastModified)
+{
+    EntryPtr entry = load(filename, file, size, lastModified);
+
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(filename, new EntryPtr(entry), int(entry->data.size() / 1024) + 1);
+    Q_EMIT watchRequested(filename, QPrivateSignal());
+    return entry;
+}
+
+StaticFileCache::EntryPtr StaticFileCache::load(const QString &filename, QIODevice *file, qint64 size, const QDateTime &lastModified) const
+{
+    auto entry = new Entry;
+    entry->size = size;
+    entry->lastModifiedDateTime = lastModified;
+
+    Cutelyst::Headers headers;
+    entry->lastModified = headers.setLastModified(entry->lastModifiedDateTime);
+
+    // use the extension to match to be faster
+    entry->contentType = Cutelyst::Utils::mimeTypeForFile(filename);
+
+    if (entry->size <= m_maxFileSize) {
+        entry->data = file->readAll();
+        // The file changed while we read it
+        entry->size = entry->data.size();
+    }
+
+    // Content based so that replicas and redeploys of the same file agree
+    if (entry->data.isNull()) {
+        entry->etag = Cutelyst::Utils::fileContentETag(filename, entry->lastModifiedDateTime, entry->size, file);
+    } else {
+        entry->etag = Cutelyst::Utils::contentETag(entry->data);
+    }
+
+    return EntryPtr(entry);
+}
+
+void StaticFileCache::watch(const QString &filename)
+{
+    if (!m_watcher) {
+        m_watcher = new QFileSystemWatcher(this);
+        connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &StaticFileCache::fileChanged);
+    }
+    m_watcher->addPath(filename);
+
+    // The file might have changed before it was watched
+    const QFileInfo info(filename);
+
+    QMutexLocker locker(&m_mutex);
+    EntryPtr *cached = m_cache.object(filename);
+    if (cached && (!info.isFile() ||
+                   info.size() != (*cached)->size ||
+                   info.lastModified() != (*cached)->lastModifiedDateTime)) {
+        m_cache.remove(filename);
+    }
+
+    // Drop the watches of evicted entries
+    const QStringList watched = m_watcher->files();
+    if (watched.size() > m_cache.count() * 2 + 64) {
+        for (const QString &file : watched) {
+            if (!m_cache.contains(file)) {
+                m_watcher->removePath(file);
+            }
+        }
+    }
+}
+
+void StaticFileCache::fileChanged(const QString &filename)
+{
+    qCDebug(CWSGI_STATICCACHE) << "Invalidating" << filename;
+
+    m_watcher->removePath(filename);
+
+    QMutexLocker locker(&m_mutex);
+    m_cache.remove(filename);
+}
+
+#include "moc_staticfilecache.cpp"
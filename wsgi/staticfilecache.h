@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef STATICFILECACHE_H
+#define STATICFILECACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QMutex>
+#include <QDateTime>
+#include <QSharedPointer>
+
+class QFileSystemWatcher;
+class QIODevice;
+
+namespace CWSGI {
+
+/**
+ * Process wide cache of static files, small files are held in
+ * memory and all entries carry their precomputed headers.
+ *
+ * Lookups are thread-safe, entries are invalidated by a file
+ * system watcher (inotify on Linux) living on the thread of this
+ * object, so it must be created on a thread with an event loop.
+ */
+class StaticFileCache : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry {
+        // Null when the file is larger than the in memory limit
+        QByteArray data;
+        QString contentType;
+        QString lastModified;
+        QDateTime lastModifiedDateTime;
+        QString etag;
+        qint64 size;
+    };
+    typedef QSharedPointer<const Entry> EntryPtr;
+
+    explicit StaticFileCache(qint64 maxSize, qint64 maxFileSize, QObject *parent = nullptr);
+
+    // Returns a null pointer if filename is not cached
+    EntryPtr entry(const QString &filename);
+
+    // Caches filename from its open file
+    EntryPtr insert(const QString &filename, QIODevice *file, qint64 size, const QDateTime &lastModified);
+
+Q_SIGNALS:
+    void watchRequested(const QString &filename, QPrivateSignal);
+
+private:
+    EntryPtr load(const QString &filename, QIODevice *file, qint64 size, const QDateTime &lastModified) const;
+    void watch(const QString &filename);
+    void fileChanged(const QString &filename);
+
+    QMutex m_mutex;
+    QCache<QString, EntryPtr> m_cache;
+    QFileSystemWatcher *m_watcher = nullptr;
+    qint64 m_maxFileSize;
+};
+
+}
+
+#endif // STATICFILECACHE_H
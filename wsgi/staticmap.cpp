@@ -18,21 +18,34 @@
 #include "staticmap.h"
 
 #include "socket.h"
+#include "staticfilecache.h"
 
-#include <QDir>
 #include <QFile>
+#include <QBuffer>
 #include <QLoggingCategory>
 
 #include <Cutelyst/Application>
 #include <Cutelyst/Response>
 #include <Cutelyst/Request>
+#include <Cutelyst/enginerequest.h>
+#include <Cutelyst/utils.h>
 
 Q_LOGGING_CATEGORY(CUTELYST_SM, "cwsgi.staticmap", QtWarningMsg)
 
 using namespace CWSGI;
 using namespace Cutelyst;
 
-StaticMap::StaticMap(Cutelyst::Application *parent) : Plugin(parent)
+static inline bool isNotModified(const Headers &reqHeaders, const QString &etag, const QDateTime &lastModified)
+{
+    // If-Modified-Since is ignored when If-None-Match is present
+    if (reqHeaders.header(QStringLiteral("IF_NONE_MATCH")).isEmpty()) {
+        return !reqHeaders.ifModifiedSince(lastModified);
+    }
+    return reqHeaders.ifNoneMatch(etag);
+}
+
+StaticMap::StaticMap(Cutelyst::Application *parent, StaticFileCache *cache) : Plugin(parent)
+  , m_cache(cache)
 {
 
 }
@@ -40,26 +53,32 @@ StaticMap::StaticMap(Cutelyst::Application *parent) : Plugin(parent)
 bool StaticMap::setup(Cutelyst::Application *app)
 {
     connect(app, &Cutelyst::Application::beforePrepareAction,
-            this, &StaticMap::beforePrepareAction);
+            this, &StaticMap::beforePrepareAction, Qt::DirectConnection);
+
+    Utils::registerMimeTypes(m_resolver.directories());
+
     return true;
 }
 
 void StaticMap::addStaticMap(const QString &mountPoint, const QString &path, bool append)
 {
-    QString mp = mountPoint;
-    while (mp.startsWith(QLatin1Char('/'))) {
-        mp.remove(0, 1);
-    }
-    if (!mp.endsWith(QLatin1Char('/'))) {
-        mp += QLatin1Char('/');
-    }
+    qCInfo(CUTELYST_SM) << "added mapping for" << mountPoint << "=>" << path;
 
-    qCInfo(CUTELYST_SM) << "added mapping for" << mp << "=>" << path;
+    m_resolver.addMountPoint(mountPoint, path, append);
+}
+
+void StaticMap::setFollowSymlinks(bool follow)
+{
+    m_resolver.setFollowSymlinks(follow);
+}
 
-    m_staticMaps.push_back({ mp, path, append });
-    std::sort(m_staticMaps.begin(), m_staticMaps.end(), [](const MountPoint &a, const MountPoint &b) -> bool {
-              return a.mountPoint.size() < b.mountPoint.size();
-    });
+void StaticMap::setImmutablePattern(const QString &pattern)
+{
+    m_immutablePattern.setPattern(pattern);
+    if (!m_immutablePattern.isValid()) {
+        qCWarning(CUTELYST_SM) << "Invalid immutable pattern" << pattern << m_immutablePattern.errorString();
+        m_immutablePattern.setPattern(QString());
+    }
 }
 
 void StaticMap::beforePrepareAction(Cutelyst::Context *c, bool *skipMethod)
@@ -68,70 +87,252 @@ void StaticMap::beforePrepareAction(Cutelyst::Context *c, bool *skipMethod)
         return;
     }
 
-    const QString path = c->req()->path();
-    for (const MountPoint &mp : m_staticMaps) {
-        if (path.startsWith(mp.mountPoint)) {
-            if (tryToServeFile(c, mp, path)) {
-                *skipMethod = true;
-                break;
-            }
+    const QVector<StaticResolver::Target> targets = m_resolver.resolve(c->req()->path());
+    for (const StaticResolver::Target &target : targets) {
+        if (m_cache ? serveCachedFile(c, target) : serveFile(c, target)) {
+            *skipMethod = true;
+            break;
         }
     }
 }
 
-bool StaticMap::tryToServeFile(Cutelyst::Context *c, const MountPoint &mp, const QString &path)
+bool StaticMap::prepareReply(const EngineRequest &request, const Headers &defaultHeaders, qint64 maxSize, StaticReply &reply) const
 {
-    QString localPath = path;
-    if (!mp.append) {
-        localPath = path.mid(mp.mountPoint.size());
-        while (localPath.startsWith(QLatin1Char('/'))) {
-            localPath.remove(0, 1);
+    if (request.method != QLatin1String("GET") && request.method != QLatin1String("HEAD")) {
+        return false;
+    }
+
+    // Ranges are only implemented by the EngineRequest of a Context
+    const Headers &reqHeaders = request.headers;
+    if (!reqHeaders.header(QStringLiteral("RANGE")).isEmpty()) {
+        return false;
+    }
+
+    const bool head = request.method == QLatin1String("HEAD");
+    const QVector<StaticResolver::Target> targets = m_resolver.resolve(request.path);
+    for (const StaticResolver::Target &target : targets) {
+        QString etag;
+        QString lastModified;
+        QDateTime lastModifiedDateTime;
+        QString contentType;
+        if (m_cache) {
+            const StaticFileCache::EntryPtr entry = cachedEntry(target);
+            if (!entry) {
+                continue;
+            }
+            etag = entry->etag;
+            lastModified = entry->lastModified;
+            lastModifiedDateTime = entry->lastModifiedDateTime;
+            contentType = entry->contentType;
+            reply.data = entry->data;
+            reply.size = entry->size;
+        } else {
+            if (!m_resolver.stat(target, &reply.size, &lastModifiedDateTime)) {
+                continue;
+            }
+
+            // Files too large for us are not hashed unless already known
+            etag = Utils::cachedFileContentETag(target.filename, lastModifiedDateTime, reply.size);
+            if (etag.isEmpty()) {
+                if (!head && reply.size > maxSize) {
+                    return false;
+                }
+                if (!openFile(target, reply.file, &reply.size, &lastModifiedDateTime, &etag)) {
+                    continue;
+                }
+            }
+            contentType = Utils::mimeTypeForFile(target.filename);
+        }
+
+        reply.headers = defaultHeaders;
+        Headers &headers = reply.headers;
+
+        if (isNotModified(reqHeaders, etag, lastModifiedDateTime)) {
+            qCDebug(CUTELYST_SM) << "Not modified" << target.filename;
+            if (!etag.isEmpty()) {
+                headers.setETag(etag);
+            }
+            reply.status = Response::NotModified;
+            reply.data.clear();
+            reply.file.reset();
+            reply.size = 0;
+            return true;
+        }
+
+        if (head) {
+            reply.file.reset();
+        } else if (reply.size > maxSize) {
+            return false;
+        } else if (reply.data.isNull() && !reply.file) {
+            if (m_cache) {
+                reply.file.reset(m_resolver.open(target, &reply.size));
+            } else {
+                openFile(target, reply.file, &reply.size, &lastModifiedDateTime, &etag);
+            }
+            if (!reply.file) {
+                qCWarning(CUTELYST_SM) << "Could not serve" << target.filename;
+                return false;
+            }
+
+            // It grew since it was looked up
+            if (reply.size > maxSize) {
+                return false;
+            }
+        }
+        qCDebug(CUTELYST_SM) << "Serving from the protocol" << target.filename;
+
+        if (!etag.isEmpty()) {
+            headers.setETag(etag);
+        }
+
+        if (!contentType.isEmpty()) {
+            headers.setContentType(contentType);
         }
+        headers.setContentLength(reply.size);
+        if (lastModified.isEmpty()) {
+            headers.setLastModified(lastModifiedDateTime);
+        } else {
+            headers.setLastModified(lastModified);
+        }
+        headers.setHeader(QStringLiteral("ACCEPT_RANGES"), QStringLiteral("bytes"));
+        headers.setHeader(QStringLiteral("CACHE_CONTROL"), Utils::staticFileCacheControl(m_immutablePattern, request.path));
+        reply.status = Response::OK;
+
+        return true;
+    }
+
+    return false;
+}
+
+StaticFileCache::EntryPtr StaticMap::cachedEntry(const StaticResolver::Target &target) const
+{
+    StaticFileCache::EntryPtr entry = m_cache->entry(target.filename);
+    if (entry) {
+        return entry;
+    }
+
+    qint64 size;
+    QDateTime lastModified;
+    QScopedPointer<QFile> file(m_resolver.open(target, &size, &lastModified));
+    if (!file) {
+        return entry;
+    }
+    return m_cache->insert(target.filename, file.data(), size, lastModified);
+}
+
+bool StaticMap::statFile(const StaticResolver::Target &target, QScopedPointer<QFile> &file, qint64 *size, QDateTime *lastModified, QString *etag) const
+{
+    if (!m_resolver.stat(target, size, lastModified)) {
+        return false;
     }
 
-    QDir dir(mp.path);
-    QString absFilePath = dir.absoluteFilePath(localPath);
-    if (!QFile::exists(absFilePath)) {
+    // Revalidating a version hashed before does not open the file
+    *etag = Utils::cachedFileContentETag(target.filename, *lastModified, *size);
+    if (etag->isEmpty()) {
+        return openFile(target, file, size, lastModified, etag);
+    }
+    return true;
+}
+
+bool StaticMap::openFile(const StaticResolver::Target &target, QScopedPointer<QFile> &file, qint64 *size, QDateTime *lastModified, QString *etag) const
+{
+    const qint64 statSize = *size;
+    const QDateTime statLastModified = *lastModified;
+    file.reset(m_resolver.open(target, size, lastModified));
+    if (!file) {
         return false;
     }
 
-    return serveFile(c, absFilePath);
+    // Hashed from the descriptor that is served, so the tag can not
+    // describe a file swapped after it was resolved
+    if (etag->isEmpty() || *size != statSize || *lastModified != statLastModified) {
+        *etag = Utils::fileContentETag(target.filename, *lastModified, *size, file.data());
+    }
+    return true;
 }
 
-bool StaticMap::serveFile(Cutelyst::Context *c, const QString &filename)
+bool StaticMap::serveFile(Cutelyst::Context *c, const StaticResolver::Target &target)
 {
     auto res = c->response();
-    const QDateTime currentDateTime = QFileInfo(filename).lastModified();
-    if (!c->request()->headers().ifModifiedSince(currentDateTime)) {
+    qint64 size;
+    QDateTime currentDateTime;
+    QString etag;
+    QScopedPointer<QFile> file;
+    if (!statFile(target, file, &size, &currentDateTime, &etag)) {
+        return false;
+    }
+
+    if (isNotModified(c->request()->headers(), etag, currentDateTime)) {
         res->setStatus(Response::NotModified);
+        res->headers().setETag(etag);
         return true;
     }
 
-    auto file = new QFile(filename);
-    if (file->open(QFile::ReadOnly)) {
-        qCDebug(CUTELYST_SM) << "Serving" << filename;
-        Headers &headers = res->headers();
+    if (!file && !openFile(target, file, &size, &currentDateTime, &etag)) {
+        return false;
+    }
+
+    qCDebug(CUTELYST_SM) << "Serving" << target.filename;
+    Headers &headers = res->headers();
 
-        // set our open file
-        res->setBody(file);
+    // set our open file
+    res->setBody(file.take());
 
-        // use the extension to match to be faster
-        QMimeType mimeType = m_db.mimeTypeForFile(filename, QMimeDatabase::MatchExtension);
-        if (mimeType.isValid()) {
-            headers.setContentType(mimeType.name());
-        }
-        headers.setContentLength(file->size());
+    // use the extension to match to be faster
+    headers.setContentType(Utils::mimeTypeForFile(target.filename));
+    headers.setContentLength(size);
+
+    headers.setLastModified(currentDateTime);
+    if (!etag.isEmpty()) {
+        headers.setETag(etag);
+    }
+    headers.setHeader(QStringLiteral("cache_control"), Utils::staticFileCacheControl(m_immutablePattern, c->request()->path()));
 
-        headers.setLastModified(currentDateTime);
-        // Tell Firefox & friends its OK to cache, even over SSL
-        headers.setHeader(QStringLiteral("cache_control"), QStringLiteral("public"));
+    return true;
+}
+
+bool StaticMap::serveCachedFile(Cutelyst::Context *c, const StaticResolver::Target &target)
+{
+    const StaticFileCache::EntryPtr entry = cachedEntry(target);
+    if (!entry) {
+        return false;
+    }
 
+    auto res = c->response();
+    const Headers &reqHeaders = c->request()->headers();
+    if (isNotModified(reqHeaders, entry->etag, entry->lastModifiedDateTime)) {
+        res->setStatus(Response::NotModified);
+        res->headers().setETag(entry->etag);
         return true;
     }
 
-    qCWarning(CUTELYST_SM) << "Could not serve" << filename << file->errorString();
-    delete file;
-    return false;
+    if (entry->data.isNull()) {
+        QFile *file = m_resolver.open(target);
+        if (!file) {
+            qCWarning(CUTELYST_SM) << "Could not serve" << target.filename;
+            return false;
+        }
+        res->setBody(file);
+    } else if (!reqHeaders.header(QStringLiteral("RANGE")).isEmpty()) {
+        // Range requests need a seekable body
+        auto buffer = new QBuffer;
+        buffer->setData(entry->data);
+        buffer->open(QBuffer::ReadOnly);
+        res->setBody(buffer);
+    } else {
+        res->setBody(entry->data);
+    }
+    qCDebug(CUTELYST_SM) << "Serving cached" << target.filename;
+
+    Headers &headers = res->headers();
+    if (!entry->contentType.isEmpty()) {
+        headers.setContentType(entry->contentType);
+    }
+    headers.setLastModified(entry->lastModified);
+    headers.setETag(entry->etag);
+    headers.setHeader(QStringLiteral("cache_control"), Utils::staticFileCacheControl(m_immutablePattern, c->request()->path()));
+
+    return true;
 }
 
 #include "moc_staticmap.cpp"
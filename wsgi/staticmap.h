@@ -19,18 +19,35 @@
 #define STATICMAP_H
 
 #include <QString>
-#include <QMimeDatabase>
-#include <vector>
+#include <QRegularExpression>
+#include <QScopedPointer>
+#include <QFile>
 
 #include <Cutelyst/Plugin>
 #include <Cutelyst/Context>
+#include <Cutelyst/Headers>
+
+#include "staticfilecache.h"
+#include "staticresolver.h"
+
+namespace Cutelyst {
+class EngineRequest;
+}
 
 namespace CWSGI {
 
-struct MountPoint {
-    QString mountPoint;
-    QString path;
-    bool append;
+// Largest body the protocols send before going back to the event loop,
+// larger files are written by the application
+#define STATIC_REPLY_MAX_SIZE (1024 * 1024)
+
+// A static map response built without a Context, data holds the
+// body unless it must be read from file, 304s and HEADs have neither
+struct StaticReply {
+    Cutelyst::Headers headers;
+    QByteArray data;
+    QScopedPointer<QFile> file;
+    qint64 size = 0;
+    quint16 status = 200;
 };
 
 class Socket;
@@ -38,21 +55,44 @@ class StaticMap : public Cutelyst::Plugin
 {
     Q_OBJECT
 public:
-    StaticMap(Cutelyst::Application *parent);
+    StaticMap(Cutelyst::Application *parent, StaticFileCache *cache = nullptr);
 
     virtual bool setup(Cutelyst::Application *app) override;
 
     void addStaticMap(const QString &mountPoint, const QString &path, bool append);
 
+    // Refuses files reached through symbolic links when false
+    void setFollowSymlinks(bool follow);
+
+    // Request paths matching pattern are sent as immutable
+    void setImmutablePattern(const QString &pattern);
+
+    // Thread-safe lookup used by the protocols to answer GET and HEAD
+    // requests before a Context is created, returns false when the
+    // request must go through the application, like Range requests or
+    // bodies larger than maxSize, which are refused before being hashed
+    bool prepareReply(const Cutelyst::EngineRequest &request, const Cutelyst::Headers &defaultHeaders, qint64 maxSize, StaticReply &reply) const;
+
 private:
     void beforePrepareAction(Cutelyst::Context *c, bool *skipMethod);
 
-    bool tryToServeFile(Cutelyst::Context *c, const MountPoint &mp, const QString &path);
+    bool serveFile(Cutelyst::Context *c, const StaticResolver::Target &target);
+
+    // Stats target and sets etag from the tag cache, opening file to hash
+    // it only when this version was not hashed before
+    bool statFile(const StaticResolver::Target &target, QScopedPointer<QFile> &file, qint64 *size, QDateTime *lastModified, QString *etag) const;
+
+    // Opens target into file, hashing etag again if it changed since the stat
+    bool openFile(const StaticResolver::Target &target, QScopedPointer<QFile> &file, qint64 *size, QDateTime *lastModified, QString *etag) const;
+
+    bool serveCachedFile(Cutelyst::Context *c, const StaticResolver::Target &target);
 
-    bool serveFile(Cutelyst::Context *c, const QString &filename);
+    // Returns the cache entry of target, loading it on a miss
+    StaticFileCache::EntryPtr cachedEntry(const StaticResolver::Target &target) const;
 
-    QMimeDatabase m_db;
-    std::vector<MountPoint> m_staticMaps;
+    QRegularExpression m_immutablePattern;
+    StaticResolver m_resolver;
+    StaticFileCache *m_cache;
 };
 
 }
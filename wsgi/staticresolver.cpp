@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "staticresolver.h"
+
+#include <Cutelyst/utils.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QPair>
+#include <QVarLengthArray>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Q_LOGGING_CATEGORY(CWSGI_STATICRESOLVER, "cwsgi.staticresolver", QtWarningMsg)
+
+using namespace CWSGI;
+
+#ifdef Q_OS_UNIX
+static inline QDateTime modificationTime(const struct stat &st)
+{
+#if defined(Q_OS_DARWIN)
+    return QDateTime::fromMSecsSinceEpoch(qint64(st.st_mtimespec.tv_sec) * 1000 + st.st_mtimespec.tv_nsec / 1000000);
+#elif _POSIX_VERSION >= 200809L
+    return QDateTime::fromMSecsSinceEpoch(qint64(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000);
+#else
+    return QDateTime::fromMSecsSinceEpoch(qint64(st.st_mtime) * 1000);
+#endif
+}
+#endif
+
+StaticResolver::StaticResolver()
+{
+    // The root node
+    m_nodes.push_back(Node());
+}
+
+StaticResolver::~StaticResolver()
+{
+#ifdef Q_OS_UNIX
+    for (const Mount &mount : m_mounts) {
+        if (mount.fd != -1) {
+            ::close(mount.fd);
+        }
+    }
+#endif
+}
+
+void StaticResolver::addMountPoint(const QString &mountPoint, const QString &path, bool append)
+{
+    Mount mount;
+    mount.path = QDir(path).absolutePath();
+    mount.fd = -1;
+    mount.append = append;
+    // A descriptor would keep serving the old target once the link changes
+    mount.reopen = QFileInfo(mount.path).canonicalFilePath() != mount.path;
+
+#ifdef Q_OS_UNIX
+    if (mount.reopen) {
+        qCDebug(CWSGI_STATICRESOLVER) << "Opening" << mount.path << "on every request, it is reached through a symbolic link";
+    } else {
+        mount.fd = ::open(QFile::encodeName(mount.path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (mount.fd == -1) {
+            qCWarning(CWSGI_STATICRESOLVER) << "Could not open directory" << mount.path << qt_error_string(errno);
+        }
+    }
+#endif
+
+    const int mountIndex = int(m_mounts.size());
+    m_mounts.push_back(mount);
+
+    int node = 0;
+    const QStringList segments = Cutelyst::Utils::cleanRelativePath(mountPoint).split(QLatin1Char('/'), QString::SkipEmptyParts);
+    for (const QString &segment : segments) {
+        auto it = m_nodes[size_t(node)].children.constFind(segment);
+        if (it == m_nodes[size_t(node)].children.constEnd()) {
+            const int child = int(m_nodes.size());
+            m_nodes.push_back(Node());
+            m_nodes[size_t(node)].children.insert(segment, child);
+            node = child;
+        } else {
+            node = it.value();
+        }
+    }
+    m_nodes[size_t(node)].mounts.append(mountIndex);
+}
+
+void StaticResolver::setFollowSymlinks(bool follow)
+{
+    m_followSymlinks = follow;
+}
+
+QStringList StaticResolver::directories() const
+{
+    QStringList ret;
+    for (const Mount &mount : m_mounts) {
+        ret.append(mount.path);
+    }
+    return ret;
+}
+
+QVector<StaticResolver::Target> StaticResolver::resolve(const QString &path) const
+{
+    QVector<Target> targets;
+    const QString relPath = Cutelyst::Utils::cleanRelativePath(path);
+    if (relPath.isNull()) {
+        qCDebug(CWSGI_STATICRESOLVER) << "Refusing to resolve" << path;
+        return targets;
+    }
+
+    // Matching nodes and where the rest of the path starts on each
+    QVarLengthArray<QPair<int, int>, 8> matches;
+    const int size = relPath.size();
+    int node = 0;
+    int pos = 0;
+    Q_FOREVER {
+        const Node &current = m_nodes[size_t(node)];
+        if (!current.mounts.isEmpty()) {
+            matches.append(qMakePair(node, pos));
+        }
+
+        if (pos >= size) {
+            break;
+        }
+
+        int end = relPath.indexOf(QLatin1Char('/'), pos);
+        if (end == -1) {
+            end = size;
+        }
+
+        auto it = current.children.constFind(relPath.mid(pos, end - pos));
+        if (it == current.children.constEnd()) {
+            break;
+        }
+        node = it.value();
+        pos = end + 1;
+    }
+
+    // The most specific mount point wins, like it does on a file system
+    for (int i = matches.size() - 1; i >= 0; --i) {
+        const QPair<int, int> &match = matches.at(i);
+        for (int mountIndex : m_nodes[size_t(match.first)].mounts) {
+            const Mount &mount = m_mounts[size_t(mountIndex)];
+            const QString local = mount.append ? relPath : relPath.mid(match.second);
+            if (!local.isEmpty()) {
+                targets.append({ mount.path + QLatin1Char('/') + local, local, mountIndex });
+            }
+        }
+    }
+
+    return targets;
+}
+
+int StaticResolver::openRoot(const Target &target) const
+{
+#ifdef Q_OS_UNIX
+    const Mount &mount = m_mounts[size_t(target.mount)];
+    if (!mount.reopen) {
+        return mount.fd;
+    }
+    return ::open(QFile::encodeName(mount.path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#else
+    Q_UNUSED(target)
+    return -1;
+#endif
+}
+
+void StaticResolver::closeRoot(const Target &target, int rootFd) const
+{
+#ifdef Q_OS_UNIX
+    if (rootFd != -1 && m_mounts[size_t(target.mount)].reopen) {
+        ::close(rootFd);
+    }
+#else
+    Q_UNUSED(target)
+    Q_UNUSED(rootFd)
+#endif
+}
+
+int StaticResolver::openParent(const Target &target, int rootFd, QByteArray *name) const
+{
+#ifdef Q_OS_UNIX
+    if (m_followSymlinks) {
+        *name = QFile::encodeName(target.relPath);
+        return rootFd;
+    }
+
+    // Each directory is opened refusing symbolic links
+    const QByteArray relPath = QFile::encodeName(target.relPath);
+    int dirFd = rootFd;
+    int start = 0;
+    int slash;
+    while ((slash = relPath.indexOf('/', start)) != -1) {
+        const QByteArray segment = relPath.mid(start, slash - start);
+        const int fd = ::openat(dirFd, segment.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (dirFd != rootFd) {
+            ::close(dirFd);
+        }
+        if (fd == -1) {
+            return -1;
+        }
+        dirFd = fd;
+        start = slash + 1;
+    }
+    *name = relPath.mid(start);
+    return dirFd;
+#else
+    Q_UNUSED(target)
+    Q_UNUSED(rootFd)
+    Q_UNUSED(name)
+    return -1;
+#endif
+}
+
+bool StaticResolver::stat(const Target &target, qint64 *size, QDateTime *lastModified) const
+{
+#ifdef Q_OS_UNIX
+    const int rootFd = openRoot(target);
+    if (rootFd != -1) {
+        QByteArray name;
+        const int dirFd = openParent(target, rootFd, &name);
+        if (dirFd == -1) {
+            closeRoot(target, rootFd);
+            return false;
+        }
+
+        struct stat st;
+        const int ret = ::fstatat(dirFd, name.constData(), &st, m_followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW);
+        if (dirFd != rootFd) {
+            ::close(dirFd);
+        }
+        closeRoot(target, rootFd);
+        if (ret != 0 || !S_ISREG(st.st_mode)) {
+            return false;
+        }
+
+        *size = st.st_size;
+        *lastModified = modificationTime(st);
+        return true;
+    }
+#endif
+
+    const QFileInfo info(target.filename);
+    if (!info.isFile() || (!m_followSymlinks && info.isSymLink())) {
+        return false;
+    }
+    *size = info.size();
+    *lastModified = info.lastModified();
+    return true;
+}
+
+QFile *StaticResolver::open(const Target &target, qint64 *size, QDateTime *lastModified) const
+{
+#ifdef Q_OS_UNIX
+    const int rootFd = openRoot(target);
+    if (rootFd != -1) {
+        QByteArray name;
+        const int dirFd = openParent(target, rootFd, &name);
+        if (dirFd == -1) {
+            closeRoot(target, rootFd);
+            return nullptr;
+        }
+
+        const int fd = ::openat(dirFd, name.constData(), O_RDONLY | O_CLOEXEC | (m_followSymlinks ? 0 : O_NOFOLLOW));
+        if (dirFd != rootFd) {
+            ::close(dirFd);
+        }
+        closeRoot(target, rootFd);
+        if (fd == -1) {
+            return nullptr;
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return nullptr;
+        }
+        if (size) {
+            *size = st.st_size;
+        }
+        if (lastModified) {
+            *lastModified = modificationTime(st);
+        }
+
+        // The name is only informative, reads use the descriptor
+        auto file = new QFile(target.filename);
+        if (!file->open(fd, QFile::ReadOnly, QFileDevice::AutoCloseHandle)) {
+            qCWarning(CWSGI_STATICRESOLVER) << "Could not open" << target.filename << file->errorString();
+            ::close(fd);
+            delete file;
+            return nullptr;
+        }
+        return file;
+    }
+#endif
+
+    qint64 fileSize;
+    QDateTime fileLastModified;
+    if (!stat(target, &fileSize, &fileLastModified)) {
+        return nullptr;
+    }
+
+    auto file = new QFile(target.filename);
+    if (!file->open(QFile::ReadOnly)) {
+        qCWarning(CWSGI_STATICRESOLVER) << "Could not open" << target.filename << file->errorString();
+        delete file;
+        return nullptr;
+    }
+    if (size) {
+        *size = fileSize;
+    }
+    if (lastModified) {
+        *lastModified = fileLastModified;
+    }
+    return file;
+}
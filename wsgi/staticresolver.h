@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef STATICRESOLVER_H
+#define STATICRESOLVER_H
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QVector>
+#include <QHash>
+
+#include <vector>
+
+class QFile;
+
+namespace CWSGI {
+
+/**
+ * Maps request paths to files below the static map directories.
+ *
+ * The path is cleaned once and refused if it has ".." segments, mount
+ * points are matched walking a trie of their path segments and, on Unix,
+ * files are reached with openat() from the directory descriptors opened
+ * when the mount points were added, so they can not escape them. Symbolic
+ * links can be refused, checking every segment of the path.
+ *
+ * Directories reached through a symbolic link, like a "current" link
+ * switched by deployments, are opened again for every lookup so that the
+ * new target is served instead of the one found at startup.
+ *
+ * Lookups are thread-safe once all mount points are added.
+ */
+class StaticResolver
+{
+public:
+    struct Target {
+        // The mount point directory joined with relPath
+        QString filename;
+        QString relPath;
+        int mount;
+    };
+
+    StaticResolver();
+    ~StaticResolver();
+
+    void addMountPoint(const QString &mountPoint, const QString &path, bool append);
+
+    void setFollowSymlinks(bool follow);
+
+    QStringList directories() const;
+
+    // Targets of the mount points matching path, deeper mount points first
+    // and then in the order they were added, empty if path could escape
+    // the directories
+    QVector<Target> resolve(const QString &path) const;
+
+    // Returns true if target is a regular file
+    bool stat(const Target &target, qint64 *size, QDateTime *lastModified) const;
+
+    // Returns the open regular file of target or nullptr
+    QFile *open(const Target &target, qint64 *size = nullptr, QDateTime *lastModified = nullptr) const;
+
+private:
+    struct Mount {
+        QString path;
+        int fd;
+        bool append;
+        // The path goes through a symbolic link
+        bool reopen;
+    };
+
+    struct Node {
+        QHash<QString, int> children;
+        QVector<int> mounts;
+    };
+
+    inline int openRoot(const Target &target) const;
+    inline void closeRoot(const Target &target, int rootFd) const;
+    inline int openParent(const Target &target, int rootFd, QByteArray *name) const;
+
+    std::vector<Mount> m_mounts;
+    std::vector<Node> m_nodes;
+    bool m_followSymlinks = true;
+};
+
+}
+
+#endif // STATICRESOLVER_H
@@ -31,6 +31,7 @@ TcpServer::TcpServer(const QString &serverAddress, Protocol *protocol, WSGI *wsg
   , m_protocol(protocol)
 {
     m_engine = qobject_cast<CWsgiEngine*>(parent);
+    m_maxConnectionsPerIp = m_wsgi->maxConnectionsPerIp();
 
     if (m_wsgi->tcpNodelay()) {
         m_socketOptions.push_back({ QAbstractSocket::LowDelayOption, 1 });
@@ -58,10 +59,12 @@ void TcpServer::incomingConnection(qintptr handle)
         sock->protoData = m_protocol->createData(sock);
 
         connect(sock, &QIODevice::readyRead, [sock] () {
-            sock->timeout = false;
             sock->proto->parse(sock, sock);
+            sock->startTimeout();
         });
         connect(sock, &TcpSocket::finished, this, [this, sock] () {
+            sock->stopTimeout();
+            removeConnection(sock->remoteAddress);
             sock->resetSocket();
             m_socks.push_back(sock);
             --m_processing;
@@ -79,8 +82,12 @@ void TcpServer::incomingConnection(qintptr handle)
             sock->setSocketOption(opt.first, opt.second);
         }
 
-        if (++m_processing) {
-            m_engine->startSocketTimeout();
+        ++m_processing;
+        if (Q_LIKELY(addConnection(sock->remoteAddress))) {
+            sock->startTimeout();
+        } else {
+            // Goes through finished() like any other connection
+            sock->connectionClose();
         }
     } else {
         m_socks.push_back(sock);
@@ -111,23 +118,6 @@ void TcpServer::shutdown()
     }
 }
 
-void TcpServer::timeoutConnections()
-{
-    if (m_processing) {
-        const auto childrenL = children();
-        for (auto child : childrenL) {
-            auto socket = qobject_cast<TcpSocket*>(child);
-            if (socket && !socket->processing && socket->state() == QAbstractSocket::ConnectedState) {
-                if (socket->timeout) {
-                    socket->connectionClose();
-                } else {
-                    socket->timeout = true;
-                }
-            }
-        }
-    }
-}
-
 Protocol *TcpServer::protocol() const
 {
     return m_protocol;
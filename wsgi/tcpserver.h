@@ -19,6 +19,8 @@
 #define TCPSERVER_H
 
 #include <QTcpServer>
+#include <QHostAddress>
+#include <QHash>
 
 namespace CWSGI {
 
@@ -36,7 +38,6 @@ public:
     virtual void incomingConnection(qintptr handle) override;
 
     virtual void shutdown();
-    virtual void timeoutConnections();
 
     Protocol *protocol() const;
     void setProtocol(Protocol *protocol);
@@ -47,13 +48,29 @@ Q_SIGNALS:
 protected:
     friend class TcpServerBalancer;
 
+    // Returns false if the address exceeds max_connections_per_ip
+    inline bool addConnection(const QHostAddress &address) {
+        return !m_maxConnectionsPerIp || ++m_connectionsPerIp[address] <= m_maxConnectionsPerIp;
+    }
+
+    inline void removeConnection(const QHostAddress &address) {
+        if (m_maxConnectionsPerIp) {
+            auto it = m_connectionsPerIp.find(address);
+            if (it != m_connectionsPerIp.end() && --it.value() == 0) {
+                m_connectionsPerIp.erase(it);
+            }
+        }
+    }
+
     QString m_serverAddress;
     CWsgiEngine *m_engine;
     WSGI *m_wsgi;
 
     std::vector<std::pair<QAbstractSocket::SocketOption, QVariant> > m_socketOptions;
     std::vector<TcpSocket *> m_socks;
+    QHash<QHostAddress, int> m_connectionsPerIp;
     Protocol *m_protocol;
+    int m_maxConnectionsPerIp;
     int m_processing = 0;
 };
 
@@ -24,6 +24,7 @@
 
 #include <QFile>
 #include <QLoggingCategory>
+#include <QThread>
 
 #include <QSslKey>
 
@@ -34,6 +35,11 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <fcntl.h>
+#include <linux/filter.h>
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
 #endif
 
 
@@ -43,6 +49,7 @@ using namespace CWSGI;
 
 #ifdef Q_OS_LINUX
 int listenReuse(const QHostAddress &address, quint16 port, bool startListening);
+bool attachReuseCpuProgram(int socket, quint32 groupSize);
 #endif
 
 TcpServerBalancer::TcpServerBalancer(WSGI *wsgi) : QTcpServer(wsgi)
@@ -148,6 +155,34 @@ bool TcpServerBalancer::listen(const QString &line, Protocol *protocol, bool sec
                       << " : " << qPrintable(errorString()) << std::endl;
             exit(1);
         }
+
+        if (m_wsgi->reusePortCbpf()) {
+            // One listening socket per worker thread, created before forking so
+            // their position in the reuse port group matches the worker slot
+            auto workerCount = [] (const QString &value) {
+                if (value == QLatin1String("auto")) {
+                    return QThread::idealThreadCount();
+                }
+                return qMax(1, value.toInt());
+            };
+            m_threads = workerCount(m_wsgi->threads());
+            const int workers = workerCount(m_wsgi->processes()) * m_threads;
+            for (int i = 0; i < workers; ++i) {
+                int groupSocket = listenReuse(address, port, true);
+                if (groupSocket < 0) {
+                    std::cerr << "Failed to listen on TCP: " << qPrintable(line) << std::endl;
+                    exit(1);
+                }
+                m_reuseGroup.push_back(groupSocket);
+            }
+
+            if (!attachReuseCpuProgram(m_reuseGroup.front(), quint32(workers))) {
+                std::cerr << "Failed to attach SO_ATTACH_REUSEPORT_CBPF program (Linux 4.6+), "
+                             "connections will be hashed by the kernel" << std::endl;
+            } else if (m_wsgi->cpuAffinity() != 1) {
+                std::cerr << "*** WARNING: reuse-port-cbpf should be used with cpu-affinity 1 ***" << std::endl;
+            }
+        }
     } else {
 #endif
         bool ret = QTcpServer::listen(address, port);
@@ -383,6 +418,27 @@ int listenReuse(const QHostAddress &address, quint16 port, bool startListening)
 
     return socket;
 }
+
+bool attachReuseCpuProgram(int socket, quint32 groupSize)
+{
+    // Returns the index of the socket in the group: CPU % group size,
+    // worker slot N is pinned to CPU N with cpu-affinity 1
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, quint32(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, groupSize },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+
+    struct sock_fprog prog;
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+
+    if (::setsockopt(socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog))) {
+        qCCritical(CWSGI_BALANCER) << "Failed to attach reuse port CPU program on socket" << socket;
+        return false;
+    }
+    return true;
+}
 #endif // Q_OS_LINUX
 
 void TcpServerBalancer::setBalancer(bool enable)
@@ -422,7 +478,14 @@ TcpServer *TcpServerBalancer::createServer(CWsgiEngine *engine)
 #ifdef Q_OS_LINUX
         if (m_wsgi->reusePort()) {
             connect(engine, &CWsgiEngine::started, this, [=] () {
-                int socket = listenReuse(m_address, m_port, true);
+                int socket;
+                if (m_reuseGroup.empty()) {
+                    socket = listenReuse(m_address, m_port, true);
+                } else {
+                    const size_t slot = size_t(engine->workerId() * m_threads + engine->workerCore());
+                    socket = m_reuseGroup.at(slot % m_reuseGroup.size());
+                }
+
                 if (!server->setSocketDescriptor(socket)) {
                     qFatal("Failed to set server socket descriptor, reuse-port");
                 }
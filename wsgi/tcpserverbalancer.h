@@ -50,10 +50,12 @@ private:
     quint16 m_port = 0;
     QString m_serverName;
     std::vector<TcpServer *> m_servers;
+    std::vector<int> m_reuseGroup;
     WSGI *m_wsgi;
     Protocol *m_protocol = nullptr;
     QSslConfiguration *m_sslConfiguration = nullptr;
     int m_currentServer = 0;
+    int m_threads = 1;
     bool m_balancer = false;
 };
 
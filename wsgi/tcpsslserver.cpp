@@ -40,10 +40,12 @@ void TcpSslServer::incomingConnection(qintptr handle)
     sock->setSslConfiguration(m_sslConfiguration);
 
     connect(sock, &QIODevice::readyRead, this, [sock] () {
-        sock->timeout = false;
         sock->proto->parse(sock, sock);
+        sock->startTimeout();
     });
     connect(sock, &SslSocket::finished, this, [this, sock] () {
+        sock->stopTimeout();
+        removeConnection(sock->remoteAddress);
         sock->deleteLater();
         --m_processing;
     });
@@ -60,9 +62,12 @@ void TcpSslServer::incomingConnection(qintptr handle)
             sock->setSocketOption(opt.first, opt.second);
         }
 
-        if (++m_processing) {
-            m_engine->startSocketTimeout();
+        ++m_processing;
+        if (Q_UNLIKELY(!addConnection(sock->remoteAddress))) {
+            sock->connectionClose();
+            return;
         }
+        sock->startTimeout();
 
         sock->startServerEncryption();
         if (m_http2Protocol) {
@@ -100,23 +105,6 @@ void TcpSslServer::shutdown()
     }
 }
 
-void TcpSslServer::timeoutConnections()
-{
-    if (m_processing) {
-        const auto childrenL = children();
-        for (auto child : childrenL) {
-            auto socket = qobject_cast<SslSocket*>(child);
-            if (socket && !socket->processing && socket->state() == QAbstractSocket::ConnectedState) {
-                if (socket->timeout) {
-                    socket->connectionClose();
-                } else {
-                    socket->timeout = true;
-                }
-            }
-        }
-    }
-}
-
 void TcpSslServer::setSslConfiguration(const QSslConfiguration &conf)
 {
     m_sslConfiguration = conf;
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "timerwheel.h"
+
+using namespace CWSGI;
+
+TimerWheelNode::~TimerWheelNode()
+{
+    if (m_timerWheel) {
+        m_timerWheel->cancel(this);
+    }
+}
+
+TimerWheel::TimerWheel(int resolution, QObject *parent) : QObject(parent)
+  , m_slots()
+  , m_timer(this)
+  , m_resolution(qMax(1, resolution))
+{
+    m_clock.start();
+    m_timer.setInterval(m_resolution);
+    connect(&m_timer, &QTimer::timeout, this, &TimerWheel::advance);
+}
+
+TimerWheel::~TimerWheel()
+{
+    // Nodes might outlive us (sockets are deleted after the engine children)
+    for (TimerWheelNode *node : m_slots) {
+        while (node) {
+            TimerWheelNode *next = node->m_timerNext;
+            node->m_timerNext = nullptr;
+            node->m_timerPrev = nullptr;
+            node->m_timerWheel = nullptr;
+            node = next;
+        }
+    }
+}
+
+void TimerWheel::start(TimerWheelNode *node, qint64 msec)
+{
+    if (node->m_timerWheel) {
+        node->m_timerWheel->unlink(node);
+    }
+    node->m_timerPending = false;
+
+    const quint64 now = currentTick();
+    if (m_count == 0) {
+        m_tick = now;
+        m_timer.start();
+    }
+
+    const quint64 ticks = qMax(quint64(1), quint64(msec + m_resolution - 1) / quint64(m_resolution));
+    node->m_timerDeadline = qMax(now, m_tick) + ticks;
+    node->m_timerWheel = this;
+
+    TimerWheelNode *&head = m_slots[node->m_timerDeadline & SlotMask];
+    node->m_timerPrev = nullptr;
+    node->m_timerNext = head;
+    if (head) {
+        head->m_timerPrev = node;
+    }
+    head = node;
+    ++m_count;
+}
+
+void TimerWheel::cancel(TimerWheelNode *node)
+{
+    node->m_timerPending = false;
+    if (node->m_timerWheel == this) {
+        unlink(node);
+        if (m_count == 0) {
+            m_timer.stop();
+        }
+    }
+}
+
+void TimerWheel::unlink(TimerWheelNode *node)
+{
+    if (node->m_timerPrev) {
+        node->m_timerPrev->m_timerNext = node->m_timerNext;
+    } else {
+        m_slots[node->m_timerDeadline & SlotMask] = node->m_timerNext;
+    }
+
+    if (node->m_timerNext) {
+        node->m_timerNext->m_timerPrev = node->m_timerPrev;
+    }
+
+    node->m_timerNext = nullptr;
+    node->m_timerPrev = nullptr;
+    node->m_timerWheel = nullptr;
+    --m_count;
+}
+
+void TimerWheel::advance()
+{
+    const quint64 now = currentTick();
+    if (now <= m_tick) {
+        return;
+    }
+
+    // Only the slots of the elapsed ticks can hold expired nodes,
+    // nodes further away in time are skipped until their round comes
+    const quint64 steps = qMin(now - m_tick, quint64(Slots));
+    for (quint64 i = 1; i <= steps; ++i) {
+        TimerWheelNode *node = m_slots[(m_tick + i) & SlotMask];
+        while (node) {
+            TimerWheelNode *next = node->m_timerNext;
+            if (node->m_timerDeadline <= now) {
+                unlink(node);
+                node->m_timerPending = true;
+                m_expired.push_back(node);
+            }
+            node = next;
+        }
+    }
+    m_tick = now;
+
+    // Expire only after the wheel is consistent as
+    // nodes are allowed to re-arm or cancel each other
+    for (TimerWheelNode *node : m_expired) {
+        if (node->m_timerPending) {
+            node->m_timerPending = false;
+            node->timerWheelExpired();
+        }
+    }
+    m_expired.clear();
+
+    if (m_count == 0) {
+        m_timer.stop();
+    }
+}
+
+#include "moc_timerwheel.cpp"
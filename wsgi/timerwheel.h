@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018 Daniel Nicoletti <dantti12@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include <vector>
+
+namespace CWSGI {
+
+class TimerWheel;
+class TimerWheelNode
+{
+public:
+    virtual ~TimerWheelNode();
+
+    inline bool isTimerArmed() const { return m_timerWheel; }
+
+protected:
+    // Called from the wheel once the deadline is reached,
+    // the node is already unlinked so it may re-arm itself
+    virtual void timerWheelExpired() = 0;
+
+private:
+    friend class TimerWheel;
+
+    TimerWheelNode *m_timerNext = nullptr;
+    TimerWheelNode *m_timerPrev = nullptr;
+    TimerWheel *m_timerWheel = nullptr;
+    quint64 m_timerDeadline = 0;
+    bool m_timerPending = false;
+};
+
+/**
+ * Hashed timing wheel, nodes are intrusive so arming,
+ * re-arming and cancelling are O(1) without allocations,
+ * advancing only visits the slots of the elapsed ticks.
+ */
+class TimerWheel : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TimerWheel(int resolution, QObject *parent = nullptr);
+    ~TimerWheel() override;
+
+    // (Re)arms node to expire after msec milliseconds
+    void start(TimerWheelNode *node, qint64 msec);
+    void cancel(TimerWheelNode *node);
+
+    inline int count() const { return m_count; }
+
+private:
+    enum {
+        Slots = 512,
+        SlotMask = Slots - 1
+    };
+
+    inline quint64 currentTick() const {
+        return quint64(m_clock.elapsed()) / quint64(m_resolution);
+    }
+    void unlink(TimerWheelNode *node);
+    void advance();
+
+    TimerWheelNode *m_slots[Slots];
+    std::vector<TimerWheelNode *> m_expired;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    quint64 m_tick = 0;
+    int m_resolution;
+    int m_count = 0;
+};
+
+}
+
+#endif // TIMERWHEEL_H
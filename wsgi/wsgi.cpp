@@ -25,6 +25,7 @@
 #include "socket.h"
 #include "tcpserverbalancer.h"
 #include "localserver.h"
+#include "staticfilecache.h"
 
 #ifdef Q_OS_UNIX
 #include "unixfork.h"
@@ -190,6 +191,26 @@ void WSGI::parseCommandLine(const QStringList &arguments)
                                      QCoreApplication::translate("main", "seconds"));
     parser.addOption(socketTimeout);
 
+    QCommandLineOption headerTimeoutOpt(QStringLiteral("header-timeout"),
+                                        QCoreApplication::translate("main", "set timeout to receive complete request headers (defaults to socket-timeout)"),
+                                        QCoreApplication::translate("main", "seconds"));
+    parser.addOption(headerTimeoutOpt);
+
+    QCommandLineOption bodyTimeoutOpt(QStringLiteral("body-timeout"),
+                                      QCoreApplication::translate("main", "set timeout between request body reads (defaults to socket-timeout)"),
+                                      QCoreApplication::translate("main", "seconds"));
+    parser.addOption(bodyTimeoutOpt);
+
+    QCommandLineOption bodyMinRateOpt(QStringLiteral("body-min-rate"),
+                                      QCoreApplication::translate("main", "disconnect clients sending the request body slower than this"),
+                                      QCoreApplication::translate("main", "bytes per second"));
+    parser.addOption(bodyMinRateOpt);
+
+    QCommandLineOption maxConnectionsPerIpOpt(QStringLiteral("max-connections-per-ip"),
+                                              QCoreApplication::translate("main", "limit concurrent TCP connections of a remote address on each worker thread"),
+                                              QCoreApplication::translate("main", "connections"));
+    parser.addOption(maxConnectionsPerIpOpt);
+
     QCommandLineOption staticMapOpt(QStringLiteral("static-map"),
                                     QCoreApplication::translate("main", "map mountpoint to static directory (or file)"),
                                     QCoreApplication::translate("main", "mountpoint=path"));
@@ -200,6 +221,29 @@ void WSGI::parseCommandLine(const QStringList &arguments)
                                      QCoreApplication::translate("main", "mountpoint=path"));
     parser.addOption(staticMap2Opt);
 
+    QCommandLineOption staticMapCacheSizeOpt(QStringLiteral("static-map-cache-size"),
+                                             QCoreApplication::translate("main", "size of the in memory cache of static map files"),
+                                             QCoreApplication::translate("main", "bytes"));
+    parser.addOption(staticMapCacheSizeOpt);
+
+    QCommandLineOption staticMapCacheFileSizeOpt(QStringLiteral("static-map-cache-file-size"),
+                                                 QCoreApplication::translate("main", "maximum size of a static map file held in memory (default 64KiB)"),
+                                                 QCoreApplication::translate("main", "bytes"));
+    parser.addOption(staticMapCacheFileSizeOpt);
+
+    QCommandLineOption staticMapImmutableOpt(QStringLiteral("static-map-immutable"),
+                                             QCoreApplication::translate("main", "regular expression of static map paths sent as immutable"),
+                                             QCoreApplication::translate("main", "pattern"));
+    parser.addOption(staticMapImmutableOpt);
+
+    QCommandLineOption staticMapFastPathOpt(QStringLiteral("static-map-fast-path"),
+                                            QCoreApplication::translate("main", "serve static map files from the protocol layer, bypassing the application"));
+    parser.addOption(staticMapFastPathOpt);
+
+    QCommandLineOption staticMapRefuseSymlinksOpt(QStringLiteral("static-map-refuse-symlinks"),
+                                                  QCoreApplication::translate("main", "do not follow symbolic links below static map directories"));
+    parser.addOption(staticMapRefuseSymlinksOpt);
+
     QCommandLineOption autoReload({ QStringLiteral("auto-restart"), QStringLiteral("r") },
                                   QCoreApplication::translate("main", "auto restarts when the application file changes"));
     parser.addOption(autoReload);
@@ -282,6 +326,10 @@ void WSGI::parseCommandLine(const QStringList &arguments)
     QCommandLineOption reusePortOption(QStringLiteral("reuse-port"),
                                        QCoreApplication::translate("main", "enable SO_REUSEPORT flag on socket (Linux 3.9+)"));
     parser.addOption(reusePortOption);
+
+    QCommandLineOption reusePortCbpfOption(QStringLiteral("reuse-port-cbpf"),
+                                           QCoreApplication::translate("main", "steer reuse-port connections to the worker thread pinned to the receiving CPU (Linux 4.6+)"));
+    parser.addOption(reusePortCbpfOption);
 #endif
 
     QCommandLineOption threadBalancerOpt(QStringLiteral("experimental-thread-balancer"),
@@ -335,6 +383,42 @@ void WSGI::parseCommandLine(const QStringList &arguments)
         }
     }
 
+    if (parser.isSet(headerTimeoutOpt)) {
+        bool ok;
+        auto size = parser.value(headerTimeoutOpt).toInt(&ok);
+        setHeaderTimeout(size);
+        if (!ok || size < 0) {
+            parser.showHelp(1);
+        }
+    }
+
+    if (parser.isSet(bodyTimeoutOpt)) {
+        bool ok;
+        auto size = parser.value(bodyTimeoutOpt).toInt(&ok);
+        setBodyTimeout(size);
+        if (!ok || size < 0) {
+            parser.showHelp(1);
+        }
+    }
+
+    if (parser.isSet(bodyMinRateOpt)) {
+        bool ok;
+        auto rate = parser.value(bodyMinRateOpt).toLongLong(&ok);
+        setBodyMinRate(rate);
+        if (!ok || rate < 0) {
+            parser.showHelp(1);
+        }
+    }
+
+    if (parser.isSet(maxConnectionsPerIpOpt)) {
+        bool ok;
+        auto max = parser.value(maxConnectionsPerIpOpt).toInt(&ok);
+        setMaxConnectionsPerIp(max);
+        if (!ok || max < 0) {
+            parser.showHelp(1);
+        }
+    }
+
     if (parser.isSet(pidfileOpt)) {
         setPidfile(parser.value(pidfileOpt));
     }
@@ -386,6 +470,10 @@ void WSGI::parseCommandLine(const QStringList &arguments)
     if (parser.isSet(reusePortOption)) {
         setReusePort(true);
     }
+
+    if (parser.isSet(reusePortCbpfOption)) {
+        setReusePortCbpf(true);
+    }
 #endif
 
     if (parser.isSet(lazyOption)) {
@@ -419,6 +507,36 @@ void WSGI::parseCommandLine(const QStringList &arguments)
         }
     }
 
+    if (parser.isSet(staticMapCacheSizeOpt)) {
+        bool ok;
+        auto size = parser.value(staticMapCacheSizeOpt).toLongLong(&ok);
+        setStaticMapCacheSize(size);
+        if (!ok || size < 0) {
+            parser.showHelp(1);
+        }
+    }
+
+    if (parser.isSet(staticMapCacheFileSizeOpt)) {
+        bool ok;
+        auto size = parser.value(staticMapCacheFileSizeOpt).toLongLong(&ok);
+        setStaticMapCacheFileSize(size);
+        if (!ok || size < 0) {
+            parser.showHelp(1);
+        }
+    }
+
+    if (parser.isSet(staticMapImmutableOpt)) {
+        setStaticMapImmutable(parser.value(staticMapImmutableOpt));
+    }
+
+    if (parser.isSet(staticMapFastPathOpt)) {
+        setStaticMapFastPath(true);
+    }
+
+    if (parser.isSet(staticMapRefuseSymlinksOpt)) {
+        setStaticMapRefuseSymlinks(true);
+    }
+
     if (parser.isSet(application)) {
         setApplication(parser.value(application));
     }
@@ -598,6 +716,11 @@ int WSGI::exec(Cutelyst::Application *app)
 
     d->app = app;
 
+    // Shared by all engines, on the main thread where the file watcher is
+    if (d->staticMapCacheSize > 0 && (!d->staticMaps.isEmpty() || !d->staticMaps2.isEmpty())) {
+        d->staticCache = new StaticFileCache(d->staticMapCacheSize, d->staticMapCacheFileSize, d);
+    }
+
     if (!d->lazy) {
         d->setupApplication();
     }
@@ -985,6 +1108,58 @@ int WSGI::socketTimeout() const
     return d->socketTimeout;
 }
 
+void WSGI::setHeaderTimeout(int timeout)
+{
+    Q_D(WSGI);
+    d->headerTimeout = timeout;
+    Q_EMIT changed();
+}
+
+int WSGI::headerTimeout() const
+{
+    Q_D(const WSGI);
+    return d->headerTimeout;
+}
+
+void WSGI::setBodyTimeout(int timeout)
+{
+    Q_D(WSGI);
+    d->bodyTimeout = timeout;
+    Q_EMIT changed();
+}
+
+int WSGI::bodyTimeout() const
+{
+    Q_D(const WSGI);
+    return d->bodyTimeout;
+}
+
+void WSGI::setBodyMinRate(qint64 rate)
+{
+    Q_D(WSGI);
+    d->bodyMinRate = rate;
+    Q_EMIT changed();
+}
+
+qint64 WSGI::bodyMinRate() const
+{
+    Q_D(const WSGI);
+    return d->bodyMinRate;
+}
+
+void WSGI::setMaxConnectionsPerIp(int max)
+{
+    Q_D(WSGI);
+    d->maxConnectionsPerIp = max;
+    Q_EMIT changed();
+}
+
+int WSGI::maxConnectionsPerIp() const
+{
+    Q_D(const WSGI);
+    return d->maxConnectionsPerIp;
+}
+
 void WSGI::setChdir2(const QString &chdir2)
 {
     Q_D(WSGI);
@@ -1050,6 +1225,71 @@ QStringList WSGI::staticMap2() const
     return d->staticMaps2;
 }
 
+void WSGI::setStaticMapCacheSize(qint64 size)
+{
+    Q_D(WSGI);
+    d->staticMapCacheSize = size;
+    Q_EMIT changed();
+}
+
+qint64 WSGI::staticMapCacheSize() const
+{
+    Q_D(const WSGI);
+    return d->staticMapCacheSize;
+}
+
+void WSGI::setStaticMapCacheFileSize(qint64 size)
+{
+    Q_D(WSGI);
+    d->staticMapCacheFileSize = size;
+    Q_EMIT changed();
+}
+
+qint64 WSGI::staticMapCacheFileSize() const
+{
+    Q_D(const WSGI);
+    return d->staticMapCacheFileSize;
+}
+
+void WSGI::setStaticMapImmutable(const QString &pattern)
+{
+    Q_D(WSGI);
+    d->staticMapImmutable = pattern;
+    Q_EMIT changed();
+}
+
+QString WSGI::staticMapImmutable() const
+{
+    Q_D(const WSGI);
+    return d->staticMapImmutable;
+}
+
+void WSGI::setStaticMapFastPath(bool enable)
+{
+    Q_D(WSGI);
+    d->staticMapFastPath = enable;
+    Q_EMIT changed();
+}
+
+bool WSGI::staticMapFastPath() const
+{
+    Q_D(const WSGI);
+    return d->staticMapFastPath;
+}
+
+void WSGI::setStaticMapRefuseSymlinks(bool enable)
+{
+    Q_D(WSGI);
+    d->staticMapRefuseSymlinks = enable;
+    Q_EMIT changed();
+}
+
+bool WSGI::staticMapRefuseSymlinks() const
+{
+    Q_D(const WSGI);
+    return d->staticMapRefuseSymlinks;
+}
+
 void WSGI::setMaster(bool enable)
 {
     Q_D(WSGI);
@@ -1336,6 +1576,21 @@ bool WSGI::reusePort() const
     return d->reusePort;
 }
 
+void WSGI::setReusePortCbpf(bool enable)
+{
+#ifdef Q_OS_LINUX
+    Q_D(WSGI);
+    d->reusePortCbpf = enable;
+    Q_EMIT changed();
+#endif
+}
+
+bool WSGI::reusePortCbpf() const
+{
+    Q_D(const WSGI);
+    return d->reusePortCbpf;
+}
+
 void WSGI::setLazy(bool enable)
 {
     Q_D(WSGI);
@@ -1390,6 +1645,12 @@ void WSGIPrivate::setupApplication()
         //        QCoreApplication::setApplicationName(QString::fromLatin1(app->metaObject()->className()));
         //    }
         qCDebug(CUTELYST_WSGI) << "Loaded application: " << QCoreApplication::applicationName();
+
+        // Engines only own the instances they create,
+        // a shared one must outlive all of them
+        if (localApp->isThreadShared()) {
+            localApp->setParent(this);
+        }
     }
 
     if (!chdir2.isEmpty()) {
@@ -1503,7 +1764,7 @@ CWsgiEngine *WSGIPrivate::createEngine(Application *app, int core)
 {
     Q_Q(WSGI);
 
-    auto engine = new CWsgiEngine(app, core, opt, q);
+    auto engine = new CWsgiEngine(app, core, opt, q, staticCache);
     connect(this, &WSGIPrivate::shutdown, engine, &CWsgiEngine::shutdown, Qt::QueuedConnection);
     connect(this, &WSGIPrivate::postForked, engine, &CWsgiEngine::postFork, Qt::QueuedConnection);
     connect(engine, &CWsgiEngine::shutdownCompleted, this, &WSGIPrivate::engineShutdown, Qt::QueuedConnection);
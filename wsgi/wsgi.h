@@ -191,6 +191,42 @@ public:
     void setSocketTimeout(int timeout);
     int socketTimeout() const;
 
+    /**
+     * Defines the timeout in seconds to receive a complete HTTP/1 request header counting
+     * from its first byte, if 0 the socket_timeout value is used
+     * @accessors headerTimeout(), setHeaderTimeout()
+     */
+    Q_PROPERTY(int header_timeout READ headerTimeout WRITE setHeaderTimeout NOTIFY changed)
+    void setHeaderTimeout(int timeout);
+    int headerTimeout() const;
+
+    /**
+     * Defines the timeout in seconds between reads of a request body, or of a
+     * partial HTTP/2 frame or FastCGI record, if 0 the socket_timeout value is used
+     * @accessors bodyTimeout(), setBodyTimeout()
+     */
+    Q_PROPERTY(int body_timeout READ bodyTimeout WRITE setBodyTimeout NOTIFY changed)
+    void setBodyTimeout(int timeout);
+    int bodyTimeout() const;
+
+    /**
+     * Defines the minimum rate in bytes per second a request body must be
+     * received with, slower clients are disconnected, 0 disables (default)
+     * @accessors bodyMinRate(), setBodyMinRate()
+     */
+    Q_PROPERTY(qint64 body_min_rate READ bodyMinRate WRITE setBodyMinRate NOTIFY changed)
+    void setBodyMinRate(qint64 rate);
+    qint64 bodyMinRate() const;
+
+    /**
+     * Defines the maximum number of concurrent TCP connections of a single
+     * remote address on each worker thread, 0 disables (default)
+     * @accessors maxConnectionsPerIp(), setMaxConnectionsPerIp()
+     */
+    Q_PROPERTY(int max_connections_per_ip READ maxConnectionsPerIp WRITE setMaxConnectionsPerIp NOTIFY changed)
+    void setMaxConnectionsPerIp(int max);
+    int maxConnectionsPerIp() const;
+
     /**
      * Defines directory to chdir to after application loading
      * @accessors chdir2(), setChdir2()
@@ -231,6 +267,55 @@ public:
     void setStaticMap2(const QStringList &staticMap);
     QStringList staticMap2() const;
 
+    /**
+     * Defines the size in bytes of the in memory cache of static map files shared
+     * by all threads of a worker, entries hold their headers precomputed and are
+     * invalidated when the file changes, 0 disables (default)
+     * @accessors staticMapCacheSize(), setStaticMapCacheSize()
+     */
+    Q_PROPERTY(qint64 static_map_cache_size READ staticMapCacheSize WRITE setStaticMapCacheSize NOTIFY changed)
+    void setStaticMapCacheSize(qint64 size);
+    qint64 staticMapCacheSize() const;
+
+    /**
+     * Defines the maximum size in bytes of a static map file to be held in memory
+     * by the static map cache, larger files only have their headers cached, defaults to 64KiB
+     * @accessors staticMapCacheFileSize(), setStaticMapCacheFileSize()
+     */
+    Q_PROPERTY(qint64 static_map_cache_file_size READ staticMapCacheFileSize WRITE setStaticMapCacheFileSize NOTIFY changed)
+    void setStaticMapCacheFileSize(qint64 size);
+    qint64 staticMapCacheFileSize() const;
+
+    /**
+     * Defines a regular expression matching the request paths of fingerprinted static
+     * map files, like app.3f2a9c1d.js, that are sent with "Cache-Control: public,
+     * max-age=31536000, immutable" so browsers do not revalidate them, empty disables (default)
+     * @accessors staticMapImmutable(), setStaticMapImmutable()
+     */
+    Q_PROPERTY(QString static_map_immutable READ staticMapImmutable WRITE setStaticMapImmutable NOTIFY changed)
+    void setStaticMapImmutable(const QString &pattern);
+    QString staticMapImmutable() const;
+
+    /**
+     * Serves static map files straight from the HTTP/1.1 and HTTP/2 protocol layers, without
+     * creating a Context, so the application (plugins, response compression, stats) does not
+     * see those requests. Range requests, files larger than 1 MiB and HTTP/2 responses larger
+     * than the flow control window still go through the application, defaults to false
+     * @accessors staticMapFastPath(), setStaticMapFastPath()
+     */
+    Q_PROPERTY(bool static_map_fast_path READ staticMapFastPath WRITE setStaticMapFastPath NOTIFY changed)
+    void setStaticMapFastPath(bool enable);
+    bool staticMapFastPath() const;
+
+    /**
+     * Refuses to serve static map files when any segment of their path below the mapped
+     * directory is a symbolic link, defaults to false
+     * @accessors staticMapRefuseSymlinks(), setStaticMapRefuseSymlinks()
+     */
+    Q_PROPERTY(bool static_map_refuse_symlinks READ staticMapRefuseSymlinks WRITE setStaticMapRefuseSymlinks NOTIFY changed)
+    void setStaticMapRefuseSymlinks(bool enable);
+    bool staticMapRefuseSymlinks() const;
+
     /**
      * Defines if a master process should be created to watch for it's
      * child processes
@@ -400,6 +485,17 @@ public:
     void setReusePort(bool enable);
     bool reusePort() const;
 
+    /**
+     * Attach a SO_ATTACH_REUSEPORT_CBPF program to the SO_REUSEPORT sockets so that
+     * connections are accepted by the worker thread pinned to the CPU that received them,
+     * requires reuse_port and works best with cpu_affinity set to 1
+     * @accessors reusePortCbpf(), setReusePortCbpf()
+     * \note Linux 4.6+ only
+     */
+    Q_PROPERTY(bool reuse_port_cbpf READ reusePortCbpf WRITE setReusePortCbpf NOTIFY changed)
+    void setReusePortCbpf(bool enable);
+    bool reusePortCbpf() const;
+
     /**
      * Defines is the Application should be lazy loaded.
      * @accessors lazy(), setLazy()
@@ -91,8 +91,14 @@ public:
     bool noInitgroups = false;
     int cpuAffinity = 0;
     bool reusePort = false;
+    bool reusePortCbpf = false;
     qint64 postBuffering = -1;
     qint64 postBufferingBufsize = 4096;
+    qint64 bodyMinRate = 0;
+    qint64 staticMapCacheSize = 0;
+    qint64 staticMapCacheFileSize = 64 * 1024;
+    QString staticMapImmutable;
+    StaticFileCache *staticCache = nullptr;
     Protocol *protoHTTP = nullptr;
     ProtocolHttp2 *protoHTTP2 = nullptr;
     Protocol *protoFCGI = nullptr;
@@ -104,6 +110,9 @@ public:
     int socketSendBuf = -1;
     int socketReceiveBuf = -1;
     int socketTimeout = 4;
+    int headerTimeout = 0;
+    int bodyTimeout = 0;
+    int maxConnectionsPerIp = 0;
     int websocketMaxSize = 1024 * 1024;
     bool lazy = false;
     bool master = false;
@@ -115,6 +124,8 @@ public:
     bool upgradeH2c = false;
     bool httpsH2 = false;
     bool usingFrontendProxy = false;
+    bool staticMapFastPath = false;
+    bool staticMapRefuseSymlinks = false;
 
 Q_SIGNALS:
     void postForked(int workerId);